@@ -0,0 +1,471 @@
+/*
+ * Benchmark for the diff engine.
+ *
+ * Generates pairs of texts for a few kinds of change and times each way of
+ * diffing them:
+ *   chars        - myers_diff(), the character-level diff of two strings
+ *   lines        - line_table_new() on both sides plus myers_diff_sequence()
+ *   stats        - line_table_new() on both sides plus myers_diff_stats()
+ *   perform_diff - perform_diff() on two files, reading them included
+ *
+ * Corpora (left is generated, right is derived from it):
+ *   small_edits      - source-like text with about one line in 500 changed
+ *   random           - two unrelated texts drawn from the same 64 lines
+ *   append_only      - a log with 5% more lines appended
+ *   reordered_blocks - the same 64 blocks in shuffled order
+ *   binary           - random bytes with 1% of them changed
+ *
+ * Output is one JSON object per line: median seconds over the runs, MB/s of
+ * left + right input, peak RSS during the run and, on glibc, the number of
+ * malloc/calloc/realloc calls and bytes requested in one run. "result" is
+ * the op count for chars and perform_diff, the edit run count for lines and
+ * the changed line count for stats, as a cheap check that a change to an
+ * algorithm did not change its answer.
+ *
+ * Sizes default to 16 KB, 1 MB and 8 MB. Cases that are quadratic in the
+ * number of differences (chars above 16 KB, random and binary above 1 MB)
+ * are skipped unless --all is given.
+ *
+ * Usage: bench_diff.exe [--all] [--size KB]... [--corpus NAME] [--algorithm NAME]
+ */
+#include "diff_logic.h"
+#include "line_table.h"
+#include "myers_diff.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef G_OS_WIN32
+#include <sys/resource.h>
+#endif
+
+#define MIN_RUNS 3
+#define MIN_SECONDS 0.5
+
+// ---
+// --- Allocation counting
+// ---
+
+/* glibc exports its allocator under __libc_* names, so wrapping it needs no dlsym */
+#if defined(__GLIBC__)
+#define HAVE_ALLOC_COUNTS 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gboolean counting;
+static guint64 alloc_calls;
+static guint64 alloc_bytes;
+
+void *malloc(size_t size) {
+    if (counting) { alloc_calls++; alloc_bytes += size; }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    if (counting) { alloc_calls++; alloc_bytes += n * size; }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (counting) { alloc_calls++; alloc_bytes += size; }
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+// ---
+// --- Memory
+// ---
+
+/* VmRSS or VmHWM from /proc/self/status in KB, or -1 where there is no procfs */
+static long proc_status_kb(const char *field) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    gsize len = strlen(field);
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, field, len) == 0 && line[len] == ':') {
+            kb = strtol(line + len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* Start a new high-water mark so the next peak belongs to one case (Linux only) */
+static gboolean reset_peak_rss(void) {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f) return FALSE;
+    gboolean ok = fputs("5", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+static long peak_rss_kb(void) {
+    long kb = proc_status_kb("VmHWM");
+    if (kb >= 0) return kb;
+#ifdef G_OS_WIN32
+    return -1;
+#else
+    /* Without procfs this is the peak for the whole process so far */
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// ---
+// --- Corpora
+// ---
+
+typedef struct {
+    gchar *left;
+    gsize left_len;
+    gchar *right;
+    gsize right_len;
+    gchar *left_path;       /* written on first use by perform_diff */
+    gchar *right_path;
+} Corpus;
+
+static const char *code_words[] = {"alpha", "beta", "gamma", "delta", "count", "value", "index", "buffer",
+                                   "return", "const", "static", "int", "char", "if", "else", "while"};
+
+static void append_code_line(GString *out, GRand *rand) {
+    guint indent = g_rand_int_range(rand, 0, 4) * 4;
+    for (guint i = 0; i < indent; ++i) g_string_append_c(out, ' ');
+    guint words = g_rand_int_range(rand, 2, 9);
+    for (guint i = 0; i < words; ++i) {
+        if (i) g_string_append_c(out, ' ');
+        g_string_append(out, code_words[g_rand_int_range(rand, 0, G_N_ELEMENTS(code_words))]);
+    }
+    g_string_append_printf(out, "; // %u\n", g_rand_int(rand) % 10000);
+}
+
+static void append_log_line(GString *out, GRand *rand, guint n) {
+    static const char *levels[] = {"INFO", "INFO", "INFO", "WARN", "DEBUG", "ERROR"};
+    g_string_append_printf(out, "2024-01-01T%02u:%02u:%02u.%03u %s request %u took %u ms\n",
+                           (n / 3600000) % 24, (n / 60000) % 60, (n / 1000) % 60, n % 1000,
+                           levels[g_rand_int_range(rand, 0, G_N_ELEMENTS(levels))],
+                           g_rand_int(rand) % 100000, g_rand_int_range(rand, 1, 2000));
+}
+
+/* Offsets of each line start in text, plus the end */
+static GArray *line_starts(const char *text, gsize len) {
+    GArray *starts = g_array_new(FALSE, FALSE, sizeof(gsize));
+    gsize pos = 0;
+    while (pos < len) {
+        g_array_append_val(starts, pos);
+        const char *nl = memchr(text + pos, '\n', len - pos);
+        pos = nl ? (gsize)(nl - text) + 1 : len;
+    }
+    g_array_append_val(starts, len);
+    return starts;
+}
+
+static void make_small_edits(Corpus *c, gsize target, GRand *rand) {
+    GString *left = g_string_sized_new(target + 128);
+    while (left->len < target) append_code_line(left, rand);
+
+    GString *right = g_string_sized_new(target + target / 64);
+    GArray *starts = line_starts(left->str, left->len);
+    for (guint i = 0; i + 1 < starts->len; ++i) {
+        gsize s = g_array_index(starts, gsize, i), e = g_array_index(starts, gsize, i + 1);
+        switch (g_rand_int_range(rand, 0, 1500)) {
+        case 0: break;                                                          /* delete */
+        case 1: append_code_line(right, rand); break;                           /* replace */
+        case 2: append_code_line(right, rand); /* fall through: insert before */
+        default: g_string_append_len(right, left->str + s, (gssize)(e - s));
+        }
+    }
+    g_array_unref(starts);
+    c->left_len = left->len; c->left = g_string_free(left, FALSE);
+    c->right_len = right->len; c->right = g_string_free(right, FALSE);
+}
+
+static void make_random(Corpus *c, gsize target, GRand *rand) {
+    GString *vocabulary[64];
+    for (guint i = 0; i < G_N_ELEMENTS(vocabulary); ++i) {
+        vocabulary[i] = g_string_new(NULL);
+        append_code_line(vocabulary[i], rand);
+    }
+    GString *sides[2];
+    for (guint s = 0; s < 2; ++s) {
+        sides[s] = g_string_sized_new(target + 128);
+        while (sides[s]->len < target) {
+            GString *line = vocabulary[g_rand_int_range(rand, 0, G_N_ELEMENTS(vocabulary))];
+            g_string_append_len(sides[s], line->str, (gssize)line->len);
+        }
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(vocabulary); ++i) g_string_free(vocabulary[i], TRUE);
+    c->left_len = sides[0]->len; c->left = g_string_free(sides[0], FALSE);
+    c->right_len = sides[1]->len; c->right = g_string_free(sides[1], FALSE);
+}
+
+static void make_append_only(Corpus *c, gsize target, GRand *rand) {
+    GString *log = g_string_sized_new(target + target / 16);
+    guint n = 0;
+    while (log->len < target) append_log_line(log, rand, n++);
+    gsize left_len = log->len;
+    while (log->len < target + target / 20) append_log_line(log, rand, n++);
+    c->left_len = left_len;
+    c->left = g_strndup(log->str, left_len);
+    c->right_len = log->len;
+    c->right = g_string_free(log, FALSE);
+}
+
+static void make_reordered_blocks(Corpus *c, gsize target, GRand *rand) {
+    GString *left = g_string_sized_new(target + 128);
+    while (left->len < target) append_code_line(left, rand);
+
+    /* 64 blocks cut at line boundaries, then put back in shuffled order */
+    GArray *starts = line_starts(left->str, left->len);
+    guint n_lines = starts->len - 1;
+    guint n_blocks = MIN(64, MAX(n_lines, 1));
+    guint order[64];
+    for (guint i = 0; i < n_blocks; ++i) order[i] = i;
+    for (guint i = n_blocks - 1; i > 0; --i) {
+        guint j = g_rand_int_range(rand, 0, i + 1);
+        guint t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+    GString *right = g_string_sized_new(left->len);
+    for (guint i = 0; i < n_blocks; ++i) {
+        gsize s = g_array_index(starts, gsize, (gsize)n_lines * order[i] / n_blocks);
+        gsize e = g_array_index(starts, gsize, (gsize)n_lines * (order[i] + 1) / n_blocks);
+        g_string_append_len(right, left->str + s, (gssize)(e - s));
+    }
+    g_array_unref(starts);
+    c->left_len = left->len; c->left = g_string_free(left, FALSE);
+    c->right_len = right->len; c->right = g_string_free(right, FALSE);
+}
+
+static void make_binary(Corpus *c, gsize target, GRand *rand) {
+    c->left = g_malloc(target + 1);
+    for (gsize i = 0; i < target; ++i) c->left[i] = (char)g_rand_int_range(rand, 0, 256);
+    c->left[target] = '\0';
+    c->left_len = target;
+    c->right = g_memdup2(c->left, target + 1);
+    c->right_len = target;
+    for (gsize i = 0; i < target / 100; ++i) {
+        c->right[g_rand_int_range(rand, 0, (gint32)MIN(target, G_MAXINT32))] = (char)g_rand_int_range(rand, 0, 256);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*make)(Corpus *c, gsize target, GRand *rand);
+    gsize default_limit;    /* largest size run without --all, 0 = none */
+} CorpusKind;
+
+static const CorpusKind corpora[] = {
+    {"small_edits", make_small_edits, 0},
+    {"random", make_random, 1024 * 1024},
+    {"append_only", make_append_only, 0},
+    {"reordered_blocks", make_reordered_blocks, 0},
+    {"binary", make_binary, 1024 * 1024},
+};
+
+static void corpus_clear(Corpus *c) {
+    if (c->left_path) { g_remove(c->left_path); g_free(c->left_path); }
+    if (c->right_path) { g_remove(c->right_path); g_free(c->right_path); }
+    g_free(c->left);
+    g_free(c->right);
+    memset(c, 0, sizeof(*c));
+}
+
+static gchar *write_temp(const char *data, gsize len) {
+    gchar *path = NULL;
+    int fd = g_file_open_tmp("diff_bench_XXXXXX", &path, NULL);
+    if (fd < 0) return NULL;
+    g_close(fd, NULL);
+    if (!g_file_set_contents(path, data, (gssize)len, NULL)) {
+        g_remove(path);
+        g_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+// ---
+// --- Algorithms
+// ---
+
+/* Each returns the size of its result (ops, edit runs or changed lines), or -1 if it could not run */
+static gint64 run_chars(Corpus *c) {
+    /* myers_diff works on C strings; binary input would be cut at the first NUL */
+    if (memchr(c->left, '\0', c->left_len) || memchr(c->right, '\0', c->right_len)) return -1;
+    Arena *arena = arena_new(0);
+    GArray *ops = myers_diff(c->left, c->right, arena);
+    gint64 n = ops->len;
+    g_array_unref(ops);
+    arena_free(arena);
+    return n;
+}
+
+static gint64 run_lines(Corpus *c) {
+    LineTable *left = line_table_new(c->left, c->left_len);
+    LineTable *right = line_table_new(c->right, c->right_len);
+    GArray *edits = myers_diff_sequence(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                        &g_array_index(right->hashes, guint64, 0), right->n_lines);
+    gint64 n = edits->len;
+    g_array_unref(edits);
+    line_table_free(left);
+    line_table_free(right);
+    return n;
+}
+
+static gint64 run_stats(Corpus *c) {
+    LineTable *left = line_table_new(c->left, c->left_len);
+    LineTable *right = line_table_new(c->right, c->right_len);
+    guint inserted = 0, deleted = 0;
+    myers_diff_stats(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                     &g_array_index(right->hashes, guint64, 0), right->n_lines, 0, &inserted, &deleted);
+    line_table_free(left);
+    line_table_free(right);
+    return (gint64)inserted + deleted;
+}
+
+static gint64 run_perform_diff(Corpus *c) {
+    GArray *ops = perform_diff(c->left_path, c->right_path, NULL);
+    if (!ops) return -1;
+    gint64 n = ops->len;
+    g_array_unref(ops);
+    return n;
+}
+
+typedef struct {
+    const char *name;
+    gint64 (*run)(Corpus *c);
+    gsize default_limit;
+} Algorithm;
+
+static const Algorithm algorithms[] = {
+    {"chars", run_chars, 16 * 1024},
+    {"lines", run_lines, 0},
+    {"stats", run_stats, 0},
+    {"perform_diff", run_perform_diff, 0},
+};
+
+// ---
+// --- Driver
+// ---
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_case(const char *corpus, const Algorithm *algo, Corpus *c, gsize target) {
+    if (g_strcmp0(algo->name, "perform_diff") == 0 && !c->left_path) {
+        c->left_path = write_temp(c->left, c->left_len);
+        c->right_path = write_temp(c->right, c->right_len);
+        if (!c->left_path || !c->right_path) {
+            g_printerr("diff_bench: could not write temporary files\n");
+            return;
+        }
+    }
+
+    /* The first run is also the one measured for memory and allocations */
+    gboolean fresh_peak = reset_peak_rss();
+    long rss_before = proc_status_kb("VmRSS");
+#ifdef HAVE_ALLOC_COUNTS
+    alloc_calls = alloc_bytes = 0;
+    counting = TRUE;
+#endif
+    gint64 start = g_get_monotonic_time();
+    gint64 result = algo->run(c);
+    double first = (g_get_monotonic_time() - start) / 1e6;
+#ifdef HAVE_ALLOC_COUNTS
+    counting = FALSE;
+#endif
+    long peak = peak_rss_kb();
+    if (result < 0) return;
+
+    GArray *times = g_array_new(FALSE, FALSE, sizeof(double));
+    g_array_append_val(times, first);
+    double total = first;
+    while (times->len < MIN_RUNS || total < MIN_SECONDS) {
+        start = g_get_monotonic_time();
+        algo->run(c);
+        double t = (g_get_monotonic_time() - start) / 1e6;
+        g_array_append_val(times, t);
+        total += t;
+    }
+    qsort(times->data, times->len, sizeof(double), compare_doubles);
+    double median = g_array_index(times, double, times->len / 2);
+
+    gsize bytes = c->left_len + c->right_len;
+    printf("{\"bench\":\"diff\",\"corpus\":\"%s\",\"algorithm\":\"%s\",\"size\":%" G_GSIZE_FORMAT
+           ",\"bytes\":%" G_GSIZE_FORMAT ",\"result\":%" G_GINT64_FORMAT ",\"runs\":%u,"
+           "\"seconds\":%.6f,\"mb_per_s\":%.2f,",
+           corpus, algo->name, target, bytes, result, times->len,
+           median, median > 0 ? bytes / median / (1024.0 * 1024.0) : 0.0);
+    /* Peak RSS is per case only where the high-water mark could be reset */
+    printf("\"peak_rss_kb\":%ld,\"rss_growth_kb\":", peak);
+    if (fresh_peak && rss_before >= 0) printf("%ld,", peak - rss_before);
+    else printf("null,");
+#ifdef HAVE_ALLOC_COUNTS
+    printf("\"allocs\":%" G_GUINT64_FORMAT ",\"alloc_bytes\":%" G_GUINT64_FORMAT "}\n", alloc_calls, alloc_bytes);
+#else
+    printf("\"allocs\":null,\"alloc_bytes\":null}\n");
+#endif
+    fflush(stdout);
+    g_array_unref(times);
+}
+
+int main(int argc, char **argv) {
+    gboolean all = FALSE;
+    const char *only_corpus = NULL, *only_algorithm = NULL;
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = TRUE;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            gsize kb = g_ascii_strtoull(argv[++i], NULL, 10);
+            if (kb == 0) { g_printerr("diff_bench: bad --size %s\n", argv[i]); return 2; }
+            kb *= 1024;
+            g_array_append_val(sizes, kb);
+        } else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            only_corpus = argv[++i];
+        } else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc) {
+            only_algorithm = argv[++i];
+        } else {
+            g_printerr("usage: %s [--all] [--size KB]... [--corpus NAME] [--algorithm NAME]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sizes->len == 0) {
+        const gsize defaults[] = {16 * 1024, 1024 * 1024, 8 * 1024 * 1024};
+        g_array_append_vals(sizes, defaults, G_N_ELEMENTS(defaults));
+    }
+
+    for (guint k = 0; k < G_N_ELEMENTS(corpora); ++k) {
+        const CorpusKind *kind = &corpora[k];
+        if (only_corpus && g_strcmp0(only_corpus, kind->name) != 0) continue;
+        for (guint s = 0; s < sizes->len; ++s) {
+            gsize target = g_array_index(sizes, gsize, s);
+            if (!all && kind->default_limit && target > kind->default_limit) continue;
+
+            GRand *rand = g_rand_new_with_seed(42 + k);
+            Corpus corpus = {0};
+            kind->make(&corpus, target, rand);
+            g_rand_free(rand);
+
+            for (guint a = 0; a < G_N_ELEMENTS(algorithms); ++a) {
+                const Algorithm *algo = &algorithms[a];
+                if (only_algorithm && g_strcmp0(only_algorithm, algo->name) != 0) continue;
+                if (!all && algo->default_limit && target > algo->default_limit) continue;
+                bench_case(kind->name, algo, &corpus, target);
+            }
+            corpus_clear(&corpus);
+        }
+    }
+    g_array_unref(sizes);
+    return 0;
+}
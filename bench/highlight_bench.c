@@ -0,0 +1,102 @@
+/*
+ * Benchmark for the compare window's highlighting stage.
+ *
+ * Builds synthetic "latest file" texts from 1 MB to 10 MB with roughly one
+ * changed word in ten, then times two ways of producing the tagged buffer:
+ *   linear - diff_highlight_append(), appending text and tags in one pass
+ *   offset - set_text followed by two gtk_text_buffer_get_iter_at_offset()
+ *            lookups per span (the previous approach)
+ *
+ * Output is one JSON object per line. ns_per_byte staying flat as bytes grow
+ * is what "linear" means here. The offset method is only run up to 2 MB by
+ * default because it gets slow; pass --all to run it at every size.
+ */
+#include "diff_highlight.h"
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SPAN_BATCH 512
+
+static gchar *make_text(gsize target, GArray *spans, guint32 seed) {
+    static const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+                                  "return", "value", "const", "static", "int", "char", "if", "else"};
+    GRand *rand = g_rand_new_with_seed(seed);
+    GString *text = g_string_sized_new(target + 64);
+    guint word_no = 0;
+    while (text->len < target) {
+        const char *w = words[g_rand_int_range(rand, 0, G_N_ELEMENTS(words))];
+        gsize start = text->len;
+        g_string_append(text, w);
+        if (g_rand_int_range(rand, 0, 10) == 0) {
+            DiffSpan span = { start, text->len };
+            g_array_append_val(spans, span);
+        }
+        g_string_append_c(text, (++word_no % 12) == 0 ? '\n' : ' ');
+    }
+    g_rand_free(rand);
+    return g_string_free(text, FALSE);
+}
+
+static double run_linear(const char *text, gsize length, GArray *spans) {
+    GtkTextBuffer *buffer = gtk_text_buffer_new(NULL);
+    GtkTextTag *tag = gtk_text_buffer_create_tag(buffer, "diff-insert", "underline", PANGO_UNDERLINE_SINGLE, NULL);
+    gint64 start = g_get_monotonic_time();
+    gsize cursor = 0;
+    /* Same batching as the compare window: a batch covers text up to its last span */
+    for (guint i = 0; i < spans->len; i += SPAN_BATCH) {
+        guint n = MIN(SPAN_BATCH, spans->len - i);
+        const DiffSpan *batch = &g_array_index(spans, DiffSpan, i);
+        diff_highlight_append(buffer, tag, text, &cursor, batch, n, batch[n - 1].end);
+    }
+    diff_highlight_append(buffer, tag, text, &cursor, NULL, 0, length);
+    double seconds = (g_get_monotonic_time() - start) / 1e6;
+    g_object_unref(buffer);
+    return seconds;
+}
+
+static double run_offset(const char *text, gsize length, GArray *spans) {
+    GtkTextBuffer *buffer = gtk_text_buffer_new(NULL);
+    gtk_text_buffer_create_tag(buffer, "diff-insert", "underline", PANGO_UNDERLINE_SINGLE, NULL);
+    gint64 start = g_get_monotonic_time();
+    gtk_text_buffer_set_text(buffer, text, (int)length);
+    for (guint i = 0; i < spans->len; ++i) {
+        const DiffSpan *span = &g_array_index(spans, DiffSpan, i);
+        GtkTextIter s, e;
+        /* The text is ASCII, so byte offsets are character offsets */
+        gtk_text_buffer_get_iter_at_offset(buffer, &s, (int)span->start);
+        gtk_text_buffer_get_iter_at_offset(buffer, &e, (int)span->end);
+        gtk_text_buffer_apply_tag_by_name(buffer, "diff-insert", &s, &e);
+    }
+    double seconds = (g_get_monotonic_time() - start) / 1e6;
+    g_object_unref(buffer);
+    return seconds;
+}
+
+static void report(const char *method, gsize bytes, guint spans, double seconds) {
+    printf("{\"bench\":\"highlight\",\"method\":\"%s\",\"bytes\":%" G_GSIZE_FORMAT ",\"spans\":%u,"
+           "\"seconds\":%.6f,\"ns_per_byte\":%.3f}\n",
+           method, bytes, spans, seconds, seconds * 1e9 / (double)bytes);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    gboolean all = argc > 1 && strcmp(argv[1], "--all") == 0;
+    const gsize sizes_mb[] = {1, 2, 4, 6, 8, 10};
+
+    for (guint i = 0; i < G_N_ELEMENTS(sizes_mb); ++i) {
+        gsize target = sizes_mb[i] * 1024 * 1024;
+        GArray *spans = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+        gchar *text = make_text(target, spans, 42);
+        gsize length = strlen(text);
+
+        report("linear", length, spans->len, run_linear(text, length, spans));
+        if (all || sizes_mb[i] <= 2) {
+            report("offset", length, spans->len, run_offset(text, length, spans));
+        }
+
+        g_free(text);
+        g_array_unref(spans);
+    }
+    return 0;
+}
@@ -0,0 +1,399 @@
+/*
+ * Benchmark for the data/ directory: the versions index, stored copies and
+ * the tracked files list, driven through version_store.
+ *
+ * For each history size (versions of one tracked file) a fresh data
+ * directory is built in a temporary directory, with that many stored copies
+ * and index entries, and a files index listing the tracked files. Then each
+ * operation is timed over a number of samples:
+ *   record     - version_store_record(), as "Record version" does
+ *   list       - version_store_list(path), the index read behind the
+ *                versions pane (populate_versions_for_path() parses the same
+ *                index before building its rows)
+ *   list_all   - version_store_list(NULL), as the batch manifest does
+ *   index_sync - trigram_index_sync() over the whole history (one sample),
+ *                as the first search in a data directory indexed before
+ *                the trigram index existed does
+ *   search     - trigram_index_search() for one version's contents, as the
+ *                versions pane search does
+ *   delete     - version_store_delete() of a recorded version
+ *   track      - version_store_track_file() of a new path
+ *   untrack    - version_store_untrack_file() of a tracked path
+ *
+ * Before the histories, chunk_store_split() is run over CHUNK_BENCH_BYTES of
+ * pseudo-random data and its throughput reported, the cut-point search
+ * version_store_record() does before hashing and writing chunks.
+ *
+ * Output is one JSON object per line with latency percentiles in
+ * microseconds and, where /proc/self/io exists, the mean bytes read and
+ * written per operation (rchar/wchar, so cached reads count too).
+ *
+ * Defaults: 10, 1000 and 100000 versions, 10000 tracked files, 100 samples.
+ *
+ * Usage: bench_store.exe [--versions N]... [--files N] [--samples N] [--keep]
+ */
+#include "version_store.h"
+#include "trigram_index.h"
+#include "chunk_store.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__has_include)
+# if __has_include(<json-glib/json-glib.h>)
+/* Same check as version_store.c, so the synthetic index is in the format it reads */
+#  define HAVE_JSON_GLIB 1
+# endif
+#endif
+
+#define TRACKED_NAME "tracked.txt"
+#define CHUNK_BENCH_BYTES (256 * 1024 * 1024)
+
+// ---
+// --- Measurements
+// ---
+
+typedef struct {
+    guint64 read;
+    guint64 written;
+} IoCounters;
+
+/* Bytes passed to read/write-like calls so far; FALSE where there is no /proc/self/io */
+static gboolean io_counters(IoCounters *io) {
+    FILE *f = fopen("/proc/self/io", "r");
+    if (!f) return FALSE;
+    char line[128];
+    memset(io, 0, sizeof(*io));
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "rchar:", 6) == 0) io->read = g_ascii_strtoull(line + 6, NULL, 10);
+        else if (strncmp(line, "wchar:", 6) == 0) io->written = g_ascii_strtoull(line + 6, NULL, 10);
+    }
+    fclose(f);
+    return TRUE;
+}
+
+typedef struct {
+    const char *op;
+    GArray *micros;     /* gdouble per sample */
+    gboolean have_io;
+    IoCounters io_start;
+    IoCounters io_total;
+    gint64 started;
+} OpStats;
+
+static void op_init(OpStats *stats, const char *op) {
+    memset(stats, 0, sizeof(*stats));
+    stats->op = op;
+    stats->micros = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stats->have_io = TRUE;
+}
+
+static void op_begin(OpStats *stats) {
+    stats->have_io = stats->have_io && io_counters(&stats->io_start);
+    stats->started = g_get_monotonic_time();
+}
+
+static void op_end(OpStats *stats) {
+    gdouble us = (gdouble)(g_get_monotonic_time() - stats->started);
+    g_array_append_val(stats->micros, us);
+    IoCounters now;
+    if (stats->have_io && io_counters(&now)) {
+        stats->io_total.read += now.read - stats->io_start.read;
+        stats->io_total.written += now.written - stats->io_start.written;
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return x < y ? -1 : x > y;
+}
+
+static gdouble percentile(GArray *sorted, gdouble p) {
+    guint i = (guint)(p * (sorted->len - 1) + 0.5);
+    return g_array_index(sorted, gdouble, i);
+}
+
+static void op_report(OpStats *stats, guint versions, guint files) {
+    GArray *m = stats->micros;
+    if (m->len > 0) {
+        qsort(m->data, m->len, sizeof(gdouble), compare_doubles);
+        printf("{\"bench\":\"store\",\"op\":\"%s\",\"versions\":%u,\"files\":%u,\"samples\":%u,"
+               "\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,",
+               stats->op, versions, files, m->len,
+               percentile(m, 0.50), percentile(m, 0.90), percentile(m, 0.99), g_array_index(m, gdouble, m->len - 1));
+        if (stats->have_io) {
+            printf("\"read_bytes\":%.0f,\"write_bytes\":%.0f}\n",
+                   (gdouble)stats->io_total.read / m->len, (gdouble)stats->io_total.written / m->len);
+        } else {
+            printf("\"read_bytes\":null,\"write_bytes\":null}\n");
+        }
+        fflush(stdout);
+    }
+    g_array_unref(m);
+}
+
+// ---
+// --- Synthetic data directory
+// ---
+
+static gboolean remove_tree(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        if (dir) {
+            const char *name;
+            while ((name = g_dir_read_name(dir))) {
+                gchar *child = g_build_filename(path, name, NULL);
+                remove_tree(child);
+                g_free(child);
+            }
+            g_dir_close(dir);
+        }
+    }
+    return g_remove(path) == 0;
+}
+
+static void append_index_entry(GString *index, const char *original, const char *stored, const char *timestamp) {
+#ifdef HAVE_JSON_GLIB
+    /* The generated paths need no escaping */
+    g_string_append_printf(index, "%s{\"original\":\"%s\",\"stored\":\"%s\",\"timestamp\":\"%s\"}",
+                           index->len > 1 ? "," : "", original, stored, timestamp);
+#else
+    g_string_append_printf(index, "%s|%s|%s\n", original, stored, timestamp);
+#endif
+}
+
+/*
+ * data/ with 'versions' stored copies of 'tracked' and 'files' lines in the
+ * files index (the tracked file plus others). Stored names follow the
+ * <base>_<timestamp>.<ext> pattern of real recordings.
+ */
+static gboolean build_data_dir(const char *tracked, guint versions, guint files) {
+    gchar *versions_dir = g_build_filename("data", "versions", NULL);
+    g_mkdir_with_parents(versions_dir, 0755);
+
+#ifdef HAVE_JSON_GLIB
+    GString *index = g_string_new("[");
+#else
+    GString *index = g_string_new(NULL);
+#endif
+    gboolean ok = TRUE;
+    for (guint i = 0; i < versions && ok; ++i) {
+        /* One version per second starting 2024-01-01, spread over days as needed */
+        guint day = i / 86400, sec = i % 86400;
+        gchar *timestamp = g_strdup_printf("2024%02u%02u%02u%02u%02u", 1 + day / 28 % 12, 1 + day % 28,
+                                           sec / 3600, sec / 60 % 60, sec % 60);
+        gchar *stored = g_strdup_printf("tracked_%s.txt", timestamp);
+        gchar *stored_path = g_build_filename(versions_dir, stored, NULL);
+        gchar *contents = g_strdup_printf("version %u\n", i);
+        ok = g_file_set_contents(stored_path, contents, -1, NULL);
+        append_index_entry(index, tracked, stored, timestamp);
+        g_free(contents);
+        g_free(stored_path);
+        g_free(stored);
+        g_free(timestamp);
+    }
+#ifdef HAVE_JSON_GLIB
+    g_string_append(index, "]");
+    gchar *index_path = g_build_filename("data", "versions_index.json", NULL);
+#else
+    gchar *index_path = g_build_filename("data", "versions_index.txt", NULL);
+#endif
+    ok = ok && g_file_set_contents(index_path, index->str, (gssize)index->len, NULL);
+    g_free(index_path);
+    g_string_free(index, TRUE);
+
+    GString *files_index = g_string_new(NULL);
+    g_string_append_printf(files_index, "%s\n", tracked);
+    for (guint i = 1; i < files; ++i) g_string_append_printf(files_index, "/home/user/project/src/file_%05u.c\n", i);
+    gchar *files_path = g_build_filename("data", "files_index.txt", NULL);
+    ok = ok && g_file_set_contents(files_path, files_index->str, (gssize)files_index->len, NULL);
+    g_free(files_path);
+    g_string_free(files_index, TRUE);
+
+    g_free(versions_dir);
+    return ok;
+}
+
+// ---
+// --- Driver
+// ---
+
+static void bench_chunking(void) {
+    guint8 *data = g_malloc(CHUNK_BENCH_BYTES);
+    guint64 x = 88172645463325252ull;
+    for (gsize i = 0; i < CHUNK_BENCH_BYTES; ++i) {
+        /* xorshift64 */
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (guint8)x;
+    }
+    gint64 started = g_get_monotonic_time();
+    GArray *lengths = chunk_store_split(data, CHUNK_BENCH_BYTES);
+    gdouble seconds = (g_get_monotonic_time() - started) / 1e6;
+    printf("{\"bench\":\"store\",\"op\":\"chunk\",\"bytes\":%d,\"chunks\":%u,\"mean_chunk\":%.0f,"
+           "\"mb_per_s\":%.1f}\n",
+           CHUNK_BENCH_BYTES, lengths->len, (gdouble)CHUNK_BENCH_BYTES / MAX(lengths->len, 1),
+           CHUNK_BENCH_BYTES / 1e6 / MAX(seconds, 1e-9));
+    fflush(stdout);
+    g_array_unref(lengths);
+    g_free(data);
+}
+
+static void bench_history(const char *tracked, guint versions, guint files, guint samples) {
+    if (!build_data_dir(tracked, versions, files)) {
+        g_printerr("store_bench: could not build a data directory with %u versions\n", versions);
+        return;
+    }
+
+    OpStats stats;
+    GPtrArray *recorded = g_ptr_array_new_with_free_func(g_free);
+
+    op_init(&stats, "record");
+    for (guint i = 0; i < samples; ++i) {
+        GError *error = NULL;
+        op_begin(&stats);
+        gchar *stored = version_store_record(tracked, &error);
+        op_end(&stats);
+        if (!stored) {
+            g_printerr("store_bench: record failed: %s\n", error ? error->message : "unknown");
+            g_clear_error(&error);
+            break;
+        }
+        g_ptr_array_add(recorded, version_store_stored_path(stored));
+        g_free(stored);
+    }
+    op_report(&stats, versions, files);
+
+    op_init(&stats, "list");
+    for (guint i = 0; i < samples; ++i) {
+        op_begin(&stats);
+        GPtrArray *entries = version_store_list(tracked);
+        op_end(&stats);
+        g_ptr_array_free(entries, TRUE);
+    }
+    op_report(&stats, versions, files);
+
+    op_init(&stats, "list_all");
+    for (guint i = 0; i < samples; ++i) {
+        op_begin(&stats);
+        GPtrArray *entries = version_store_list(NULL);
+        op_end(&stats);
+        g_ptr_array_free(entries, TRUE);
+    }
+    op_report(&stats, versions, files);
+
+    op_init(&stats, "index_sync");
+    op_begin(&stats);
+    trigram_index_sync();
+    op_end(&stats);
+    op_report(&stats, versions, files);
+
+    op_init(&stats, "search");
+    for (guint i = 0; i < samples; ++i) {
+        /* Each synthetic version holds "version <n>\n", so this matches exactly one of them */
+        gchar *needle = g_strdup_printf("version %u\n", (guint)((guint64)i * 7919 % MAX(versions, 1)));
+        op_begin(&stats);
+        GHashTable *matches = trigram_index_search(needle, NULL);
+        op_end(&stats);
+        if (versions > 0 && g_hash_table_size(matches) != 1) {
+            g_printerr("store_bench: search for %s found %u versions\n", needle, g_hash_table_size(matches));
+        }
+        g_hash_table_unref(matches);
+        g_free(needle);
+    }
+    op_report(&stats, versions, files);
+
+    /* Newest first, like a user clearing out recent versions */
+    op_init(&stats, "delete");
+    for (guint i = recorded->len; i > 0; --i) {
+        GError *error = NULL;
+        op_begin(&stats);
+        gboolean ok = version_store_delete(g_ptr_array_index(recorded, i - 1), &error);
+        op_end(&stats);
+        if (!ok) {
+            g_printerr("store_bench: delete failed: %s\n", error ? error->message : "unknown");
+            g_clear_error(&error);
+            break;
+        }
+    }
+    op_report(&stats, versions, files);
+    g_ptr_array_free(recorded, TRUE);
+
+    op_init(&stats, "track");
+    for (guint i = 0; i < samples; ++i) {
+        gchar *path = g_strdup_printf("/home/user/project/new/file_%05u.c", i);
+        op_begin(&stats);
+        version_store_track_file(path);
+        op_end(&stats);
+        g_free(path);
+    }
+    op_report(&stats, versions, files);
+
+    op_init(&stats, "untrack");
+    for (guint i = 0; i < samples; ++i) {
+        gchar *path = g_strdup_printf("/home/user/project/new/file_%05u.c", i);
+        op_begin(&stats);
+        version_store_untrack_file(path);
+        op_end(&stats);
+        g_free(path);
+    }
+    op_report(&stats, versions, files);
+}
+
+int main(int argc, char **argv) {
+    GArray *histories = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint files = 10000, samples = 100;
+    gboolean keep = FALSE;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--versions") == 0 && i + 1 < argc) {
+            guint n = (guint)g_ascii_strtoull(argv[++i], NULL, 10);
+            g_array_append_val(histories, n);
+        } else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc) {
+            files = (guint)g_ascii_strtoull(argv[++i], NULL, 10);
+            files = MAX(files, 1);
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = (guint)g_ascii_strtoull(argv[++i], NULL, 10);
+            samples = MAX(samples, 1);
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            keep = TRUE;
+        } else {
+            g_printerr("usage: %s [--versions N]... [--files N] [--samples N] [--keep]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (histories->len == 0) {
+        const guint defaults[] = {10, 1000, 100000};
+        g_array_append_vals(histories, defaults, G_N_ELEMENTS(defaults));
+    }
+
+    bench_chunking();
+
+    /* version_store works on ./data, so each history gets its own working directory */
+    gchar *cwd = g_get_current_dir();
+    for (guint h = 0; h < histories->len; ++h) {
+        guint versions = g_array_index(histories, guint, h);
+        gchar *root = g_dir_make_tmp("store_bench_XXXXXX", NULL);
+        if (!root || g_chdir(root) != 0) {
+            g_printerr("store_bench: could not create a temporary directory\n");
+            g_free(root);
+            break;
+        }
+        gchar *tracked = g_build_filename(root, TRACKED_NAME, NULL);
+        g_file_set_contents(tracked, "line one\nline two\nline three\n", -1, NULL);
+
+        bench_history(tracked, versions, files, samples);
+
+        trigram_index_close();
+        g_chdir(cwd);
+        if (keep) g_printerr("store_bench: kept %s\n", root);
+        else remove_tree(root);
+        g_free(tracked);
+        g_free(root);
+    }
+    g_free(cwd);
+    g_array_unref(histories);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <glib.h>
+
+/**
+ * Bump-pointer allocator for the many small, same-lifetime allocations of
+ * one diff or compare session (tokens, ops, their texts).
+ *
+ * Memory comes from large chunks and is only released all at once by
+ * arena_free(); there is no per-allocation free. Allocations are aligned
+ * for any scalar type. Requests bigger than a quarter of the chunk size get
+ * a chunk of their own so they don't waste the rest of the current one.
+ * An arena is not thread-safe: use one per thread or per session.
+ */
+typedef struct _Arena Arena;
+
+typedef struct {
+    gsize allocations;  /* arena_alloc() calls */
+    gsize bytes;        /* bytes requested by them */
+    gsize chunks;       /* chunks obtained from the system allocator */
+    gsize reserved;     /* total size of those chunks */
+} ArenaStats;
+
+/* chunk_size = 0 means 64 KB */
+Arena *arena_new(gsize chunk_size);
+void arena_free(Arena *arena);
+
+gpointer arena_alloc(Arena *arena, gsize size);
+gpointer arena_alloc0(Arena *arena, gsize size);
+/* NUL-terminated copy of length bytes of text */
+gchar *arena_strndup(Arena *arena, const char *text, gsize length);
+
+void arena_get_stats(const Arena *arena, ArenaStats *stats);
+
+#endif // ARENA_H
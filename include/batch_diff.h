@@ -0,0 +1,22 @@
+#ifndef BATCH_DIFF_H
+#define BATCH_DIFF_H
+
+#include <glib.h>
+#include <stdio.h>
+
+/**
+ * Diff many file pairs in parallel and report on each as it finishes.
+ *
+ * The manifest has one pair per line, "<old path><TAB><new path>"; blank
+ * lines and lines starting with '#' are skipped. Pairs are diffed with
+ * perform_diff() on a WorkPool (n_threads = 0 for one per processor).
+ * Each finished pair is written to 'out' as one JSON object per line, in
+ * completion order, followed by a summary line.
+ * Returns 0 if every pair could be diffed and 2 otherwise.
+ */
+int batch_diff_run(const char *manifest_path, guint n_threads, FILE *out);
+
+/* Write a manifest pairing each tracked file's two most recent versions */
+void batch_diff_write_tracked_manifest(FILE *out);
+
+#endif // BATCH_DIFF_H
@@ -0,0 +1,52 @@
+#ifndef BINARY_DIFF_H
+#define BINARY_DIFF_H
+
+#include <glib.h>
+
+/* How much of a file binary detection looks at, the same as git */
+#define BINARY_DIFF_SNIFF_BYTES 8000
+
+/* TRUE if the data has a NUL byte in its first BINARY_DIFF_SNIFF_BYTES bytes */
+gboolean binary_diff_is_binary(const char *data, gsize length);
+/* The same test on the start of a file; FALSE if it can't be read */
+gboolean binary_diff_file_is_binary(const char *path);
+
+typedef enum {
+    BINARY_RUN_COPY,    /* bytes also found in the left data, at left_start */
+    BINARY_RUN_LITERAL  /* bytes not found in the left data; left_start is unused */
+} BinaryRunType;
+
+/* A run of the right data */
+typedef struct {
+    BinaryRunType type;
+    gsize left_start;
+    gsize right_start;
+    gsize length;
+} BinaryRun;
+
+/* A byte range [start, start + length) */
+typedef struct {
+    gsize start;
+    gsize length;
+} ByteRange;
+
+/**
+ * Block-matching diff of two byte strings, in the manner of rsync and xdelta.
+ *
+ * The left data is cut into blocks of block_size bytes (0 picks a size from
+ * the left length, about its square root), indexed by a polynomial hash. A
+ * window of the same size rolls over the right data one byte at a time; when
+ * its hash hits a block with the same bytes, the match is extended in both
+ * directions and the window jumps past it. Copies may come from anywhere in
+ * the left data, in any order, so moved and repeated blocks are found too.
+ *
+ * Returns BinaryRuns covering the right data in order. Expected time is
+ * linear in both lengths; memory is one index entry per left block.
+ */
+GArray *binary_diff(const guint8 *left, gsize left_length, const guint8 *right, gsize right_length,
+                    gsize block_size);
+
+/* Left ranges no COPY run of 'runs' reads from, in order (ByteRange) */
+GArray *binary_diff_unused(const GArray *runs, gsize left_length);
+
+#endif // BINARY_DIFF_H
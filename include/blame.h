@@ -0,0 +1,35 @@
+#ifndef BLAME_H
+#define BLAME_H
+
+#include "line_table.h"
+#include <glib.h>
+
+/**
+ * Per-line annotation of a tracked file's newest version: for each line, the
+ * recorded version that introduced it. Computed by walking the line diffs
+ * between consecutive versions in the index, oldest first; a line keeps its
+ * origin while it is unchanged and takes the version's index where inserted.
+ *
+ * The result is cached in data/blame/<sha256 of the path> as the stored names
+ * the walk covered plus the origins of the last one's lines. Later requests
+ * only diff the versions recorded since, and version_store_record() extends
+ * an existing cache by one diff. If a version in the cached chain has been
+ * deleted the walk starts over.
+ */
+
+typedef struct {
+    GPtrArray *versions;    /* VersionEntry*, oldest first */
+    GArray *origins;        /* guint per line of the newest version: index into versions */
+    gchar *text;            /* newest version's contents */
+    gsize length;
+    LineTable *lines;       /* line boundaries of text */
+} BlameResult;
+
+/* Annotate the newest recorded version of 'original_path'; NULL if it has none or one can't be read */
+BlameResult *blame_annotate(const char *original_path, GError **error);
+void blame_result_free(BlameResult *result);
+
+/* Bring an existing cache for 'original_path' up to date; does nothing if it was never annotated */
+gboolean blame_extend_cached(const char *original_path, GError **error);
+
+#endif // BLAME_H
@@ -0,0 +1,13 @@
+#ifndef BLAME_VIEW_H
+#define BLAME_VIEW_H
+
+#include <gtk/gtk.h>
+
+/**
+ * Window showing the newest recorded version of a tracked file with, beside
+ * each run of lines, the version that introduced them (see blame.h). The
+ * annotation is computed in a worker thread; the window shows up right away.
+ */
+void create_blame_window(GtkWindow *parent, const char *original_path);
+
+#endif // BLAME_VIEW_H
@@ -0,0 +1,126 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/**
+ * Content-defined chunk storage for recorded versions.
+ *
+ * Contents are cut into chunks with FastCDC (a gear rolling hash with
+ * normalized chunking), so an edit only changes the chunks around it and
+ * files that share regions share most of their chunks. Each distinct chunk is
+ * stored once, as data/chunks/<2 hex>/<sha256>. A stored file is then a chunk
+ * list next to where the file itself would be, "<path>.chunks": magic, a
+ * little-endian guint32 format version, total length and chunk count as
+ * varints, then per chunk its SHA-256 and a varint length.
+ *
+ * Reading a chunked file costs one chunk per CHUNK_AVG_SIZE bytes of it, however
+ * long the history behind it. Chunks read back are kept in an LRU of
+ * CHUNK_CACHE_BUDGET bytes shared by all files, so versions near one that was
+ * just read (which share most of its chunks) come mostly from memory, without
+ * disk reads or hash checks.
+ *
+ * Chunks are shared, so removing a chunk list leaves its chunks in place;
+ * chunk_store_collect() later removes those no list refers to any more.
+ * All functions are thread-safe.
+ */
+
+#define CHUNK_MIN_SIZE (2 * 1024)
+#define CHUNK_AVG_SIZE (8 * 1024)
+#define CHUNK_MAX_SIZE (64 * 1024)
+
+#define CHUNK_CACHE_BUDGET (64 * 1024 * 1024)
+
+/* Length of the first chunk of data[0, length) */
+gsize chunk_store_cut(const guint8 *data, gsize length);
+
+/* Lengths of all chunks of data, in order (guint32) */
+GArray *chunk_store_split(const guint8 *data, gsize length);
+
+typedef struct {
+    guint chunks;           /* chunks in the list */
+    guint new_chunks;       /* of which were not stored yet */
+    gsize new_bytes;        /* bytes written to data/chunks */
+} ChunkWriteStats;
+
+/* Store data as chunks and write its chunk list for 'path'; 'stats' may be NULL */
+gboolean chunk_store_write(const char *path, const char *data, gsize length, ChunkWriteStats *stats, GError **error);
+
+/* TRUE if 'path' has a chunk list */
+gboolean chunk_store_is_chunked(const char *path);
+
+/*
+ * Contents of 'path': the file itself if it exists, otherwise reassembled
+ * from its chunk list. Chunks are checked against their hashes.
+ */
+gboolean chunk_store_read_file(const char *path, gchar **contents, gsize *length, GError **error);
+
+/* Receives the contents of a file piece by piece, in order; returning FALSE stops the stream (set error if it failed) */
+typedef gboolean (*ChunkSink)(const char *data, gsize length, gpointer user_data, GError **error);
+
+/* Feed the contents of 'path' to sink, a chunk at a time, without holding all of it in memory; FALSE if it stopped */
+gboolean chunk_store_stream(const char *path, ChunkSink sink, gpointer user_data, GError **error);
+
+/* Stream the contents of 'path' into dest_path, replacing it atomically */
+gboolean chunk_store_export(const char *path, const char *dest_path, GError **error);
+
+/*
+ * A plain file with the contents of 'path', for code that needs a real file
+ * (mapping it, handing it to another app): 'path' itself unless it is chunked,
+ * otherwise a copy exported to the temp directory. Copies are named after the
+ * chunk list's hash and shared by every caller asking for the same contents;
+ * each call takes a hold on the copy, see chunk_store_release_materialized()
+ * and chunk_store_clear_materialized().
+ */
+gchar *chunk_store_materialize(const char *path, GError **error);
+
+/*
+ * chunk_store_materialize() in a worker thread, for the UI: rebuilding a large
+ * version takes a while. Cancelling stops the export between chunks; the
+ * callback then gets G_IO_ERROR_CANCELLED from _finish().
+ */
+void chunk_store_materialize_async(const char *path, GCancellable *cancellable, GAsyncReadyCallback callback,
+                                   gpointer user_data);
+gchar *chunk_store_materialize_finish(GAsyncResult *result, GError **error);
+
+/* Drop one hold on a copy made by chunk_store_materialize(), deleting it with the last; plain files it handed back are left alone */
+void chunk_store_release_materialized(const char *copy_path);
+
+/*
+ * Delete every materialized copy. Copies handed to other apps can't be
+ * released when those apps are done with them, so this runs at startup.
+ * Copies still open elsewhere (mapped, on Windows) are skipped.
+ */
+void chunk_store_clear_materialized(void);
+
+/* Length of the file, or of the chunked contents if there is no file; -1 if neither exists */
+gint64 chunk_store_file_length(const char *path);
+
+/*
+ * SHA-256 (hex) of the chunk list of 'path', which names its contents as
+ * well as a hash of them would: chunking is deterministic, so equal contents
+ * give equal lists. Reads only the list. NULL if 'path' is a plain file or
+ * has no list.
+ */
+gchar *chunk_store_content_id(const char *path);
+
+/* Remove the chunk list of 'path' */
+gboolean chunk_store_remove(const char *path, GError **error);
+
+typedef struct {
+    guint live_chunks;      /* chunks some list still refers to */
+    guint removed_chunks;
+    guint64 freed_bytes;
+} ChunkCollectStats;
+
+/*
+ * Mark and sweep: collect the digests named by every chunk list in
+ * 'lists_dir', then delete the chunk files under data/chunks that none of
+ * them names. Nothing is deleted if a list can't be read. Writes in this
+ * process wait while it runs; another process recording at the same time is
+ * not accounted for. 'stats' may be NULL.
+ */
+gboolean chunk_store_collect(const char *lists_dir, ChunkCollectStats *stats, GError **error);
+
+#endif // CHUNK_STORE_H
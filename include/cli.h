@@ -0,0 +1,27 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <glib.h>
+
+/**
+ * Command-line mode, for scripts and CI:
+ *   myapp --diff <old> <new>   unified diff on stdout (exit 0 same, 1 differ, 2 error)
+ *   myapp --record <path>      record a version of <path> and print its stored path
+ *   myapp --list <path>        print recorded versions of <path>, oldest first
+ *   myapp --show <stored>      print a recorded version, streamed from its chunks
+ *   myapp --restore <stored> <path>
+ *                              put <path> back to a recorded version
+ *   myapp --annotate <path>    newest version of <path>, each line prefixed with
+ *                              the version that introduced it
+ *   myapp --merge <base> <left> <right>
+ *                              three-way merge on stdout (exit 0 clean, 1 conflicts, 2 error)
+ *   myapp --batch <manifest> [threads]
+ *                              diff many pairs in parallel, JSON-lines report
+ *   myapp --tracked-pairs      manifest of each tracked file's last two versions
+ *
+ * None of these touch GTK. Returns FALSE if argv holds no command, in which
+ * case the UI should start; otherwise runs it and sets *status.
+ */
+gboolean cli_try_run(int argc, char **argv, int *status);
+
+#endif // CLI_H
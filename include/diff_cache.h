@@ -0,0 +1,70 @@
+#ifndef DIFF_CACHE_H
+#define DIFF_CACHE_H
+
+#include "diff_highlight.h"
+#include "hunk_index.h"
+#include <glib.h>
+
+/* How a comparison was computed; part of the cache key */
+typedef enum {
+    DIFF_ALGO_WORDS = 1,  /* word-by-word at the same positions (compare window) */
+    DIFF_ALGO_LINES = 2   /* line diff with moved blocks (compare window, "Compare Lines") */
+} DiffAlgorithm;
+
+/*
+ * Identifies one comparison. Both sides are identified by the SHA-256 of
+ * their contents rather than by path or mtime, so an entry can only ever be
+ * found for exactly the bytes it was computed from.
+ */
+typedef struct {
+    guint8 left[32];
+    guint8 right[32];
+    guint32 algorithm;
+    guint32 options;
+} DiffCacheKey;
+
+/* A block of lines moved from left_start in the left text to right_start in the right one */
+typedef struct {
+    guint left_start;
+    guint right_start;
+    guint length;
+} DiffMove;
+
+/* Everything the compare window needs to redisplay a comparison */
+typedef struct {
+    GArray *spans;      /* DiffSpan, byte offsets into the right text */
+    GArray *hunks;      /* DiffHunk, in right_start order */
+    GArray *moves;      /* DiffMove, in right_start order (DIFF_ALGO_LINES only) */
+    guint left_lines;
+    guint right_lines;
+} DiffResult;
+
+DiffResult *diff_result_new(void);
+DiffResult *diff_result_ref(DiffResult *result);
+void diff_result_unref(DiffResult *result);
+
+void diff_cache_key_init(DiffCacheKey *key, const char *left, gsize left_length,
+                         const char *right, gsize right_length,
+                         DiffAlgorithm algorithm, guint32 options);
+
+/**
+ * Two-tier cache of comparison results, safe to use from worker threads.
+ *
+ * The memory tier is an LRU bounded by DIFF_CACHE_MEMORY_BUDGET bytes. The
+ * disk tier keeps one small varint-encoded file per key in data/diff_cache/;
+ * a disk hit is promoted into memory and touches the file. The disk tier is
+ * bounded by DIFF_CACHE_DISK_BUDGET bytes: the directory is measured on the
+ * first store, and whenever it grows past the budget the least recently
+ * modified files are deleted until it is back to three quarters of it. Files
+ * that are truncated, from another format version or for another key are
+ * ignored.
+ */
+#define DIFF_CACHE_MEMORY_BUDGET (64 * 1024 * 1024)
+#define DIFF_CACHE_DISK_BUDGET (256 * 1024 * 1024)
+
+/* Returns a new reference, or NULL on a miss */
+DiffResult *diff_cache_lookup(const DiffCacheKey *key);
+/* Stores result in both tiers (the cache takes its own reference) */
+void diff_cache_store(const DiffCacheKey *key, DiffResult *result);
+
+#endif // DIFF_CACHE_H
@@ -0,0 +1,25 @@
+#ifndef DIFF_HIGHLIGHT_H
+#define DIFF_HIGHLIGHT_H
+
+#include <gtk/gtk.h>
+
+/* A highlighted range of the latest file, as byte offsets into its text */
+typedef struct {
+    gsize start;
+    gsize end;
+} DiffSpan;
+
+/**
+ * Appends text[*cursor .. upto) to the end of buffer, applying tag to every
+ * span in that range.
+ *
+ * Spans must be sorted, non-overlapping, start at or after *cursor and end at
+ * or before upto. Text is inserted at the end iterator in order, so the cost
+ * is linear in the number of bytes appended, independent of buffer size.
+ * Called repeatedly with increasing upto, this builds the tagged buffer in a
+ * single pass. *cursor is advanced to upto.
+ */
+void diff_highlight_append(GtkTextBuffer *buffer, GtkTextTag *tag, const char *text,
+                           gsize *cursor, const DiffSpan *spans, guint n_spans, gsize upto);
+
+#endif // DIFF_HIGHLIGHT_H
@@ -2,8 +2,107 @@
 #define DIFF_LOGIC_H
 
 #include "myers_diff.h"
+#include "line_table.h"
 #include <glib.h>
+#include <stdio.h>
 
-GArray* perform_diff(const char* file1_path, const char* file2_path);
+/*
+ * Line diff of two files as DiffOps, one per run of equal, deleted or
+ * inserted lines (each op's text is those lines, newlines included).
+ * Blocks moved elsewhere in the file are MOVE ops instead, once where they
+ * were taken out (with the left file's lines) and once where they were put
+ * (with the right file's). See diff_edits_find_moves().
+ *
+ * If either file is binary (binary_diff_is_binary), there is no line diff:
+ * the ops are binary_diff()'s runs of the right file in order, EQUAL for
+ * bytes copied from anywhere in the left file and INSERT for new bytes,
+ * followed by DELETE ops for the left bytes nothing was copied from. Op
+ * texts may then contain NULs; use their length.
+ * Returns NULL if either file can't be read; g_array_unref() frees the texts.
+ * 'inputs', if not NULL, receives what was read, so callers reporting on the
+ * files need not read them again.
+ */
+typedef struct {
+    gsize left_length;
+    gsize right_length;
+    gboolean binary;    /* either side is binary: the ops are a block diff */
+} DiffInputs;
+
+GArray* perform_diff(const char* file1_path, const char* file2_path, DiffInputs* inputs);
+
+/* Line counts of a perform_diff() result */
+typedef struct {
+    guint inserted;
+    guint deleted;
+    guint changes;      /* separate changed regions (not set by perform_diff_stats) */
+    guint moved;        /* lines in moved blocks, not counted as inserted or deleted (diff_ops_count only) */
+    gboolean approximate; /* counts are an upper bound */
+    gboolean binary;      /* a side is binary (see binary_diff_is_binary); nothing was counted */
+} DiffStats;
+
+void diff_ops_count(const GArray* diffs, DiffStats* stats);
+
+/*
+ * Inserted and deleted line counts of two files, without building DiffOps.
+ * Gives up on exact counts beyond max_d changed lines (see myers_diff_stats).
+ * If either file is binary nothing is counted and stats->binary is set.
+ * Returns FALSE if either file can't be read.
+ */
+gboolean perform_diff_stats(const char* file1_path, const char* file2_path, guint max_d, DiffStats* stats);
+
+/*
+ * Write a line diff of two files to 'out' in unified format with 'context'
+ * lines around each change, as the lines are produced. Binary files only
+ * get a "Binary files ... differ" line.
+ * Returns 0 if the files are the same, 1 if they differ and 2 if one of them
+ * could not be read (the same convention as diff(1)).
+ */
+int write_unified_diff(FILE* out, const char* file1_path, const char* file2_path, guint context);
+
+/*
+ * Three-way merge of two descendants of a common base, diff3-style. Both
+ * base-to-side line diffs run in parallel; the base lines between their
+ * changes are kept, a change made on one side only is taken, and changes on
+ * both sides that touch the same base lines are a conflict unless the two
+ * sides made the same change.
+ */
+typedef enum {
+    MERGE_REGION_STABLE,    /* unchanged on both sides */
+    MERGE_REGION_LEFT,      /* changed on the left only: the left lines are taken */
+    MERGE_REGION_RIGHT,     /* changed on the right only */
+    MERGE_REGION_BOTH,      /* changed the same way on both sides */
+    MERGE_REGION_CONFLICT
+} MergeRegionType;
+
+/* Line ranges of one region in the base, the left and the right */
+typedef struct {
+    MergeRegionType type;
+    guint base_start, base_length;
+    guint left_start, left_length;
+    guint right_start, right_length;
+} MergeRegion;
+
+enum { MERGE_BASE, MERGE_LEFT, MERGE_RIGHT };
+
+typedef struct {
+    GArray *regions;        /* MergeRegion, in order */
+    gchar *texts[3];        /* contents, indexed by MERGE_BASE/LEFT/RIGHT */
+    gsize lengths[3];
+    LineTable *lines[3];
+    guint n_conflicts;
+} Merge3Result;
+
+/* NULL if one of the files can't be read or is binary (which has no lines to merge) */
+Merge3Result* perform_merge3(const char* base_path, const char* left_path, const char* right_path, GError** error);
+void merge3_result_free(Merge3Result* result);
+
+/*
+ * The merged text. Conflicts are written between "<<<<<<< left",
+ * "||||||| base", "=======" and ">>>>>>> right" marker lines, labelled with
+ * labels[MERGE_BASE/LEFT/RIGHT]. If 'conflict_lines' is not NULL, the first
+ * line and line count of each conflict, markers included, are appended to it
+ * as pairs of guints.
+ */
+gchar* merge3_render(const Merge3Result* result, const char* const labels[3], gsize* length, GArray* conflict_lines);
 
 #endif // DIFF_LOGIC_H
@@ -2,7 +2,19 @@
 #define DIFF_VIEW_H
 
 #include <gtk/gtk.h>
+#include "diff_cache.h"
 
 void create_diff_window(GtkWindow* parent, const char* file1_path, const char* file2_path);
 
+/* Same window with a choice of comparison: DIFF_ALGO_WORDS (the default above) or DIFF_ALGO_LINES, a line
+ * diff that strikes out deleted lines and shades blocks that moved on both sides. Line mode can ignore
+ * whitespace, blank lines, case and line endings (LineCompareFlags); toggling one diffs again without
+ * re-reading the files. Line mode also watches file2, so comparing a version against the working copy
+ * stays live: each save is spliced in and only the edited lines are diffed again (see incremental_diff). */
+void create_diff_window_full(GtkWindow* parent, const char* file1_path, const char* file2_path,
+                             DiffAlgorithm algorithm);
+
+/* Three-way merge of two versions from a common base (see perform_merge3), with conflicts highlighted and editable */
+void create_merge_window(GtkWindow* parent, const char* base_path, const char* left_path, const char* right_path);
+
 #endif // DIFF_VIEW_H
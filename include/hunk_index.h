@@ -0,0 +1,38 @@
+#ifndef HUNK_INDEX_H
+#define HUNK_INDEX_H
+
+#include <glib.h>
+
+/* A changed region, as half-open line ranges [start, end) on each side */
+typedef struct {
+    guint left_start, left_end;
+    guint right_start, right_end;
+} DiffHunk;
+
+/**
+ * Sorted hunks of one comparison plus a precomputed overview.
+ *
+ * Hunks are ordered by right_start and never share a right-side line, so
+ * next/previous lookups are binary searches. The overview splits the right
+ * file into n_buckets equal slices and stores how much of each slice is
+ * changed (0 = untouched, 255 = fully changed), so drawing a minimap costs
+ * the same no matter how many hunks there are.
+ */
+typedef struct {
+    GArray *hunks;      /* DiffHunk */
+    guint left_lines;
+    guint right_lines;
+    guint n_buckets;
+    guint8 *buckets;
+} HunkIndex;
+
+/* Takes ownership of 'hunks' (in right_start order); touching or overlapping hunks are merged */
+HunkIndex *hunk_index_new(GArray *hunks, guint left_lines, guint right_lines, guint n_buckets);
+void hunk_index_free(HunkIndex *index);
+
+/* Index of the first hunk starting after right_line, or -1 */
+int hunk_index_next(const HunkIndex *index, guint right_line);
+/* Index of the last hunk starting before right_line, or -1 */
+int hunk_index_prev(const HunkIndex *index, guint right_line);
+
+#endif // HUNK_INDEX_H
@@ -0,0 +1,32 @@
+#ifndef INCREMENTAL_DIFF_H
+#define INCREMENTAL_DIFF_H
+
+#include "line_table.h"
+#include "myers_diff.h"
+#include <glib.h>
+
+typedef enum {
+    DIFF_SIDE_LEFT,
+    DIFF_SIDE_RIGHT
+} DiffSide;
+
+/**
+ * Update a line diff after one side changed, without rediffing everything.
+ *
+ * 'previous' is the DiffEdit script between the old texts. 'left' and
+ * 'right' are the line tables of the current texts (the edited one already
+ * updated, e.g. with line_table_splice()); 'edits' are the changes made to
+ * 'side', in that side's old line numbers. The edits are merged into one
+ * window, the window is snapped to positions where the previous script had
+ * both sides in step, and only that stretch is diffed again. Runs before the
+ * window are kept as they were and runs after it are shifted.
+ *
+ * The cost is proportional to the size of the window and the number of
+ * runs, not the file, so typing in a large working copy stays cheap. The
+ * result is a valid edit script; it can be slightly longer than a full
+ * rediff would give when a change makes distant lines line up differently.
+ */
+GArray *incremental_diff(const GArray *previous, const LineTable *left, const LineTable *right,
+                         DiffSide side, const LineEdit *edits, guint n_edits);
+
+#endif // INCREMENTAL_DIFF_H
@@ -0,0 +1,39 @@
+#ifndef LARGE_FILE_VIEW_H
+#define LARGE_FILE_VIEW_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/**
+ * LargeFileView is a read-only, scrollable text pane for files too big for
+ * GtkTextView.
+ *
+ * The file is memory-mapped and only a fixed-size table of line offsets is
+ * kept (one checkpoint every few lines, at most LINE_INDEX_CHECKPOINTS of
+ * them), built in a worker thread. Only the lines in view are laid out and
+ * drawn, so memory use does not grow with the file.
+ *
+ * Two views can be paired with large_file_view_set_peer(). Once both are
+ * indexed, a worker diffs their lines (skipping the common prefix by bytes)
+ * and both panes show the same rows: changed lines are highlighted and the
+ * side without a run gets gap rows. If the rest of the files is longer than
+ * ALIGN_MAX_LINES lines or needs more than ALIGN_MAX_EDITS edits, lines are
+ * compared by line number instead, as they are until the diff is done. The
+ * "compared" signal (gboolean aligned) says which. Pairs are meant to share a
+ * vertical GtkAdjustment so they scroll together.
+ */
+#define LARGE_TYPE_FILE_VIEW (large_file_view_get_type())
+G_DECLARE_FINAL_TYPE(LargeFileView, large_file_view, LARGE, FILE_VIEW, GtkWidget)
+
+GtkWidget *large_file_view_new(void);
+
+/* Map 'path' and start indexing it; returns FALSE and sets error if it can't be mapped */
+gboolean large_file_view_load(LargeFileView *self, const char *path, GError **error);
+
+/* Compare against 'peer' (not referenced; both views should live in the same window) */
+void large_file_view_set_peer(LargeFileView *self, LargeFileView *peer);
+
+G_END_DECLS
+
+#endif // LARGE_FILE_VIEW_H
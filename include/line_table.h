@@ -0,0 +1,68 @@
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+#include <glib.h>
+
+/**
+ * Line boundaries and per-line hashes of one text, for line-level diffing.
+ *
+ * Line i covers bytes [offsets[i], offsets[i + 1]) including its '\n'; a
+ * trailing newline does not start an extra empty line. The hash covers the
+ * whole line including its '\n', so a last line without one differs from the
+ * same line with one. The table does not keep the text.
+ */
+/* Differences line_table_keys() can be told to overlook */
+typedef enum {
+    LINE_IGNORE_WHITESPACE  = 1 << 0, /* every ASCII whitespace byte, line ends included */
+    LINE_IGNORE_BLANK_LINES = 1 << 1, /* lines of nothing but whitespace are left out */
+    LINE_IGNORE_CASE        = 1 << 2, /* ASCII letters only */
+    LINE_IGNORE_LINE_ENDING = 1 << 3  /* "\r\n", "\n" or none on the last line */
+} LineCompareFlags;
+
+#define LINE_COMPARE_FLAGS_ALL 0xf
+
+typedef struct {
+    GArray *offsets;    /* gsize, n_lines + 1 entries; the last is the text length */
+    GArray *hashes;     /* guint64, n_lines entries */
+    guint n_lines;
+    /* Filled in by line_table_keys() on first use, dropped by line_table_splice() */
+    GArray *keys[LINE_COMPARE_FLAGS_ALL + 1]; /* guint64 */
+    GArray *non_blank;                         /* guint, indices of non-blank lines, then n_lines */
+} LineTable;
+
+/* A change to a text in lines: [start, start + old_lines) became new_lines lines */
+typedef struct {
+    guint start;
+    guint old_lines;
+    guint new_lines;
+} LineEdit;
+
+LineTable *line_table_new(const char *text, gsize length);
+void line_table_free(LineTable *table);
+
+/**
+ * Update the table after bytes [byte_start, byte_start + old_bytes) of the
+ * old text were replaced by new_bytes bytes, giving new_text. Only the lines
+ * touched by the edit are rescanned and rehashed; later offsets are shifted.
+ * The affected line range is written to *edit.
+ */
+void line_table_splice(LineTable *table, const char *new_text, gsize new_length,
+                       gsize byte_start, gsize old_bytes, gsize new_bytes, LineEdit *edit);
+
+/* FNV-1a, the hash used for line contents */
+guint64 line_table_hash(const char *data, gsize length);
+
+/**
+ * Per-line keys for diffing under 'flags': the hash of each line as the flags
+ * see it, so lines that differ only in what the flags ignore get equal keys.
+ * Lines are hashed in place, never copied, and each flags value is computed
+ * once and kept with the table (text must be the table's text). With no flags
+ * these are the table's own hashes.
+ *
+ * With LINE_IGNORE_BLANK_LINES there is no key for blank lines; *kept then
+ * receives the line index of each key followed by n_lines, else NULL.
+ * Not thread-safe: one caller per table at a time.
+ */
+const guint64 *line_table_keys(LineTable *table, const char *text, guint flags, guint *n_keys, const guint **kept);
+
+#endif // LINE_TABLE_H
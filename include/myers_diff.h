@@ -1,19 +1,92 @@
 #ifndef MYERS_DIFF_H
 #define MYERS_DIFF_H
 
+#include "arena.h"
 #include <glib.h>
 
 typedef enum {
     DIFF_OP_EQUAL,
     DIFF_OP_INSERT,
-    DIFF_OP_DELETE
+    DIFF_OP_DELETE,
+    DIFF_OP_MOVE        /* a block deleted in one place and inserted in another (see diff_edits_find_moves) */
 } DiffOpType;
 
 typedef struct {
     DiffOpType type;
     char* text;
+    gsize length;   /* bytes of text, which may hold NULs when it comes from a binary file */
 } DiffOp;
 
-GArray* myers_diff(const char* text1, const char* text2);
+/*
+ * Character-level diff of two strings, one DiffOp per character. The op
+ * texts are allocated from 'arena', so the arena must outlive the result and
+ * freeing it releases them all at once.
+ */
+GArray* myers_diff(const char* text1, const char* text2, Arena* arena);
+
+/*
+ * A run of consecutive edit operations over two sequences. EQUAL runs cover
+ * 'length' elements on both sides, DELETE runs only on the left (at
+ * right_start) and INSERT runs only on the right (at left_start).
+ *
+ * MOVE runs come in pairs with the same fields: the block is at left_start
+ * in the left sequence and at right_start in the right one. One of the pair
+ * sits in the list where the block was taken out and covers left elements
+ * like a DELETE; the other sits where it was put and covers right elements
+ * like an INSERT. diff_edit_moved_out() tells them apart during a walk.
+ */
+typedef struct {
+    DiffOpType type;
+    guint left_start;
+    guint right_start;
+    guint length;
+} DiffEdit;
+
+/**
+ * Shortest edit script between two sequences of element hashes (for example
+ * LineTable hashes), as DiffEdit runs in order.
+ *
+ * Uses the linear-space variant of Myers' algorithm: O((n + m) * D) time
+ * and O(n + m) memory, where D is the number of differing elements. Common
+ * prefixes and suffixes are stripped first.
+ */
+GArray* myers_diff_sequence(const guint64* a, guint n, const guint64* b, guint m);
+
+/**
+ * Insertion and deletion counts of the shortest edit script between two hash
+ * sequences, without building the script: only the greedy frontier of the
+ * O(ND) algorithm is kept, O(min(max_d, n + m)) working memory and no output
+ * allocation.
+ * Gives up once more than max_d edits would be needed (0 = no limit); it then
+ * returns FALSE and reports everything between the common prefix and suffix
+ * as changed, an upper bound.
+ */
+gboolean myers_diff_stats(const guint64* a, guint n, const guint64* b, guint m, guint max_d,
+                          guint* inserted, guint* deleted);
+
+/* Append a run to a DiffEdit array, merging it into the previous run when they are adjacent */
+void diff_edits_append(GArray* edits, DiffOpType type, guint left_start, guint right_start, guint length);
+
+/* Shortest block reported as a move, and how many of its elements may differ: one in every DIFF_MOVE_FUZZ */
+#define DIFF_MOVE_MIN_LENGTH 3
+#define DIFF_MOVE_FUZZ 8
+
+/**
+ * Post-pass over an edit script of a and b that finds deleted blocks which
+ * were inserted again elsewhere, in a different change. A block matches if
+ * it has the same length on both sides and at most one element in
+ * DIFF_MOVE_FUZZ differs (never two in a row, never the first or last).
+ * Those deletions and insertions become MOVE pairs; the rest is unchanged.
+ *
+ * Deleted elements are indexed by hash, and each inserted run is scanned
+ * once, trying a bounded number of candidates per position, so the cost is
+ * close to linear in the number of changed elements.
+ */
+GArray* diff_edits_find_moves(const GArray* edits, const guint64* a, guint n, const guint64* b, guint m);
+
+/* For a MOVE run met while walking an edit list at left position 'left_pos': TRUE where the block was taken out */
+static inline gboolean diff_edit_moved_out(const DiffEdit* edit, guint left_pos) {
+    return edit->left_start == left_pos;
+}
 
 #endif // MYERS_DIFF_H
@@ -0,0 +1,46 @@
+#ifndef NWAY_COMPARE_H
+#define NWAY_COMPARE_H
+
+#include "line_table.h"
+#include <glib.h>
+
+/**
+ * The work behind the N-way window (nway_view.h), without widgets. Loading
+ * reads every version and splits it into lines; a run then diffs each
+ * version against the base. Both phases spread the versions over a
+ * WorkPool, so the n - 1 diffs of a run go concurrently. Line tables are
+ * kept, so a run against another base only redoes the diffs.
+ */
+typedef struct _NWayCompare NWayCompare;
+
+/* One version's diff against the base, handed to the caller as it is done */
+typedef struct {
+    guint column;
+    guint base;
+    GArray *edits;      /* DiffEdit, base on the left */
+    guint inserted;
+    guint deleted;
+} NWayColumn;
+
+/* Called on a worker thread for each version but the base; takes ownership of 'column' */
+typedef void (*NWayColumnFunc)(NWayColumn *column, gpointer user_data);
+
+void nway_column_free(NWayColumn *column);
+
+NWayCompare *nway_compare_new(const char *const *paths, guint n_paths);
+void nway_compare_free(NWayCompare *cmp);
+
+/* Read and split every version; blocks until all are loaded */
+void nway_compare_load(NWayCompare *cmp);
+
+/* A loaded version as valid UTF-8 (or a note that it could not be read), and its lines */
+const char *nway_compare_get_display(NWayCompare *cmp, guint i);
+const LineTable *nway_compare_get_lines(NWayCompare *cmp, guint i);
+
+/* Diff every loaded version against 'base'; blocks until all are done */
+void nway_compare_run(NWayCompare *cmp, guint base, NWayColumnFunc func, gpointer user_data);
+
+/* Make running and later calls skip the versions not started yet; thread-safe */
+void nway_compare_cancel(NWayCompare *cmp);
+
+#endif // NWAY_COMPARE_H
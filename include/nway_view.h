@@ -0,0 +1,20 @@
+#ifndef NWAY_VIEW_H
+#define NWAY_VIEW_H
+
+#include <gtk/gtk.h>
+
+/* Most versions one window shows side by side */
+#define NWAY_MAX_VERSIONS 10
+
+/**
+ * Window showing several versions side by side, each compared line by line
+ * against one of them, the base (at first the one at index 'base'; a drop-down
+ * switches it). Versions are read and the diffs against the base computed on a
+ * work pool, so the n - 1 comparisons run concurrently and each column is
+ * marked up as its diff arrives: lines a version added are shaded green, and
+ * base lines that any version removed or changed are shaded red. The columns
+ * share one vertical scroll position.
+ */
+void create_nway_window(GtkWindow *parent, const char *const *paths, guint n_paths, guint base);
+
+#endif // NWAY_VIEW_H
@@ -0,0 +1,37 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <glib.h>
+
+/**
+ * Process-wide performance counters for the in-app HUD.
+ *
+ * Each counter is a relaxed 64-bit atomic, so subsystems can update them
+ * from any thread for about the cost of a plain store. Gauges hold the
+ * latest value; totals only grow.
+ */
+typedef enum {
+    PERF_LAST_DIFF_US,          /* gauge: duration of the last comparison */
+    PERF_LAST_DIFF_LEFT_BYTES,  /* gauge: its input sizes */
+    PERF_LAST_DIFF_RIGHT_BYTES,
+    PERF_INDEX_LOAD_US,         /* gauge: last versions or files index load */
+    PERF_VERSIONS_RENDERED,     /* gauge: rows built by the last versions pane refresh */
+    PERF_RECORD_BYTES,          /* total: bytes of recorded versions */
+    PERF_STORED_BYTES,          /* total: of which written as new chunks */
+    PERF_DIFF_RESULT_BYTES,     /* gauge: diff results held in the memory cache */
+    PERF_CHUNK_CACHE_BYTES,     /* gauge: version chunks held in the chunk cache */
+    PERF_FRAME_STALLS,          /* total: frames late by more than PERF_STALL_US */
+    PERF_WORST_STALL_US,        /* maximum: the longest such delay */
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+/* A frame is a stall when it arrives this much later than the refresh interval */
+#define PERF_STALL_US (16 * 1000)
+
+void perf_counter_set(PerfCounter counter, gint64 value);
+void perf_counter_add(PerfCounter counter, gint64 delta);
+/* Raise the counter to value if it is lower */
+void perf_counter_max(PerfCounter counter, gint64 value);
+gint64 perf_counter_get(PerfCounter counter);
+
+#endif // PERF_COUNTERS_H
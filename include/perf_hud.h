@@ -0,0 +1,17 @@
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <gtk/gtk.h>
+
+/**
+ * Overlay showing the perf_counters values, for a GtkOverlay over the main
+ * window's content. Starts hidden. While it is visible it refreshes a few
+ * times a second and watches the frame clock for stalls; while hidden it
+ * costs nothing.
+ */
+GtkWidget *perf_hud_new(void);
+
+/* Show or hide the HUD (bound to F12 in the main window) */
+void perf_hud_toggle(GtkWidget *hud);
+
+#endif // PERF_HUD_H
@@ -8,7 +8,10 @@
  *
  * This function builds a vertical box containing:
  * 1. A browse button at the top.
- * 2. A GtkListBox below it for file names.
+ * 2. A GtkListView below it, backed by a GListStore of TrackedFile items.
+ *
+ * The tracked files list is read in a worker thread and per-file metadata
+ * (size, mtime, version count, changed badge) is filled in asynchronously.
  *
  * @param parent_window The main GtkWindow, needed to parent the file chooser dialog.
  * @return A GtkWidget pointer to the fully constructed sidebar (a GtkBox).
@@ -18,4 +21,10 @@ GtkWidget *create_sidebar(GtkWindow *parent_window);
 /* Clear all children from a container (list box) */
 void clear_list_box_widget(GtkWidget *box_widget);
 
+/* Re-read size, mtime and version count for one tracked path (e.g. after recording a version) */
+void sidebar_refresh_file(GtkWindow *window, const char *path);
+
+/* Show only versions whose contents contain 'needle' (all of them if it is empty); searches in a worker thread */
+void sidebar_search_versions(GtkListBox *versions_list, const char *needle);
+
 #endif // SIDEBAR_H
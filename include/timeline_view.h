@@ -0,0 +1,15 @@
+#ifndef TIMELINE_VIEW_H
+#define TIMELINE_VIEW_H
+
+#include <gtk/gtk.h>
+
+/**
+ * Window charting how much a tracked file changed between each consecutive
+ * pair of its recorded versions: one bar per pair, inserted lines above the
+ * axis and deleted lines below, on a log scale. The counts come from
+ * version_stats_get() on a work pool, and bars fill in as they arrive.
+ * Hovering a bar shows its counts; clicking it opens the pair's diff.
+ */
+void create_timeline_window(GtkWindow *parent, const char *original_path);
+
+#endif // TIMELINE_VIEW_H
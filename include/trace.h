@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+
+/**
+ * Timed spans around the slow paths (index parsing, file copies, diffing,
+ * building rows), exported in Chrome's trace event format for chrome://tracing
+ * or Perfetto.
+ *
+ * Only compiled in with `make TRACE=1`, which defines GH_TRACE; otherwise
+ * every macro below expands to nothing and the functions do not exist.
+ *
+ * Each thread records into its own fixed-size ring buffer without locking;
+ * when a ring is full the oldest spans are overwritten. The spans are
+ * written out by trace_dump(), at exit and with Ctrl+Shift+T in the main
+ * window, to $GYATTHUB_TRACE or gyatthub-trace.json.
+ *
+ * Names and argument names must be string literals: only the pointers are kept.
+ *
+ *   TRACE_SCOPE("versions.populate");          until the end of the block
+ *   TRACE_SCOPE_ARG("bytes", length);          attach a number to that span
+ *
+ *   TRACE_BEGIN(read, "diff.read");            explicit start and end
+ *   TRACE_END(read);
+ */
+
+#ifdef GH_TRACE
+
+typedef struct {
+    const char *name;
+    const char *arg_name;   /* NULL if the span has no argument */
+    gint64 arg;
+    gint64 start_us;
+} TraceSpan;
+
+void trace_span_end(TraceSpan *span);
+
+/* Dump at exit to $GYATTHUB_TRACE (default gyatthub-trace.json); names the calling thread "main" */
+void trace_init(void);
+
+/* Label the calling thread's spans in the trace */
+void trace_set_thread_name(const char *name);
+
+/* Write every thread's recorded spans as trace event JSON */
+gboolean trace_dump(const char *path, GError **error);
+const char *trace_default_path(void);
+
+#define TRACE_SCOPE(name) \
+    __attribute__((cleanup(trace_span_end))) TraceSpan _trace_scope = { (name), NULL, 0, g_get_monotonic_time() }
+#define TRACE_SCOPE_ARG(key, value) (_trace_scope.arg_name = (key), _trace_scope.arg = (gint64)(value))
+#define TRACE_BEGIN(var, name) TraceSpan var = { (name), NULL, 0, g_get_monotonic_time() }
+#define TRACE_ARG(var, key, value) ((var).arg_name = (key), (var).arg = (gint64)(value))
+#define TRACE_END(var) trace_span_end(&(var))
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(key, value) ((void)0)
+#define TRACE_BEGIN(var, name)
+#define TRACE_ARG(var, key, value) ((void)0)
+#define TRACE_END(var) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif // GH_TRACE
+
+#endif // TRACE_H
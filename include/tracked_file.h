@@ -0,0 +1,38 @@
+#ifndef TRACKED_FILE_H
+#define TRACKED_FILE_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * TrackedFile is the item type stored in the sidebar's GListModel.
+ *
+ * It holds the tracked path plus metadata that is filled in lazily
+ * (size, modification time, number of recorded versions and whether the
+ * file changed since its last recorded version). Until a value is known
+ * the numeric fields are -1.
+ */
+#define TRACKED_TYPE_FILE (tracked_file_get_type())
+G_DECLARE_FINAL_TYPE(TrackedFile, tracked_file, TRACKED, FILE, GObject)
+
+TrackedFile *tracked_file_new(const char *path);
+
+const char *tracked_file_get_path(TrackedFile *self);
+const char *tracked_file_get_name(TrackedFile *self);
+void        tracked_file_set_path(TrackedFile *self, const char *path);
+
+gint64   tracked_file_get_size(TrackedFile *self);
+gint64   tracked_file_get_mtime(TrackedFile *self);
+int      tracked_file_get_version_count(TrackedFile *self);
+gint64   tracked_file_get_last_recorded(TrackedFile *self);
+gboolean tracked_file_get_changed(TrackedFile *self);
+
+/* Set stat results; mtime is seconds since the epoch, -1 if the file is missing */
+void tracked_file_set_stat(TrackedFile *self, gint64 size, gint64 mtime);
+/* Set version summary; last_recorded is seconds since the epoch or -1 */
+void tracked_file_set_versions(TrackedFile *self, int count, gint64 last_recorded);
+
+G_END_DECLS
+
+#endif // TRACKED_FILE_H
@@ -0,0 +1,48 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <glib.h>
+
+/**
+ * Substring search over the contents of every stored version.
+ *
+ * Each stored version gets a document id in the order it was indexed. The
+ * index keeps, for every three-byte sequence, the sorted list of documents
+ * containing it, as delta-encoded varints. Files in data/trigram/:
+ *
+ *   index.bin    document names, then a table of trigrams sorted by value
+ *                (count, last document, offset and length of the list), then
+ *                the lists themselves. Memory-mapped for queries.
+ *   pending.log  documents added since index.bin was written: the name and
+ *                the document's trigrams, appended by version_store_record().
+ *                Merged into index.bin every TRIGRAM_COMPACT_DOCS documents.
+ *
+ * A query intersects the lists of the needle's trigrams and then reads the
+ * remaining candidates to confirm the match, so results are exact. Needles
+ * shorter than three bytes have no trigrams and check every candidate.
+ * Deleted versions stay in the index and drop out when their file is missing.
+ *
+ * All functions are thread-safe.
+ */
+
+/* Documents appended to pending.log before it is merged into index.bin */
+#define TRIGRAM_COMPACT_DOCS 256
+
+/* Index the contents of the stored version 'stored' (a name under data/versions) */
+gboolean trigram_index_add(const char *stored, const char *contents, gsize length, GError **error);
+
+/* Index every version in the versions index that is not indexed yet; returns how many were added */
+guint trigram_index_sync(void);
+
+/*
+ * Stored names of versions whose contents contain 'needle', as a set (keys
+ * only, free with g_hash_table_unref()). 'within', if not NULL, is a set of
+ * stored names to restrict the search to. The first search calls
+ * trigram_index_sync(); after that version_store_record() keeps it current.
+ */
+GHashTable *trigram_index_search(const char *needle, GHashTable *within);
+
+/* Unmap and forget the loaded index, e.g. before switching to another data directory */
+void trigram_index_close(void);
+
+#endif // TRIGRAM_INDEX_H
@@ -0,0 +1,37 @@
+#ifndef VERSION_STATS_H
+#define VERSION_STATS_H
+
+#include "diff_logic.h"
+#include <glib.h>
+
+/**
+ * Inserted/deleted line counts between two stored versions, cached by a key
+ * for each side's contents, so a pair of contents is only ever diffed once
+ * however many times it recurs in a history (reverts, unchanged re-records).
+ * A chunked version's key is the hash of its chunk list
+ * (chunk_store_content_id()), so finding it after a restart reads only the
+ * list; plain versions recorded before chunking are keyed by the SHA-256 of
+ * their contents.
+ *
+ * Results are kept in memory and appended to data/version_stats.txt, one
+ * "<key older> <key newer> <max_d> <inserted> <deleted> <approximate>" per
+ * line, so they survive restarts. Stored versions never change, so each
+ * stored path's key is also remembered once computed. Pairs with a binary
+ * side are not counted: stats->binary is set instead.
+ *
+ * All functions are thread-safe.
+ */
+
+/* Past this many changed lines counts are an upper bound; one value for every caller, so cache entries are shared */
+#define VERSION_STATS_MAX_D 20000
+
+/* Like perform_diff_stats(), but through the cache; FALSE if either file can't be read */
+gboolean version_stats_get(const char *older_path, const char *newer_path, guint max_d, DiffStats *stats);
+
+/* Counts already known for the pair, without reading or diffing anything; FALSE if they aren't */
+gboolean version_stats_lookup(const char *older_path, const char *newer_path, guint max_d, DiffStats *stats);
+
+/* Forget the loaded cache, e.g. before switching to another data directory */
+void version_stats_close(void);
+
+#endif // VERSION_STATS_H
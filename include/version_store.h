@@ -0,0 +1,52 @@
+#ifndef VERSION_STORE_H
+#define VERSION_STORE_H
+
+#include "chunk_store.h"
+#include <glib.h>
+
+/**
+ * Headless access to the data/ directory: recorded versions of tracked files
+ * and the list of tracked files. Used by both the UI and the command line.
+ *
+ * Stored versions live in data/versions/, as chunk lists (see chunk_store.h)
+ * or, if recorded before chunking, as plain copies. The versions index is
+ * data/versions_index.json when json-glib is available, otherwise
+ * data/versions_index.txt with one "original|stored|timestamp" per line.
+ * Tracked files are listed one per line in data/files_index.txt.
+ */
+
+typedef struct {
+    gchar *original;    /* path of the tracked file */
+    gchar *stored;      /* file name under data/versions */
+    gchar *timestamp;   /* YYYYmmddHHMMSS */
+} VersionEntry;
+
+void version_entry_free(VersionEntry *entry);
+
+/* Path of a stored version, e.g. data/versions/<stored>; free with g_free() */
+gchar *version_store_stored_path(const char *stored);
+
+/* Store 'path' in data/versions and add it to the index; returns the stored name */
+gchar *version_store_record(const char *path, GError **error);
+
+/* Versions of 'path' in recording order (all versions if path is NULL), as VersionEntry* */
+GPtrArray *version_store_list(const char *path);
+
+/* Remove a stored version file and its index entry */
+gboolean version_store_delete(const char *stored_path, GError **error);
+
+/* Delete the chunks no stored version refers to any more, e.g. after deletes; see chunk_store_collect() */
+gboolean version_store_collect_chunks(ChunkCollectStats *stats, GError **error);
+
+/*
+ * Write a stored version back over 'path', streamed and replacing it
+ * atomically. If 'path' exists its current contents are recorded first, so
+ * the restore can be undone.
+ */
+gboolean version_store_restore(const char *stored_path, const char *path, GError **error);
+
+/* Add or remove a path in data/files_index.txt */
+void version_store_track_file(const char *path);
+void version_store_untrack_file(const char *path);
+
+#endif // VERSION_STORE_H
@@ -0,0 +1,64 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <glib.h>
+#include <string.h>
+
+/**
+ * Encoding helpers shared by the on-disk formats under data/ (chunk lists,
+ * the trigram index, blame and diff caches).
+ *
+ * Varints are LEB128: seven bits per byte, least significant first, high bit
+ * set on all but the last byte. Fixed-width fields are little-endian whatever
+ * the host, so files move between machines. Readers take a cursor and an end
+ * pointer and never read past the end.
+ */
+
+static inline void wire_put_varint(GByteArray *out, guint64 v) {
+    while (v >= 0x80) {
+        guint8 b = (guint8)(v | 0x80);
+        g_byte_array_append(out, &b, 1);
+        v >>= 7;
+    }
+    guint8 b = (guint8)v;
+    g_byte_array_append(out, &b, 1);
+}
+
+/* Reads one varint at *p and moves *p past it; FALSE if it is cut off or longer than 64 bits */
+static inline gboolean wire_get_varint(const guint8 **p, const guint8 *end, guint64 *v) {
+    guint64 result = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        guint8 b = *(*p)++;
+        result |= (guint64)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static inline void wire_put_u32(GByteArray *out, guint32 v) {
+    v = GUINT32_TO_LE(v);
+    g_byte_array_append(out, (const guint8 *)&v, 4);
+}
+
+static inline void wire_put_u64(GByteArray *out, guint64 v) {
+    v = GUINT64_TO_LE(v);
+    g_byte_array_append(out, (const guint8 *)&v, 8);
+}
+
+/* The caller checks that 4 (or 8) bytes are there */
+static inline guint32 wire_get_u32(const guint8 *p) {
+    guint32 v;
+    memcpy(&v, p, 4);
+    return GUINT32_FROM_LE(v);
+}
+
+static inline guint64 wire_get_u64(const guint8 *p) {
+    guint64 v;
+    memcpy(&v, p, 8);
+    return GUINT64_FROM_LE(v);
+}
+
+#endif // WIRE_FORMAT_H
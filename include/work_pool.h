@@ -0,0 +1,34 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <glib.h>
+
+/**
+ * Fixed set of worker threads with per-worker queues and work stealing.
+ *
+ * Each worker takes its newest item first from its own queue and, when that
+ * is empty, steals the oldest item from another worker's queue, so uneven
+ * item costs even out without a single shared queue being contended. Items
+ * pushed from outside are dealt round-robin; items pushed from inside a
+ * worker go to that worker's own queue.
+ */
+typedef struct _WorkPool WorkPool;
+
+typedef void (*WorkPoolFunc)(gpointer item, gpointer user_data);
+
+/* n_threads = 0 means one per processor */
+WorkPool *work_pool_new(guint n_threads, WorkPoolFunc func, gpointer user_data);
+guint work_pool_get_n_threads(WorkPool *pool);
+
+void work_pool_push(WorkPool *pool, gpointer item);
+
+/* Block until every pushed item has been processed */
+void work_pool_wait(WorkPool *pool);
+
+/* Index of the calling worker thread, or -1 outside the pool */
+int work_pool_current_worker(void);
+
+/* Waits for outstanding items, then joins the threads */
+void work_pool_free(WorkPool *pool);
+
+#endif // WORK_POOL_H
@@ -1,6 +1,10 @@
 #include <gtk/gtk.h>
 #include "sidebar.h"
 #include "context_menu.h"
+#include "cli.h"
+#include "trace.h"
+#include "perf_hud.h"
+#include "chunk_store.h"
 #include <stdlib.h> // For _putenv_s on Windows
 // Use a struct to hold application state instead of globals
 typedef struct {
@@ -36,6 +40,36 @@ static void on_toggle_button_clicked(GtkButton *button, gpointer user_data) {
     }
 }
 
+/* Versions pane search box; GtkSearchEntry already waits for typing to pause */
+static void on_versions_search_changed(GtkSearchEntry *entry, gpointer user_data) {
+    sidebar_search_versions(GTK_LIST_BOX(user_data), gtk_editable_get_text(GTK_EDITABLE(entry)));
+}
+
+/* F12: show or hide the performance HUD */
+static gboolean on_toggle_hud(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    perf_hud_toggle(GTK_WIDGET(user_data));
+    return TRUE;
+}
+
+#ifdef GH_TRACE
+/* Ctrl+Shift+T: write the spans recorded so far without quitting */
+static gboolean on_dump_trace(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    GError *error = NULL;
+    if (trace_dump(trace_default_path(), &error)) {
+        g_print("trace written to %s\n", trace_default_path());
+    } else {
+        g_printerr("trace: %s\n", error ? error->message : "dump failed");
+        g_clear_error(&error);
+    }
+    return TRUE;
+}
+#endif
+
+/* Once per running instance: drop temp copies of versions left by the last run */
+static void on_startup(GApplication *app, gpointer user_data) {
+    chunk_store_clear_materialized();
+}
+
 // This function builds the UI when the application is activated
 static void on_activate(GApplication *app, gpointer user_data) {
     GtkWidget *window;
@@ -91,7 +125,20 @@ static void on_activate(GApplication *app, gpointer user_data) {
     // GTK4: Set vexpand/valign on the child
     gtk_widget_set_vexpand(main_paned, TRUE);
     gtk_widget_set_valign(main_paned, GTK_ALIGN_FILL);
-    gtk_box_append(GTK_BOX(main_vbox), main_paned);
+
+    // The performance HUD floats over the panes
+    GtkWidget *content_overlay = gtk_overlay_new();
+    gtk_widget_set_vexpand(content_overlay, TRUE);
+    gtk_overlay_set_child(GTK_OVERLAY(content_overlay), main_paned);
+    GtkWidget *hud = perf_hud_new();
+    gtk_overlay_add_overlay(GTK_OVERLAY(content_overlay), hud);
+    gtk_box_append(GTK_BOX(main_vbox), content_overlay);
+
+    GtkEventController *hud_shortcuts = gtk_shortcut_controller_new();
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(hud_shortcuts),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("F12"),
+                         gtk_callback_action_new(on_toggle_hud, hud, NULL)));
+    gtk_widget_add_controller(window, hud_shortcuts);
 
     // 4. Create and add the sidebar
     // This function must also be GTK4-friendly (as converted in previous steps)
@@ -112,12 +159,23 @@ static void on_activate(GApplication *app, gpointer user_data) {
     GtkWidget *versions_list = gtk_list_box_new();
     gtk_widget_set_name(versions_list, "versions-list");
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(versions_scrolled), versions_list);
+    gtk_widget_set_vexpand(versions_scrolled, TRUE);
 
     // Store the versions list on the window so sidebar can populate it
     g_object_set_data(G_OBJECT(window), "versions-list", versions_list);
 
+    // Search box above the list: filters versions by their contents
+    GtkWidget *versions_search = gtk_search_entry_new();
+    gtk_search_entry_set_placeholder_text(GTK_SEARCH_ENTRY(versions_search), "Search version contents");
+    gtk_widget_set_margin_top(versions_search, 10);
+    g_signal_connect(versions_search, "search-changed", G_CALLBACK(on_versions_search_changed), versions_list);
+
+    GtkWidget *versions_pane = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_box_append(GTK_BOX(versions_pane), versions_search);
+    gtk_box_append(GTK_BOX(versions_pane), versions_scrolled);
+
     // GTK4: Use gtk_paned_set_end_child
-    gtk_paned_set_end_child(GTK_PANED(main_paned), versions_scrolled);
+    gtk_paned_set_end_child(GTK_PANED(main_paned), versions_pane);
 
     // 6. Add main_vbox to window
     // GTK4: Use gtk_window_set_child
@@ -152,6 +210,27 @@ static void on_activate(GApplication *app, gpointer user_data) {
         "   font-size: 1em;"
         "   padding-top: 2px;"
         "   padding-bottom: 2px;"
+        "}"
+        "#file-list-box row label.file-meta {"
+        "   font-size: 0.85em;"
+        "   opacity: 0.7;"
+        "}"
+        "#file-list-box row label.changed-badge {"
+        "   color: #e66100;"
+        "}"
+        "#versions-list row label.version-stats {"
+        "   font-family: monospace;"
+        "   font-size: 0.85em;"
+        "   opacity: 0.8;"
+        "}"
+        ".perf-hud {"
+        "   margin: 8px;"
+        "   padding: 6px 10px;"
+        "   border-radius: 6px;"
+        "   background: alpha(black, 0.7);"
+        "   color: white;"
+        "   font-family: monospace;"
+        "   font-size: 0.85em;"
         "}";
 
     //
@@ -166,6 +245,14 @@ static void on_activate(GApplication *app, gpointer user_data) {
                                                GTK_STYLE_PROVIDER_PRIORITY_USER);
     g_object_unref(cssProvider); // Can unref immediately
 
+#ifdef GH_TRACE
+    GtkEventController *trace_shortcuts = gtk_shortcut_controller_new();
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(trace_shortcuts),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Control><Shift>t"),
+                         gtk_callback_action_new(on_dump_trace, NULL, NULL)));
+    gtk_widget_add_controller(window, trace_shortcuts);
+#endif
+
     // 9. Show the window
     // GTK4: No gtk_widget_show_all()
     gtk_window_present(GTK_WINDOW(window));
@@ -180,6 +267,14 @@ static void on_activate(GApplication *app, gpointer user_data) {
 
 // The new main function just sets up and runs the GtkApplication
 int main(int argc, char **argv) {
+#ifdef GH_TRACE
+    trace_init();
+#endif
+
+    // Command-line mode (--diff, --record, --list) never initializes GTK
+    int cli_status;
+    if (cli_try_run(argc, argv, &cli_status)) return cli_status;
+
     // Set the GSK_RENDERER environment variable to "cairo" for this process.
     // This is done to prevent screen flickering issues on some Windows systems
     // by forcing a software rendering backend. This must be done before
@@ -194,6 +289,7 @@ int main(int argc, char **argv) {
     );
 
     // 2. Connect the "activate" signal to our UI-building function
+    g_signal_connect(app, "startup", G_CALLBACK(on_startup), NULL);
     g_signal_connect(app, "activate", G_CALLBACK(on_activate), NULL);
 
     // 3. Run the application
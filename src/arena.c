@@ -0,0 +1,93 @@
+#include "arena.h"
+#include <string.h>
+
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+#define ARENA_ALIGN (2 * sizeof(void *))
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    gsize size;         /* usable bytes after the header */
+    gsize used;
+} ArenaChunk;
+
+/* Header rounded up so chunk data starts aligned */
+#define CHUNK_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct _Arena {
+    ArenaChunk *current;    /* bump allocations come from here */
+    ArenaChunk *full;       /* retired and oversized chunks */
+    gsize chunk_size;
+    ArenaStats stats;
+};
+
+Arena *arena_new(gsize chunk_size) {
+    Arena *arena = g_new0(Arena, 1);
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+    return arena;
+}
+
+static void free_chunks(ArenaChunk *chunk) {
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        g_free(chunk);
+        chunk = next;
+    }
+}
+
+void arena_free(Arena *arena) {
+    if (!arena) return;
+    free_chunks(arena->current);
+    free_chunks(arena->full);
+    g_free(arena);
+}
+
+static ArenaChunk *new_chunk(Arena *arena, gsize size) {
+    ArenaChunk *chunk = g_malloc(CHUNK_HEADER + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->stats.chunks++;
+    arena->stats.reserved += CHUNK_HEADER + size;
+    return chunk;
+}
+
+gpointer arena_alloc(Arena *arena, gsize size) {
+    gsize rounded = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    arena->stats.allocations++;
+    arena->stats.bytes += size;
+
+    ArenaChunk *chunk = arena->current;
+    if (!chunk || chunk->size - chunk->used < rounded) {
+        if (rounded > arena->chunk_size / 4) {
+            /* Oversized: its own chunk, kept off the bump path */
+            chunk = new_chunk(arena, rounded);
+            chunk->used = rounded;
+            chunk->next = arena->full;
+            arena->full = chunk;
+            return (guint8 *)chunk + CHUNK_HEADER;
+        }
+        if (chunk) {
+            chunk->next = arena->full;
+            arena->full = chunk;
+        }
+        chunk = arena->current = new_chunk(arena, arena->chunk_size);
+    }
+    gpointer p = (guint8 *)chunk + CHUNK_HEADER + chunk->used;
+    chunk->used += rounded;
+    return p;
+}
+
+gpointer arena_alloc0(Arena *arena, gsize size) {
+    return memset(arena_alloc(arena, size), 0, size);
+}
+
+gchar *arena_strndup(Arena *arena, const char *text, gsize length) {
+    gchar *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_get_stats(const Arena *arena, ArenaStats *stats) {
+    *stats = arena->stats;
+}
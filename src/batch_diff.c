@@ -0,0 +1,162 @@
+#include "batch_diff.h"
+#include "diff_logic.h"
+#include "version_store.h"
+#include "work_pool.h"
+#include <string.h>
+
+typedef struct {
+    guint index;
+    gchar *left;
+    gchar *right;
+} BatchPair;
+
+typedef struct {
+    FILE *out;
+    GMutex out_lock;
+    gint errors;
+} BatchRun;
+
+static void batch_pair_free(BatchPair *pair) {
+    g_free(pair->left);
+    g_free(pair->right);
+    g_free(pair);
+}
+
+/* Paths may hold backslashes (Windows) or quotes, so escape them for JSON */
+static void append_json_string(GString *out, const char *s) {
+    g_string_append_c(out, '"');
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        switch (*p) {
+        case '"': g_string_append(out, "\\\""); break;
+        case '\\': g_string_append(out, "\\\\"); break;
+        case '\n': g_string_append(out, "\\n"); break;
+        case '\r': g_string_append(out, "\\r"); break;
+        case '\t': g_string_append(out, "\\t"); break;
+        default:
+            if (*p < 0x20) g_string_append_printf(out, "\\u%04x", *p);
+            else g_string_append_c(out, (char)*p);
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+static void diff_pair(gpointer item, gpointer user_data) {
+    BatchPair *pair = item;
+    BatchRun *run = user_data;
+
+    gint64 start = g_get_monotonic_time();
+    DiffInputs inputs;
+    GArray *diffs = perform_diff(pair->left, pair->right, &inputs);
+    double seconds = (g_get_monotonic_time() - start) / 1e6;
+
+    GString *line = g_string_new("{\"index\":");
+    g_string_append_printf(line, "%u,\"left\":", pair->index);
+    append_json_string(line, pair->left);
+    g_string_append(line, ",\"right\":");
+    append_json_string(line, pair->right);
+    if (diffs) {
+        DiffStats stats;
+        diff_ops_count(diffs, &stats);
+        g_string_append_printf(line,
+            ",\"status\":\"ok\",\"inserted\":%u,\"deleted\":%u,\"moved\":%u,\"changes\":%u"
+            ",\"binary\":%s,\"left_bytes\":%" G_GSIZE_FORMAT ",\"right_bytes\":%" G_GSIZE_FORMAT,
+            stats.inserted, stats.deleted, stats.moved, stats.changes, inputs.binary ? "true" : "false",
+            inputs.left_length, inputs.right_length);
+        g_array_unref(diffs);
+    } else {
+        g_string_append(line, ",\"status\":\"error\"");
+        g_atomic_int_inc(&run->errors);
+    }
+    g_string_append_printf(line, ",\"seconds\":%.6f,\"worker\":%d}\n", seconds, work_pool_current_worker());
+
+    /* One write per line keeps lines whole; flush so readers see results as they land */
+    g_mutex_lock(&run->out_lock);
+    fwrite(line->str, 1, line->len, run->out);
+    fflush(run->out);
+    g_mutex_unlock(&run->out_lock);
+
+    g_string_free(line, TRUE);
+    batch_pair_free(pair);
+}
+
+int batch_diff_run(const char *manifest_path, guint n_threads, FILE *out) {
+    gchar *manifest = NULL;
+    GError *error = NULL;
+    gboolean from_stdin = g_strcmp0(manifest_path, "-") == 0;
+    if (from_stdin) {
+        GString *buf = g_string_new(NULL);
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), stdin)) > 0) g_string_append_len(buf, chunk, (gssize)n);
+        manifest = g_string_free(buf, FALSE);
+    } else if (!g_file_get_contents(manifest_path, &manifest, NULL, &error)) {
+        fprintf(stderr, "batch: %s\n", error ? error->message : "could not read manifest");
+        g_clear_error(&error);
+        return 2;
+    }
+
+    BatchRun run = { out, { 0 }, 0 };
+    g_mutex_init(&run.out_lock);
+    WorkPool *pool = work_pool_new(n_threads, diff_pair, &run);
+    gint64 start = g_get_monotonic_time();
+
+    guint n_pairs = 0;
+    gchar **lines = g_strsplit(manifest, "\n", -1);
+    for (gchar **l = lines; *l; ++l) {
+        g_strchomp(*l);  /* also drops a '\r' from CRLF manifests */
+        if (**l == '\0' || **l == '#') continue;
+        gchar *tab = strchr(*l, '\t');
+        if (!tab) {
+            fprintf(stderr, "batch: skipping line without a tab: %s\n", *l);
+            continue;
+        }
+        BatchPair *pair = g_new0(BatchPair, 1);
+        pair->index = n_pairs++;
+        pair->left = g_strndup(*l, tab - *l);
+        pair->right = g_strdup(tab + 1);
+        work_pool_push(pool, pair);
+    }
+    g_strfreev(lines);
+    g_free(manifest);
+
+    work_pool_wait(pool);
+    double seconds = (g_get_monotonic_time() - start) / 1e6;
+    fprintf(out, "{\"summary\":true,\"pairs\":%u,\"errors\":%d,\"threads\":%u,\"seconds\":%.6f,"
+                 "\"pairs_per_second\":%.1f}\n",
+            n_pairs, run.errors, work_pool_get_n_threads(pool), seconds,
+            seconds > 0 ? n_pairs / seconds : 0.0);
+    fflush(out);
+
+    work_pool_free(pool);
+    g_mutex_clear(&run.out_lock);
+    return run.errors ? 2 : 0;
+}
+
+void batch_diff_write_tracked_manifest(FILE *out) {
+    /* Group the index by original path; entries are in recording order */
+    GPtrArray *all = version_store_list(NULL);
+    GHashTable *latest = g_hash_table_new(g_str_hash, g_str_equal);   /* original -> newest entry */
+    GHashTable *previous = g_hash_table_new(g_str_hash, g_str_equal); /* original -> entry before it */
+    GPtrArray *order = g_ptr_array_new();
+    for (guint i = 0; i < all->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(all, i);
+        VersionEntry *newest = g_hash_table_lookup(latest, entry->original);
+        if (!newest) g_ptr_array_add(order, entry->original);
+        else g_hash_table_insert(previous, entry->original, newest);
+        g_hash_table_insert(latest, entry->original, entry);
+    }
+    for (guint i = 0; i < order->len; ++i) {
+        VersionEntry *older = g_hash_table_lookup(previous, order->pdata[i]);
+        if (!older) continue;
+        VersionEntry *newer = g_hash_table_lookup(latest, order->pdata[i]);
+        gchar *a = version_store_stored_path(older->stored);
+        gchar *b = version_store_stored_path(newer->stored);
+        fprintf(out, "%s\t%s\n", a, b);
+        g_free(a);
+        g_free(b);
+    }
+    g_ptr_array_free(order, TRUE);
+    g_hash_table_destroy(latest);
+    g_hash_table_destroy(previous);
+    g_ptr_array_free(all, TRUE);
+}
@@ -0,0 +1,194 @@
+#include "binary_diff.h"
+#include "chunk_store.h"
+#include "trace.h"
+#include <string.h>
+
+#define MIN_BLOCK 32
+#define MAX_BLOCK 4096
+/* Multiplier of the rolling polynomial hash; any odd constant with well-mixed bits */
+#define HASH_BASE G_GUINT64_CONSTANT(0x100000001b3)
+
+gboolean binary_diff_is_binary(const char *data, gsize length) {
+    return memchr(data, '\0', MIN(length, BINARY_DIFF_SNIFF_BYTES)) != NULL;
+}
+
+typedef struct {
+    char data[BINARY_DIFF_SNIFF_BYTES];
+    gsize length;
+} SniffBuffer;
+
+static gboolean sniff_head(const char *data, gsize length, gpointer user_data, GError **error) {
+    SniffBuffer *head = user_data;
+    gsize n = MIN(length, sizeof(head->data) - head->length);
+    memcpy(head->data + head->length, data, n);
+    head->length += n;
+    return head->length < sizeof(head->data);
+}
+
+gboolean binary_diff_file_is_binary(const char *path) {
+    /* Streamed, so a chunked version only has its first chunks read */
+    SniffBuffer *head = g_new(SniffBuffer, 1);
+    head->length = 0;
+    GError *error = NULL;
+    gboolean ok = chunk_store_stream(path, sniff_head, head, &error) || !error;
+    g_clear_error(&error);
+    gboolean binary = ok && binary_diff_is_binary(head->data, head->length);
+    g_free(head);
+    return binary;
+}
+
+// ---
+// --- Block index
+// ---
+
+/* Open addressing over the left blocks; the first block with a given hash wins */
+typedef struct {
+    guint64 hash;
+    gsize offset_plus_one;  /* 0 = empty slot */
+} IndexSlot;
+
+typedef struct {
+    IndexSlot *slots;
+    gsize mask;
+} BlockIndex;
+
+static gsize slot_of(const BlockIndex *index, guint64 hash) {
+    /* Polynomial hashes mod 2^64 are weak in the low bits; take the high ones */
+    return (gsize)((hash * G_GUINT64_CONSTANT(0x9e3779b97f4a7c15)) >> 32) & index->mask;
+}
+
+static guint64 block_hash(const guint8 *data, gsize length) {
+    guint64 h = 0;
+    for (gsize i = 0; i < length; ++i) h = h * HASH_BASE + data[i];
+    return h;
+}
+
+static void index_build(BlockIndex *index, const guint8 *left, gsize left_length, gsize block) {
+    gsize n_blocks = left_length / block;
+    gsize size = 16;
+    while (size < n_blocks * 2) size <<= 1;
+    index->slots = g_new0(IndexSlot, size);
+    index->mask = size - 1;
+    for (gsize b = 0; b < n_blocks; ++b) {
+        guint64 h = block_hash(left + b * block, block);
+        gsize s = slot_of(index, h);
+        while (index->slots[s].offset_plus_one && index->slots[s].hash != h) s = (s + 1) & index->mask;
+        if (index->slots[s].offset_plus_one) continue;
+        index->slots[s].hash = h;
+        index->slots[s].offset_plus_one = b * block + 1;
+    }
+}
+
+/* Offset of the left block with this hash, or -1 */
+static gssize index_find(const BlockIndex *index, guint64 hash) {
+    for (gsize s = slot_of(index, hash); index->slots[s].offset_plus_one; s = (s + 1) & index->mask) {
+        if (index->slots[s].hash == hash) return (gssize)(index->slots[s].offset_plus_one - 1);
+    }
+    return -1;
+}
+
+// ---
+// --- Diff
+// ---
+
+static void append_run(GArray *runs, BinaryRunType type, gsize left_start, gsize right_start, gsize length) {
+    if (runs->len > 0) {
+        BinaryRun *last = &g_array_index(runs, BinaryRun, runs->len - 1);
+        if (last->type == type && last->right_start + last->length == right_start &&
+            (type == BINARY_RUN_LITERAL || last->left_start + last->length == left_start)) {
+            last->length += length;
+            return;
+        }
+    }
+    BinaryRun run = { type, type == BINARY_RUN_COPY ? left_start : 0, right_start, length };
+    g_array_append_val(runs, run);
+}
+
+GArray *binary_diff(const guint8 *left, gsize left_length, const guint8 *right, gsize right_length,
+                    gsize block_size) {
+    TRACE_SCOPE("binary_diff");
+    gsize block = block_size;
+    if (block == 0) {
+        block = MIN_BLOCK;
+        while (block < MAX_BLOCK && block * block < left_length) block <<= 1;
+    }
+    TRACE_SCOPE_ARG("block", block);
+    GArray *runs = g_array_new(FALSE, FALSE, sizeof(BinaryRun));
+    if (left_length < block || right_length < block) {
+        if (right_length > 0) append_run(runs, BINARY_RUN_LITERAL, 0, 0, right_length);
+        return runs;
+    }
+
+    BlockIndex index;
+    index_build(&index, left, left_length, block);
+    /* HASH_BASE^(block - 1), to take the outgoing byte off the rolling hash */
+    guint64 top = 1;
+    for (gsize i = 1; i < block; ++i) top *= HASH_BASE;
+
+    gsize literal_start = 0; /* right bytes from here to pos are not matched yet */
+    gsize pos = 0;
+    guint64 h = block_hash(right, block);
+    while (pos + block <= right_length) {
+        gssize found = index_find(&index, h);
+        if (found >= 0 && memcmp(left + found, right + pos, block) == 0) {
+            /* Grow the match back into the pending literal bytes, then forward as far as it goes */
+            gsize l = (gsize)found, r = pos;
+            while (r > literal_start && l > 0 && left[l - 1] == right[r - 1]) {
+                l--;
+                r--;
+            }
+            gsize end_l = (gsize)found + block, end_r = pos + block;
+            while (end_l < left_length && end_r < right_length && left[end_l] == right[end_r]) {
+                end_l++;
+                end_r++;
+            }
+            if (r > literal_start) append_run(runs, BINARY_RUN_LITERAL, 0, literal_start, r - literal_start);
+            append_run(runs, BINARY_RUN_COPY, l, r, end_r - r);
+            literal_start = pos = end_r;
+            /* Rehashing from scratch is paid for by the block-sized jump */
+            if (pos + block <= right_length) h = block_hash(right + pos, block);
+            continue;
+        }
+        if (pos + block < right_length) h = (h - right[pos] * top) * HASH_BASE + right[pos + block];
+        pos++;
+    }
+    if (literal_start < right_length) {
+        append_run(runs, BINARY_RUN_LITERAL, 0, literal_start, right_length - literal_start);
+    }
+    g_free(index.slots);
+    TRACE_SCOPE_ARG("runs", runs->len);
+    return runs;
+}
+
+static gint compare_ranges(gconstpointer a, gconstpointer b) {
+    gsize x = ((const ByteRange *)a)->start, y = ((const ByteRange *)b)->start;
+    return x < y ? -1 : x > y;
+}
+
+GArray *binary_diff_unused(const GArray *runs, gsize left_length) {
+    GArray *used = g_array_new(FALSE, FALSE, sizeof(ByteRange));
+    for (guint i = 0; i < runs->len; ++i) {
+        const BinaryRun *run = &g_array_index(runs, BinaryRun, i);
+        if (run->type != BINARY_RUN_COPY) continue;
+        ByteRange range = { run->left_start, run->length };
+        g_array_append_val(used, range);
+    }
+    g_array_sort(used, compare_ranges);
+
+    GArray *unused = g_array_new(FALSE, FALSE, sizeof(ByteRange));
+    gsize covered = 0; /* everything before this is read by some copy */
+    for (guint i = 0; i < used->len; ++i) {
+        const ByteRange *range = &g_array_index(used, ByteRange, i);
+        if (range->start > covered) {
+            ByteRange gap = { covered, range->start - covered };
+            g_array_append_val(unused, gap);
+        }
+        covered = MAX(covered, range->start + range->length);
+    }
+    if (covered < left_length) {
+        ByteRange gap = { covered, left_length - covered };
+        g_array_append_val(unused, gap);
+    }
+    g_array_unref(used);
+    return unused;
+}
@@ -0,0 +1,262 @@
+#include "blame.h"
+#include "myers_diff.h"
+#include "version_store.h"
+#include "chunk_store.h"
+#include "trace.h"
+#include "wire_format.h"
+#include <string.h>
+
+#define BLAME_MAGIC "GHBL"
+#define BLAME_FORMAT 1
+
+// ---
+// --- Cache file
+// ---
+
+static gchar *cache_path(const char *original_path) {
+    gchar *name = g_compute_checksum_for_string(G_CHECKSUM_SHA256, original_path, -1);
+    gchar *path = g_build_filename("data", "blame", name, NULL);
+    g_free(name);
+    return path;
+}
+
+/* Stored names the cached walk covered and the origins of the last one's lines; FALSE if absent or damaged */
+static gboolean cache_load(const char *original_path, GPtrArray **names_out, GArray **origins_out) {
+    gchar *path = cache_path(original_path);
+    gchar *contents = NULL;
+    gsize length = 0;
+    gboolean ok = g_file_get_contents(path, &contents, &length, NULL);
+    g_free(path);
+    if (!ok) return FALSE;
+
+    const guint8 *p = (const guint8 *)contents;
+    const guint8 *end = p + length;
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    GArray *origins = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint64 n_versions, n_lines;
+    ok = FALSE;
+
+    if (length < 8 || memcmp(p, BLAME_MAGIC, 4) != 0 || wire_get_u32(p + 4) != BLAME_FORMAT) goto out;
+    p += 8;
+
+    if (!wire_get_varint(&p, end, &n_versions) || n_versions > (guint64)(end - p)) goto out;
+    for (guint64 i = 0; i < n_versions; ++i) {
+        guint64 len;
+        if (!wire_get_varint(&p, end, &len) || len > (guint64)(end - p)) goto out;
+        g_ptr_array_add(names, g_strndup((const char *)p, (gsize)len));
+        p += len;
+    }
+    if (!wire_get_varint(&p, end, &n_lines) || n_lines > (guint64)(end - p)) goto out;
+    g_array_set_size(origins, (guint)n_lines);
+    for (guint i = 0; i < n_lines; ++i) {
+        guint64 origin;
+        if (!wire_get_varint(&p, end, &origin) || origin >= n_versions) goto out;
+        g_array_index(origins, guint, i) = (guint)origin;
+    }
+    ok = p == end && n_versions > 0;
+
+out:
+    g_free(contents);
+    if (ok) {
+        *names_out = names;
+        *origins_out = origins;
+    } else {
+        g_ptr_array_free(names, TRUE);
+        g_array_unref(origins);
+    }
+    return ok;
+}
+
+static gboolean cache_save(const char *original_path, GPtrArray *entries, GArray *origins, GError **error) {
+    GByteArray *out = g_byte_array_sized_new(64 + origins->len * 2);
+    g_byte_array_append(out, (const guint8 *)BLAME_MAGIC, 4);
+    wire_put_u32(out, BLAME_FORMAT);
+    wire_put_varint(out, entries->len);
+    for (guint i = 0; i < entries->len; ++i) {
+        const VersionEntry *entry = g_ptr_array_index(entries, i);
+        gsize len = strlen(entry->stored);
+        wire_put_varint(out, len);
+        g_byte_array_append(out, (const guint8 *)entry->stored, (guint)len);
+    }
+    wire_put_varint(out, origins->len);
+    for (guint i = 0; i < origins->len; ++i) wire_put_varint(out, g_array_index(origins, guint, i));
+
+    gchar *path = cache_path(original_path);
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    gboolean ok = g_file_set_contents(path, (const gchar *)out->data, (gssize)out->len, error);
+    g_free(dir);
+    g_free(path);
+    g_byte_array_unref(out);
+    return ok;
+}
+
+// ---
+// --- Walking the history
+// ---
+
+static gboolean read_version(const VersionEntry *entry, gchar **text, gsize *length, GError **error) {
+    gchar *path = version_store_stored_path(entry->stored);
+    gboolean ok = chunk_store_read_file(path, text, length, error);
+    g_free(path);
+    return ok;
+}
+
+/* Origins of the lines of 'cur' given those of 'prev': unchanged lines keep theirs, inserted ones get 'version' */
+static GArray *carry_origins(const LineTable *prev, const GArray *prev_origins, const LineTable *cur, guint version) {
+    GArray *origins = g_array_sized_new(FALSE, FALSE, sizeof(guint), cur->n_lines);
+    g_array_set_size(origins, cur->n_lines);
+    GArray *edits = myers_diff_sequence((const guint64 *)prev->hashes->data, prev->n_lines,
+                                        (const guint64 *)cur->hashes->data, cur->n_lines);
+    for (guint e = 0; e < edits->len; ++e) {
+        const DiffEdit *edit = &g_array_index(edits, DiffEdit, e);
+        if (edit->type == DIFF_OP_EQUAL) {
+            memcpy(&g_array_index(origins, guint, edit->right_start),
+                   &g_array_index(prev_origins, guint, edit->left_start), edit->length * sizeof(guint));
+        } else if (edit->type == DIFF_OP_INSERT) {
+            for (guint i = 0; i < edit->length; ++i) g_array_index(origins, guint, edit->right_start + i) = version;
+        }
+    }
+    g_array_unref(edits);
+    return origins;
+}
+
+/*
+ * Origins for the newest of 'entries', resuming from the cache where it is
+ * still a prefix of the history. With 'cached_only', returns NULL without an
+ * error when there is no usable cache. The newest version's text and line
+ * table are handed back when asked for.
+ */
+static GArray *bring_up_to_date(const char *original_path, GPtrArray *entries, gboolean cached_only,
+                                gchar **text_out, gsize *length_out, LineTable **lines_out, GError **error) {
+    TRACE_SCOPE("blame.update");
+    if (entries->len == 0) {
+        if (!cached_only) g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "no versions of %s recorded", original_path);
+        return NULL;
+    }
+
+    GPtrArray *cached_names = NULL;
+    GArray *origins = NULL;
+    guint done = 0;
+    if (cache_load(original_path, &cached_names, &origins)) {
+        gboolean prefix = cached_names->len <= entries->len;
+        for (guint i = 0; prefix && i < cached_names->len; ++i) {
+            const VersionEntry *entry = g_ptr_array_index(entries, i);
+            prefix = strcmp(entry->stored, g_ptr_array_index(cached_names, i)) == 0;
+        }
+        if (prefix) done = cached_names->len;
+        else g_clear_pointer(&origins, g_array_unref);
+        g_ptr_array_free(cached_names, TRUE);
+    }
+    if (cached_only && done == 0) return NULL;
+
+    /* The newest covered version, whose lines the cached origins describe */
+    gchar *text = NULL;
+    gsize length = 0;
+    const VersionEntry *start = g_ptr_array_index(entries, done > 0 ? done - 1 : 0);
+    if (!read_version(start, &text, &length, error)) {
+        if (origins) g_array_unref(origins);
+        return NULL;
+    }
+    LineTable *lines = line_table_new(text, length);
+    if (origins && origins->len != lines->n_lines) {
+        /* The stored copy no longer matches what was annotated: start over */
+        g_clear_pointer(&origins, g_array_unref);
+        done = 0;
+        g_free(text);
+        line_table_free(lines);
+        if (!read_version(g_ptr_array_index(entries, 0), &text, &length, error)) return NULL;
+        lines = line_table_new(text, length);
+    }
+    if (done == 0) {
+        origins = g_array_sized_new(FALSE, TRUE, sizeof(guint), lines->n_lines);
+        g_array_set_size(origins, lines->n_lines);
+        done = 1;
+    }
+    guint resumed_at = done;
+
+    for (guint v = done; v < entries->len; ++v) {
+        gchar *next_text = NULL;
+        gsize next_length = 0;
+        if (!read_version(g_ptr_array_index(entries, v), &next_text, &next_length, error)) {
+            g_array_unref(origins);
+            origins = NULL;
+            break;
+        }
+        LineTable *next_lines = line_table_new(next_text, next_length);
+        GArray *next_origins = carry_origins(lines, origins, next_lines, v);
+        g_array_unref(origins);
+        line_table_free(lines);
+        g_free(text);
+        origins = next_origins;
+        lines = next_lines;
+        text = next_text;
+        length = next_length;
+    }
+    TRACE_SCOPE_ARG("diffs", entries->len - resumed_at);
+
+    if (origins && resumed_at < entries->len) {
+        GError *save_error = NULL;
+        if (!cache_save(original_path, entries, origins, &save_error)) {
+            g_printerr("blame: could not cache %s: %s\n", original_path, save_error ? save_error->message : "unknown");
+            g_clear_error(&save_error);
+        }
+    }
+
+    if (origins && text_out) {
+        *text_out = text;
+        *length_out = length;
+        text = NULL;
+    }
+    if (origins && lines_out) {
+        *lines_out = lines;
+        lines = NULL;
+    }
+    g_free(text);
+    if (lines) line_table_free(lines);
+    return origins;
+}
+
+// ---
+// --- Public API
+// ---
+
+BlameResult *blame_annotate(const char *original_path, GError **error) {
+    GPtrArray *entries = version_store_list(original_path);
+    BlameResult *result = g_new0(BlameResult, 1);
+    result->origins = bring_up_to_date(original_path, entries, FALSE, &result->text, &result->length,
+                                       &result->lines, error);
+    result->versions = entries;
+    if (!result->origins) {
+        blame_result_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+void blame_result_free(BlameResult *result) {
+    if (!result) return;
+    if (result->versions) g_ptr_array_free(result->versions, TRUE);
+    if (result->origins) g_array_unref(result->origins);
+    if (result->lines) line_table_free(result->lines);
+    g_free(result->text);
+    g_free(result);
+}
+
+gboolean blame_extend_cached(const char *original_path, GError **error) {
+    gchar *path = cache_path(original_path);
+    gboolean cached = g_file_test(path, G_FILE_TEST_EXISTS);
+    g_free(path);
+    if (!cached) return TRUE;
+
+    GPtrArray *entries = version_store_list(original_path);
+    GError *local_error = NULL;
+    GArray *origins = bring_up_to_date(original_path, entries, TRUE, NULL, NULL, NULL, &local_error);
+    g_ptr_array_free(entries, TRUE);
+    if (origins) g_array_unref(origins);
+    if (local_error) {
+        g_propagate_error(error, local_error);
+        return FALSE;
+    }
+    return TRUE;
+}
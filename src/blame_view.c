@@ -0,0 +1,154 @@
+#include "blame_view.h"
+#include "blame.h"
+#include "version_store.h"
+#include <string.h>
+
+/* "v<n> <date time> │ ", in characters; continuation lines get blanks of the same width */
+#define GUTTER_FORMAT "v%-5u %-16s │ "
+#define GUTTER_CHARS 26
+
+/* What the worker hands back: the buffer's text and which lines start a new run */
+typedef struct {
+    gchar *text;
+    GArray *run_starts;     /* guint line numbers */
+    guint n_lines;
+    guint n_versions;
+    guint newest_lines;     /* lines the newest version introduced */
+} BlameText;
+
+static void blame_text_free(BlameText *bt) {
+    g_free(bt->text);
+    g_array_unref(bt->run_starts);
+    g_free(bt);
+}
+
+/* YYYYmmddHHMMSS -> "YYYY-mm-dd HH:MM" */
+static void format_timestamp(char *out, gsize size, const char *ts) {
+    if (ts && strlen(ts) >= 12) {
+        g_snprintf(out, size, "%.4s-%.2s-%.2s %.2s:%.2s", ts, ts + 4, ts + 6, ts + 8, ts + 10);
+    } else {
+        g_strlcpy(out, ts ? ts : "", size);
+    }
+}
+
+static BlameText *render_blame(const BlameResult *result) {
+    BlameText *bt = g_new0(BlameText, 1);
+    bt->run_starts = g_array_new(FALSE, FALSE, sizeof(guint));
+    bt->n_lines = result->lines->n_lines;
+    bt->n_versions = result->versions->len;
+
+    GString *out = g_string_sized_new(result->length + (gsize)bt->n_lines * (GUTTER_CHARS + 2));
+    guint newest = result->versions->len - 1;
+    for (guint i = 0; i < bt->n_lines; ++i) {
+        guint origin = g_array_index(result->origins, guint, i);
+        if (origin == newest) bt->newest_lines++;
+        if (i == 0 || origin != g_array_index(result->origins, guint, i - 1)) {
+            const VersionEntry *entry = g_ptr_array_index(result->versions, origin);
+            char when[32];
+            format_timestamp(when, sizeof(when), entry->timestamp);
+            g_string_append_printf(out, GUTTER_FORMAT, origin + 1, when);
+            g_array_append_val(bt->run_starts, i);
+        } else {
+            g_string_append_printf(out, "%*s│ ", GUTTER_CHARS - 2, "");
+        }
+
+        gsize start = g_array_index(result->lines->offsets, gsize, i);
+        gsize end = g_array_index(result->lines->offsets, gsize, i + 1);
+        if (end > start && result->text[end - 1] == '\n') end--;
+        gchar *line = g_utf8_make_valid(result->text + start, (gssize)(end - start));
+        g_string_append(out, line);
+        g_string_append_c(out, '\n');
+        g_free(line);
+    }
+    bt->text = g_string_free(out, FALSE);
+    return bt;
+}
+
+static void blame_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    GError *error = NULL;
+    BlameResult *result = blame_annotate(task_data, &error);
+    if (!result) {
+        g_task_return_error(task, error);
+        return;
+    }
+    BlameText *bt = render_blame(result);
+    blame_result_free(result);
+    g_task_return_pointer(task, bt, (GDestroyNotify)blame_text_free);
+}
+
+/* The text view is the task's source object, so it is still alive even if the window was closed */
+static void on_blame_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    GtkLabel *status = GTK_LABEL(user_data);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source));
+    GError *error = NULL;
+    BlameText *bt = g_task_propagate_pointer(G_TASK(res), &error);
+    if (!bt) {
+        gchar *message = g_strdup_printf("Could not annotate: %s", error ? error->message : "unknown error");
+        gtk_label_set_text(status, message);
+        g_free(message);
+        g_clear_error(&error);
+        g_object_unref(status);
+        return;
+    }
+
+    gtk_text_buffer_set_text(buffer, bt->text, -1);
+    GtkTextIter start, end;
+    /* Every line has a gutter; run starts are set apart so each version's block is easy to spot */
+    for (guint line = 0; line < bt->n_lines; ++line) {
+        gtk_text_buffer_get_iter_at_line_offset(buffer, &start, (gint)line, 0);
+        gtk_text_buffer_get_iter_at_line_offset(buffer, &end, (gint)line, GUTTER_CHARS);
+        gtk_text_buffer_apply_tag_by_name(buffer, "blame-gutter", &start, &end);
+    }
+    for (guint r = 0; r < bt->run_starts->len; ++r) {
+        gint line = (gint)g_array_index(bt->run_starts, guint, r);
+        gtk_text_buffer_get_iter_at_line_offset(buffer, &start, line, 0);
+        gtk_text_buffer_get_iter_at_line_offset(buffer, &end, line, GUTTER_CHARS - 2);
+        gtk_text_buffer_apply_tag_by_name(buffer, "blame-run-start", &start, &end);
+    }
+
+    gchar *message = g_strdup_printf("%u lines from %u versions; %u new in the latest",
+                                     bt->n_lines, bt->n_versions, bt->newest_lines);
+    gtk_label_set_text(status, message);
+    g_free(message);
+    blame_text_free(bt);
+    g_object_unref(status);
+}
+
+void create_blame_window(GtkWindow *parent, const char *original_path) {
+    GtkWidget *window = gtk_window_new();
+    gchar *basename = g_path_get_basename(original_path);
+    gchar *title = g_strdup_printf("Annotate %s", basename);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_default_size(GTK_WINDOW(window), 1000, 800);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+    g_free(title);
+    g_free(basename);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    GtkWidget *status = gtk_label_new("Annotating…");
+    gtk_widget_set_halign(status, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(status, 10);
+    gtk_widget_set_margin_top(status, 5);
+    gtk_widget_set_margin_bottom(status, 5);
+    gtk_box_append(GTK_BOX(vbox), status);
+
+    GtkWidget *view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+    gtk_text_buffer_create_tag(buffer, "blame-gutter", "foreground", "gray", NULL);
+    gtk_text_buffer_create_tag(buffer, "blame-run-start", "weight", PANGO_WEIGHT_BOLD, NULL);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
+    gtk_box_append(GTK_BOX(vbox), scrolled);
+    gtk_window_set_child(GTK_WINDOW(window), vbox);
+    gtk_window_present(GTK_WINDOW(window));
+
+    GTask *task = g_task_new(view, NULL, on_blame_ready, g_object_ref(status));
+    g_task_set_task_data(task, g_strdup(original_path), g_free);
+    g_task_run_in_thread(task, blame_thread);
+    g_object_unref(task);
+}
@@ -0,0 +1,676 @@
+#include "chunk_store.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "wire_format.h"
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNK_LIST_MAGIC "GHCK"
+#define CHUNK_LIST_FORMAT 1
+#define CHUNK_LIST_SUFFIX ".chunks"
+#define DIGEST_LENGTH 32
+
+/* FastCDC's normalized chunking masks for an 8 KiB average: more bits (harder to cut) below the average,
+ * fewer above, which pulls chunk sizes towards it */
+#define MASK_SMALL G_GUINT64_CONSTANT(0x0003590703530000)
+#define MASK_LARGE G_GUINT64_CONSTANT(0x0000d90003530000)
+
+// ---
+// --- Chunking
+// ---
+
+static guint64 gear[256];
+
+/* Fixed pseudo-random values, the same in every build, so cut points never move between runs */
+static void init_gear(void) {
+    static gsize initialized = 0;
+    if (!g_once_init_enter(&initialized)) return;
+    guint64 state = G_GUINT64_CONSTANT(0x6a09e667f3bcc908);
+    for (int i = 0; i < 256; ++i) {
+        /* splitmix64 */
+        guint64 z = (state += G_GUINT64_CONSTANT(0x9e3779b97f4a7c15));
+        z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94d049bb133111eb);
+        gear[i] = z ^ (z >> 31);
+    }
+    g_once_init_leave(&initialized, 1);
+}
+
+gsize chunk_store_cut(const guint8 *data, gsize length) {
+    init_gear();
+    if (length <= CHUNK_MIN_SIZE) return length;
+    gsize end = MIN(length, CHUNK_MAX_SIZE);
+    gsize normal = MIN(end, CHUNK_AVG_SIZE);
+    guint64 fp = 0;
+    /* Nothing is cut inside the minimum size, so the hash only starts there */
+    gsize i = CHUNK_MIN_SIZE;
+    for (; i < normal; ++i) {
+        fp = (fp << 1) + gear[data[i]];
+        if (!(fp & MASK_SMALL)) return i;
+    }
+    for (; i < end; ++i) {
+        fp = (fp << 1) + gear[data[i]];
+        if (!(fp & MASK_LARGE)) return i;
+    }
+    return end;
+}
+
+GArray *chunk_store_split(const guint8 *data, gsize length) {
+    TRACE_SCOPE("chunks.split");
+    GArray *lengths = g_array_sized_new(FALSE, FALSE, sizeof(guint32), (guint)(length / CHUNK_AVG_SIZE + 1));
+    for (gsize pos = 0; pos < length;) {
+        guint32 n = (guint32)chunk_store_cut(data + pos, length - pos);
+        g_array_append_val(lengths, n);
+        pos += n;
+    }
+    TRACE_SCOPE_ARG("chunks", lengths->len);
+    return lengths;
+}
+
+// ---
+// --- Chunk files and lists
+// ---
+
+/* Held shared by writers for a whole write and alone by chunk_store_collect(), so a collection never
+ * sweeps a chunk that a write found on disk and is about to reference */
+static GRWLock collect_lock;
+
+static gchar *chunk_path(const guint8 digest[DIGEST_LENGTH]) {
+    gchar hex[DIGEST_LENGTH * 2 + 1];
+    for (int i = 0; i < DIGEST_LENGTH; ++i) g_snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    gchar dir[3] = { hex[0], hex[1], '\0' };
+    return g_build_filename("data", "chunks", dir, hex, NULL);
+}
+
+static gchar *list_path(const char *path) {
+    return g_strconcat(path, CHUNK_LIST_SUFFIX, NULL);
+}
+
+static void digest_of(const char *data, gsize length, guint8 digest[DIGEST_LENGTH]) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, (const guchar *)data, (gssize)length);
+    gsize digest_length = DIGEST_LENGTH;
+    g_checksum_get_digest(checksum, digest, &digest_length);
+    g_checksum_free(checksum);
+}
+
+gboolean chunk_store_write(const char *path, const char *data, gsize length, ChunkWriteStats *stats, GError **error) {
+    TRACE_SCOPE("chunks.write");
+    g_rw_lock_reader_lock(&collect_lock);
+    ChunkWriteStats local = { 0 };
+    GArray *lengths = chunk_store_split((const guint8 *)data, length);
+    GByteArray *list = g_byte_array_sized_new(16 + lengths->len * (DIGEST_LENGTH + 3));
+    g_byte_array_append(list, (const guint8 *)CHUNK_LIST_MAGIC, 4);
+    wire_put_u32(list, CHUNK_LIST_FORMAT);
+    wire_put_varint(list, length);
+    wire_put_varint(list, lengths->len);
+
+    gboolean ok = TRUE;
+    gsize pos = 0;
+    for (guint i = 0; ok && i < lengths->len; ++i) {
+        guint32 n = g_array_index(lengths, guint32, i);
+        guint8 digest[DIGEST_LENGTH];
+        digest_of(data + pos, n, digest);
+        g_byte_array_append(list, digest, DIGEST_LENGTH);
+        wire_put_varint(list, n);
+
+        /* Content-addressed: an existing file already holds these bytes */
+        gchar *file = chunk_path(digest);
+        if (!g_file_test(file, G_FILE_TEST_EXISTS)) {
+            gchar *dir = g_path_get_dirname(file);
+            g_mkdir_with_parents(dir, 0755);
+            g_free(dir);
+            ok = g_file_set_contents(file, data + pos, n, error);
+            local.new_chunks++;
+            local.new_bytes += n;
+        }
+        g_free(file);
+        pos += n;
+    }
+    local.chunks = lengths->len;
+    TRACE_SCOPE_ARG("new_chunks", local.new_chunks);
+
+    if (ok) {
+        gchar *lpath = list_path(path);
+        ok = g_file_set_contents(lpath, (const gchar *)list->data, (gssize)list->len, error);
+        g_free(lpath);
+    }
+    g_rw_lock_reader_unlock(&collect_lock);
+    if (stats) *stats = local;
+    g_byte_array_unref(list);
+    g_array_unref(lengths);
+    return ok;
+}
+
+gboolean chunk_store_is_chunked(const char *path) {
+    gchar *lpath = list_path(path);
+    gboolean chunked = g_file_test(lpath, G_FILE_TEST_EXISTS);
+    g_free(lpath);
+    return chunked;
+}
+
+/* The list's header; *p is left at the first chunk */
+static gboolean read_list_header(const guint8 **p, const guint8 *end, guint64 *total, guint64 *n_chunks) {
+    if (end - *p < 8 || memcmp(*p, CHUNK_LIST_MAGIC, 4) != 0 || wire_get_u32(*p + 4) != CHUNK_LIST_FORMAT) return FALSE;
+    *p += 8;
+    /* n_chunks is bounded by the list's size, and no chunk is longer than CHUNK_MAX_SIZE */
+    return wire_get_varint(p, end, total) && wire_get_varint(p, end, n_chunks) &&
+           *n_chunks <= (guint64)(end - *p) / (DIGEST_LENGTH + 1) && *total <= *n_chunks * CHUNK_MAX_SIZE;
+}
+
+// ---
+// --- Chunk cache
+// ---
+
+typedef struct {
+    guint8 digest[DIGEST_LENGTH];
+    GList link;         /* position in cache_lru, most recent first */
+    gsize length;
+    gchar data[];
+} CachedChunk;
+
+static GMutex cache_lock;
+static GHashTable *cache_table;   /* digest -> CachedChunk* */
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_bytes;
+
+static guint digest_hash(gconstpointer key) {
+    /* SHA-256 bytes are already uniform */
+    guint h;
+    memcpy(&h, key, sizeof(h));
+    return h;
+}
+
+static gboolean digest_equal(gconstpointer a, gconstpointer b) {
+    return memcmp(a, b, DIGEST_LENGTH) == 0;
+}
+
+/* Copy a cached chunk into out (CHUNK_MAX_SIZE bytes); FALSE if it isn't cached */
+static gboolean cache_lookup(const guint8 *digest, gchar *out, gsize length) {
+    g_mutex_lock(&cache_lock);
+    CachedChunk *chunk = cache_table ? g_hash_table_lookup(cache_table, digest) : NULL;
+    gboolean found = chunk && chunk->length == length;
+    if (found) {
+        g_queue_unlink(&cache_lru, &chunk->link);
+        g_queue_push_head_link(&cache_lru, &chunk->link);
+        memcpy(out, chunk->data, length);
+    }
+    g_mutex_unlock(&cache_lock);
+    return found;
+}
+
+static void cache_insert(const guint8 *digest, const gchar *data, gsize length) {
+    g_mutex_lock(&cache_lock);
+    if (!cache_table) cache_table = g_hash_table_new_full(digest_hash, digest_equal, NULL, g_free);
+    if (!g_hash_table_contains(cache_table, digest)) {
+        CachedChunk *chunk = g_malloc(sizeof(CachedChunk) + length);
+        memcpy(chunk->digest, digest, DIGEST_LENGTH);
+        chunk->link = (GList){ .data = chunk };
+        chunk->length = length;
+        memcpy(chunk->data, data, length);
+        g_queue_push_head_link(&cache_lru, &chunk->link);
+        g_hash_table_insert(cache_table, chunk->digest, chunk);
+        cache_bytes += length;
+
+        while (cache_bytes > CHUNK_CACHE_BUDGET) {
+            CachedChunk *victim = g_queue_pop_tail_link(&cache_lru)->data;
+            cache_bytes -= victim->length;
+            g_hash_table_remove(cache_table, victim->digest);
+        }
+        perf_counter_set(PERF_CHUNK_CACHE_BYTES, (gint64)cache_bytes);
+    }
+    g_mutex_unlock(&cache_lock);
+}
+
+/* Chunk bytes into out, from the cache or from disk; chunks read from disk are checked against their hash */
+static gboolean load_chunk(const char *path, const guint8 *digest, gsize length, gchar *out, GError **error) {
+    if (cache_lookup(digest, out, length)) return TRUE;
+
+    gchar *file = chunk_path(digest);
+    gchar *chunk = NULL;
+    gsize chunk_length = 0;
+    gboolean ok = g_file_get_contents(file, &chunk, &chunk_length, error);
+    g_free(file);
+    if (!ok) return FALSE;
+    guint8 check[DIGEST_LENGTH];
+    digest_of(chunk, chunk_length, check);
+    if (chunk_length != length || memcmp(check, digest, DIGEST_LENGTH) != 0) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: a chunk is damaged", path);
+        g_free(chunk);
+        return FALSE;
+    }
+    memcpy(out, chunk, length);
+    cache_insert(digest, chunk, length);
+    g_free(chunk);
+    return TRUE;
+}
+
+// ---
+// --- Reading
+// ---
+
+typedef gboolean (*ChunkBegin)(guint64 total, gpointer user_data, GError **error);
+
+/* Feed the chunks of a chunk list to sink in order; 'begin' (may be NULL) gets the total length first */
+static gboolean walk_chunks(const char *path, ChunkBegin begin, ChunkSink sink, gpointer user_data, GError **error) {
+    TRACE_SCOPE("chunks.read");
+    gchar *lpath = list_path(path);
+    gchar *list = NULL;
+    gsize list_length = 0;
+    gboolean ok = g_file_get_contents(lpath, &list, &list_length, error);
+    g_free(lpath);
+    if (!ok) return FALSE;
+
+    const guint8 *p = (const guint8 *)list;
+    const guint8 *end = p + list_length;
+    guint64 total, n_chunks;
+    gchar *buffer = NULL;
+    guint64 pos = 0;
+    ok = FALSE;
+    if (!read_list_header(&p, end, &total, &n_chunks)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: damaged chunk list", path);
+        goto out;
+    }
+    TRACE_SCOPE_ARG("chunks", n_chunks);
+    if (begin && !begin(total, user_data, error)) goto out;
+    buffer = g_malloc(CHUNK_MAX_SIZE);
+    for (guint64 i = 0; i < n_chunks; ++i) {
+        guint64 n;
+        const guint8 *digest = p;
+        p += DIGEST_LENGTH;
+        if (p > end || !wire_get_varint(&p, end, &n) || n > total - pos || n > CHUNK_MAX_SIZE) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: damaged chunk list", path);
+            goto out;
+        }
+        if (!load_chunk(path, digest, (gsize)n, buffer, error) || !sink(buffer, (gsize)n, user_data, error)) goto out;
+        pos += n;
+    }
+    if (pos != total || p != end) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: damaged chunk list", path);
+        goto out;
+    }
+    ok = TRUE;
+
+out:
+    g_free(buffer);
+    g_free(list);
+    return ok;
+}
+
+typedef struct {
+    gchar *data;
+    gsize length;
+} ReadBuffer;
+
+static gboolean read_begin(guint64 total, gpointer user_data, GError **error) {
+    ReadBuffer *buffer = user_data;
+    buffer->data = total < G_MAXSIZE ? g_try_malloc((gsize)total + 1) : NULL;
+    if (!buffer->data) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "not enough memory for %" G_GUINT64_FORMAT " bytes",
+                    total);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean read_append(const char *data, gsize length, gpointer user_data, GError **error) {
+    ReadBuffer *buffer = user_data;
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return TRUE;
+}
+
+gboolean chunk_store_read_file(const char *path, gchar **contents, gsize *length, GError **error) {
+    if (g_file_test(path, G_FILE_TEST_EXISTS) || !chunk_store_is_chunked(path)) {
+        return g_file_get_contents(path, contents, length, error);
+    }
+    ReadBuffer buffer = { NULL, 0 };
+    if (!walk_chunks(path, read_begin, read_append, &buffer, error)) {
+        g_free(buffer.data);
+        return FALSE;
+    }
+    buffer.data[buffer.length] = '\0';
+    *contents = buffer.data;
+    if (length) *length = buffer.length;
+    return TRUE;
+}
+
+gboolean chunk_store_stream(const char *path, ChunkSink sink, gpointer user_data, GError **error) {
+    if (!g_file_test(path, G_FILE_TEST_EXISTS) && chunk_store_is_chunked(path)) {
+        return walk_chunks(path, NULL, sink, user_data, error);
+    }
+    FILE *in = g_fopen(path, "rb");
+    if (!in) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not open %s: %s", path,
+                    g_strerror(saved));
+        return FALSE;
+    }
+    gchar *buffer = g_malloc(CHUNK_MAX_SIZE);
+    gboolean ok = TRUE;
+    size_t n;
+    while (ok && (n = fread(buffer, 1, CHUNK_MAX_SIZE, in)) > 0) ok = sink(buffer, n, user_data, error);
+    if (ok && ferror(in)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "could not read %s", path);
+        ok = FALSE;
+    }
+    g_free(buffer);
+    fclose(in);
+    return ok;
+}
+
+typedef struct {
+    FILE *out;
+    GCancellable *cancellable;
+} ExportTarget;
+
+static gboolean write_to_file(const char *data, gsize length, gpointer user_data, GError **error) {
+    ExportTarget *target = user_data;
+    if (g_cancellable_set_error_if_cancelled(target->cancellable, error)) return FALSE;
+    if (fwrite(data, 1, length, target->out) == length) return TRUE;
+    int saved = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not write: %s", g_strerror(saved));
+    return FALSE;
+}
+
+/* Export, giving up between chunks once 'cancellable' is cancelled */
+static gboolean export_file(const char *path, const char *dest_path, GCancellable *cancellable, GError **error) {
+    TRACE_SCOPE("chunks.export");
+    /* Written next to the destination and renamed over it, so it is never seen half-written */
+    gchar *tmp_path = g_strconcat(dest_path, ".XXXXXX", NULL);
+    int fd = g_mkstemp(tmp_path);
+    FILE *out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!out) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not create %s: %s", tmp_path,
+                    g_strerror(saved));
+        if (fd >= 0) g_close(fd, NULL);
+        g_free(tmp_path);
+        return FALSE;
+    }
+    /* mkstemp creates the file private; keep the mode of the file being replaced */
+    GStatBuf st;
+    g_chmod(tmp_path, g_stat(dest_path, &st) == 0 ? (int)(st.st_mode & 0777) : 0644);
+    ExportTarget target = { out, cancellable };
+    gboolean ok = chunk_store_stream(path, write_to_file, &target, error);
+    if (fclose(out) != 0 && ok) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not write %s: %s", tmp_path,
+                    g_strerror(saved));
+        ok = FALSE;
+    }
+    if (ok && g_rename(tmp_path, dest_path) != 0) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not replace %s: %s", dest_path,
+                    g_strerror(saved));
+        ok = FALSE;
+    }
+    if (!ok) g_remove(tmp_path);
+    g_free(tmp_path);
+    return ok;
+}
+
+gboolean chunk_store_export(const char *path, const char *dest_path, GError **error) {
+    return export_file(path, dest_path, NULL, error);
+}
+
+/* Materialized copies live in <tmp>/gyatthub/<16 hex of the list hash>/<name> */
+static gchar *materialized_root(void) {
+    return g_build_filename(g_get_tmp_dir(), "gyatthub", NULL);
+}
+
+/* Callers holding each copy: one copy may back several windows, so it goes once the last one releases it */
+static GMutex materialized_lock;
+static GHashTable *materialized_refs;  /* copy path -> count */
+
+static void materialized_ref_locked(const char *copy_path) {
+    if (!materialized_refs) materialized_refs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    guint count = GPOINTER_TO_UINT(g_hash_table_lookup(materialized_refs, copy_path));
+    g_hash_table_insert(materialized_refs, g_strdup(copy_path), GUINT_TO_POINTER(count + 1));
+}
+
+/* TRUE if that was the last holder */
+static gboolean materialized_unref_locked(const char *copy_path) {
+    guint count = materialized_refs ? GPOINTER_TO_UINT(g_hash_table_lookup(materialized_refs, copy_path)) : 0;
+    if (count > 1) {
+        g_hash_table_insert(materialized_refs, g_strdup(copy_path), GUINT_TO_POINTER(count - 1));
+        return FALSE;
+    }
+    if (count == 1) g_hash_table_remove(materialized_refs, copy_path);
+    return TRUE;
+}
+
+static gchar *materialize(const char *path, GCancellable *cancellable, GError **error) {
+    if (g_file_test(path, G_FILE_TEST_EXISTS) || !chunk_store_is_chunked(path)) return g_strdup(path);
+
+    /* Named after the chunk list's hash, so a copy already there holds these exact contents */
+    gchar *lpath = list_path(path);
+    gchar *list = NULL;
+    gsize list_length = 0;
+    gboolean ok = g_file_get_contents(lpath, &list, &list_length, error);
+    g_free(lpath);
+    if (!ok) return NULL;
+    gchar *hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *)list, list_length);
+    g_free(list);
+    hash[16] = '\0';
+
+    gchar *root = materialized_root();
+    gchar *dir = g_build_filename(root, hash, NULL);
+    g_free(root);
+    gchar *base = g_path_get_basename(path);
+    gchar *copy_path = g_build_filename(dir, base, NULL);
+    /* Taken before the export, so a release by another holder can't delete the copy under this one */
+    g_mutex_lock(&materialized_lock);
+    materialized_ref_locked(copy_path);
+    gboolean exists = g_file_test(copy_path, G_FILE_TEST_EXISTS);
+    if (!exists) g_mkdir_with_parents(dir, 0700);
+    g_mutex_unlock(&materialized_lock);
+    /* Two callers may both export a copy that isn't there yet; the rename makes either result whole */
+    if (!exists && !export_file(path, copy_path, cancellable, error)) {
+        g_mutex_lock(&materialized_lock);
+        materialized_unref_locked(copy_path);
+        g_mutex_unlock(&materialized_lock);
+        g_clear_pointer(&copy_path, g_free);
+    }
+    g_free(base);
+    g_free(dir);
+    g_free(hash);
+    return copy_path;
+}
+
+gchar *chunk_store_materialize(const char *path, GError **error) {
+    return materialize(path, NULL, error);
+}
+
+static void materialize_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    TRACE_SCOPE("chunks.materialize");
+    GError *error = NULL;
+    gchar *copy_path = materialize(task_data, cancellable, &error);
+    if (copy_path) g_task_return_pointer(task, copy_path, g_free);
+    else g_task_return_error(task, error);
+}
+
+void chunk_store_materialize_async(const char *path, GCancellable *cancellable, GAsyncReadyCallback callback,
+                                   gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, g_strdup(path), g_free);
+    g_task_run_in_thread(task, materialize_thread);
+    g_object_unref(task);
+}
+
+gchar *chunk_store_materialize_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+void chunk_store_release_materialized(const char *copy_path) {
+    gchar *root = materialized_root();
+    gchar *dir = g_path_get_dirname(copy_path);
+    gchar *parent = g_path_get_dirname(dir);
+    /* Anything else is a file of the user's, handed back as is by chunk_store_materialize() */
+    if (g_strcmp0(parent, root) == 0) {
+        g_mutex_lock(&materialized_lock);
+        if (materialized_unref_locked(copy_path)) {
+            g_remove(copy_path);
+            g_rmdir(dir);
+        }
+        g_mutex_unlock(&materialized_lock);
+    }
+    g_free(parent);
+    g_free(dir);
+    g_free(root);
+}
+
+void chunk_store_clear_materialized(void) {
+    TRACE_SCOPE("chunks.clear_materialized");
+    gchar *root = materialized_root();
+    GDir *copies = g_dir_open(root, 0, NULL);
+    const gchar *hash;
+    while (copies && (hash = g_dir_read_name(copies)) != NULL) {
+        gchar *dir = g_build_filename(root, hash, NULL);
+        GDir *files = g_dir_open(dir, 0, NULL);
+        const gchar *name;
+        while (files && (name = g_dir_read_name(files)) != NULL) {
+            gchar *file = g_build_filename(dir, name, NULL);
+            g_remove(file);
+            g_free(file);
+        }
+        if (files) g_dir_close(files);
+        g_rmdir(dir);
+        g_free(dir);
+    }
+    if (copies) g_dir_close(copies);
+    g_free(root);
+}
+
+gint64 chunk_store_file_length(const char *path) {
+    GStatBuf st;
+    if (g_stat(path, &st) == 0) return (gint64)st.st_size;
+
+    gchar *lpath = list_path(path);
+    gchar *list = NULL;
+    gsize list_length = 0;
+    gint64 result = -1;
+    if (g_file_get_contents(lpath, &list, &list_length, NULL)) {
+        const guint8 *p = (const guint8 *)list;
+        guint64 total, n_chunks;
+        if (read_list_header(&p, p + list_length, &total, &n_chunks)) result = (gint64)total;
+    }
+    g_free(list);
+    g_free(lpath);
+    return result;
+}
+
+gchar *chunk_store_content_id(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_EXISTS)) return NULL;
+    gchar *lpath = list_path(path);
+    gchar *list = NULL;
+    gsize list_length = 0;
+    gchar *id = NULL;
+    if (g_file_get_contents(lpath, &list, &list_length, NULL)) {
+        id = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *)list, list_length);
+    }
+    g_free(list);
+    g_free(lpath);
+    return id;
+}
+
+gboolean chunk_store_remove(const char *path, GError **error) {
+    gchar *lpath = list_path(path);
+    gboolean ok = g_remove(lpath) == 0;
+    if (!ok) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved), "could not remove %s: %s", lpath,
+                    g_strerror(saved));
+    }
+    g_free(lpath);
+    return ok;
+}
+
+// ---
+// --- Collection
+// ---
+
+/* Add the digest of every chunk the list at lpath refers to */
+static gboolean mark_list(const char *lpath, GHashTable *live, GError **error) {
+    gchar *list = NULL;
+    gsize list_length = 0;
+    if (!g_file_get_contents(lpath, &list, &list_length, error)) return FALSE;
+    const guint8 *p = (const guint8 *)list;
+    const guint8 *end = p + list_length;
+    guint64 total, n_chunks, n;
+    gboolean ok = read_list_header(&p, end, &total, &n_chunks);
+    for (guint64 i = 0; ok && i < n_chunks; ++i) {
+        if (!g_hash_table_contains(live, p)) g_hash_table_add(live, g_memdup2(p, DIGEST_LENGTH));
+        p += DIGEST_LENGTH;
+        ok = p <= end && wire_get_varint(&p, end, &n);
+    }
+    if (!ok) g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: damaged chunk list", lpath);
+    g_free(list);
+    return ok;
+}
+
+/* Digest named by a chunk file, 64 hex digits */
+static gboolean parse_chunk_name(const char *name, guint8 digest[DIGEST_LENGTH]) {
+    if (strlen(name) != DIGEST_LENGTH * 2) return FALSE;
+    for (int i = 0; i < DIGEST_LENGTH; ++i) {
+        int hi = g_ascii_xdigit_value(name[i * 2]);
+        int lo = g_ascii_xdigit_value(name[i * 2 + 1]);
+        if (hi < 0 || lo < 0) return FALSE;
+        digest[i] = (guint8)(hi << 4 | lo);
+    }
+    return TRUE;
+}
+
+gboolean chunk_store_collect(const char *lists_dir, ChunkCollectStats *stats, GError **error) {
+    TRACE_SCOPE("chunks.collect");
+    ChunkCollectStats local = { 0 };
+    GHashTable *live = g_hash_table_new_full(digest_hash, digest_equal, g_free, NULL);
+    g_rw_lock_writer_lock(&collect_lock);
+
+    /* Mark. Any list that can't be read stops the collection before anything is removed */
+    GDir *lists = g_dir_open(lists_dir, 0, error);
+    gboolean ok = lists != NULL;
+    const gchar *name;
+    while (ok && (name = g_dir_read_name(lists)) != NULL) {
+        if (!g_str_has_suffix(name, CHUNK_LIST_SUFFIX)) continue;
+        gchar *lpath = g_build_filename(lists_dir, name, NULL);
+        ok = mark_list(lpath, live, error);
+        g_free(lpath);
+    }
+    if (lists) g_dir_close(lists);
+    local.live_chunks = ok ? g_hash_table_size(live) : 0;
+
+    /* Sweep every chunk file no list named; whatever else is in there is left alone */
+    gchar *root = g_build_filename("data", "chunks", NULL);
+    GDir *prefixes = ok ? g_dir_open(root, 0, NULL) : NULL;
+    const gchar *prefix;
+    while (prefixes && (prefix = g_dir_read_name(prefixes)) != NULL) {
+        gchar *dir = g_build_filename(root, prefix, NULL);
+        GDir *chunks = g_dir_open(dir, 0, NULL);
+        while (chunks && (name = g_dir_read_name(chunks)) != NULL) {
+            guint8 digest[DIGEST_LENGTH];
+            if (!parse_chunk_name(name, digest) || g_hash_table_contains(live, digest)) continue;
+            gchar *file = g_build_filename(dir, name, NULL);
+            GStatBuf st;
+            gint64 size = g_stat(file, &st) == 0 ? (gint64)st.st_size : 0;
+            if (g_remove(file) == 0) {
+                local.removed_chunks++;
+                local.freed_bytes += (guint64)size;
+            }
+            g_free(file);
+        }
+        if (chunks) g_dir_close(chunks);
+        g_rmdir(dir);   /* only succeeds once it is empty */
+        g_free(dir);
+    }
+    if (prefixes) g_dir_close(prefixes);
+    g_free(root);
+
+    g_rw_lock_writer_unlock(&collect_lock);
+    g_hash_table_unref(live);
+    TRACE_SCOPE_ARG("removed", local.removed_chunks);
+    if (stats) *stats = local;
+    return ok;
+}
@@ -0,0 +1,196 @@
+#include "cli.h"
+#include "batch_diff.h"
+#include "blame.h"
+#include "chunk_store.h"
+#include "diff_logic.h"
+#include "version_store.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef G_OS_WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#define UNIFIED_CONTEXT 3
+
+static void print_usage(FILE *out) {
+    fputs("Usage:\n"
+          "  myapp                      start the GyattHub window\n"
+          "  myapp --diff OLD NEW       print a unified diff of two files\n"
+          "  myapp --record PATH        record a version of PATH\n"
+          "  myapp --list PATH          list recorded versions of PATH\n"
+          "  myapp --show STORED        print a recorded version (a path from --list)\n"
+          "  myapp --restore STORED PATH\n"
+          "                             put PATH back to a recorded version, recording its current contents first\n"
+          "  myapp --annotate PATH      print the newest version of PATH with the version that added each line\n"
+          "  myapp --merge BASE LEFT RIGHT\n"
+          "                             three-way merge of LEFT and RIGHT from BASE, conflicts marked\n"
+          "  myapp --batch MANIFEST [THREADS]\n"
+          "                             diff every pair in MANIFEST ('-' for stdin), JSON lines out\n"
+          "  myapp --tracked-pairs      print a manifest of each tracked file's last two versions\n", out);
+}
+
+/* Versions are indexed by absolute path, as the file chooser reports them */
+static gchar *absolute_path(const char *path) {
+    return g_canonicalize_filename(path, NULL);
+}
+
+static int run_record(const char *arg) {
+    gchar *path = absolute_path(arg);
+    GError *error = NULL;
+    gchar *stored = version_store_record(path, &error);
+    if (!stored) {
+        fprintf(stderr, "record: %s: %s\n", path, error ? error->message : "unknown error");
+        g_clear_error(&error);
+        g_free(path);
+        return 1;
+    }
+    version_store_track_file(path);
+    gchar *stored_path = version_store_stored_path(stored);
+    printf("%s\n", stored_path);
+    g_free(stored_path);
+    g_free(stored);
+    g_free(path);
+    return 0;
+}
+
+static int run_list(const char *arg) {
+    gchar *path = absolute_path(arg);
+    GPtrArray *versions = version_store_list(path);
+    for (guint i = 0; i < versions->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(versions, i);
+        gchar *stored_path = version_store_stored_path(entry->stored);
+        printf("%s\t%s\n", entry->timestamp, stored_path);
+        g_free(stored_path);
+    }
+    g_ptr_array_free(versions, TRUE);
+    g_free(path);
+    return 0;
+}
+
+/* Stored versions and diffs go out byte for byte; in text mode the Windows CRT would turn \n into \r\n */
+static void binary_stdout(void) {
+#ifdef G_OS_WIN32
+    fflush(stdout);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+static gboolean write_stdout(const char *data, gsize length, gpointer user_data, GError **error) {
+    if (fwrite(data, 1, length, stdout) == length) return TRUE;
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "could not write to stdout");
+    return FALSE;
+}
+
+static int run_show(const char *stored_path) {
+    GError *error = NULL;
+    binary_stdout();
+    if (!chunk_store_stream(stored_path, write_stdout, NULL, &error)) {
+        fprintf(stderr, "show: %s\n", error ? error->message : "unknown error");
+        g_clear_error(&error);
+        return 1;
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static int run_restore(const char *stored_path, const char *arg) {
+    gchar *path = absolute_path(arg);
+    GError *error = NULL;
+    gboolean ok = version_store_restore(stored_path, path, &error);
+    if (!ok) {
+        fprintf(stderr, "restore: %s: %s\n", path, error ? error->message : "unknown error");
+        g_clear_error(&error);
+    }
+    g_free(path);
+    return ok ? 0 : 1;
+}
+
+static int run_annotate(const char *arg) {
+    gchar *path = absolute_path(arg);
+    GError *error = NULL;
+    BlameResult *blame = blame_annotate(path, &error);
+    if (!blame) {
+        fprintf(stderr, "annotate: %s: %s\n", path, error ? error->message : "unknown error");
+        g_clear_error(&error);
+        g_free(path);
+        return 1;
+    }
+    for (guint i = 0; i < blame->lines->n_lines; ++i) {
+        const VersionEntry *entry = g_ptr_array_index(blame->versions, g_array_index(blame->origins, guint, i));
+        gsize start = g_array_index(blame->lines->offsets, gsize, i);
+        gsize end = g_array_index(blame->lines->offsets, gsize, i + 1);
+        printf("%s %s\t", entry->timestamp, entry->stored);
+        fwrite(blame->text + start, 1, end - start, stdout);
+        if (end == start || blame->text[end - 1] != '\n') putchar('\n');
+    }
+    blame_result_free(blame);
+    g_free(path);
+    return 0;
+}
+
+static int run_merge(const char *base, const char *left, const char *right) {
+    GError *error = NULL;
+    Merge3Result *merge = perform_merge3(base, left, right, &error);
+    if (!merge) {
+        fprintf(stderr, "merge: %s\n", error ? error->message : "could not read input");
+        g_clear_error(&error);
+        return 2;
+    }
+    const char *labels[3] = { base, left, right };
+    gsize length = 0;
+    gchar *text = merge3_render(merge, labels, &length, NULL);
+    binary_stdout();
+    fwrite(text, 1, length, stdout);
+    int status = merge->n_conflicts > 0 ? 1 : 0;
+    if (status) fprintf(stderr, "merge: %u conflict%s\n", merge->n_conflicts, merge->n_conflicts == 1 ? "" : "s");
+    g_free(text);
+    merge3_result_free(merge);
+    return status;
+}
+
+gboolean cli_try_run(int argc, char **argv, int *status) {
+    if (argc < 2 || strncmp(argv[1], "--", 2) != 0) return FALSE;
+    const char *command = argv[1];
+
+    if (strcmp(command, "--diff") == 0 && argc == 4) {
+        /* Large buffer: hunks are written line by line */
+        static char buffer[1 << 16];
+        binary_stdout();
+        setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+        *status = write_unified_diff(stdout, argv[2], argv[3], UNIFIED_CONTEXT);
+        fflush(stdout);
+    } else if (strcmp(command, "--record") == 0 && argc == 3) {
+        *status = run_record(argv[2]);
+    } else if (strcmp(command, "--list") == 0 && argc == 3) {
+        *status = run_list(argv[2]);
+    } else if (strcmp(command, "--show") == 0 && argc == 3) {
+        *status = run_show(argv[2]);
+    } else if (strcmp(command, "--restore") == 0 && argc == 4) {
+        *status = run_restore(argv[2], argv[3]);
+    } else if (strcmp(command, "--annotate") == 0 && argc == 3) {
+        *status = run_annotate(argv[2]);
+    } else if (strcmp(command, "--merge") == 0 && argc == 5) {
+        *status = run_merge(argv[2], argv[3], argv[4]);
+    } else if (strcmp(command, "--batch") == 0 && (argc == 3 || argc == 4)) {
+        guint threads = argc == 4 ? (guint)g_ascii_strtoull(argv[3], NULL, 10) : 0;
+        *status = batch_diff_run(argv[2], threads, stdout);
+    } else if (strcmp(command, "--tracked-pairs") == 0 && argc == 2) {
+        batch_diff_write_tracked_manifest(stdout);
+        *status = 0;
+    } else if (strcmp(command, "--help") == 0) {
+        print_usage(stdout);
+        *status = 0;
+    } else if (strcmp(command, "--diff") == 0 || strcmp(command, "--record") == 0 ||
+               strcmp(command, "--list") == 0 || strcmp(command, "--show") == 0 ||
+               strcmp(command, "--restore") == 0 || strcmp(command, "--annotate") == 0 ||
+               strcmp(command, "--merge") == 0 || strcmp(command, "--batch") == 0 ||
+               strcmp(command, "--tracked-pairs") == 0) {
+        print_usage(stderr);
+        *status = 2;
+    } else {
+        /* Anything else (e.g. --gapplication-service) is for GApplication */
+        return FALSE;
+    }
+    return TRUE;
+}
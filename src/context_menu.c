@@ -1,6 +1,14 @@
 #include <gtk/gtk.h>
 #include "context_menu.h"
 #include "diff_view.h"
+#include "blame_view.h"
+#include "timeline_view.h"
+#include "nway_view.h"
+#include "sidebar.h"
+#include "tracked_file.h"
+#include "version_store.h"
+#include "chunk_store.h"
+#include "trace.h"
 #include <stdio.h> // For printf
 #include <gio/gio.h>
 #include <time.h>
@@ -29,26 +37,8 @@ static GList *selected_for_comparison = NULL;
 // --- CONTEXT 1: "sidebar-element" Actions
 // ---
 
-static void open(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
-    GtkWidget *widget = GTK_WIDGET(user_data);
-
-    const char *stored_path = g_object_get_data(G_OBJECT(widget), "file-path");
-    const char *path = stored_path ? stored_path : gtk_widget_get_name(widget);
-
-    if (path == NULL) {
-        g_printerr("Open: no path available for widget\n");
-        return;
-    }
-
-    g_print("Open: requested path='%s'\n", path);
-
-    // Ensure we have an absolute, canonical path
-    char *abs_path = g_canonicalize_filename(path, NULL);
-    if (abs_path == NULL) {
-        g_printerr("Open: failed to canonicalize path '%s'\n", path);
-        return;
-    }
-
+/* Hand a plain file to the system's default app for it; takes abs_path */
+static void launch_file(char *abs_path) {
     // Check the file exists
     if (!g_file_test(abs_path, G_FILE_TEST_EXISTS)) {
         g_printerr("Open: file does not exist: '%s'\n", abs_path);
@@ -143,6 +133,48 @@ static void open(GSimpleAction *action, GVariant *parameter, gpointer user_data)
     g_free(abs_path);
 }
 
+static void on_open_copy_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    char *abs_path = user_data;
+    GError *error = NULL;
+    gchar *copy_path = chunk_store_materialize_finish(res, &error);
+    if (copy_path) {
+        launch_file(copy_path);
+    } else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_printerr("Open: could not reconstruct '%s': %s\n", abs_path, error ? error->message : "unknown");
+    }
+    g_clear_error(&error);
+    g_free(abs_path);
+}
+
+static void open(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    GtkWidget *widget = GTK_WIDGET(user_data);
+
+    const char *stored_path = g_object_get_data(G_OBJECT(widget), "file-path");
+    const char *path = stored_path ? stored_path : gtk_widget_get_name(widget);
+
+    if (path == NULL) {
+        g_printerr("Open: no path available for widget\n");
+        return;
+    }
+
+    g_print("Open: requested path='%s'\n", path);
+
+    // Ensure we have an absolute, canonical path
+    char *abs_path = g_canonicalize_filename(path, NULL);
+    if (abs_path == NULL) {
+        g_printerr("Open: failed to canonicalize path '%s'\n", path);
+        return;
+    }
+
+    // A chunked version has no file of its own: the viewer gets a copy, reconstructed in the background
+    GCancellable *cancellable = g_cancellable_new();
+    GtkWidget *toplevel = gtk_widget_get_ancestor(widget, GTK_TYPE_WINDOW);
+    if (toplevel) g_signal_connect_object(toplevel, "destroy", G_CALLBACK(g_cancellable_cancel), cancellable,
+                                          G_CONNECT_SWAPPED);
+    chunk_store_materialize_async(abs_path, cancellable, on_open_copy_ready, abs_path);
+    g_object_unref(cancellable);
+}
+
 typedef struct {
     GtkWidget *dialog;
     GtkWidget *entry;
@@ -171,6 +203,10 @@ static void on_rename_response(GtkDialog *dialog, int response_id, gpointer user
                     g_printerr("Rename failed: %s\n", error ? error->message : "unknown");
                     g_clear_error(&error);
                 } else {
+                    /* Sidebar rows are recycled by the list view, so the model item is the source of truth */
+                    TrackedFile *item = g_object_get_data(G_OBJECT(rd->target_widget), "tracked-file");
+                    if (item) tracked_file_set_path(item, new_path);
+
                     /* Update stored path (g_object_set_data_full will handle freeing the previous value) */
                     g_object_set_data_full(G_OBJECT(rd->target_widget), "file-path", g_strdup(new_path), g_free);
 
@@ -266,7 +302,9 @@ static void _rename(GSimpleAction *action, GVariant *parameter, gpointer user_da
 /* Helper that performs the actual deletion of a sidebar row and index update */
 static void perform_delete_row(GtkWidget *row) {
     if (!row) return;
-    const char *path = g_object_get_data(G_OBJECT(row), "file-path");
+    /* Copy the path: removing the model item unbinds the row and frees its data */
+    gchar *path = g_strdup(g_object_get_data(G_OBJECT(row), "file-path"));
+    GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
     g_print("perform_delete_row: row=%p path=%s\n", row, path ? path : "(null)");
 
     /* Try to remove the file from disk first */
@@ -275,7 +313,6 @@ static void perform_delete_row(GtkWidget *row) {
             int err = errno;
             const char *errstr = strerror(err);
             /* Show an error dialog and abort deletion */
-            GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
             GtkWindow *parent_window = toplevel ? GTK_WINDOW(toplevel) : NULL;
             GtkWidget *dialog = gtk_window_new();
             gtk_window_set_title(GTK_WINDOW(dialog), "Delete Failed");
@@ -296,14 +333,21 @@ static void perform_delete_row(GtkWidget *row) {
             gtk_window_set_child(GTK_WINDOW(dialog), vbox);
             gtk_window_present(GTK_WINDOW(dialog));
             g_printerr("perform_delete_row: failed to remove file %s: %s\n", path, errstr ? errstr : "unknown");
+            g_free(path);
             return;
         }
         g_print("perform_delete_row: removed file from disk: %s\n", path);
     }
 
     /* Remove row from UI */
+    TrackedFile *item = g_object_get_data(G_OBJECT(row), "tracked-file");
+    GListStore *store = toplevel ? g_object_get_data(G_OBJECT(toplevel), "files-store") : NULL;
     GtkWidget *parent = gtk_widget_get_parent(row);
-    if (GTK_IS_LIST_BOX(parent)) {
+    guint position;
+    if (item && store && g_list_store_find(store, item, &position)) {
+        g_list_store_remove(store, position);
+        g_print("perform_delete_row: removed item from files model\n");
+    } else if (GTK_IS_LIST_BOX(parent)) {
         gtk_list_box_remove(GTK_LIST_BOX(parent), row);
         g_print("perform_delete_row: removed row from list box\n");
     } else {
@@ -312,38 +356,9 @@ static void perform_delete_row(GtkWidget *row) {
     }
 
     /* Remove from data/files_index.txt */
-    if (path) {
-        const char *data_dir = "data";
-        gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
-        if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-            GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
-            FILE *f = fopen(index_path, "r");
-            if (f) {
-                char buf[4096];
-                while (fgets(buf, sizeof(buf), f)) {
-                    char *nl = strchr(buf, '\n'); if (nl) *nl = '\0';
-                    if (g_strcmp0(buf, path) != 0) {
-                        g_ptr_array_add(lines, g_strdup(buf));
-                    }
-                }
-                fclose(f);
-            }
-            /* write back */
-            FILE *fw = fopen(index_path, "w");
-            if (fw) {
-                for (guint i = 0; i < lines->len; ++i) {
-                    fprintf(fw, "%s\n", (char *)g_ptr_array_index(lines, i));
-                }
-                fclose(fw);
-            }
-            g_ptr_array_free(lines, TRUE);
-            g_print("perform_delete_row: updated files_index.txt\n");
-        }
-        g_free(index_path);
-    }
+    if (path) version_store_untrack_file(path);
 
     /* Hide versions list if present on the same toplevel window */
-    GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
     if (toplevel) {
         GtkWidget *versions_list = g_object_get_data(G_OBJECT(toplevel), "versions-list");
         if (versions_list) {
@@ -353,6 +368,7 @@ static void perform_delete_row(GtkWidget *row) {
             g_print("perform_delete_row: cleared and hid versions list\n");
         }
     }
+    g_free(path);
 }
 
 typedef struct { GtkWidget *row; GtkWidget *dialog; } DeleteConfirmData;
@@ -439,119 +455,51 @@ static void record_version(GSimpleAction *action, GVariant *parameter, gpointer
     GtkWidget *widget = GTK_WIDGET(user_data);
     const char *path = g_object_get_data(G_OBJECT(widget), "file-path");
     if (!path) { g_printerr("record_version: no file path\n"); return; }
-
-    const char *data_dir = "data";
-    gchar *versions_dir = g_build_filename(data_dir, "versions", NULL);
-    g_mkdir_with_parents(versions_dir, 0755);
-
-    // build timestamped filename and preserve extension
-    time_t t = time(NULL);
-    struct tm tminfo;
-#if defined(_WIN32) || defined(__MINGW32__)
-    localtime_s(&tminfo, &t);
-#elif defined(__linux__) || defined(__unix__) || defined(__APPLE__)
-    localtime_r(&t, &tminfo);
-#else
-    {
-        struct tm *tmp = localtime(&t);
-        if (tmp) tminfo = *tmp; else memset(&tminfo, 0, sizeof(tminfo));
-    }
-#endif
-    char timestr[64]; strftime(timestr, sizeof(timestr), "%Y%m%d%H%M%S", &tminfo);
-
-    gchar *base = g_path_get_basename(path);
-    gchar *safe_base = g_strdup(base);
-    for (char *p = safe_base; *p; ++p) if (*p == '/' || *p == '\\') *p = '_';
-    /* extract extension manually to avoid missing glib API on some systems */
-    const char *ext = NULL;
-    char *dot = strrchr(base, '.');
-    if (dot && dot[1] != '\0') ext = dot + 1;
-    gchar *dest_name;
-    if (ext && *ext) dest_name = g_strdup_printf("%s_%s.%s", safe_base, timestr, ext);
-    else dest_name = g_strdup_printf("%s_%s", safe_base, timestr);
-    gchar *dest_path = g_build_filename(versions_dir, dest_name, NULL);
+    TRACE_SCOPE("ui.record_version");
 
     GError *error = NULL;
-    GFile *src = g_file_new_for_path(path);
-    GFile *dest = g_file_new_for_path(dest_path);
-    if (!g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &error)) {
+    gchar *stored = version_store_record(path, &error);
+    if (!stored) {
         g_printerr("record_version: copy failed: %s\n", error ? error->message : "unknown");
         g_clear_error(&error);
-    } else {
-#ifdef HAVE_JSON_GLIB
-        /* Update JSON index: data/versions_index.json */
-        gchar *index_path = g_build_filename(data_dir, "versions_index.json", NULL);
-        JsonParser *parser = json_parser_new();
-        JsonArray *arr = NULL;
-        if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-            if (json_parser_load_from_file(parser, index_path, &error)) {
-                JsonNode *root = json_parser_get_root(parser);
-                if (JSON_NODE_HOLDS_ARRAY(root)) arr = json_node_get_array(root);
-            } else {
-                g_clear_error(&error);
-            }
-        }
-        if (!arr) arr = json_array_new();
-
-        JsonObject *obj = json_object_new();
-        json_object_set_string_member(obj, "original", path);
-        json_object_set_string_member(obj, "stored", dest_name);
-        json_object_set_string_member(obj, "timestamp", timestr);
-
-        JsonNode *obj_node = json_node_new(JSON_NODE_OBJECT);
-        json_node_set_object(obj_node, obj);
-        json_array_add_element(arr, obj_node);
-
-        /* write back */
-        JsonGenerator *gen = json_generator_new();
-        JsonNode *root_node = json_node_new(JSON_NODE_ARRAY);
-        json_node_set_array(root_node, arr);
-        json_generator_set_root(gen, root_node);
-        if (!json_generator_to_file(gen, index_path, &error)) {
-            g_printerr("Failed to write versions index: %s\n", error ? error->message : "unknown");
-            g_clear_error(&error);
-        }
-
-        if (gen) g_object_unref(gen);
-        if (root_node) json_node_free(root_node);
-        if (parser) g_object_unref(parser);
-
-        g_free(index_path);
-#else
-        /* Fallback: append to text index versions_index.txt (original|stored|timestamp) */
-        gchar *index_path = g_build_filename(data_dir, "versions_index.txt", NULL);
-        FILE *fi = fopen(index_path, "a");
-        if (fi) {
-            fprintf(fi, "%s|%s|%s\n", path, dest_name, timestr);
-            fclose(fi);
-        }
-        g_free(index_path);
-#endif
+        return;
+    }
+    g_free(stored);
 
-        /* update UI: find versions-list on toplevel and repopulate */
-        GtkWidget *toplevel = gtk_widget_get_ancestor(widget, GTK_TYPE_WINDOW);
-        if (toplevel) {
-            GtkWidget *versions_list = g_object_get_data(G_OBJECT(toplevel), "versions-list");
-            if (versions_list) {
-                extern void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, const char *original_path);
-                populate_versions_for_path(GTK_WINDOW(toplevel), GTK_LIST_BOX(versions_list), path);
-            }
+    /* update UI: find versions-list on toplevel and repopulate */
+    GtkWidget *toplevel = gtk_widget_get_ancestor(widget, GTK_TYPE_WINDOW);
+    if (toplevel) {
+        GtkWidget *versions_list = g_object_get_data(G_OBJECT(toplevel), "versions-list");
+        if (versions_list) {
+            extern void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, const char *original_path);
+            populate_versions_for_path(GTK_WINDOW(toplevel), GTK_LIST_BOX(versions_list), path);
         }
+        /* Update the version count and changed badge in the sidebar */
+        sidebar_refresh_file(GTK_WINDOW(toplevel), path);
     }
+}
 
-    g_free(versions_dir);
-    g_free(safe_base);
-    g_free(dest_name);
-    g_free(dest_path);
-    if (base) g_free(base);
-    if (src) g_object_unref(src);
-    if (dest) g_object_unref(dest);
+/* Show which recorded version introduced each line of the file */
+static void annotate_file(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    GtkWidget *widget = GTK_WIDGET(user_data);
+    const char *path = g_object_get_data(G_OBJECT(widget), "file-path");
+    if (!path) { g_printerr("annotate_file: no file path\n"); return; }
+    create_blame_window(GTK_WINDOW(gtk_widget_get_ancestor(widget, GTK_TYPE_WINDOW)), path);
+}
+
+static void timeline_file(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    GtkWidget *widget = GTK_WIDGET(user_data);
+    const char *path = g_object_get_data(G_OBJECT(widget), "file-path");
+    if (!path) { g_printerr("timeline_file: no file path\n"); return; }
+    create_timeline_window(GTK_WINDOW(gtk_widget_get_ancestor(widget, GTK_TYPE_WINDOW)), path);
 }
 
 // An array of actions for the "sideabar-element" context
 static const GActionEntry sidebar_element_menu_actions[] = {
     {"open_file", open, NULL, NULL, NULL},
     {"record_version", record_version, NULL, NULL, NULL},
+    {"annotate_file", annotate_file, NULL, NULL, NULL},
+    {"timeline_file", timeline_file, NULL, NULL, NULL},
     {"delete_file", delete_file, NULL, NULL, NULL},
     {"rename_file",  _rename,  NULL, NULL, NULL}
 };
@@ -571,7 +519,7 @@ static void clear_comparison_selection() {
     selected_for_comparison = NULL;
 }
 
-static void compare_versions(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+static void compare_selected(DiffAlgorithm algorithm) {
     if (g_list_length(selected_for_comparison) != 2) {
         g_printerr("Compare action should not be available\n");
         return;
@@ -586,13 +534,73 @@ static void compare_versions(GSimpleAction *action, GVariant *parameter, gpointe
     if (path1 && path2) {
         g_print("Comparing '%s' and '%s'\n", path1, path2);
         GtkWindow *parent = GTK_WINDOW(gtk_widget_get_ancestor(widget1, GTK_TYPE_WINDOW));
-        create_diff_window(parent, path1, path2);
+        create_diff_window_full(parent, path1, path2, algorithm);
     } else {
         g_printerr("Could not get paths for comparison\n");
     }
     clear_comparison_selection();
 }
 
+static void compare_versions(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    compare_selected(DIFF_ALGO_WORDS);
+}
+
+/* Line-by-line, with moved blocks told apart from deletions and insertions */
+static void compare_versions_lines(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    compare_selected(DIFF_ALGO_LINES);
+}
+
+static gint compare_row_positions(gconstpointer a, gconstpointer b) {
+    return gtk_list_box_row_get_index(GTK_LIST_BOX_ROW(a)) - gtk_list_box_row_get_index(GTK_LIST_BOX_ROW(b));
+}
+
+/* Three selected versions: the earliest recorded is the base, the other two are merged in list order */
+static void merge_versions(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    if (g_list_length(selected_for_comparison) != 3) {
+        g_printerr("Merge action should not be available\n");
+        return;
+    }
+
+    GList *rows = g_list_sort(g_list_copy(selected_for_comparison), compare_row_positions);
+    const char *base = g_object_get_data(G_OBJECT(rows->data), "file-path");
+    const char *left = g_object_get_data(G_OBJECT(rows->next->data), "file-path");
+    const char *right = g_object_get_data(G_OBJECT(rows->next->next->data), "file-path");
+    if (base && left && right) {
+        GtkWindow *parent = GTK_WINDOW(gtk_widget_get_ancestor(GTK_WIDGET(rows->data), GTK_TYPE_WINDOW));
+        create_merge_window(parent, base, left, right);
+    } else {
+        g_printerr("Could not get paths for merging\n");
+    }
+    g_list_free(rows);
+    clear_comparison_selection();
+}
+
+/* All selected versions side by side, in list order, against the earliest recorded; the window can switch the base */
+static void compare_versions_nway(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    guint n = g_list_length(selected_for_comparison);
+    if (n < 2) {
+        g_printerr("Compare all action should not be available\n");
+        return;
+    }
+
+    GList *rows = g_list_sort(g_list_copy(selected_for_comparison), compare_row_positions);
+    const char **paths = g_new0(const char *, n);
+    guint n_paths = 0;
+    for (GList *l = rows; l != NULL; l = l->next) {
+        const char *path = g_object_get_data(G_OBJECT(l->data), "file-path");
+        if (path) paths[n_paths++] = path;
+    }
+    if (n_paths == n) {
+        GtkWindow *parent = GTK_WINDOW(gtk_widget_get_ancestor(GTK_WIDGET(rows->data), GTK_TYPE_WINDOW));
+        create_nway_window(parent, paths, n_paths, 0);
+    } else {
+        g_printerr("Could not get paths for comparison\n");
+    }
+    g_free(paths);
+    g_list_free(rows);
+    clear_comparison_selection();
+}
+
 static void select_for_comparison(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
     GtkWidget *widget = GTK_WIDGET(user_data);
 
@@ -607,8 +615,8 @@ static void select_for_comparison(GSimpleAction *action, GVariant *parameter, gp
         selected_for_comparison = g_list_prepend(selected_for_comparison, widget);
         g_object_ref(widget);
 
-        // If we now have more than 2 items, remove the oldest one
-        if (g_list_length(selected_for_comparison) > 2) {
+        // Up to NWAY_MAX_VERSIONS items (two to compare, three to merge, more side by side); past that, drop the oldest selection
+        if (g_list_length(selected_for_comparison) > NWAY_MAX_VERSIONS) {
             GList *last = g_list_last(selected_for_comparison);
             GtkWidget *last_widget = GTK_WIDGET(last->data);
             gtk_widget_remove_css_class(last_widget, "selected-for-compare");
@@ -638,10 +646,25 @@ static gboolean repopulate_versions_idle(gpointer user_data) {
     return G_SOURCE_REMOVE;
 }
 
+/* Reclaim the chunks deleted versions no longer share; walks every chunk list, so off the main thread */
+static void collect_chunks_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    ChunkCollectStats stats;
+    GError *error = NULL;
+    if (version_store_collect_chunks(&stats, &error)) {
+        g_print("delete_version: freed %u chunks (%" G_GUINT64_FORMAT " bytes)\n",
+                stats.removed_chunks, stats.freed_bytes);
+    } else {
+        g_printerr("delete_version: chunks not collected: %s\n", error ? error->message : "unknown error");
+        g_clear_error(&error);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
 static void delete_version(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
     GtkWidget *row = GTK_WIDGET(user_data);
     const char *vpath = g_object_get_data(G_OBJECT(row), "version-path");
     if (!vpath) return;
+    TRACE_SCOPE("ui.delete_version");
 
     // Store information we need before destroying anything
     GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
@@ -664,117 +687,13 @@ static void delete_version(GSimpleAction *action, GVariant *parameter, gpointer
         g_object_set_data(G_OBJECT(row), "popover", NULL);
     }
 
-    // Try to remove the file (use _wremove on Windows for better Unicode support)
-#if defined(_WIN32) || defined(__MINGW32__)
-    wchar_t *wpath = g_utf8_to_utf16(vpath_copy, -1, NULL, NULL, NULL);
-    int result = -1;
-    if (wpath) {
-        result = _wremove(wpath);
-        g_free(wpath);
-    }
-#else
-    int result = remove(vpath_copy);
-#endif
-
-    if (result == 0) {
+    // Remove the stored copy and its index entry
+    GError *error = NULL;
+    if (version_store_delete(vpath_copy, &error)) {
         g_print("delete_version: successfully removed %s\n", vpath_copy);
-
-        gchar *stored_basename = g_path_get_basename(vpath_copy);
-
-#ifdef HAVE_JSON_GLIB
-        /* Update JSON index: data/versions_index.json */
-        const char *data_dir = "data";
-        gchar *index_path = g_build_filename(data_dir, "versions_index.json", NULL);
-        JsonParser *parser = json_parser_new();
-        JsonArray *arr = NULL;
-        GError *error = NULL;
-
-        if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-            if (json_parser_load_from_file(parser, index_path, &error)) {
-                JsonNode *root = json_parser_get_root(parser);
-                if (JSON_NODE_HOLDS_ARRAY(root)) {
-                    arr = json_node_get_array(root);
-                    JsonArray *new_arr = json_array_new();
-
-                    for (guint i = 0; i < json_array_get_length(arr); i++) {
-                        JsonNode *elem = json_array_get_element(arr, i);
-                        if (JSON_NODE_HOLDS_OBJECT(elem)) {
-                            JsonObject *obj = json_node_get_object(elem);
-                            const char *stored = json_object_get_string_member(obj, "stored");
-                            if (g_strcmp0(stored, stored_basename) != 0) {
-                                json_array_add_element(new_arr, json_node_copy(elem));
-                            }
-                        }
-                    }
-
-                    // Write back the new array
-                    JsonGenerator *gen = json_generator_new();
-                    JsonNode *root_node = json_node_new(JSON_NODE_ARRAY);
-                    json_node_set_array(root_node, new_arr);
-                    json_generator_set_root(gen, root_node);
-                    json_generator_to_file(gen, index_path, NULL);
-                    g_object_unref(gen);
-                    json_node_free(root_node);
-                }
-            } else {
-                g_clear_error(&error);
-            }
-        }
-        if (parser) g_object_unref(parser);
-        g_free(index_path);
-#else
-        /* Fallback index: data/versions_index.txt */
-        const char *data_dir = "data";
-        gchar *index_path = g_build_filename(data_dir, "versions_index.txt", NULL);
-        if (stored_basename && g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-            GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
-            FILE *f = fopen(index_path, "r");
-            if (f) {
-                char buf[4096];
-                while (fgets(buf, sizeof(buf), f)) {
-                    char *trimmed = g_strdup(buf);
-                    if (!trimmed) continue;
-                    char *nl = strpbrk(trimmed, "\r\n");
-                    if (nl) *nl = '\0';
-
-                    gboolean keep = TRUE;
-                    char *sep1 = strchr(trimmed, '|');
-                    if (sep1) {
-                        char *sep2 = strchr(sep1 + 1, '|');
-                        if (sep2) {
-                            *sep2 = '\0';
-                            const char *stored = sep1 + 1;
-                            if (g_strcmp0(stored, stored_basename) == 0) {
-                                keep = FALSE;
-                            }
-                            *sep2 = '|';
-                        }
-                    }
-
-                    if (keep) {
-                        g_ptr_array_add(lines, trimmed);
-                    } else {
-                        g_free(trimmed);
-                    }
-                }
-                fclose(f);
-            }
-
-            FILE *fw = fopen(index_path, "w");
-            if (fw) {
-                for (guint i = 0; i < lines->len; ++i) {
-                    const char *line = g_ptr_array_index(lines, i);
-                    fprintf(fw, "%s\n", line);
-                }
-                fclose(fw);
-            }
-
-            g_ptr_array_free(lines, TRUE);
-        }
-        g_free(index_path);
-#endif
-
-        if (stored_basename) g_free(stored_basename);
+        GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+        g_task_run_in_thread(task, collect_chunks_thread);
+        g_object_unref(task);
 
         /* Schedule repopulation in an idle callback to avoid issues with widget destruction */
         if (toplevel && original_path && versions_list) {
@@ -783,21 +702,66 @@ static void delete_version(GSimpleAction *action, GVariant *parameter, gpointer
             data->versions_list = GTK_LIST_BOX(versions_list);
             data->original_path = g_strdup(original_path);
             g_idle_add(repopulate_versions_idle, data);
+            sidebar_refresh_file(GTK_WINDOW(toplevel), original_path);
         }
     } else {
-        int err = errno;
-        g_printerr("delete_version: failed to remove %s: %s (errno=%d)\n", 
-                   vpath_copy, strerror(err), err);
+        g_printerr("delete_version: %s\n", error ? error->message : "unknown error");
+        g_clear_error(&error);
     }
     
     g_free(vpath_copy);
 }
 
+/* Put the tracked file back to this version; its current contents are recorded first */
+static void restore_version(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    GtkWidget *row = GTK_WIDGET(user_data);
+    const char *vpath = g_object_get_data(G_OBJECT(row), "version-path");
+    GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
+    const char *original_path = toplevel ? g_object_get_data(G_OBJECT(toplevel), "original-path") : NULL;
+    if (!vpath || !original_path) { g_printerr("restore_version: no version or file path\n"); return; }
+    TRACE_SCOPE("ui.restore_version");
+
+    /* The row is rebuilt by the repopulation below */
+    gchar *original_copy = g_strdup(original_path);
+    GError *error = NULL;
+    if (version_store_restore(vpath, original_copy, &error)) {
+        g_print("restore_version: restored %s from %s\n", original_copy, vpath);
+        GtkWidget *versions_list = g_object_get_data(G_OBJECT(toplevel), "versions-list");
+        if (versions_list) {
+            RepopulateData *data = g_new0(RepopulateData, 1);
+            data->window = GTK_WINDOW(toplevel);
+            data->versions_list = GTK_LIST_BOX(versions_list);
+            data->original_path = g_strdup(original_copy);
+            g_idle_add(repopulate_versions_idle, data);
+        }
+        sidebar_refresh_file(GTK_WINDOW(toplevel), original_copy);
+    } else {
+        g_printerr("restore_version: %s\n", error ? error->message : "unknown error");
+        g_clear_error(&error);
+    }
+    g_free(original_copy);
+}
+
+/* Line diff of this version against the tracked file as it is now, kept up to date while the file is edited */
+static void compare_working_copy(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
+    GtkWidget *row = GTK_WIDGET(user_data);
+    const char *vpath = g_object_get_data(G_OBJECT(row), "version-path");
+    GtkWidget *toplevel = gtk_widget_get_ancestor(row, GTK_TYPE_WINDOW);
+    const char *original_path = toplevel ? g_object_get_data(G_OBJECT(toplevel), "original-path") : NULL;
+    if (!vpath || !original_path) { g_printerr("compare_working_copy: no version or file path\n"); return; }
+    create_diff_window_full(GTK_WINDOW(toplevel), vpath, original_path, DIFF_ALGO_LINES);
+}
+
 static const GActionEntry version_element_menu_actions[] = {
     {"open_version", open_version, NULL, NULL, NULL},
+    {"restore_version", restore_version, NULL, NULL, NULL},
+    {"compare_working_copy", compare_working_copy, NULL, NULL, NULL},
     {"delete_version", delete_version, NULL, NULL, NULL},
     {"select_for_comparison", select_for_comparison, NULL, NULL, NULL},
-    {"compare_versions", compare_versions, NULL, NULL, NULL}
+    {"compare_versions", compare_versions, NULL, NULL, NULL},
+    {"compare_versions_lines", compare_versions_lines, NULL, NULL, NULL},
+    {"merge_versions", merge_versions, NULL, NULL, NULL},
+    {"compare_versions_nway", compare_versions_nway, NULL, NULL, NULL}
 };
 
 // ---
@@ -845,6 +809,8 @@ void on_widget_right_click(GtkGestureClick *gesture,
         // Build the menu model
     g_menu_append(menu_model, "Open File", "win.open_file");
     g_menu_append(menu_model, "Record This Version", "win.record_version");
+    g_menu_append(menu_model, "Annotate", "win.annotate_file");
+    g_menu_append(menu_model, "Timeline", "win.timeline_file");
     g_menu_append(menu_model, "Rename File", "win.rename_file");
     g_menu_append(menu_model, "Delete File", "win.delete_file");
     clear_comparison_selection();
@@ -857,11 +823,24 @@ void on_widget_right_click(GtkGestureClick *gesture,
                                         G_N_ELEMENTS(version_element_menu_actions),
                                         widget);
         g_menu_append(menu_model, "Open Version", "win.open_version");
+        g_menu_append(menu_model, "Restore This Version", "win.restore_version");
+        g_menu_append(menu_model, "Compare with Working Copy", "win.compare_working_copy");
         g_menu_append(menu_model, "Select for Compare", "win.select_for_comparison");
         
         // The 'Compare' item is only enabled if exactly two items are selected
         if (g_list_length(selected_for_comparison) == 2) {
              g_menu_append(menu_model, "Compare", "win.compare_versions");
+             g_menu_append(menu_model, "Compare Lines", "win.compare_versions_lines");
+        }
+        // 'Merge' needs a base and two versions to combine
+        if (g_list_length(selected_for_comparison) == 3) {
+             g_menu_append(menu_model, "Merge (earliest as base)", "win.merge_versions");
+        }
+        // Three or more: every selected version against one base
+        if (g_list_length(selected_for_comparison) >= 3) {
+             gchar *label = g_strdup_printf("Compare All %u (earliest as base)", g_list_length(selected_for_comparison));
+             g_menu_append(menu_model, label, "win.compare_versions_nway");
+             g_free(label);
         }
        
         g_menu_append(menu_model, "Delete Version", "win.delete_version");
@@ -0,0 +1,357 @@
+#include "diff_cache.h"
+#include "perf_counters.h"
+#include "wire_format.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define DIFF_CACHE_MAGIC "GHDC"
+#define DIFF_CACHE_VERSION 2
+
+// ---
+// --- Results
+// ---
+
+DiffResult *diff_result_new(void) {
+    DiffResult *result = g_atomic_rc_box_new0(DiffResult);
+    result->spans = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+    result->hunks = g_array_new(FALSE, FALSE, sizeof(DiffHunk));
+    result->moves = g_array_new(FALSE, FALSE, sizeof(DiffMove));
+    return result;
+}
+
+DiffResult *diff_result_ref(DiffResult *result) {
+    return g_atomic_rc_box_acquire(result);
+}
+
+static void diff_result_clear(gpointer mem) {
+    DiffResult *result = (DiffResult *)mem;
+    g_array_unref(result->spans);
+    g_array_unref(result->hunks);
+    g_array_unref(result->moves);
+}
+
+void diff_result_unref(DiffResult *result) {
+    if (result) g_atomic_rc_box_release_full(result, diff_result_clear);
+}
+
+static gsize diff_result_bytes(const DiffResult *result) {
+    return sizeof(DiffResult) + result->spans->len * sizeof(DiffSpan) + result->hunks->len * sizeof(DiffHunk) +
+           result->moves->len * sizeof(DiffMove);
+}
+
+// ---
+// --- Keys
+// ---
+
+static void sha256(const char *data, gsize length, guint8 out[32]) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, (const guchar *)data, (gssize)length);
+    gsize digest_length = 32;
+    g_checksum_get_digest(checksum, out, &digest_length);
+    g_checksum_free(checksum);
+}
+
+void diff_cache_key_init(DiffCacheKey *key, const char *left, gsize left_length,
+                         const char *right, gsize right_length,
+                         DiffAlgorithm algorithm, guint32 options) {
+    memset(key, 0, sizeof(*key));
+    sha256(left, left_length, key->left);
+    sha256(right, right_length, key->right);
+    key->algorithm = (guint32)algorithm;
+    key->options = options;
+}
+
+static guint key_hash(gconstpointer p) {
+    /* The digests are already uniformly distributed */
+    const DiffCacheKey *key = p;
+    guint h;
+    memcpy(&h, key->left, sizeof(h));
+    return h ^ (key->right[0] | key->right[1] << 8 | key->right[2] << 16 | (guint)key->right[3] << 24)
+             ^ key->algorithm * 31 ^ key->options;
+}
+
+static gboolean key_equal(gconstpointer a, gconstpointer b) {
+    return memcmp(a, b, sizeof(DiffCacheKey)) == 0;
+}
+
+// ---
+// --- Memory tier
+// ---
+
+typedef struct {
+    DiffCacheKey key;
+    DiffResult *result;
+    gsize bytes;
+    GList link;         /* position in lru, most recent first */
+} CacheNode;
+
+static GMutex cache_lock;
+static GHashTable *cache_table;   /* DiffCacheKey* -> CacheNode* */
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_bytes;
+
+static void cache_node_free(gpointer p) {
+    CacheNode *node = p;
+    diff_result_unref(node->result);
+    g_free(node);
+}
+
+static void memory_insert_locked(const DiffCacheKey *key, DiffResult *result) {
+    if (!cache_table) cache_table = g_hash_table_new_full(key_hash, key_equal, NULL, cache_node_free);
+
+    CacheNode *node = g_hash_table_lookup(cache_table, key);
+    if (node) {
+        g_queue_unlink(&cache_lru, &node->link);
+        g_queue_push_head_link(&cache_lru, &node->link);
+        return;
+    }
+
+    gsize bytes = diff_result_bytes(result);
+    if (bytes > DIFF_CACHE_MEMORY_BUDGET) return;
+
+    node = g_new0(CacheNode, 1);
+    node->key = *key;
+    node->result = diff_result_ref(result);
+    node->bytes = bytes;
+    node->link.data = node;
+    g_queue_push_head_link(&cache_lru, &node->link);
+    g_hash_table_insert(cache_table, &node->key, node);
+    cache_bytes += bytes;
+
+    while (cache_bytes > DIFF_CACHE_MEMORY_BUDGET) {
+        GList *oldest = g_queue_pop_tail_link(&cache_lru);
+        CacheNode *victim = oldest->data;
+        cache_bytes -= victim->bytes;
+        g_hash_table_remove(cache_table, &victim->key);
+    }
+    perf_counter_set(PERF_DIFF_RESULT_BYTES, (gint64)cache_bytes);
+}
+
+static DiffResult *memory_lookup_locked(const DiffCacheKey *key) {
+    CacheNode *node = cache_table ? g_hash_table_lookup(cache_table, key) : NULL;
+    if (!node) return NULL;
+    g_queue_unlink(&cache_lru, &node->link);
+    g_queue_push_head_link(&cache_lru, &node->link);
+    return diff_result_ref(node->result);
+}
+
+// ---
+// --- Disk tier
+// ---
+//
+// Layout: magic, version (little-endian guint32), the key itself, then
+// varints (see wire_format.h): left_lines, right_lines, n_spans, n_hunks,
+// n_moves, spans as (gap since previous end, length), hunks as (left_start,
+// left length, right_start gap, right length), moves as (left_start,
+// right_start gap, length).
+
+static GMutex disk_lock;
+static gint64 disk_bytes = -1;    /* size of data/diff_cache, -1 until measured */
+
+typedef struct {
+    gchar *path;
+    gint64 mtime;
+    gint64 size;
+} DiskFile;
+
+static gint compare_mtime(gconstpointer a, gconstpointer b) {
+    const DiskFile *x = a, *y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+/* Measure the directory and, if it is over budget, delete the least recently used files */
+static void disk_prune_locked(void) {
+    gchar *dir_path = g_build_filename("data", "diff_cache", NULL);
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    GArray *files = g_array_new(FALSE, FALSE, sizeof(DiskFile));
+    gint64 total = 0;
+    const gchar *name;
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        DiskFile file = { g_build_filename(dir_path, name, NULL), 0, 0 };
+        GStatBuf st;
+        if (g_stat(file.path, &st) != 0) {
+            g_free(file.path);
+            continue;
+        }
+        file.mtime = (gint64)st.st_mtime;
+        file.size = (gint64)st.st_size;
+        total += file.size;
+        g_array_append_val(files, file);
+    }
+    if (dir) g_dir_close(dir);
+
+    if (total > DIFF_CACHE_DISK_BUDGET) {
+        g_array_sort(files, compare_mtime);
+        for (guint i = 0; i < files->len && total > DIFF_CACHE_DISK_BUDGET / 4 * 3; ++i) {
+            const DiskFile *file = &g_array_index(files, DiskFile, i);
+            if (g_remove(file->path) == 0) total -= file->size;
+        }
+    }
+    for (guint i = 0; i < files->len; ++i) g_free(g_array_index(files, DiskFile, i).path);
+    g_array_unref(files);
+    g_free(dir_path);
+    disk_bytes = total;
+}
+
+static gchar *disk_path(const DiffCacheKey *key) {
+    gchar *name = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *)key, sizeof(*key));
+    gchar *path = g_build_filename("data", "diff_cache", name, NULL);
+    g_free(name);
+    return path;
+}
+
+static void disk_store(const DiffCacheKey *key, const DiffResult *result) {
+    GByteArray *out = g_byte_array_sized_new(64 + result->spans->len * 3);
+    g_byte_array_append(out, (const guint8 *)DIFF_CACHE_MAGIC, 4);
+    wire_put_u32(out, DIFF_CACHE_VERSION);
+    g_byte_array_append(out, (const guint8 *)key, sizeof(*key));
+    wire_put_varint(out, result->left_lines);
+    wire_put_varint(out, result->right_lines);
+    wire_put_varint(out, result->spans->len);
+    wire_put_varint(out, result->hunks->len);
+    wire_put_varint(out, result->moves->len);
+
+    gsize prev_end = 0;
+    for (guint i = 0; i < result->spans->len; ++i) {
+        const DiffSpan *s = &g_array_index(result->spans, DiffSpan, i);
+        wire_put_varint(out, s->start - prev_end);
+        wire_put_varint(out, s->end - s->start);
+        prev_end = s->end;
+    }
+    guint prev_right = 0;
+    for (guint i = 0; i < result->hunks->len; ++i) {
+        const DiffHunk *h = &g_array_index(result->hunks, DiffHunk, i);
+        wire_put_varint(out, h->left_start);
+        wire_put_varint(out, h->left_end - h->left_start);
+        wire_put_varint(out, h->right_start - prev_right);
+        wire_put_varint(out, h->right_end - h->right_start);
+        prev_right = h->right_start;
+    }
+    prev_right = 0;
+    for (guint i = 0; i < result->moves->len; ++i) {
+        const DiffMove *m = &g_array_index(result->moves, DiffMove, i);
+        wire_put_varint(out, m->left_start);
+        wire_put_varint(out, m->right_start - prev_right);
+        wire_put_varint(out, m->length);
+        prev_right = m->right_start;
+    }
+
+    gchar *path = disk_path(key);
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    GError *error = NULL;
+    if (!g_file_set_contents(path, (const gchar *)out->data, (gssize)out->len, &error)) {
+        g_printerr("diff cache: could not write %s: %s\n", path, error ? error->message : "unknown");
+        g_clear_error(&error);
+    } else {
+        /* Rewriting an existing key counts twice; the next measurement puts that right */
+        g_mutex_lock(&disk_lock);
+        if (disk_bytes >= 0) disk_bytes += out->len;
+        if (disk_bytes < 0 || disk_bytes > DIFF_CACHE_DISK_BUDGET) disk_prune_locked();
+        g_mutex_unlock(&disk_lock);
+    }
+    g_free(dir);
+    g_free(path);
+    g_byte_array_unref(out);
+}
+
+static DiffResult *disk_lookup(const DiffCacheKey *key) {
+    gchar *path = disk_path(key);
+    gchar *contents = NULL;
+    gsize length = 0;
+    gboolean ok = g_file_get_contents(path, &contents, &length, NULL);
+    /* A hit counts as a use for pruning, which goes by modification time */
+    if (ok) g_utime(path, NULL);
+    g_free(path);
+    if (!ok) return NULL;
+
+    const guint8 *p = (const guint8 *)contents;
+    const guint8 *end = p + length;
+    DiffResult *result = NULL;
+    guint64 left_lines, right_lines, n_spans, n_hunks, n_moves;
+
+    /* The key is kept as is: on a host of the other byte order it just won't match, a miss */
+    gsize header = 4 + 4 + sizeof(*key);
+    if (length < header || memcmp(p, DIFF_CACHE_MAGIC, 4) != 0) goto out;
+    if (wire_get_u32(p + 4) != DIFF_CACHE_VERSION || memcmp(p + 8, key, sizeof(*key)) != 0) goto out;
+    p += header;
+
+    if (!wire_get_varint(&p, end, &left_lines) || !wire_get_varint(&p, end, &right_lines) ||
+        !wire_get_varint(&p, end, &n_spans) || !wire_get_varint(&p, end, &n_hunks) || !wire_get_varint(&p, end, &n_moves)) goto out;
+    /* Each record takes at least one byte per field; reject absurd counts before allocating */
+    if (n_spans > (guint64)(end - p) / 2 || n_hunks > (guint64)(end - p) / 4 || n_moves > (guint64)(end - p) / 3) goto out;
+
+    result = diff_result_new();
+    result->left_lines = (guint)left_lines;
+    result->right_lines = (guint)right_lines;
+    g_array_set_size(result->spans, (guint)n_spans);
+    g_array_set_size(result->hunks, (guint)n_hunks);
+    g_array_set_size(result->moves, (guint)n_moves);
+
+    guint64 prev_end = 0;
+    for (guint i = 0; i < n_spans; ++i) {
+        guint64 gap, len;
+        if (!wire_get_varint(&p, end, &gap) || !wire_get_varint(&p, end, &len)) goto fail;
+        DiffSpan *s = &g_array_index(result->spans, DiffSpan, i);
+        s->start = (gsize)(prev_end + gap);
+        s->end = (gsize)(s->start + len);
+        prev_end = s->end;
+    }
+    guint64 prev_right = 0;
+    for (guint i = 0; i < n_hunks; ++i) {
+        guint64 ls, ll, rg, rl;
+        if (!wire_get_varint(&p, end, &ls) || !wire_get_varint(&p, end, &ll) ||
+            !wire_get_varint(&p, end, &rg) || !wire_get_varint(&p, end, &rl)) goto fail;
+        DiffHunk *h = &g_array_index(result->hunks, DiffHunk, i);
+        h->left_start = (guint)ls;
+        h->left_end = (guint)(ls + ll);
+        h->right_start = (guint)(prev_right + rg);
+        h->right_end = (guint)(h->right_start + rl);
+        prev_right = h->right_start;
+    }
+    prev_right = 0;
+    for (guint i = 0; i < n_moves; ++i) {
+        guint64 ls, rg, len;
+        if (!wire_get_varint(&p, end, &ls) || !wire_get_varint(&p, end, &rg) || !wire_get_varint(&p, end, &len)) goto fail;
+        DiffMove *m = &g_array_index(result->moves, DiffMove, i);
+        m->left_start = (guint)ls;
+        m->right_start = (guint)(prev_right + rg);
+        m->length = (guint)len;
+        prev_right = m->right_start;
+    }
+    if (p != end) goto fail;
+    goto out;
+
+fail:
+    diff_result_unref(result);
+    result = NULL;
+out:
+    g_free(contents);
+    return result;
+}
+
+// ---
+// --- Public API
+// ---
+
+DiffResult *diff_cache_lookup(const DiffCacheKey *key) {
+    g_mutex_lock(&cache_lock);
+    DiffResult *result = memory_lookup_locked(key);
+    g_mutex_unlock(&cache_lock);
+    if (result) return result;
+
+    result = disk_lookup(key);
+    if (result) {
+        g_mutex_lock(&cache_lock);
+        memory_insert_locked(key, result);
+        g_mutex_unlock(&cache_lock);
+    }
+    return result;
+}
+
+void diff_cache_store(const DiffCacheKey *key, DiffResult *result) {
+    g_mutex_lock(&cache_lock);
+    memory_insert_locked(key, result);
+    g_mutex_unlock(&cache_lock);
+    disk_store(key, result);
+}
@@ -0,0 +1,26 @@
+#include "diff_highlight.h"
+
+void diff_highlight_append(GtkTextBuffer *buffer, GtkTextTag *tag, const char *text,
+                           gsize *cursor, const DiffSpan *spans, guint n_spans, gsize upto) {
+    GtkTextIter end;
+    gsize pos = *cursor;
+
+    /* Inserting at 'end' revalidates it, so one iterator walks the whole batch */
+    gtk_text_buffer_get_end_iter(buffer, &end);
+    for (guint i = 0; i < n_spans; ++i) {
+        const DiffSpan *span = &spans[i];
+        if (span->start < pos || span->end > upto || span->end < span->start) continue;
+        if (span->start > pos) {
+            gtk_text_buffer_insert(buffer, &end, text + pos, (int)(span->start - pos));
+        }
+        if (span->end > span->start) {
+            gtk_text_buffer_insert_with_tags(buffer, &end, text + span->start,
+                                             (int)(span->end - span->start), tag, NULL);
+        }
+        pos = span->end;
+    }
+    if (upto > pos) {
+        gtk_text_buffer_insert(buffer, &end, text + pos, (int)(upto - pos));
+    }
+    *cursor = upto;
+}
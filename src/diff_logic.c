@@ -1,20 +1,517 @@
 #include "diff_logic.h"
+#include "line_table.h"
+#include "binary_diff.h"
+#include "chunk_store.h"
+#include "trace.h"
 #include <glib.h>
+#include <string.h>
 
-GArray* perform_diff(const char* file1_path, const char* file2_path) {
-    gchar *contents1, *contents2;
+static void clear_diff_op(gpointer p) {
+    g_free(((DiffOp *)p)->text);
+}
+
+/* An op holding a NUL-terminated copy of data[start, start + length) */
+static DiffOp byte_op(DiffOpType type, const gchar *data, gsize start, gsize length) {
+    DiffOp op = { type, g_malloc(length + 1), length };
+    memcpy(op.text, data + start, length);
+    op.text[length] = '\0';
+    return op;
+}
+
+/* perform_diff() of binary contents: the block diff's runs, then what was dropped from the left */
+static GArray *binary_ops(const gchar *contents1, gsize length1, const gchar *contents2, gsize length2) {
+    GArray *runs = binary_diff((const guint8 *)contents1, length1, (const guint8 *)contents2, length2, 0);
+    GArray *unused = binary_diff_unused(runs, length1);
+    GArray *diffs = g_array_sized_new(FALSE, FALSE, sizeof(DiffOp), runs->len + unused->len);
+    g_array_set_clear_func(diffs, clear_diff_op);
+    for (guint i = 0; i < runs->len; ++i) {
+        const BinaryRun *run = &g_array_index(runs, BinaryRun, i);
+        DiffOp op = byte_op(run->type == BINARY_RUN_COPY ? DIFF_OP_EQUAL : DIFF_OP_INSERT, contents2,
+                            run->right_start, run->length);
+        g_array_append_val(diffs, op);
+    }
+    for (guint i = 0; i < unused->len; ++i) {
+        const ByteRange *range = &g_array_index(unused, ByteRange, i);
+        DiffOp op = byte_op(DIFF_OP_DELETE, contents1, range->start, range->length);
+        g_array_append_val(diffs, op);
+    }
+    g_array_unref(runs);
+    g_array_unref(unused);
+    return diffs;
+}
+
+GArray* perform_diff(const char* file1_path, const char* file2_path, DiffInputs* inputs) {
+    TRACE_SCOPE("diff.perform_diff");
+    gchar *contents1 = NULL, *contents2 = NULL;
     gsize length1, length2;
 
     // Read file contents
-    if (!g_file_get_contents(file1_path, &contents1, &length1, NULL) ||
-        !g_file_get_contents(file2_path, &contents2, &length2, NULL)) {
+    TRACE_BEGIN(read, "diff.read");
+    if (!chunk_store_read_file(file1_path, &contents1, &length1, NULL) ||
+        !chunk_store_read_file(file2_path, &contents2, &length2, NULL)) {
+        g_free(contents1);
+        TRACE_END(read);
         return NULL;
     }
+    TRACE_ARG(read, "bytes", length1 + length2);
+    TRACE_END(read);
+    gboolean binary = binary_diff_is_binary(contents1, length1) || binary_diff_is_binary(contents2, length2);
+    if (inputs) *inputs = (DiffInputs){ length1, length2, binary };
+
+    // Lines mean nothing in binary files (and Myers would crawl through them): match blocks instead
+    if (binary) {
+        GArray *diffs = binary_ops(contents1, length1, contents2, length2);
+        g_free(contents1);
+        g_free(contents2);
+        return diffs;
+    }
 
-    GArray* diffs = myers_diff(contents1, contents2);
+    // Diff line hashes, then turn each run of lines into one DiffOp
+    TRACE_BEGIN(lines, "diff.line_tables");
+    LineTable *left = line_table_new(contents1, length1);
+    LineTable *right = line_table_new(contents2, length2);
+    TRACE_END(lines);
+    TRACE_BEGIN(myers, "diff.myers");
+    GArray *edits = myers_diff_sequence(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                        &g_array_index(right->hashes, guint64, 0), right->n_lines);
+    TRACE_ARG(myers, "runs", edits->len);
+    TRACE_END(myers);
+    TRACE_BEGIN(moves, "diff.moves");
+    GArray *script = diff_edits_find_moves(edits, &g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                           &g_array_index(right->hashes, guint64, 0), right->n_lines);
+    g_array_unref(edits);
+    edits = script;
+    TRACE_END(moves);
 
+    GArray* diffs = g_array_sized_new(FALSE, FALSE, sizeof(DiffOp), edits->len);
+    g_array_set_clear_func(diffs, clear_diff_op);
+    guint left_pos = 0;
+    for (guint i = 0; i < edits->len; ++i) {
+        const DiffEdit *e = &g_array_index(edits, DiffEdit, i);
+        /* A moved block's lines come from the left where it was taken out, from the right where it was put */
+        gboolean from_right = e->type == DIFF_OP_INSERT || (e->type == DIFF_OP_MOVE && !diff_edit_moved_out(e, left_pos));
+        if (!from_right) left_pos += e->length;
+        const LineTable *table = from_right ? right : left;
+        const gchar *text = from_right ? contents2 : contents1;
+        guint first = from_right ? e->right_start : e->left_start;
+        gsize start = g_array_index(table->offsets, gsize, first);
+        gsize end = g_array_index(table->offsets, gsize, first + e->length);
+        DiffOp op = byte_op(e->type, text, start, end - start);
+        g_array_append_val(diffs, op);
+    }
+
+    g_array_unref(edits);
+    line_table_free(left);
+    line_table_free(right);
     g_free(contents1);
     g_free(contents2);
 
     return diffs;
 }
+
+void diff_ops_count(const GArray* diffs, DiffStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (guint i = 0; i < diffs->len; ++i) {
+        const DiffOp *op = &g_array_index(diffs, DiffOp, i);
+        if (op->type == DIFF_OP_EQUAL) continue;
+        /* Every line ends in '\n' except possibly the file's last one */
+        gsize length = op->length;
+        guint lines = 0;
+        for (const char *p = op->text; (p = memchr(p, '\n', length - (p - op->text))); ++p) lines++;
+        if (length && op->text[length - 1] != '\n') lines++;
+        if (op->type == DIFF_OP_MOVE) {
+            /* Each moved block shows up twice, with the same number of lines */
+            stats->moved += lines;
+            continue;
+        }
+        if (op->type == DIFF_OP_INSERT) stats->inserted += lines;
+        else stats->deleted += lines;
+        /* A delete directly followed by an insert is one change */
+        if (!(op->type == DIFF_OP_INSERT && i > 0 && g_array_index(diffs, DiffOp, i - 1).type == DIFF_OP_DELETE)) {
+            stats->changes++;
+        }
+    }
+    stats->moved /= 2;
+}
+
+gboolean perform_diff_stats(const char* file1_path, const char* file2_path, guint max_d, DiffStats* stats) {
+    TRACE_SCOPE("diff.stats");
+    gchar *contents1 = NULL, *contents2 = NULL;
+    gsize length1, length2;
+    memset(stats, 0, sizeof(*stats));
+    if (!chunk_store_read_file(file1_path, &contents1, &length1, NULL) ||
+        !chunk_store_read_file(file2_path, &contents2, &length2, NULL)) {
+        g_free(contents1);
+        return FALSE;
+    }
+    if (binary_diff_is_binary(contents1, length1) || binary_diff_is_binary(contents2, length2)) {
+        stats->binary = TRUE;
+        g_free(contents1);
+        g_free(contents2);
+        return TRUE;
+    }
+
+    LineTable *left = line_table_new(contents1, length1);
+    LineTable *right = line_table_new(contents2, length2);
+    /* Only the hashes are needed from here on */
+    g_free(contents1);
+    g_free(contents2);
+    stats->approximate = !myers_diff_stats(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                           &g_array_index(right->hashes, guint64, 0), right->n_lines,
+                                           max_d, &stats->inserted, &stats->deleted);
+    line_table_free(left);
+    line_table_free(right);
+    return TRUE;
+}
+
+// ---
+// --- Unified output
+// ---
+
+static void write_line(FILE *out, char prefix, const char *text, const LineTable *table, guint line) {
+    gsize start = g_array_index(table->offsets, gsize, line);
+    gsize end = g_array_index(table->offsets, gsize, line + 1);
+    fputc(prefix, out);
+    fwrite(text + start, 1, end - start, out);
+    if (end == start || text[end - 1] != '\n') fputs("\n\\ No newline at end of file\n", out);
+}
+
+/* "start,count" as diff(1) prints it: 1-based, and the line before an empty range */
+static void write_range(FILE *out, guint start, guint count) {
+    if (count == 1) fprintf(out, "%u", start + 1);
+    else fprintf(out, "%u,%u", count ? start + 1 : start, count);
+}
+
+static guint run_left_length(const DiffEdit *e) { return e->type == DIFF_OP_INSERT ? 0 : e->length; }
+static guint run_right_length(const DiffEdit *e) { return e->type == DIFF_OP_DELETE ? 0 : e->length; }
+
+int write_unified_diff(FILE* out, const char* file1_path, const char* file2_path, guint context) {
+    TRACE_SCOPE("diff.unified");
+    gchar *text1 = NULL, *text2 = NULL;
+    gsize length1 = 0, length2 = 0;
+    GError *error = NULL;
+    if (!chunk_store_read_file(file1_path, &text1, &length1, &error) ||
+        !chunk_store_read_file(file2_path, &text2, &length2, &error)) {
+        fprintf(stderr, "%s\n", error ? error->message : "could not read input");
+        g_clear_error(&error);
+        g_free(text1);
+        return 2;
+    }
+    /* Same as diff(1): no hunks for binary files, just whether they differ */
+    if (binary_diff_is_binary(text1, length1) || binary_diff_is_binary(text2, length2)) {
+        gboolean same = length1 == length2 && memcmp(text1, text2, length1) == 0;
+        if (!same) fprintf(out, "Binary files %s and %s differ\n", file1_path, file2_path);
+        g_free(text1);
+        g_free(text2);
+        return same ? 0 : 1;
+    }
+
+    LineTable *left = line_table_new(text1, length1);
+    LineTable *right = line_table_new(text2, length2);
+    GArray *edits = myers_diff_sequence(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                        &g_array_index(right->hashes, guint64, 0), right->n_lines);
+    const DiffEdit *runs = (const DiffEdit *)edits->data;
+    gboolean differ = FALSE;
+
+    guint i = 0;
+    while (i < edits->len) {
+        if (runs[i].type == DIFF_OP_EQUAL) { i++; continue; }
+
+        /* A hunk runs from change i through every later change separated by at most 2 * context equal lines */
+        guint first = i, last = i;
+        for (guint j = i + 1; j < edits->len; ++j) {
+            if (runs[j].type != DIFF_OP_EQUAL) { last = j; continue; }
+            if (j + 1 >= edits->len || runs[j].length > 2 * context) break;
+        }
+        guint lead = first > 0 ? MIN(context, runs[first - 1].length) : 0;
+        guint trail = last + 1 < edits->len ? MIN(context, runs[last + 1].length) : 0;
+
+        guint left_start = runs[first].left_start - lead;
+        guint right_start = runs[first].right_start - lead;
+        guint left_count = lead + trail, right_count = lead + trail;
+        for (guint j = first; j <= last; ++j) {
+            left_count += run_left_length(&runs[j]);
+            right_count += run_right_length(&runs[j]);
+        }
+
+        if (!differ) {
+            fprintf(out, "--- %s\n+++ %s\n", file1_path, file2_path);
+            differ = TRUE;
+        }
+        fputs("@@ -", out);
+        write_range(out, left_start, left_count);
+        fputs(" +", out);
+        write_range(out, right_start, right_count);
+        fputs(" @@\n", out);
+
+        for (guint l = left_start; l < runs[first].left_start; ++l) write_line(out, ' ', text1, left, l);
+        for (guint j = first; j <= last; ++j) {
+            const DiffEdit *e = &runs[j];
+            for (guint k = 0; k < e->length; ++k) {
+                if (e->type == DIFF_OP_EQUAL) write_line(out, ' ', text1, left, e->left_start + k);
+                else if (e->type == DIFF_OP_DELETE) write_line(out, '-', text1, left, e->left_start + k);
+                else write_line(out, '+', text2, right, e->right_start + k);
+            }
+        }
+        if (trail) {
+            guint from = runs[last + 1].left_start;
+            for (guint l = from; l < from + trail; ++l) write_line(out, ' ', text1, left, l);
+        }
+        i = last + 1;
+    }
+
+    g_array_unref(edits);
+    line_table_free(left);
+    line_table_free(right);
+    g_free(text1);
+    g_free(text2);
+    return differ ? 1 : 0;
+}
+
+// ---
+// --- Three-way merge
+// ---
+
+/* One side's change against the base: base lines [base_start, base_end) became side lines [side_start, side_end) */
+typedef struct {
+    guint base_start, base_end;
+    guint side_start, side_end;
+} MergeHunk;
+
+typedef struct {
+    const LineTable *base;
+    const char *path;
+    gchar *text;
+    gsize length;
+    LineTable *lines;
+    GArray *hunks;      /* MergeHunk */
+    GError *error;
+} MergeSide;
+
+/* Binary files have no lines, and Myers would crawl through them */
+static gboolean check_mergeable(const char *path, const char *text, gsize length, GError **error) {
+    if (!binary_diff_is_binary(text, length)) return TRUE;
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is a binary file and can't be merged by lines", path);
+    return FALSE;
+}
+
+/* Adjacent delete and insert runs are one hunk */
+static GArray *edits_to_hunks(const GArray *edits) {
+    GArray *hunks = g_array_new(FALSE, FALSE, sizeof(MergeHunk));
+    MergeHunk hunk = {0};
+    gboolean open = FALSE;
+    for (guint i = 0; i < edits->len; ++i) {
+        const DiffEdit *e = &g_array_index(edits, DiffEdit, i);
+        if (e->type == DIFF_OP_EQUAL) {
+            if (open) g_array_append_val(hunks, hunk);
+            open = FALSE;
+            continue;
+        }
+        if (!open) {
+            hunk.base_start = hunk.base_end = e->left_start;
+            hunk.side_start = hunk.side_end = e->right_start;
+            open = TRUE;
+        }
+        if (e->type == DIFF_OP_DELETE) hunk.base_end += e->length;
+        else hunk.side_end += e->length;
+    }
+    if (open) g_array_append_val(hunks, hunk);
+    return hunks;
+}
+
+/* Read one side and diff it against the base; runs for both sides at once */
+static gpointer diff_merge_side(gpointer data) {
+    MergeSide *side = data;
+    TRACE_SCOPE("merge3.side");
+    if (!chunk_store_read_file(side->path, &side->text, &side->length, &side->error)) return NULL;
+    if (!check_mergeable(side->path, side->text, side->length, &side->error)) return NULL;
+    side->lines = line_table_new(side->text, side->length);
+    GArray *edits = myers_diff_sequence(&g_array_index(side->base->hashes, guint64, 0), side->base->n_lines,
+                                        &g_array_index(side->lines->hashes, guint64, 0), side->lines->n_lines);
+    side->hunks = edits_to_hunks(edits);
+    TRACE_SCOPE_ARG("hunks", side->hunks->len);
+    g_array_unref(edits);
+    return NULL;
+}
+
+static gboolean same_side_lines(const Merge3Result *result, const MergeRegion *region) {
+    const LineTable *left = result->lines[MERGE_LEFT];
+    const LineTable *right = result->lines[MERGE_RIGHT];
+    gsize left_start = g_array_index(left->offsets, gsize, region->left_start);
+    gsize left_end = g_array_index(left->offsets, gsize, region->left_start + region->left_length);
+    gsize right_start = g_array_index(right->offsets, gsize, region->right_start);
+    gsize right_end = g_array_index(right->offsets, gsize, region->right_start + region->right_length);
+    return left_end - left_start == right_end - right_start &&
+           memcmp(result->texts[MERGE_LEFT] + left_start, result->texts[MERGE_RIGHT] + right_start,
+                  left_end - left_start) == 0;
+}
+
+static void append_region(Merge3Result *result, MergeRegionType type, guint base_start, guint base_end,
+                          gint64 left_start, gint64 left_end, gint64 right_start, gint64 right_end) {
+    MergeRegion region = {
+        type,
+        base_start, base_end - base_start,
+        (guint)left_start, (guint)(left_end - left_start),
+        (guint)right_start, (guint)(right_end - right_start),
+    };
+    if (type == MERGE_REGION_CONFLICT && same_side_lines(result, &region)) region.type = MERGE_REGION_BOTH;
+    if (region.type == MERGE_REGION_CONFLICT) result->n_conflicts++;
+    g_array_append_val(result->regions, region);
+}
+
+/*
+ * Walk both sides' hunks in base order. Hunks of the two sides that overlap
+ * or touch (directly or through a chain of others) form one region; outside
+ * the hunks each side's lines are the base's, shifted by the size changes of
+ * that side's hunks so far.
+ */
+static void merge_hunks(Merge3Result *result, const GArray *left, const GArray *right) {
+    guint i = 0, j = 0, pos = 0;
+    gint64 left_delta = 0, right_delta = 0;
+    while (i < left->len || j < right->len) {
+        const MergeHunk *next_left = i < left->len ? &g_array_index(left, MergeHunk, i) : NULL;
+        const MergeHunk *next_right = j < right->len ? &g_array_index(right, MergeHunk, j) : NULL;
+        guint lo = next_left && (!next_right || next_left->base_start <= next_right->base_start)
+            ? next_left->base_start : next_right->base_start;
+        guint hi = lo;
+        gint64 left_after = left_delta, right_after = right_delta;
+        gboolean has_left = FALSE, has_right = FALSE;
+        for (;;) {
+            if (i < left->len && g_array_index(left, MergeHunk, i).base_start <= hi) {
+                const MergeHunk *h = &g_array_index(left, MergeHunk, i++);
+                hi = MAX(hi, h->base_end);
+                left_after = (gint64)h->side_end - h->base_end;
+                has_left = TRUE;
+            } else if (j < right->len && g_array_index(right, MergeHunk, j).base_start <= hi) {
+                const MergeHunk *h = &g_array_index(right, MergeHunk, j++);
+                hi = MAX(hi, h->base_end);
+                right_after = (gint64)h->side_end - h->base_end;
+                has_right = TRUE;
+            } else {
+                break;
+            }
+        }
+
+        if (lo > pos) {
+            append_region(result, MERGE_REGION_STABLE, pos, lo, pos + left_delta, lo + left_delta,
+                          pos + right_delta, lo + right_delta);
+        }
+        MergeRegionType type = has_left && has_right ? MERGE_REGION_CONFLICT
+                             : has_left ? MERGE_REGION_LEFT : MERGE_REGION_RIGHT;
+        append_region(result, type, lo, hi, lo + left_delta, hi + left_after, lo + right_delta, hi + right_after);
+        left_delta = left_after;
+        right_delta = right_after;
+        pos = hi;
+    }
+    guint base_lines = result->lines[MERGE_BASE]->n_lines;
+    if (pos < base_lines) {
+        append_region(result, MERGE_REGION_STABLE, pos, base_lines, pos + left_delta, base_lines + left_delta,
+                      pos + right_delta, base_lines + right_delta);
+    }
+}
+
+Merge3Result* perform_merge3(const char* base_path, const char* left_path, const char* right_path, GError** error) {
+    TRACE_SCOPE("diff.merge3");
+    Merge3Result *result = g_new0(Merge3Result, 1);
+    result->regions = g_array_new(FALSE, FALSE, sizeof(MergeRegion));
+    if (!chunk_store_read_file(base_path, &result->texts[MERGE_BASE], &result->lengths[MERGE_BASE], error) ||
+        !check_mergeable(base_path, result->texts[MERGE_BASE], result->lengths[MERGE_BASE], error)) {
+        merge3_result_free(result);
+        return NULL;
+    }
+    result->lines[MERGE_BASE] = line_table_new(result->texts[MERGE_BASE], result->lengths[MERGE_BASE]);
+
+    /* The left side is read and diffed on a helper thread while this one does the right */
+    MergeSide sides[2] = {
+        { result->lines[MERGE_BASE], left_path, NULL, 0, NULL, NULL, NULL },
+        { result->lines[MERGE_BASE], right_path, NULL, 0, NULL, NULL, NULL },
+    };
+    GThread *helper = g_thread_new("merge3", diff_merge_side, &sides[0]);
+    diff_merge_side(&sides[1]);
+    g_thread_join(helper);
+
+    for (int s = 0; s < 2; ++s) {
+        result->texts[MERGE_LEFT + s] = sides[s].text;
+        result->lengths[MERGE_LEFT + s] = sides[s].length;
+        result->lines[MERGE_LEFT + s] = sides[s].lines;
+    }
+    gboolean ok = !sides[0].error && !sides[1].error;
+    if (ok) merge_hunks(result, sides[0].hunks, sides[1].hunks);
+    else g_propagate_error(error, sides[0].error ? g_steal_pointer(&sides[0].error) : g_steal_pointer(&sides[1].error));
+    for (int s = 0; s < 2; ++s) {
+        if (sides[s].hunks) g_array_unref(sides[s].hunks);
+        g_clear_error(&sides[s].error);
+    }
+    if (!ok) {
+        merge3_result_free(result);
+        return NULL;
+    }
+    TRACE_SCOPE_ARG("conflicts", result->n_conflicts);
+    return result;
+}
+
+void merge3_result_free(Merge3Result* result) {
+    if (!result) return;
+    g_array_unref(result->regions);
+    for (int s = 0; s < 3; ++s) {
+        g_free(result->texts[s]);
+        if (result->lines[s]) line_table_free(result->lines[s]);
+    }
+    g_free(result);
+}
+
+/* Lines [start, start + count) of one input; a last line without '\n' gets one if anything follows it */
+static void append_merge_lines(GString *out, const Merge3Result *result, int which, guint start, guint count,
+                               guint *out_lines) {
+    if (count == 0) return;
+    if (out->len && out->str[out->len - 1] != '\n') g_string_append_c(out, '\n');
+    const LineTable *table = result->lines[which];
+    gsize from = g_array_index(table->offsets, gsize, start);
+    gsize to = g_array_index(table->offsets, gsize, start + count);
+    g_string_append_len(out, result->texts[which] + from, (gssize)(to - from));
+    *out_lines += count;
+}
+
+static void append_marker(GString *out, const char *marker, const char *label, guint *out_lines) {
+    if (out->len && out->str[out->len - 1] != '\n') g_string_append_c(out, '\n');
+    if (label && *label) g_string_append_printf(out, "%s %s\n", marker, label);
+    else g_string_append_printf(out, "%s\n", marker);
+    (*out_lines)++;
+}
+
+gchar* merge3_render(const Merge3Result* result, const char* const labels[3], gsize* length, GArray* conflict_lines) {
+    gsize estimate = MAX(result->lengths[MERGE_LEFT], result->lengths[MERGE_RIGHT]) + 64;
+    GString *out = g_string_sized_new(estimate);
+    guint out_lines = 0;
+    for (guint r = 0; r < result->regions->len; ++r) {
+        const MergeRegion *region = &g_array_index(result->regions, MergeRegion, r);
+        switch (region->type) {
+        case MERGE_REGION_STABLE:
+        case MERGE_REGION_LEFT:
+        case MERGE_REGION_BOTH:
+            append_merge_lines(out, result, MERGE_LEFT, region->left_start, region->left_length, &out_lines);
+            break;
+        case MERGE_REGION_RIGHT:
+            append_merge_lines(out, result, MERGE_RIGHT, region->right_start, region->right_length, &out_lines);
+            break;
+        case MERGE_REGION_CONFLICT: {
+            guint first = out_lines;
+            append_marker(out, "<<<<<<<", labels[MERGE_LEFT], &out_lines);
+            append_merge_lines(out, result, MERGE_LEFT, region->left_start, region->left_length, &out_lines);
+            append_marker(out, "|||||||", labels[MERGE_BASE], &out_lines);
+            append_merge_lines(out, result, MERGE_BASE, region->base_start, region->base_length, &out_lines);
+            append_marker(out, "=======", NULL, &out_lines);
+            append_merge_lines(out, result, MERGE_RIGHT, region->right_start, region->right_length, &out_lines);
+            append_marker(out, ">>>>>>>", labels[MERGE_RIGHT], &out_lines);
+            if (conflict_lines) {
+                guint count = out_lines - first;
+                g_array_append_val(conflict_lines, first);
+                g_array_append_val(conflict_lines, count);
+            }
+            break;
+        }
+        }
+    }
+    if (length) *length = out->len;
+    return g_string_free(out, FALSE);
+}
@@ -1,15 +1,1275 @@
 #include "diff_view.h"
 #include "diff_logic.h"
+#include "diff_highlight.h"
+#include "large_file_view.h"
+#include "hunk_index.h"
+#include "incremental_diff.h"
+#include "diff_cache.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "arena.h"
+#include "line_table.h"
+#include "myers_diff.h"
+#include "binary_diff.h"
+#include "chunk_store.h"
 #include <gtk/gtk.h>
 #include <string.h>
 
+/* Files above this size are shown with LargeFileView instead of GtkTextView */
+#define LARGE_FILE_THRESHOLD (32 * 1024 * 1024)
+
+/* Post a batch to the UI after this many spans or this much time, whichever comes first */
+#define DIFF_BATCH_SPANS 512
+#define DIFF_BATCH_INTERVAL_US (50 * 1000)
+
+/* Line mode rediffs the right file this long after it last changed on disk */
+#define REFRESH_DELAY_MS 150
+
+/* Resolution of the change overview strip */
+#define MINIMAP_BUCKETS 512
+#define MINIMAP_WIDTH 14
+
+/*
+ * State shared between the compare window and its GTask worker.
+ * It is reference counted because either side may go away first: the worker
+ * keeps a reference until it returns, every queued message holds one, and the
+ * window drops its reference on destroy (after cancelling the worker).
+ */
+typedef struct {
+    gchar *file1_path;
+    gchar *file2_path;
+    DiffAlgorithm algorithm;
+    GCancellable *cancellable;
+    /* Widgets, only touched on the main thread and only while not cancelled */
+    GtkWidget *window;
+    GtkTextBuffer *buffer1;
+    GtkTextBuffer *buffer2;
+    GtkWidget *view1;
+    GtkWidget *view2;
+    GtkWidget *minimap;
+    GtkWidget *progress_box;
+    GtkWidget *progress_bar;
+    GtkTextTag *insert_tag;
+    GtkTextTag *delete_tag;   /* line mode only, in buffer1 */
+    GtkTextTag *move_tags[2]; /* line mode only, one per buffer */
+    GtkWidget *options_box;   /* line mode only, insensitive while a comparison runs */
+    gchar *text2;      /* latest file, appended to buffer2 as spans arrive */
+    gsize appended;    /* bytes of text2 already in buffer2 */
+    HunkIndex *hunks;  /* set once the comparison finished */
+    /* Line mode keeps what it read, so toggling a flag only diffs again; the running worker owns these */
+    guint line_flags;  /* LineCompareFlags */
+    gchar *contents1;
+    gchar *contents2;
+    gsize length1;
+    gsize length2;
+    LineTable *lines1;
+    LineTable *lines2;
+    GArray *edits;     /* DiffEdit over the plain line hashes, the base for the next incremental refresh */
+    DiffCacheKey key;  /* options left at 0; each run fills in line_flags */
+    gboolean cacheable;
+    /* Line mode watches the right file (the working copy when comparing against one); main thread only */
+    GFileMonitor *monitor;
+    guint refresh_source;
+    gboolean running;          /* a worker owns the texts until its DIFF_MSG_DONE is applied */
+    gboolean refresh_pending;  /* the file changed while a worker was running */
+} DiffSession;
+
+static void diff_session_clear(gpointer mem) {
+    DiffSession *session = (DiffSession *)mem;
+    g_free(session->file1_path);
+    g_free(session->file2_path);
+    g_free(session->text2);
+    hunk_index_free(session->hunks);
+    g_free(session->contents1);
+    g_free(session->contents2);
+    line_table_free(session->lines1);
+    line_table_free(session->lines2);
+    if (session->edits) g_array_unref(session->edits);
+    g_object_unref(session->cancellable);
+}
+
+static DiffSession *diff_session_ref(DiffSession *session) {
+    return g_atomic_rc_box_acquire(session);
+}
+
+static void diff_session_unref(DiffSession *session) {
+    g_atomic_rc_box_release_full(session, diff_session_clear);
+}
+
+// ---
+// --- Messages from the worker, applied in order on the main thread
+// ---
+
+typedef enum {
+    DIFF_MSG_TEXTS, /* files were read: fill buffer1 (unless text1 is NULL), keep text2 for appending */
+    DIFF_MSG_SPANS, /* append text2 up to 'upto', tagging the hunks in it */
+    DIFF_MSG_DONE   /* comparison finished, hunk index (and moved blocks) attached */
+} DiffMessageKind;
+
+typedef struct {
+    DiffSession *session;
+    DiffMessageKind kind;
+    gchar *text1;
+    gchar *text2;
+    GArray *spans; /* DiffSpan */
+    gsize upto;
+    double fraction;
+    HunkIndex *hunks;
+    GArray *moves; /* DiffMove */
+} DiffMessage;
+
+static void diff_message_free(gpointer user_data) {
+    DiffMessage *msg = (DiffMessage *)user_data;
+    g_free(msg->text1);
+    g_free(msg->text2);
+    if (msg->spans) g_array_unref(msg->spans);
+    hunk_index_free(msg->hunks);
+    if (msg->moves) g_array_unref(msg->moves);
+    diff_session_unref(msg->session);
+    g_free(msg);
+}
+
+static void tag_lines(GtkTextBuffer *buffer, GtkTextTag *tag, guint first, guint count) {
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, (int)first);
+    gtk_text_buffer_get_iter_at_line(buffer, &end, (int)(first + count));
+    gtk_text_buffer_apply_tag(buffer, tag, &start, &end);
+}
+
+/* Line mode: strike out deleted lines on the left, then mark both ends of every moved block */
+static void mark_line_changes(DiffSession *session, const GArray *moves) {
+    for (guint i = 0; i < session->hunks->hunks->len; ++i) {
+        const DiffHunk *hunk = &g_array_index(session->hunks->hunks, DiffHunk, i);
+        if (hunk->left_end > hunk->left_start)
+            tag_lines(session->buffer1, session->delete_tag, hunk->left_start, hunk->left_end - hunk->left_start);
+    }
+    for (guint i = 0; moves && i < moves->len; ++i) {
+        const DiffMove *move = &g_array_index(moves, DiffMove, i);
+        tag_lines(session->buffer1, session->move_tags[0], move->left_start, move->length);
+        tag_lines(session->buffer2, session->move_tags[1], move->right_start, move->length);
+    }
+}
+
+static void start_refresh(DiffSession *session);
+
+static gboolean apply_diff_message(gpointer user_data) {
+    DiffMessage *msg = (DiffMessage *)user_data;
+    DiffSession *session = msg->session;
+
+    /* The window was closed: nothing left to update */
+    if (g_cancellable_is_cancelled(session->cancellable)) return G_SOURCE_REMOVE;
+    TRACE_SCOPE("view.apply_message");
+    TRACE_SCOPE_ARG("kind", msg->kind);
+
+    switch (msg->kind) {
+    case DIFF_MSG_TEXTS:
+        // The previous file goes in whole; the latest file is built up tag by tag
+        if (msg->text1) gtk_text_buffer_set_text(session->buffer1, msg->text1, -1);
+        g_free(session->text2);
+        session->text2 = msg->text2;
+        msg->text2 = NULL;
+        session->appended = 0;
+        break;
+    case DIFF_MSG_SPANS:
+        /* Appending in order keeps tagging linear; no offset lookups from the buffer start */
+        diff_highlight_append(session->buffer2, session->insert_tag, session->text2, &session->appended,
+                              msg->spans ? (DiffSpan *)msg->spans->data : NULL,
+                              msg->spans ? msg->spans->len : 0, msg->upto);
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(session->progress_bar), msg->fraction);
+        break;
+    case DIFF_MSG_DONE:
+        session->hunks = msg->hunks;
+        msg->hunks = NULL;
+        if (session->algorithm == DIFF_ALGO_LINES) {
+            mark_line_changes(session, msg->moves);
+            gtk_widget_set_sensitive(session->options_box, TRUE);
+        }
+        gtk_widget_set_visible(session->progress_box, FALSE);
+        gtk_widget_queue_draw(session->minimap);
+        session->running = FALSE;
+        if (session->refresh_pending) {
+            session->refresh_pending = FALSE;
+            start_refresh(session);
+        }
+        break;
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* Queue a message for the main thread. Messages share one priority so they
+ * are dispatched in the order they were posted. */
+static void post_diff_message(DiffSession *session, DiffMessageKind kind, gchar *text1, gchar *text2,
+                              GArray *spans, gsize upto, double fraction) {
+    DiffMessage *msg = g_new0(DiffMessage, 1);
+    msg->session = diff_session_ref(session);
+    msg->kind = kind;
+    msg->text1 = text1;
+    msg->text2 = text2;
+    msg->spans = spans;
+    msg->upto = upto;
+    msg->fraction = fraction;
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, apply_diff_message, msg, diff_message_free);
+}
+
+/* The final message; hands the finished hunk index (and, in line mode, the moved blocks) over to the window */
+static void post_diff_message_hunks(DiffSession *session, HunkIndex *hunks, GArray *moves) {
+    DiffMessage *msg = g_new0(DiffMessage, 1);
+    msg->session = diff_session_ref(session);
+    msg->kind = DIFF_MSG_DONE;
+    msg->hunks = hunks;
+    msg->moves = moves;
+    msg->fraction = 1.0;
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, apply_diff_message, msg, diff_message_free);
+}
+
+// ---
+// --- Worker thread
+// ---
+
+/* A word of the previous file: a slice of its text, never copied */
+typedef struct {
+    const gchar *start;
+    guint length;
+    guint line;
+} Word;
+
+/* Words are kept in fixed-size arena blocks, so the list never reallocates or copies */
+#define WORD_BLOCK 4096
+
+typedef struct {
+    Arena *arena;
+    GPtrArray *blocks;  /* Word[WORD_BLOCK] each */
+    guint len;
+} WordList;
+
+static void word_list_append(WordList *list, const gchar *start, guint length, guint line) {
+    if (list->len % WORD_BLOCK == 0) g_ptr_array_add(list->blocks, arena_alloc(list->arena, WORD_BLOCK * sizeof(Word)));
+    Word *word = (Word *)g_ptr_array_index(list->blocks, list->len / WORD_BLOCK) + list->len % WORD_BLOCK;
+    word->start = start;
+    word->length = length;
+    word->line = line;
+    list->len++;
+}
+
+static const Word *word_list_get(const WordList *list, guint i) {
+    return (const Word *)g_ptr_array_index(list->blocks, i / WORD_BLOCK) + i % WORD_BLOCK;
+}
+
+/* Line index in the whole text of key i, given line_table_keys()' kept lines */
+static inline guint kept_line(const guint *kept, guint i) {
+    return kept ? kept[i] : i;
+}
+
+/* A moved block as runs that are contiguous in both texts, blank lines left out of the comparison split it */
+static void append_move(GArray *moves, const guint *kept1, const guint *kept2, const DiffEdit *e) {
+    DiffMove move = { 0, 0, 0 };
+    for (guint k = 0; k < e->length; ++k) {
+        guint l = kept_line(kept1, e->left_start + k);
+        guint r = kept_line(kept2, e->right_start + k);
+        if (move.length > 0 && l == move.left_start + move.length && r == move.right_start + move.length) {
+            move.length++;
+            continue;
+        }
+        if (move.length > 0) g_array_append_val(moves, move);
+        move = (DiffMove){ l, r, 1 };
+    }
+    if (move.length > 0) g_array_append_val(moves, move);
+}
+
+/*
+ * Line mode: a line diff with moved blocks (see diff_edits_find_moves) of the
+ * texts and line tables kept in the session, compared under its line flags.
+ * 'edits', if not NULL, is the plain line diff already worked out (by a
+ * refresh) and is taken over; it is only given when no flags are set.
+ * Inserted lines are tagged as they are appended to the right; deleted and
+ * moved lines are tagged once everything is in. Hunks are the change groups
+ * between unchanged runs, moved blocks included; a change spans the ignored
+ * blank lines inside it.
+ */
+static void compare_lines(GTask *task, DiffSession *session, const DiffCacheKey *key, GArray *edits,
+                          GCancellable *cancellable) {
+    TRACE_SCOPE("view.compare_lines");
+    TRACE_SCOPE_ARG("flags", session->line_flags);
+    if (!session->lines1) session->lines1 = line_table_new(session->contents1, session->length1);
+    if (!session->lines2) session->lines2 = line_table_new(session->contents2, session->length2);
+    LineTable *left = session->lines1;
+    LineTable *right = session->lines2;
+    guint n, m;
+    const guint *kept1, *kept2;
+    const guint64 *a = line_table_keys(left, session->contents1, session->line_flags, &n, &kept1);
+    const guint64 *b = line_table_keys(right, session->contents2, session->line_flags, &m, &kept2);
+    if (!edits) edits = myers_diff_sequence(a, n, b, m);
+    /* Keys without flags are the plain hashes, so this script can be updated incrementally */
+    if (session->line_flags == 0) {
+        if (session->edits) g_array_unref(session->edits);
+        session->edits = g_array_ref(edits);
+    }
+    GArray *script = diff_edits_find_moves(edits, a, n, b, m);
+    g_array_unref(edits);
+
+    /* buffer2 holds text2 only up to its first NUL, like the word mode */
+    gsize text2_length = strlen(session->contents2);
+    DiffResult *result = diff_result_new();
+    GArray *batch = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+    DiffHunk hunk = {0};
+    gboolean in_hunk = FALSE;
+    guint left_pos = 0, right_pos = 0; /* in keys */
+    for (guint i = 0; i < script->len; ++i) {
+        const DiffEdit *e = &g_array_index(script, DiffEdit, i);
+        if (e->type == DIFF_OP_EQUAL) {
+            if (in_hunk) g_array_append_val(result->hunks, hunk);
+            in_hunk = FALSE;
+            left_pos += e->length;
+            right_pos += e->length;
+            continue;
+        }
+        if (!in_hunk) {
+            guint l = kept_line(kept1, left_pos), r = kept_line(kept2, right_pos);
+            hunk = (DiffHunk){ l, l, r, r };
+            in_hunk = TRUE;
+        }
+        if (e->type == DIFF_OP_DELETE || (e->type == DIFF_OP_MOVE && diff_edit_moved_out(e, left_pos))) {
+            left_pos += e->length;
+            hunk.left_end = kept_line(kept1, left_pos - 1) + 1;
+            continue;
+        }
+        if (e->type == DIFF_OP_INSERT) {
+            gsize start = g_array_index(right->offsets, gsize, kept_line(kept2, right_pos));
+            gsize end = g_array_index(right->offsets, gsize, kept_line(kept2, right_pos + e->length - 1) + 1);
+            if (start < text2_length) {
+                DiffSpan span = { start, MIN(end, text2_length) };
+                g_array_append_val(batch, span);
+            }
+        } else {
+            append_move(result->moves, kept1, kept2, e);
+        }
+        right_pos += e->length;
+        hunk.right_end = kept_line(kept2, right_pos - 1) + 1;
+
+        if (batch->len >= DIFF_BATCH_SPANS) {
+            gsize upto = g_array_index(batch, DiffSpan, batch->len - 1).end;
+            g_array_append_vals(result->spans, batch->data, batch->len);
+            post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, batch, upto,
+                              session->length2 ? (double)upto / (double)session->length2 : 1.0);
+            batch = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+        }
+    }
+    if (in_hunk) g_array_append_val(result->hunks, hunk);
+    TRACE_SCOPE_ARG("moves", result->moves->len);
+    result->left_lines = MAX(left->n_lines, 1);
+    result->right_lines = MAX(right->n_lines, 1);
+    g_array_unref(script);
+
+    if (g_task_return_error_if_cancelled(task)) {
+        g_array_unref(batch);
+        diff_result_unref(result);
+        return;
+    }
+    g_array_append_vals(result->spans, batch->data, batch->len);
+    if (key) {
+        TRACE_SCOPE("view.cache_store");
+        diff_cache_store(key, result);
+    }
+    post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, batch, text2_length, 1.0);
+    post_diff_message_hunks(session, hunk_index_new(g_array_copy(result->hunks), result->left_lines,
+                                                    result->right_lines, MINIMAP_BUCKETS),
+                            g_array_copy(result->moves));
+    diff_result_unref(result);
+    g_task_return_boolean(task, TRUE);
+}
+
+/*
+ * After a cache hit the result is already shown, but a live refresh needs the
+ * line tables and the plain line diff to update incrementally. Worked out
+ * here, after the result is posted, so a reopened comparison's first refresh
+ * is not a full run. Only the plain diff can be updated, so not under flags.
+ */
+static void seed_line_edits(DiffSession *session, GCancellable *cancellable) {
+    if (session->line_flags != 0 || session->edits || g_cancellable_is_cancelled(cancellable)) return;
+    TRACE_SCOPE("view.seed_edits");
+    if (!session->lines1) session->lines1 = line_table_new(session->contents1, session->length1);
+    if (!session->lines2) session->lines2 = line_table_new(session->contents2, session->length2);
+    session->edits = myers_diff_sequence((const guint64 *)session->lines1->hashes->data, session->lines1->n_lines,
+                                         (const guint64 *)session->lines2->hashes->data, session->lines2->n_lines);
+}
+
+/* Line mode once the texts are in the session: the first run, and each run after a flag is toggled */
+static void line_compare_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    DiffSession *session = (DiffSession *)task_data;
+    gint64 started = g_get_monotonic_time();
+    DiffCacheKey key = session->key;
+    key.options = session->line_flags;
+
+    TRACE_BEGIN(lookup, "view.cache_lookup");
+    DiffResult *cached = session->cacheable ? diff_cache_lookup(&key) : NULL;
+    TRACE_ARG(lookup, "hit", cached != NULL);
+    TRACE_END(lookup);
+    if (cached) {
+        post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, g_array_copy(cached->spans),
+                          strlen(session->contents2), 1.0);
+        post_diff_message_hunks(session, hunk_index_new(g_array_copy(cached->hunks), cached->left_lines,
+                                                        cached->right_lines, MINIMAP_BUCKETS),
+                                g_array_copy(cached->moves));
+        diff_result_unref(cached);
+        seed_line_edits(session, cancellable);
+        g_task_return_boolean(task, TRUE);
+    } else {
+        compare_lines(task, session, session->cacheable ? &key : NULL, NULL, cancellable);
+    }
+    perf_counter_set(PERF_LAST_DIFF_US, g_get_monotonic_time() - started);
+}
+
+/* Lengths of the common prefix and suffix of two texts; together they never exceed either length */
+static void common_ends(const gchar *a, gsize length_a, const gchar *b, gsize length_b, gsize *prefix,
+                        gsize *suffix) {
+    gsize limit = MIN(length_a, length_b);
+    gsize p = 0;
+    while (p < limit && a[p] == b[p]) p++;
+    gsize q = 0;
+    while (q < limit - p && a[length_a - 1 - q] == b[length_b - 1 - q]) q++;
+    *prefix = p;
+    *suffix = q;
+}
+
+/*
+ * Line mode after the right file changed on disk: read it again, splice the
+ * changed bytes into its line table and, with no flags set, update the
+ * previous line diff with incremental_diff(), so only the edited window is
+ * diffed again. Under flags, or before there is a line table, it is a full
+ * run on the new text.
+ */
+static void refresh_lines_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    DiffSession *session = (DiffSession *)task_data;
+    TRACE_SCOPE("view.refresh_lines");
+    gint64 started = g_get_monotonic_time();
+    gchar *contents = NULL;
+    gsize length = 0;
+    if (!chunk_store_read_file(session->file2_path, &contents, &length, NULL)) {
+        /* Most likely caught between an editor's write and rename; its next event brings the new text */
+        line_compare_thread(task, source_object, task_data, cancellable);
+        return;
+    }
+
+    GArray *edits = NULL;
+    if (session->lines2) {
+        gsize prefix, suffix;
+        common_ends(session->contents2, session->length2, contents, length, &prefix, &suffix);
+        LineEdit edit;
+        line_table_splice(session->lines2, contents, length, prefix, session->length2 - prefix - suffix,
+                          length - prefix - suffix, &edit);
+        TRACE_SCOPE_ARG("edited_lines", edit.new_lines);
+        if (session->edits && session->line_flags == 0)
+            edits = incremental_diff(session->edits, session->lines1, session->lines2, DIFF_SIDE_RIGHT, &edit, 1);
+    }
+    g_clear_pointer(&session->edits, g_array_unref);
+    g_free(session->contents2);
+    session->contents2 = contents;
+    session->length2 = length;
+    diff_cache_key_init(&session->key, session->contents1, session->length1, contents, length, DIFF_ALGO_LINES, 0);
+    perf_counter_set(PERF_LAST_DIFF_RIGHT_BYTES, (gint64)length);
+    post_diff_message(session, DIFF_MSG_TEXTS, NULL, g_strdup(contents), NULL, 0, 0.0);
+
+    DiffCacheKey key = session->key;
+    key.options = session->line_flags;
+    compare_lines(task, session, session->cacheable ? &key : NULL, edits, cancellable);
+    perf_counter_set(PERF_LAST_DIFF_US, g_get_monotonic_time() - started);
+}
+
+static void compute_diff_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    DiffSession *session = (DiffSession *)task_data;
+    TRACE_SCOPE("view.compute_diff");
+    gint64 started = g_get_monotonic_time();
+
+    // Read file contents
+    gchar *contents1 = NULL, *contents2 = NULL;
+    gsize length1 = 0, length2 = 0;
+    gboolean cacheable = TRUE;
+    TRACE_BEGIN(read, "view.read");
+
+    if (!chunk_store_read_file(session->file1_path, &contents1, &length1, NULL)) {
+        g_printerr("Failed to read file: %s\n", session->file1_path);
+        contents1 = g_strdup("[Error reading file]");
+        length1 = strlen(contents1);
+        cacheable = FALSE;
+    }
+
+    if (!chunk_store_read_file(session->file2_path, &contents2, &length2, NULL)) {
+        g_printerr("Failed to read file: %s\n", session->file2_path);
+        contents2 = g_strdup("[Error reading file]");
+        length2 = strlen(contents2);
+        cacheable = FALSE;
+    }
+
+    TRACE_ARG(read, "bytes", length1 + length2);
+    TRACE_END(read);
+    perf_counter_set(PERF_LAST_DIFF_LEFT_BYTES, (gint64)length1);
+    perf_counter_set(PERF_LAST_DIFF_RIGHT_BYTES, (gint64)length2);
+
+    /* The buffers get their own copies; we keep ours for tokenizing */
+    post_diff_message(session, DIFF_MSG_TEXTS, g_strdup(contents1), g_strdup(contents2), NULL, 0, 0.0);
+
+    if (session->algorithm == DIFF_ALGO_LINES) {
+        session->contents1 = contents1;
+        session->contents2 = contents2;
+        session->length1 = length1;
+        session->length2 = length2;
+        session->cacheable = cacheable;
+        diff_cache_key_init(&session->key, contents1, length1, contents2, length2, DIFF_ALGO_LINES, 0);
+        line_compare_thread(task, source_object, task_data, cancellable);
+        return;
+    }
+
+    // Same bytes on both sides as an earlier comparison: replay its result
+    TRACE_BEGIN(lookup, "view.cache_lookup");
+    DiffCacheKey key;
+    diff_cache_key_init(&key, contents1, length1, contents2, length2, DIFF_ALGO_WORDS, 0);
+    DiffResult *cached = cacheable ? diff_cache_lookup(&key) : NULL;
+    TRACE_ARG(lookup, "hit", cached != NULL);
+    TRACE_END(lookup);
+    if (cached) {
+        post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, g_array_copy(cached->spans), strlen(contents2), 1.0);
+        post_diff_message_hunks(session, hunk_index_new(g_array_copy(cached->hunks), cached->left_lines,
+                                                        cached->right_lines, MINIMAP_BUCKETS), NULL);
+        diff_result_unref(cached);
+        g_free(contents1);
+        g_free(contents2);
+        perf_counter_set(PERF_LAST_DIFF_US, g_get_monotonic_time() - started);
+        g_task_return_boolean(task, TRUE);
+        return;
+    }
+    DiffResult *result = diff_result_new();
+
+    // Highlight words in the latest file that differ at the same word positions
+    const gchar *p1 = contents1;
+    const gchar *p2 = contents2;
+
+    // Tokenize previous file into words array (words are non-whitespace runs).
+    // Everything the tokenizer allocates lives in one arena, freed with the session's texts.
+    TRACE_BEGIN(tokenize, "view.tokenize");
+    Arena *arena = arena_new(0);
+    WordList words1 = { arena, g_ptr_array_new(), 0 };
+    guint left_line = 0;
+    const gchar *q = p1;
+    while (*q) {
+        gunichar c = g_utf8_get_char(q);
+        if (g_unichar_isspace(c)) {
+            if (c == '\n') left_line++;
+            q = g_utf8_next_char(q);
+            continue;
+        }
+        const gchar *start = q;
+        while (*q) {
+            gunichar n = g_utf8_get_char(q);
+            if (g_unichar_isspace(n)) break;
+            q = g_utf8_next_char(q);
+        }
+        word_list_append(&words1, start, (guint)(q - start), left_line);
+    }
+    guint left_lines = left_line + 1;
+    TRACE_ARG(tokenize, "words", words1.len);
+    TRACE_END(tokenize);
+    TRACE_BEGIN(compare, "view.compare");
+
+    // Walk through latest file, recording byte ranges of words that differ
+    // and grouping runs of changed words into line-range hunks
+    GArray *batch = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+    GArray *hunks = g_array_new(FALSE, FALSE, sizeof(DiffHunk));
+    DiffHunk hunk = {0};
+    gboolean in_hunk = FALSE;
+    guint right_line = 0;
+    gint64 last_post = g_get_monotonic_time();
+    gint word_index = 0;
+    const gchar *r = p2;
+    while (*r) {
+        gunichar c = g_utf8_get_char(r);
+        if (g_unichar_isspace(c)) {
+            if (c == '\n') right_line++;
+            r = g_utf8_next_char(r);
+            continue;
+        }
+
+        // extract next word in latest file
+        const gchar *start = r;
+        while (*r) {
+            gunichar n = g_utf8_get_char(r);
+            if (g_unichar_isspace(n)) break;
+            r = g_utf8_next_char(r);
+        }
+        guint length = (guint)(r - start);
+
+        gboolean highlight = TRUE;
+        if (word_index < (gint)words1.len) {
+            const Word *w1 = word_list_get(&words1, (guint)word_index);
+            if (w1->length == length && memcmp(w1->start, start, length) == 0) highlight = FALSE;
+        }
+
+        if (highlight) {
+            DiffSpan span = { (gsize)(start - p2), (gsize)(r - p2) };
+            g_array_append_val(batch, span);
+
+            /* Words past the end of the previous file map to an empty range at its end */
+            gboolean has_left = word_index < (gint)words1.len;
+            guint l = has_left ? word_list_get(&words1, (guint)word_index)->line : left_lines;
+            if (!in_hunk) {
+                hunk.left_start = l;
+                hunk.left_end = l;
+                hunk.right_start = right_line;
+                in_hunk = TRUE;
+            }
+            hunk.left_end = MAX(hunk.left_end, has_left ? l + 1 : l);
+            hunk.right_end = right_line + 1;
+        } else if (in_hunk) {
+            g_array_append_val(hunks, hunk);
+            in_hunk = FALSE;
+        }
+
+        if ((word_index & 1023) == 0 && g_cancellable_is_cancelled(cancellable)) break;
+
+        /* An unchanged word closes the current hunk, so the batch can go out whole.
+         * A single enormous hunk is still split so progress keeps moving. */
+        if (!highlight || batch->len >= DIFF_BATCH_SPANS * 8) {
+            gint64 now = g_get_monotonic_time();
+            if (batch->len >= DIFF_BATCH_SPANS || now - last_post >= DIFF_BATCH_INTERVAL_US) {
+                double fraction = length2 ? (double)(r - p2) / (double)length2 : 1.0;
+                g_array_append_vals(result->spans, batch->data, batch->len);
+                post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, batch, (gsize)(r - p2), fraction);
+                batch = g_array_new(FALSE, FALSE, sizeof(DiffSpan));
+                last_post = now;
+            }
+        }
+
+        word_index++;
+    }
+
+    TRACE_ARG(compare, "words", word_index);
+    TRACE_END(compare);
+    gsize text2_length = (gsize)(r - p2); /* r stopped at the terminating NUL */
+    if (in_hunk) g_array_append_val(hunks, hunk);
+    g_ptr_array_free(words1.blocks, TRUE);
+    arena_free(arena);
+    g_free(contents1);
+    g_free(contents2);
+
+    if (g_task_return_error_if_cancelled(task)) {
+        g_array_unref(batch);
+        g_array_unref(hunks);
+        diff_result_unref(result);
+        return;
+    }
+    g_array_append_vals(result->spans, batch->data, batch->len);
+    g_array_append_vals(result->hunks, hunks->data, hunks->len);
+    result->left_lines = left_lines;
+    result->right_lines = right_line + 1;
+    if (cacheable) {
+        TRACE_SCOPE("view.cache_store");
+        diff_cache_store(&key, result);
+    }
+    diff_result_unref(result);
+
+    post_diff_message(session, DIFF_MSG_SPANS, NULL, NULL, batch, text2_length, 1.0);
+    post_diff_message_hunks(session, hunk_index_new(hunks, left_lines, right_line + 1, MINIMAP_BUCKETS), NULL);
+    perf_counter_set(PERF_LAST_DIFF_US, g_get_monotonic_time() - started);
+    g_task_return_boolean(task, TRUE);
+}
+
+// ---
+// --- Hunk navigation and overview
+// ---
+
+static void scroll_to_hunk(DiffSession *session, const DiffHunk *hunk) {
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line(session->buffer2, &iter, (int)hunk->right_start);
+    gtk_text_buffer_place_cursor(session->buffer2, &iter);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(session->view2), &iter, 0.0, TRUE, 0.0, 0.3);
+
+    gtk_text_buffer_get_iter_at_line(session->buffer1, &iter, (int)hunk->left_start);
+    gtk_text_buffer_place_cursor(session->buffer1, &iter);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(session->view1), &iter, 0.0, TRUE, 0.0, 0.3);
+}
+
+static guint cursor_line(GtkTextBuffer *buffer) {
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+    return (guint)gtk_text_iter_get_line(&iter);
+}
+
+static gboolean jump_to_hunk(GtkWidget *widget, DiffSession *session, gboolean forward) {
+    if (!session->hunks) return TRUE; /* still comparing */
+    guint line = cursor_line(session->buffer2);
+    int i = forward ? hunk_index_next(session->hunks, line) : hunk_index_prev(session->hunks, line);
+    if (i < 0) {
+        gtk_widget_error_bell(widget);
+        return TRUE;
+    }
+    scroll_to_hunk(session, &g_array_index(session->hunks->hunks, DiffHunk, i));
+    gtk_widget_queue_draw(session->minimap);
+    return TRUE;
+}
+
+static gboolean on_next_hunk(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    return jump_to_hunk(widget, (DiffSession *)user_data, TRUE);
+}
+
+static gboolean on_prev_hunk(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    return jump_to_hunk(widget, (DiffSession *)user_data, FALSE);
+}
+
+static void add_hunk_shortcuts(GtkWidget *window, DiffSession *session) {
+    GtkEventController *controller = gtk_shortcut_controller_new();
+    /* Capture phase so the text views don't see these keys first */
+    gtk_event_controller_set_propagation_phase(controller, GTK_PHASE_CAPTURE);
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(controller),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Alt>Down|F7"),
+                         gtk_callback_action_new(on_next_hunk, session, NULL)));
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(controller),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Alt>Up|<Shift>F7"),
+                         gtk_callback_action_new(on_prev_hunk, session, NULL)));
+    gtk_widget_add_controller(window, controller);
+}
+
+/* Overview strip: one band per bucket of the right file, shaded by how much
+ * of it changed, plus a frame for the part currently in view */
+static void draw_minimap(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+
+    cairo_set_source_rgb(cr, 0.95, 0.95, 0.95);
+    cairo_paint(cr);
+
+    if (session->hunks && session->hunks->n_buckets > 0) {
+        const HunkIndex *index = session->hunks;
+        double band = (double)height / index->n_buckets;
+        for (guint b = 0; b < index->n_buckets; ++b) {
+            if (!index->buckets[b]) continue;
+            cairo_set_source_rgba(cr, 0.7, 0.0, 0.0, 0.25 + 0.75 * index->buckets[b] / 255.0);
+            cairo_rectangle(cr, 0, b * band, width, MAX(band, 1.0));
+            cairo_fill(cr);
+        }
+    }
+
+    GtkAdjustment *adj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(session->view2));
+    double upper = gtk_adjustment_get_upper(adj) - gtk_adjustment_get_lower(adj);
+    if (upper > 0) {
+        double top = (gtk_adjustment_get_value(adj) - gtk_adjustment_get_lower(adj)) / upper * height;
+        double size = gtk_adjustment_get_page_size(adj) / upper * height;
+        cairo_set_source_rgba(cr, 0.2, 0.2, 0.2, 0.8);
+        cairo_set_line_width(cr, 1.0);
+        cairo_rectangle(cr, 0.5, top + 0.5, width - 1.0, MAX(size - 1.0, 2.0));
+        cairo_stroke(cr);
+    }
+}
+
+static void scroll_to_fraction(GtkWidget *view, double fraction) {
+    GtkAdjustment *adj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view));
+    double lower = gtk_adjustment_get_lower(adj);
+    double span = gtk_adjustment_get_upper(adj) - lower;
+    gtk_adjustment_set_value(adj, lower + fraction * span - gtk_adjustment_get_page_size(adj) / 2);
+}
+
+static void on_minimap_pressed(GtkGestureClick *gesture, int n_press, double x, double y, gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+    int height = gtk_widget_get_height(session->minimap);
+    if (height <= 0) return;
+    double fraction = CLAMP(y / height, 0.0, 1.0);
+    scroll_to_fraction(session->view2, fraction);
+    scroll_to_fraction(session->view1, fraction);
+}
+
+static void on_view_scrolled(GtkAdjustment *adj, gpointer user_data) {
+    gtk_widget_queue_draw(GTK_WIDGET(user_data));
+}
+
+// ---
+// --- Line mode options
+// ---
+
+static const struct {
+    const char *label;
+    LineCompareFlags flag;
+} line_options[] = {
+    { "Ignore whitespace", LINE_IGNORE_WHITESPACE },
+    { "Ignore blank lines", LINE_IGNORE_BLANK_LINES },
+    { "Ignore case", LINE_IGNORE_CASE },
+    { "Ignore line endings", LINE_IGNORE_LINE_ENDING },
+};
+
+/* Clear the shown line diff before another run; the right text is appended again as it is tagged */
+static void reset_line_result(DiffSession *session) {
+    gtk_widget_set_sensitive(session->options_box, FALSE);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(session->buffer1, &start, &end);
+    gtk_text_buffer_remove_tag(session->buffer1, session->delete_tag, &start, &end);
+    gtk_text_buffer_remove_tag(session->buffer1, session->move_tags[0], &start, &end);
+    gtk_text_buffer_set_text(session->buffer2, "", -1);
+    session->appended = 0;
+    g_clear_pointer(&session->hunks, hunk_index_free);
+    gtk_widget_queue_draw(session->minimap);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(session->progress_bar), 0.0);
+    gtk_widget_set_visible(session->progress_box, TRUE);
+}
+
+/* Hand the texts to a line mode worker; they are the worker's until its DIFF_MSG_DONE is applied */
+static void run_line_task(DiffSession *session, GTaskThreadFunc func) {
+    session->running = TRUE;
+    GTask *task = g_task_new(NULL, session->cancellable, NULL, NULL);
+    g_task_set_task_data(task, diff_session_ref(session), (GDestroyNotify)diff_session_unref);
+    g_task_run_in_thread(task, func);
+    g_object_unref(task);
+}
+
+/* Diff again under the new flags; texts and line tables are reused */
+static void on_line_option_toggled(GtkCheckButton *button, gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+    guint flag = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(button), "line-flag"));
+    if (gtk_check_button_get_active(button)) session->line_flags |= flag;
+    else session->line_flags &= ~flag;
+
+    reset_line_result(session);
+    run_line_task(session, line_compare_thread);
+}
+
+/* The right file changed on disk: rediff now, or once the running worker is done */
+static void start_refresh(DiffSession *session) {
+    if (session->running) {
+        session->refresh_pending = TRUE;
+        return;
+    }
+    reset_line_result(session);
+    run_line_task(session, refresh_lines_thread);
+}
+
+static gboolean on_refresh_timeout(gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+    session->refresh_source = 0;
+    start_refresh(session);
+    return G_SOURCE_REMOVE;
+}
+
+/* Editors save in bursts of events, so wait for the file to settle before reading it */
+static void on_file2_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event,
+                             gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+    if (event != G_FILE_MONITOR_EVENT_CHANGED && event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+        event != G_FILE_MONITOR_EVENT_CREATED)
+        return;
+    g_clear_handle_id(&session->refresh_source, g_source_remove);
+    session->refresh_source = g_timeout_add(REFRESH_DELAY_MS, on_refresh_timeout, session);
+}
+
+static GtkWidget *new_line_options_box(DiffSession *session) {
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_widget_set_margin_start(box, 10);
+    gtk_widget_set_margin_end(box, 10);
+    gtk_widget_set_margin_bottom(box, 5);
+    for (guint i = 0; i < G_N_ELEMENTS(line_options); ++i) {
+        GtkWidget *check = gtk_check_button_new_with_label(line_options[i].label);
+        g_object_set_data(G_OBJECT(check), "line-flag", GUINT_TO_POINTER(line_options[i].flag));
+        g_signal_connect(check, "toggled", G_CALLBACK(on_line_option_toggled), session);
+        gtk_box_append(GTK_BOX(box), check);
+    }
+    /* Enabled once the first comparison is in */
+    gtk_widget_set_sensitive(box, FALSE);
+    return box;
+}
+
+static void on_compare_window_destroy(GtkWidget *widget, gpointer user_data) {
+    DiffSession *session = (DiffSession *)user_data;
+    if (session->monitor) {
+        g_signal_handlers_disconnect_by_data(session->monitor, session);
+        g_file_monitor_cancel(session->monitor);
+        g_clear_object(&session->monitor);
+    }
+    g_clear_handle_id(&session->refresh_source, g_source_remove);
+    /* Stops the worker and turns any queued messages into no-ops */
+    g_cancellable_cancel(session->cancellable);
+    diff_session_unref(session);
+}
+
+static gboolean is_large_file(const char *path) {
+    return chunk_store_file_length(path) > LARGE_FILE_THRESHOLD;
+}
+
+static GtkWidget *new_file_label(const char *path) {
+    gchar *basename = g_path_get_basename(path);
+    GtkWidget *label = gtk_label_new(basename);
+    gtk_widget_set_halign(label, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(label, 10);
+    gtk_widget_set_margin_top(label, 5);
+    gtk_widget_set_margin_bottom(label, 5);
+    g_free(basename);
+    return label;
+}
+
+/* A large compare window waiting for plain copies of chunked versions, which it maps */
+typedef struct {
+    gchar *paths[2];
+    gchar *copies[2];
+    guint next;             /* side being materialized */
+    GtkWidget *window;      /* not referenced; only used while not cancelled */
+    GtkWidget *views[2];    /* referenced, in case the window goes first */
+    GtkWidget *status;
+    GCancellable *cancellable;
+} LargeDiffJob;
+
+static void large_diff_job_free(LargeDiffJob *job) {
+    for (int i = 0; i < 2; ++i) {
+        g_free(job->paths[i]);
+        /* Copies the window never took over */
+        if (job->copies[i]) chunk_store_release_materialized(job->copies[i]);
+        g_free(job->copies[i]);
+        g_object_unref(job->views[i]);
+    }
+    g_object_unref(job->status);
+    g_object_unref(job->cancellable);
+    g_free(job);
+}
+
+static void on_large_copy_ready(GObject *source, GAsyncResult *res, gpointer user_data);
+
+static void materialize_next(LargeDiffJob *job) {
+    chunk_store_materialize_async(job->paths[job->next], job->cancellable, on_large_copy_ready, job);
+}
+
+static void on_large_compared(LargeFileView *view, gboolean aligned, gpointer user_data) {
+    GtkWidget *status = GTK_WIDGET(user_data);
+    if (aligned) {
+        gtk_widget_set_visible(status, FALSE);
+        return;
+    }
+    gtk_label_set_text(GTK_LABEL(status), "Too many differences to line the files up: "
+                                          "lines are compared by line number");
+}
+
+/* Both copies are made one after the other, then the views map them */
+static void on_large_copy_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    LargeDiffJob *job = user_data;
+    GError *error = NULL;
+    gchar *copy_path = chunk_store_materialize_finish(res, &error);
+    if (g_cancellable_is_cancelled(job->cancellable)) {
+        if (copy_path) chunk_store_release_materialized(copy_path);
+        g_free(copy_path);
+        g_clear_error(&error);
+        large_diff_job_free(job);
+        return;
+    }
+    if (!copy_path) {
+        gchar *message = g_strdup_printf("Could not reconstruct %s: %s", job->paths[job->next],
+                                         error ? error->message : "unknown error");
+        gtk_label_set_text(GTK_LABEL(job->status), message);
+        g_free(message);
+        g_clear_error(&error);
+        large_diff_job_free(job);
+        return;
+    }
+    job->copies[job->next++] = copy_path;
+    if (job->next < 2) {
+        materialize_next(job);
+        return;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        if (!large_file_view_load(LARGE_FILE_VIEW(job->views[i]), job->copies[i], &error)) {
+            g_printerr("Failed to map file: %s: %s\n", job->copies[i], error ? error->message : "unknown");
+            g_clear_error(&error);
+        }
+        /* Copies go with the window (any still mapped are cleared at the next start) */
+        g_signal_connect_data(job->window, "destroy", G_CALLBACK(chunk_store_release_materialized),
+                              g_steal_pointer(&job->copies[i]), (GClosureNotify)g_free, G_CONNECT_SWAPPED);
+    }
+    gtk_label_set_text(GTK_LABEL(job->status), "Comparing…");
+    g_signal_connect_object(job->views[0], "compared", G_CALLBACK(on_large_compared), job->status, 0);
+    large_diff_job_free(job);
+}
+
+/* Side-by-side view for very large files: both panes draw only the visible
+ * lines from mapped files and scroll together through a shared vadjustment.
+ * Once both are indexed the panes line up on a line diff, with gaps on the
+ * side that lacks a run; files too different for that are compared by line
+ * number, and the status line says so. The
+ * window shows up at once; chunked versions are exported to plain copies in
+ * the background before the panes map them. */
+static void create_large_diff_window(GtkWindow* parent, const char* file1_path, const char* file2_path) {
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), "Compare Files");
+    gtk_window_set_default_size(GTK_WINDOW(window), 1200, 800);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+    gtk_window_set_modal(GTK_WINDOW(window), TRUE);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_window_set_child(GTK_WINDOW(window), grid);
+    gtk_grid_attach(GTK_GRID(grid), new_file_label(file1_path), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), new_file_label(file2_path), 2, 0, 1, 1);
+
+    LargeDiffJob *job = g_new0(LargeDiffJob, 1);
+    job->window = window;
+    job->paths[0] = g_strdup(file1_path);
+    job->paths[1] = g_strdup(file2_path);
+    GtkWidget *scrolled[2];
+    for (int i = 0; i < 2; ++i) {
+        job->views[i] = g_object_ref(large_file_view_new());
+        scrolled[i] = gtk_scrolled_window_new();
+        gtk_widget_set_hexpand(scrolled[i], TRUE);
+        gtk_widget_set_vexpand(scrolled[i], TRUE);
+        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled[i]), job->views[i]);
+        gtk_grid_attach(GTK_GRID(grid), scrolled[i], i * 2, 1, 1, 1);
+    }
+    large_file_view_set_peer(LARGE_FILE_VIEW(job->views[0]), LARGE_FILE_VIEW(job->views[1]));
+    large_file_view_set_peer(LARGE_FILE_VIEW(job->views[1]), LARGE_FILE_VIEW(job->views[0]));
+    gtk_scrolled_window_set_vadjustment(GTK_SCROLLED_WINDOW(scrolled[1]),
+                                        gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled[0])));
+
+    GtkWidget *gutter = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
+    gtk_widget_set_size_request(gutter, 2, -1);
+    gtk_grid_attach(GTK_GRID(grid), gutter, 1, 1, 1, 1);
+
+    job->status = g_object_ref(gtk_label_new("Reconstructing versions…"));
+    gtk_widget_set_halign(job->status, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(job->status, 10);
+    gtk_widget_set_margin_top(job->status, 5);
+    gtk_widget_set_margin_bottom(job->status, 5);
+    gtk_grid_attach(GTK_GRID(grid), job->status, 0, 2, 3, 1);
+
+    /* Closing the window stops the export; the job is freed by its last callback */
+    job->cancellable = g_cancellable_new();
+    g_signal_connect_object(window, "destroy", G_CALLBACK(g_cancellable_cancel), job->cancellable,
+                            G_CONNECT_SWAPPED);
+    materialize_next(job);
+
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// ---
+// --- Hex view for binary files
+// ---
+
+/* Only the start of bigger files is dumped; the whole files are still compared */
+#define HEX_VIEW_MAX_BYTES (4 * 1024 * 1024)
+#define HEX_BYTES_PER_LINE 16
+/* Columns of a dump line: "00000000  xx xx ... xx  ................" */
+#define HEX_COLUMN 10
+#define HEX_ASCII_COLUMN (HEX_COLUMN + 3 * HEX_BYTES_PER_LINE + 1)
+
+typedef struct {
+    gchar *paths[2];
+    gchar *dumps[2];
+    gsize lengths[2];
+    GArray *changed[2];  /* ByteRange: left bytes nothing was copied from, right bytes not in the left file */
+    gsize copied;        /* right bytes found in the left file */
+} HexJob;
+
+static void hex_job_free(HexJob *job) {
+    for (int i = 0; i < 2; ++i) {
+        g_free(job->paths[i]);
+        g_free(job->dumps[i]);
+        if (job->changed[i]) g_array_unref(job->changed[i]);
+    }
+    g_free(job);
+}
+
+static gchar *hex_dump(const guint8 *data, gsize length) {
+    gsize shown = MIN(length, HEX_VIEW_MAX_BYTES);
+    GString *out = g_string_sized_new((shown / HEX_BYTES_PER_LINE + 1) * (HEX_ASCII_COLUMN + HEX_BYTES_PER_LINE + 1));
+    for (gsize line = 0; line < shown; line += HEX_BYTES_PER_LINE) {
+        gsize n = MIN(HEX_BYTES_PER_LINE, shown - line);
+        g_string_append_printf(out, "%08" G_GSIZE_MODIFIER "x  ", line);
+        for (gsize k = 0; k < HEX_BYTES_PER_LINE; ++k) {
+            if (k < n) g_string_append_printf(out, "%02x ", data[line + k]);
+            else g_string_append(out, "   ");
+        }
+        g_string_append_c(out, ' ');
+        for (gsize k = 0; k < n; ++k) {
+            guint8 c = data[line + k];
+            g_string_append_c(out, c >= 0x20 && c < 0x7f ? (gchar)c : '.');
+        }
+        g_string_append_c(out, '\n');
+    }
+    return g_string_free(out, FALSE);
+}
+
+static void hex_diff_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    HexJob *job = task_data;
+    TRACE_SCOPE("view.hex_diff");
+    gchar *contents[2] = { NULL, NULL };
+    GError *error = NULL;
+    for (int i = 0; i < 2; ++i) {
+        if (!chunk_store_read_file(job->paths[i], &contents[i], &job->lengths[i], &error)) {
+            g_free(contents[0]);
+            g_task_return_error(task, error);
+            return;
+        }
+        /* Checked between the steps; the window may have been closed during a long read */
+        if (g_task_return_error_if_cancelled(task)) {
+            g_free(contents[0]);
+            g_free(contents[1]);
+            return;
+        }
+    }
+
+    GArray *runs = binary_diff((const guint8 *)contents[0], job->lengths[0], (const guint8 *)contents[1],
+                               job->lengths[1], 0);
+    job->changed[0] = binary_diff_unused(runs, job->lengths[0]);
+    job->changed[1] = g_array_new(FALSE, FALSE, sizeof(ByteRange));
+    for (guint i = 0; i < runs->len; ++i) {
+        const BinaryRun *run = &g_array_index(runs, BinaryRun, i);
+        if (run->type == BINARY_RUN_COPY) {
+            job->copied += run->length;
+        } else {
+            ByteRange range = { run->right_start, run->length };
+            g_array_append_val(job->changed[1], range);
+        }
+    }
+    g_array_unref(runs);
+    for (int i = 0; i < 2; ++i) {
+        if (!g_cancellable_is_cancelled(cancellable)) {
+            job->dumps[i] = hex_dump((const guint8 *)contents[i], job->lengths[i]);
+        }
+        g_free(contents[i]);
+    }
+    if (!g_task_return_error_if_cancelled(task)) g_task_return_boolean(task, TRUE);
+}
+
+/* Tag the hex digits and characters of every shown byte in 'ranges', a line at a time */
+static void tag_byte_ranges(GtkTextBuffer *buffer, GtkTextTag *tag, const GArray *ranges, gsize length) {
+    gsize shown = MIN(length, HEX_VIEW_MAX_BYTES);
+    for (guint i = 0; i < ranges->len; ++i) {
+        const ByteRange *range = &g_array_index(ranges, ByteRange, i);
+        gsize end = MIN(range->start + range->length, shown);
+        for (gsize pos = range->start; pos < end;) {
+            gint line = (gint)(pos / HEX_BYTES_PER_LINE);
+            gint k0 = (gint)(pos % HEX_BYTES_PER_LINE);
+            gint k1 = (gint)MIN((gsize)HEX_BYTES_PER_LINE, k0 + (end - pos));
+            GtkTextIter a, b;
+            gtk_text_buffer_get_iter_at_line_offset(buffer, &a, line, HEX_COLUMN + 3 * k0);
+            gtk_text_buffer_get_iter_at_line_offset(buffer, &b, line, HEX_COLUMN + 3 * k1 - 1);
+            gtk_text_buffer_apply_tag(buffer, tag, &a, &b);
+            gtk_text_buffer_get_iter_at_line_offset(buffer, &a, line, HEX_ASCII_COLUMN + k0);
+            gtk_text_buffer_get_iter_at_line_offset(buffer, &b, line, HEX_ASCII_COLUMN + k1);
+            gtk_text_buffer_apply_tag(buffer, tag, &a, &b);
+            pos += k1 - k0;
+        }
+    }
+}
+
+static gsize sum_ranges(const GArray *ranges) {
+    gsize total = 0;
+    for (guint i = 0; i < ranges->len; ++i) total += g_array_index(ranges, ByteRange, i).length;
+    return total;
+}
+
+/* The status label is the task's source object and the views are kept alive by the task, as in the merge window */
+static void on_hex_diff_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    GtkLabel *status = GTK_LABEL(source);
+    GtkTextView **views = user_data;
+    HexJob *job = g_task_get_task_data(G_TASK(res));
+    GError *error = NULL;
+    if (!g_task_propagate_boolean(G_TASK(res), &error)) {
+        /* Cancelled only once the window is gone */
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            gchar *message = g_strdup_printf("Could not compare: %s", error ? error->message : "unknown error");
+            gtk_label_set_text(status, message);
+            g_free(message);
+        }
+        g_clear_error(&error);
+    } else {
+        for (int i = 0; i < 2; ++i) {
+            GtkTextBuffer *buffer = gtk_text_view_get_buffer(views[i]);
+            gtk_text_buffer_set_text(buffer, job->dumps[i], -1);
+            GtkTextTag *tag = gtk_text_tag_table_lookup(gtk_text_buffer_get_tag_table(buffer), "hex-changed");
+            tag_byte_ranges(buffer, tag, job->changed[i], job->lengths[i]);
+        }
+        gboolean cut = job->lengths[0] > HEX_VIEW_MAX_BYTES || job->lengths[1] > HEX_VIEW_MAX_BYTES;
+        gchar *message = g_strdup_printf("Binary files: %" G_GSIZE_FORMAT " bytes copied from the left, "
+                                         "%" G_GSIZE_FORMAT " new, %" G_GSIZE_FORMAT " dropped%s",
+                                         job->copied, sum_ranges(job->changed[1]), sum_ranges(job->changed[0]),
+                                         cut ? " (first 4 MiB of each shown)" : "");
+        gtk_label_set_text(status, message);
+        g_free(message);
+    }
+    for (int i = 0; i < 2; ++i) g_object_unref(views[i]);
+    g_free(views);
+}
+
+/* Side-by-side hex dumps of two binary files, bytes the block diff could not match highlighted on each side */
+static void create_hex_diff_window(GtkWindow* parent, const char* file1_path, const char* file2_path) {
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), "Compare Binary Files");
+    gtk_window_set_default_size(GTK_WINDOW(window), 1400, 800);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+    gtk_window_set_modal(GTK_WINDOW(window), TRUE);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_window_set_child(GTK_WINDOW(window), grid);
+    gtk_grid_attach(GTK_GRID(grid), new_file_label(file1_path), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), new_file_label(file2_path), 2, 0, 1, 1);
+
+    GtkTextView **views = g_new(GtkTextView *, 2);
+    GtkWidget *scrolled[2];
+    for (int i = 0; i < 2; ++i) {
+        GtkWidget *view = gtk_text_view_new();
+        gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+        gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+        gtk_text_buffer_create_tag(gtk_text_view_get_buffer(GTK_TEXT_VIEW(view)), "hex-changed",
+                                   "background", "#ffd7d7",
+                                   "foreground", "#b30000",
+                                   NULL);
+        views[i] = GTK_TEXT_VIEW(g_object_ref(view));
+        scrolled[i] = gtk_scrolled_window_new();
+        gtk_widget_set_hexpand(scrolled[i], TRUE);
+        gtk_widget_set_vexpand(scrolled[i], TRUE);
+        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled[i]), view);
+        gtk_grid_attach(GTK_GRID(grid), scrolled[i], i * 2, 1, 1, 1);
+    }
+    /* Same offset, same line: scrolling one side scrolls both */
+    gtk_scrolled_window_set_vadjustment(GTK_SCROLLED_WINDOW(scrolled[1]),
+                                        gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled[0])));
+
+    GtkWidget *gutter = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
+    gtk_widget_set_size_request(gutter, 2, -1);
+    gtk_grid_attach(GTK_GRID(grid), gutter, 1, 1, 1, 1);
+
+    GtkWidget *status = gtk_label_new("Comparing…");
+    gtk_widget_set_halign(status, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(status, 10);
+    gtk_widget_set_margin_top(status, 5);
+    gtk_widget_set_margin_bottom(status, 5);
+    gtk_grid_attach(GTK_GRID(grid), status, 0, 2, 3, 1);
+
+    gtk_window_present(GTK_WINDOW(window));
+
+    HexJob *job = g_new0(HexJob, 1);
+    job->paths[0] = g_strdup(file1_path);
+    job->paths[1] = g_strdup(file2_path);
+    /* Closing the window stops the worker between steps */
+    GCancellable *cancellable = g_cancellable_new();
+    g_signal_connect_object(window, "destroy", G_CALLBACK(g_cancellable_cancel), cancellable, G_CONNECT_SWAPPED);
+    GTask *task = g_task_new(status, cancellable, on_hex_diff_ready, views);
+    g_object_unref(cancellable);
+    g_task_set_task_data(task, job, (GDestroyNotify)hex_job_free);
+    g_task_run_in_thread(task, hex_diff_thread);
+    g_object_unref(task);
+}
+
 void create_diff_window(GtkWindow* parent, const char* file1_path, const char* file2_path) {
+    create_diff_window_full(parent, file1_path, file2_path, DIFF_ALGO_WORDS);
+}
+
+void create_diff_window_full(GtkWindow* parent, const char* file1_path, const char* file2_path,
+                             DiffAlgorithm algorithm) {
+    if (is_large_file(file1_path) || is_large_file(file2_path)) {
+        create_large_diff_window(parent, file1_path, file2_path);
+        return;
+    }
+    if (binary_diff_file_is_binary(file1_path) || binary_diff_file_is_binary(file2_path)) {
+        create_hex_diff_window(parent, file1_path, file2_path);
+        return;
+    }
+
     GtkWidget *window, *grid, *scrolled_window1, *scrolled_window2, *view1, *view2, *gutter;
     GtkWidget *label1, *label2;
+    GtkWidget *progress_box, *progress_label, *progress_bar;
     GtkTextBuffer *buffer1, *buffer2;
 
     window = gtk_window_new();
-    gtk_window_set_title(GTK_WINDOW(window), "Compare Files");
+    gtk_window_set_title(GTK_WINDOW(window), algorithm == DIFF_ALGO_LINES ? "Compare Lines" : "Compare Files");
     gtk_window_set_default_size(GTK_WINDOW(window), 1200, 800);
     gtk_window_set_transient_for(GTK_WINDOW(window), parent);
     gtk_window_set_modal(GTK_WINDOW(window), TRUE);
@@ -18,25 +1278,11 @@ void create_diff_window(GtkWindow* parent, const char* file1_path, const char* f
     gtk_window_set_child(GTK_WINDOW(window), grid);
 
     // Add labels for file names
-    gchar *basename1 = g_path_get_basename(file1_path);
-    gchar *basename2 = g_path_get_basename(file2_path);
-    
-    label1 = gtk_label_new(basename1);
-    gtk_widget_set_halign(label1, GTK_ALIGN_START);
-    gtk_widget_set_margin_start(label1, 10);
-    gtk_widget_set_margin_top(label1, 5);
-    gtk_widget_set_margin_bottom(label1, 5);
+    label1 = new_file_label(file1_path);
     gtk_grid_attach(GTK_GRID(grid), label1, 0, 0, 1, 1);
-    
-    label2 = gtk_label_new(basename2);
-    gtk_widget_set_halign(label2, GTK_ALIGN_START);
-    gtk_widget_set_margin_start(label2, 10);
-    gtk_widget_set_margin_top(label2, 5);
-    gtk_widget_set_margin_bottom(label2, 5);
+
+    label2 = new_file_label(file2_path);
     gtk_grid_attach(GTK_GRID(grid), label2, 2, 0, 1, 1);
-    
-    g_free(basename1);
-    g_free(basename2);
 
     // Create two text views
     view1 = gtk_text_view_new();
@@ -50,9 +1296,17 @@ void create_diff_window(GtkWindow* parent, const char* file1_path, const char* f
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window1), view1);
     gtk_grid_attach(GTK_GRID(grid), scrolled_window1, 0, 1, 1, 1);
 
+    // Gutter column: separator plus the change overview
+    GtkWidget *gutter_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
     gutter = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
     gtk_widget_set_size_request(gutter, 2, -1);
-    gtk_grid_attach(GTK_GRID(grid), gutter, 1, 1, 1, 1);
+    gtk_box_append(GTK_BOX(gutter_box), gutter);
+    GtkWidget *minimap = gtk_drawing_area_new();
+    gtk_widget_set_size_request(minimap, MINIMAP_WIDTH, -1);
+    gtk_widget_set_vexpand(minimap, TRUE);
+    gtk_widget_set_tooltip_text(minimap, "Changes (Alt+Down / Alt+Up to jump)");
+    gtk_box_append(GTK_BOX(gutter_box), minimap);
+    gtk_grid_attach(GTK_GRID(grid), gutter_box, 1, 1, 1, 1);
 
     view2 = gtk_text_view_new();
     gtk_text_view_set_editable(GTK_TEXT_VIEW(view2), FALSE);
@@ -65,6 +1319,20 @@ void create_diff_window(GtkWindow* parent, const char* file1_path, const char* f
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window2), view2);
     gtk_grid_attach(GTK_GRID(grid), scrolled_window2, 2, 1, 1, 1);
 
+    // Progress row, hidden once the comparison has finished
+    progress_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_widget_set_margin_start(progress_box, 10);
+    gtk_widget_set_margin_end(progress_box, 10);
+    gtk_widget_set_margin_top(progress_box, 5);
+    gtk_widget_set_margin_bottom(progress_box, 5);
+    progress_label = gtk_label_new("Comparing…");
+    progress_bar = gtk_progress_bar_new();
+    gtk_widget_set_hexpand(progress_bar, TRUE);
+    gtk_widget_set_valign(progress_bar, GTK_ALIGN_CENTER);
+    gtk_box_append(GTK_BOX(progress_box), progress_label);
+    gtk_box_append(GTK_BOX(progress_box), progress_bar);
+    gtk_grid_attach(GTK_GRID(grid), progress_box, 0, 2, 3, 1);
+
     // Apply CSS for better styling
     GtkCssProvider *provider = gtk_css_provider_new();
     gtk_css_provider_load_from_string(provider,
@@ -75,93 +1343,271 @@ void create_diff_window(GtkWindow* parent, const char* file1_path, const char* f
     g_object_unref(provider);
 
     // Create tags for highlighting differences with underlines
-    gtk_text_buffer_create_tag(buffer2, "diff-insert",
+    GtkTextTag *insert_tag = gtk_text_buffer_create_tag(buffer2, "diff-insert",
                               "underline", PANGO_UNDERLINE_SINGLE,
                               "foreground", "#b30000",
                               NULL);
+    // Line mode also strikes out deleted lines and shades moved blocks; created last so moves win
+    GtkTextTag *delete_tag = NULL, *move_tags[2] = { NULL, NULL };
+    if (algorithm == DIFF_ALGO_LINES) {
+        delete_tag = gtk_text_buffer_create_tag(buffer1, "diff-delete",
+                                                "strikethrough", TRUE,
+                                                "foreground", "#b30000",
+                                                NULL);
+        GtkTextBuffer *buffers[2] = { buffer1, buffer2 };
+        for (int i = 0; i < 2; ++i) {
+            move_tags[i] = gtk_text_buffer_create_tag(buffers[i], "diff-move",
+                                                      "paragraph-background", "#dde8ff",
+                                                      "strikethrough", FALSE,
+                                                      "underline", PANGO_UNDERLINE_NONE,
+                                                      "foreground", "#1a4d99",
+                                                      NULL);
+        }
+    }
 
-    // Read file contents
-    gchar *contents1 = NULL, *contents2 = NULL;
-    gsize length1, length2;
-    
-    if (!g_file_get_contents(file1_path, &contents1, &length1, NULL)) {
-        g_printerr("Failed to read file: %s\n", file1_path);
-        contents1 = g_strdup("[Error reading file]");
+    // Reading, tokenizing and tagging happen in a worker; the window shows up right away
+    DiffSession *session = g_atomic_rc_box_new0(DiffSession);
+    session->file1_path = g_strdup(file1_path);
+    session->file2_path = g_strdup(file2_path);
+    session->algorithm = algorithm;
+    session->cancellable = g_cancellable_new();
+    session->window = window;
+    session->buffer1 = buffer1;
+    session->buffer2 = buffer2;
+    session->view1 = view1;
+    session->view2 = view2;
+    session->minimap = minimap;
+    session->progress_box = progress_box;
+    session->progress_bar = progress_bar;
+    session->insert_tag = insert_tag;
+    session->delete_tag = delete_tag;
+    session->move_tags[0] = move_tags[0];
+    session->move_tags[1] = move_tags[1];
+    if (algorithm == DIFF_ALGO_LINES) {
+        session->options_box = new_line_options_box(session);
+        gtk_grid_attach(GTK_GRID(grid), session->options_box, 0, 3, 3, 1);
+        /* Changes saved to the right file show up while the window is open */
+        GFile *file2 = g_file_new_for_path(file2_path);
+        session->monitor = g_file_monitor_file(file2, G_FILE_MONITOR_NONE, NULL, NULL);
+        g_object_unref(file2);
+        if (session->monitor) g_signal_connect(session->monitor, "changed", G_CALLBACK(on_file2_changed), session);
+        session->running = TRUE;
     }
-    
-    if (!g_file_get_contents(file2_path, &contents2, &length2, NULL)) {
-        g_printerr("Failed to read file: %s\n", file2_path);
-        contents2 = g_strdup("[Error reading file]");
+    g_signal_connect(window, "destroy", G_CALLBACK(on_compare_window_destroy), session);
+
+    // Hunk navigation and the overview strip; all of these die with the window
+    add_hunk_shortcuts(window, session);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(minimap), draw_minimap, session, NULL);
+    GtkGesture *minimap_click = gtk_gesture_click_new();
+    g_signal_connect(minimap_click, "pressed", G_CALLBACK(on_minimap_pressed), session);
+    gtk_widget_add_controller(minimap, GTK_EVENT_CONTROLLER(minimap_click));
+    GtkAdjustment *vadj2 = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled_window2));
+    g_signal_connect_object(vadj2, "value-changed", G_CALLBACK(on_view_scrolled), minimap, 0);
+    g_signal_connect_object(vadj2, "changed", G_CALLBACK(on_view_scrolled), minimap, 0);
+
+    GTask *task = g_task_new(NULL, session->cancellable, NULL, NULL);
+    g_task_set_task_data(task, diff_session_ref(session), (GDestroyNotify)diff_session_unref);
+    g_task_run_in_thread(task, compute_diff_thread);
+    g_object_unref(task);
+
+    gtk_window_present(GTK_WINDOW(window));
+}
+
+// ---
+// --- Three-way merge window
+// ---
+
+typedef struct {
+    gchar *paths[3];        /* indexed by MERGE_BASE/LEFT/RIGHT */
+    gchar *text;
+    GArray *conflicts;      /* guint pairs: first line and line count of each conflict */
+    guint n_conflicts;
+} MergeJob;
+
+static void merge_job_free(MergeJob *job) {
+    for (int s = 0; s < 3; ++s) g_free(job->paths[s]);
+    g_free(job->text);
+    g_array_unref(job->conflicts);
+    g_free(job);
+}
+
+static void merge_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    MergeJob *job = task_data;
+    GError *error = NULL;
+    Merge3Result *result = perform_merge3(job->paths[MERGE_BASE], job->paths[MERGE_LEFT], job->paths[MERGE_RIGHT], &error);
+    if (!result) {
+        g_task_return_error(task, error);
+        return;
     }
+    gchar *labels[3];
+    for (int s = 0; s < 3; ++s) labels[s] = g_path_get_basename(job->paths[s]);
+    job->text = merge3_render(result, (const char *const *)labels, NULL, job->conflicts);
+    job->n_conflicts = result->n_conflicts;
+    for (int s = 0; s < 3; ++s) g_free(labels[s]);
+    merge3_result_free(result);
+    g_task_return_boolean(task, TRUE);
+}
 
-    // Populate buffers with full file contents first
-    gtk_text_buffer_set_text(buffer1, contents1 ? contents1 : "", -1);
-    gtk_text_buffer_set_text(buffer2, contents2 ? contents2 : "", -1);
+/* The text view is the task's source object, so it is still alive even if the window was closed */
+static void on_merge_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    GtkLabel *status = GTK_LABEL(user_data);
+    MergeJob *job = g_task_get_task_data(G_TASK(res));
+    GError *error = NULL;
+    if (!g_task_propagate_boolean(G_TASK(res), &error)) {
+        gchar *message = g_strdup_printf("Could not merge: %s", error ? error->message : "unknown error");
+        gtk_label_set_text(status, message);
+        g_free(message);
+        g_clear_error(&error);
+        g_object_unref(status);
+        return;
+    }
 
-    // Highlight words in the latest file that differ at the same word positions
-    const gchar *p1 = contents1 ? contents1 : "";
-    const gchar *p2 = contents2 ? contents2 : "";
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(source));
+    gtk_text_buffer_set_text(buffer, job->text, -1);
+    for (guint i = 0; i + 1 < job->conflicts->len; i += 2) {
+        gint first = (gint)g_array_index(job->conflicts, guint, i);
+        gint count = (gint)g_array_index(job->conflicts, guint, i + 1);
+        GtkTextIter start, end;
+        gtk_text_buffer_get_iter_at_line(buffer, &start, first);
+        /* Past the last line this is the end of the buffer */
+        gtk_text_buffer_get_iter_at_line(buffer, &end, first + count);
+        gtk_text_buffer_apply_tag_by_name(buffer, "merge-conflict", &start, &end);
+    }
+    GtkTextIter top;
+    gtk_text_buffer_get_start_iter(buffer, &top);
+    gtk_text_buffer_place_cursor(buffer, &top);
 
-    // Tokenize previous file into words array (words are non-whitespace runs)
-    GPtrArray *words1 = g_ptr_array_new_with_free_func(g_free);
-    const gchar *q = p1;
-    while (*q) {
-        gunichar c = g_utf8_get_char(q);
-        if (g_unichar_isspace(c)) { q = g_utf8_next_char(q); continue; }
-        const gchar *start = q;
-        while (*q) {
-            gunichar n = g_utf8_get_char(q);
-            if (g_unichar_isspace(n)) break;
-            q = g_utf8_next_char(q);
+    gchar *message = job->n_conflicts == 0
+        ? g_strdup("Merged without conflicts")
+        : g_strdup_printf("%u conflict%s (Alt+Down / Alt+Up to jump); edit to resolve, then save",
+                          job->n_conflicts, job->n_conflicts == 1 ? "" : "s");
+    gtk_label_set_text(status, message);
+    g_free(message);
+    g_object_unref(status);
+}
+
+/* Conflicts are found through the tag, so jumping still works after edits */
+static gboolean jump_to_conflict(GtkWidget *widget, gpointer user_data, gboolean forward) {
+    GtkTextView *view = GTK_TEXT_VIEW(user_data);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(view);
+    GtkTextTag *tag = gtk_text_tag_table_lookup(gtk_text_buffer_get_tag_table(buffer), "merge-conflict");
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+    gboolean found = FALSE;
+    while (forward ? gtk_text_iter_forward_to_tag_toggle(&iter, tag) : gtk_text_iter_backward_to_tag_toggle(&iter, tag)) {
+        if (gtk_text_iter_starts_tag(&iter, tag)) {
+            found = TRUE;
+            break;
         }
-        gchar *w = g_strndup(start, q - start);
-        g_ptr_array_add(words1, w);
     }
+    if (!found) return FALSE;
+    gtk_text_buffer_place_cursor(buffer, &iter);
+    gtk_text_view_scroll_to_iter(view, &iter, 0.1, TRUE, 0.0, 0.2);
+    return TRUE;
+}
 
-    // Walk through latest file, tracking character offsets so tag ranges line up
-    gint latest_offset = 0; // character offset into buffer2
-    gint word_index = 0;
-    const gchar *r = p2;
-    while (*r) {
-        gunichar c = g_utf8_get_char(r);
-        if (g_unichar_isspace(c)) {
-            r = g_utf8_next_char(r);
-            latest_offset++;
-            continue;
-        }
+static gboolean on_next_conflict(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    return jump_to_conflict(widget, user_data, TRUE);
+}
 
-        // extract next word in latest file
-        const gchar *start = r;
-        while (*r) {
-            gunichar n = g_utf8_get_char(r);
-            if (g_unichar_isspace(n)) break;
-            r = g_utf8_next_char(r);
-        }
-        gchar *w2 = g_strndup(start, r - start);
-        gint wchars = g_utf8_strlen(w2, -1);
+static gboolean on_prev_conflict(GtkWidget *widget, GVariant *args, gpointer user_data) {
+    return jump_to_conflict(widget, user_data, FALSE);
+}
 
-        gboolean highlight = TRUE;
-        if (word_index < (gint)words1->len) {
-            gchar *w1 = g_ptr_array_index(words1, word_index);
-            if (g_strcmp0(w1, w2) == 0) highlight = FALSE;
+static void on_merge_save_finish(GObject *source, GAsyncResult *res, gpointer user_data) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(user_data);
+    GError *error = NULL;
+    GFile *file = gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source), res, &error);
+    if (file) {
+        GtkTextIter start, end;
+        gtk_text_buffer_get_bounds(buffer, &start, &end);
+        gchar *text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+        if (!g_file_replace_contents(file, text, strlen(text), NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error)) {
+            g_printerr("Could not save merge result: %s\n", error ? error->message : "unknown error");
         }
+        g_free(text);
+        g_object_unref(file);
+    }
+    /* Cancelling the dialog also reports an error; nothing to say about that */
+    g_clear_error(&error);
+    g_object_unref(buffer);
+    g_object_unref(source);
+}
 
-        if (highlight && wchars > 0) {
-            GtkTextIter s, e;
-            gtk_text_buffer_get_iter_at_offset(buffer2, &s, latest_offset);
-            gtk_text_buffer_get_iter_at_offset(buffer2, &e, latest_offset + wchars);
-            gtk_text_buffer_apply_tag_by_name(buffer2, "diff-insert", &s, &e);
-        }
+static void on_merge_save_clicked(GtkButton *button, gpointer user_data) {
+    GtkTextView *view = GTK_TEXT_VIEW(user_data);
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Save Merge Result");
+    gtk_file_dialog_save(dialog, GTK_WINDOW(gtk_widget_get_root(GTK_WIDGET(view))), NULL,
+                         on_merge_save_finish, g_object_ref(gtk_text_view_get_buffer(view)));
+}
 
-        latest_offset += wchars;
-        word_index++;
-        g_free(w2);
-    }
+void create_merge_window(GtkWindow* parent, const char* base_path, const char* left_path, const char* right_path) {
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(window), "Merge Versions");
+    gtk_window_set_default_size(GTK_WINDOW(window), 1000, 800);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
 
-    g_ptr_array_free(words1, TRUE);
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gchar *base_name = g_path_get_basename(base_path);
+    gchar *left_name = g_path_get_basename(left_path);
+    gchar *right_name = g_path_get_basename(right_path);
+    gchar *heading = g_strdup_printf("%s and %s, from %s", left_name, right_name, base_name);
+    GtkWidget *header = gtk_label_new(heading);
+    gtk_widget_set_halign(header, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(header, 10);
+    gtk_widget_set_margin_top(header, 5);
+    gtk_widget_set_margin_bottom(header, 5);
+    gtk_box_append(GTK_BOX(vbox), header);
+    g_free(heading);
+    g_free(base_name);
+    g_free(left_name);
+    g_free(right_name);
 
-    g_free(contents1);
-    g_free(contents2);
+    GtkWidget *view = gtk_text_view_new();
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(view), GTK_WRAP_WORD_CHAR);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+    gtk_text_buffer_create_tag(buffer, "merge-conflict", "paragraph-background", "#fff1c2", NULL);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), view);
+    gtk_box_append(GTK_BOX(vbox), scrolled);
+
+    GtkWidget *bottom = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_widget_set_margin_start(bottom, 10);
+    gtk_widget_set_margin_end(bottom, 10);
+    gtk_widget_set_margin_top(bottom, 5);
+    gtk_widget_set_margin_bottom(bottom, 5);
+    GtkWidget *status = gtk_label_new("Merging…");
+    gtk_widget_set_hexpand(status, TRUE);
+    gtk_widget_set_halign(status, GTK_ALIGN_START);
+    gtk_box_append(GTK_BOX(bottom), status);
+    GtkWidget *save = gtk_button_new_with_label("Save As…");
+    g_signal_connect(save, "clicked", G_CALLBACK(on_merge_save_clicked), view);
+    gtk_box_append(GTK_BOX(bottom), save);
+    gtk_box_append(GTK_BOX(vbox), bottom);
+    gtk_window_set_child(GTK_WINDOW(window), vbox);
+
+    GtkEventController *controller = gtk_shortcut_controller_new();
+    gtk_event_controller_set_propagation_phase(controller, GTK_PHASE_CAPTURE);
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(controller),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Alt>Down|F7"),
+                         gtk_callback_action_new(on_next_conflict, view, NULL)));
+    gtk_shortcut_controller_add_shortcut(GTK_SHORTCUT_CONTROLLER(controller),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Alt>Up|<Shift>F7"),
+                         gtk_callback_action_new(on_prev_conflict, view, NULL)));
+    gtk_widget_add_controller(window, controller);
 
     gtk_window_present(GTK_WINDOW(window));
+
+    MergeJob *job = g_new0(MergeJob, 1);
+    job->paths[MERGE_BASE] = g_strdup(base_path);
+    job->paths[MERGE_LEFT] = g_strdup(left_path);
+    job->paths[MERGE_RIGHT] = g_strdup(right_path);
+    job->conflicts = g_array_new(FALSE, FALSE, sizeof(guint));
+    GTask *task = g_task_new(view, NULL, on_merge_ready, g_object_ref(status));
+    g_task_set_task_data(task, job, (GDestroyNotify)merge_job_free);
+    g_task_run_in_thread(task, merge_thread);
+    g_object_unref(task);
 }
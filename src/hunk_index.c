@@ -0,0 +1,88 @@
+#include "hunk_index.h"
+
+static void merge_hunks(GArray *hunks) {
+    if (hunks->len < 2) return;
+    guint out = 0;
+    for (guint i = 1; i < hunks->len; ++i) {
+        DiffHunk *last = &g_array_index(hunks, DiffHunk, out);
+        DiffHunk *h = &g_array_index(hunks, DiffHunk, i);
+        if (h->right_start < last->right_end) {
+            last->right_end = MAX(last->right_end, h->right_end);
+            last->left_start = MIN(last->left_start, h->left_start);
+            last->left_end = MAX(last->left_end, h->left_end);
+        } else {
+            g_array_index(hunks, DiffHunk, ++out) = *h;
+        }
+    }
+    g_array_set_size(hunks, out + 1);
+}
+
+static void fill_buckets(HunkIndex *index) {
+    index->buckets = g_new0(guint8, MAX(index->n_buckets, 1));
+    if (index->right_lines == 0 || index->n_buckets == 0) return;
+
+    /* Count changed lines per bucket, then scale by the bucket's size */
+    guint64 *changed = g_new0(guint64, index->n_buckets);
+    for (guint i = 0; i < index->hunks->len; ++i) {
+        DiffHunk *h = &g_array_index(index->hunks, DiffHunk, i);
+        guint start = MIN(h->right_start, index->right_lines);
+        guint end = MIN(MAX(h->right_end, start + 1), index->right_lines);
+        /* Walk bucket by bucket, not line by line */
+        while (start < end) {
+            guint b = (guint)((guint64)start * index->n_buckets / index->right_lines);
+            guint bucket_end = (guint)(((guint64)(b + 1) * index->right_lines + index->n_buckets - 1) / index->n_buckets);
+            guint stop = MIN(end, MAX(bucket_end, start + 1));
+            changed[b] += stop - start;
+            start = stop;
+        }
+    }
+    /* Line l falls in bucket l * n_buckets / right_lines, so bucket b spans
+     * [ceil(b * right_lines / n_buckets), ceil((b + 1) * right_lines / n_buckets)) */
+    for (guint b = 0; b < index->n_buckets; ++b) {
+        guint64 first = ((guint64)b * index->right_lines + index->n_buckets - 1) / index->n_buckets;
+        guint64 last = ((guint64)(b + 1) * index->right_lines + index->n_buckets - 1) / index->n_buckets;
+        guint64 size = MAX(last - first, 1);
+        if (changed[b]) index->buckets[b] = (guint8)MAX(1, MIN(255, changed[b] * 255 / size));
+    }
+    g_free(changed);
+}
+
+HunkIndex *hunk_index_new(GArray *hunks, guint left_lines, guint right_lines, guint n_buckets) {
+    HunkIndex *index = g_new0(HunkIndex, 1);
+    index->hunks = hunks ? hunks : g_array_new(FALSE, FALSE, sizeof(DiffHunk));
+    index->left_lines = left_lines;
+    index->right_lines = right_lines;
+    index->n_buckets = n_buckets;
+    merge_hunks(index->hunks);
+    fill_buckets(index);
+    return index;
+}
+
+void hunk_index_free(HunkIndex *index) {
+    if (!index) return;
+    g_array_unref(index->hunks);
+    g_free(index->buckets);
+    g_free(index);
+}
+
+int hunk_index_next(const HunkIndex *index, guint right_line) {
+    /* Lower bound on right_start > right_line */
+    guint lo = 0, hi = index->hunks->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(index->hunks, DiffHunk, mid).right_start <= right_line) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < index->hunks->len ? (int)lo : -1;
+}
+
+int hunk_index_prev(const HunkIndex *index, guint right_line) {
+    /* Lower bound on right_start >= right_line, then step back one */
+    guint lo = 0, hi = index->hunks->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(index->hunks, DiffHunk, mid).right_start < right_line) lo = mid + 1;
+        else hi = mid;
+    }
+    return (int)lo - 1;
+}
@@ -0,0 +1,145 @@
+#include "incremental_diff.h"
+
+/*
+ * Internally the unchanged side is "fixed" (f) and the changed side "edited"
+ * (e). INSERT means a run only on the edited side, DELETE only on the fixed
+ * side. For DIFF_SIDE_RIGHT this is the usual left/right meaning; for
+ * DIFF_SIDE_LEFT the sides and the two types are swapped on the way in and out.
+ */
+typedef struct {
+    DiffOpType type;
+    guint f_start;
+    guint e_start;
+    guint length;
+} SideEdit;
+
+static DiffOpType swap_type(DiffOpType type) {
+    if (type == DIFF_OP_INSERT) return DIFF_OP_DELETE;
+    if (type == DIFF_OP_DELETE) return DIFF_OP_INSERT;
+    return type;
+}
+
+static SideEdit to_side(const DiffEdit *edit, DiffSide side) {
+    SideEdit s;
+    if (side == DIFF_SIDE_RIGHT) {
+        s.type = edit->type;
+        s.f_start = edit->left_start;
+        s.e_start = edit->right_start;
+    } else {
+        s.type = swap_type(edit->type);
+        s.f_start = edit->right_start;
+        s.e_start = edit->left_start;
+    }
+    s.length = edit->length;
+    return s;
+}
+
+/* Line after a run on the edited side; runs only on the fixed side end where they start */
+static guint edited_end(const DiffEdit *edit, DiffSide side) {
+    SideEdit r = to_side(edit, side);
+    return r.e_start + (r.type == DIFF_OP_DELETE ? 0 : r.length);
+}
+
+static void append_side(GArray *out, DiffSide side, DiffOpType type, guint f_start, guint e_start, guint length) {
+    if (side == DIFF_SIDE_RIGHT) diff_edits_append(out, type, f_start, e_start, length);
+    else diff_edits_append(out, swap_type(type), e_start, f_start, length);
+}
+
+GArray *incremental_diff(const GArray *previous, const LineTable *left, const LineTable *right,
+                         DiffSide side, const LineEdit *edits, guint n_edits) {
+    const LineTable *fixed = side == DIFF_SIDE_RIGHT ? left : right;
+    const LineTable *edited = side == DIFF_SIDE_RIGHT ? right : left;
+    GArray *out = g_array_new(FALSE, FALSE, sizeof(DiffEdit));
+
+    if (n_edits == 0) {
+        g_array_append_vals(out, previous->data, previous->len);
+        return out;
+    }
+
+    /* One window [ws, we) in old edited lines covering every edit; shift is the net line change */
+    guint ws = G_MAXUINT, we = 0;
+    gint64 shift = 0;
+    for (guint i = 0; i < n_edits; ++i) {
+        ws = MIN(ws, edits[i].start);
+        we = MAX(we, edits[i].start + edits[i].old_lines);
+        shift += (gint64)edits[i].new_lines - (gint64)edits[i].old_lines;
+    }
+
+    /* Grow the window over changed runs it touches, so it starts and ends where
+     * the previous script had both sides in step. Runs are in order on both
+     * sides, so the touched runs are one stretch: bisect to its first run, walk
+     * forward over it, then back over any run ending where it now starts. */
+    guint lo = 0, hi = previous->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (edited_end(&g_array_index(previous, DiffEdit, mid), side) < ws) lo = mid + 1;
+        else hi = mid;
+    }
+    for (guint i = lo; i < previous->len; ++i) {
+        SideEdit r = to_side(&g_array_index(previous, DiffEdit, i), side);
+        if (r.e_start > we) break;
+        if (r.type == DIFF_OP_EQUAL) continue;
+        ws = MIN(ws, r.e_start);
+        we = MAX(we, r.e_start + (r.type == DIFF_OP_INSERT ? r.length : 0));
+    }
+    for (guint i = lo; i > 0; --i) {
+        SideEdit r = to_side(&g_array_index(previous, DiffEdit, i - 1), side);
+        if (edited_end(&g_array_index(previous, DiffEdit, i - 1), side) < ws) break;
+        if (r.type != DIFF_OP_EQUAL) ws = MIN(ws, r.e_start);
+    }
+
+    /* Keep what lies before ws, set aside what lies at or after we; f_sync/f_end
+     * are the fixed-side lines where the kept parts stop and resume */
+    GArray *tail = g_array_new(FALSE, FALSE, sizeof(SideEdit));
+    guint f_sync = 0, f_end = fixed->n_lines;
+    for (guint i = 0; i < previous->len; ++i) {
+        SideEdit r = to_side(&g_array_index(previous, DiffEdit, i), side);
+
+        if (r.type == DIFF_OP_DELETE) {
+            if (r.e_start < ws) {
+                append_side(out, side, r.type, r.f_start, r.e_start, r.length);
+                f_sync = MAX(f_sync, r.f_start + r.length);
+            } else if (r.e_start >= we) {
+                SideEdit t = { r.type, r.f_start, (guint)(r.e_start + shift), r.length };
+                g_array_append_val(tail, t);
+                f_end = MIN(f_end, r.f_start);
+            }
+            continue;
+        }
+
+        guint f_step = r.type == DIFF_OP_EQUAL ? 1 : 0;
+        if (r.e_start < ws) {
+            guint pre = MIN(r.length, ws - r.e_start);
+            append_side(out, side, r.type, r.f_start, r.e_start, pre);
+            f_sync = MAX(f_sync, r.f_start + pre * f_step);
+        }
+        guint post = MAX(we, r.e_start);
+        if (post < r.e_start + r.length) {
+            guint skip = post - r.e_start;
+            SideEdit t = { r.type, r.f_start + skip * f_step, (guint)(post + shift), r.length - skip };
+            g_array_append_val(tail, t);
+            f_end = MIN(f_end, t.f_start);
+        }
+    }
+    f_end = MAX(f_end, f_sync);
+
+    /* Rediff the window against the current texts */
+    guint e_from = ws;
+    guint e_to = (guint)(we + shift);
+    const guint64 *fh = &g_array_index(fixed->hashes, guint64, 0);
+    const guint64 *eh = &g_array_index(edited->hashes, guint64, 0);
+    GArray *window = myers_diff_sequence(fh + f_sync, f_end - f_sync, eh + e_from, e_to - e_from);
+    for (guint i = 0; i < window->len; ++i) {
+        DiffEdit *w = &g_array_index(window, DiffEdit, i);
+        /* myers_diff_sequence is fixed (a) against edited (b), so types are already side-relative */
+        append_side(out, side, w->type, w->left_start + f_sync, w->right_start + e_from, w->length);
+    }
+    g_array_unref(window);
+
+    for (guint i = 0; i < tail->len; ++i) {
+        SideEdit *t = &g_array_index(tail, SideEdit, i);
+        append_side(out, side, t->type, t->f_start, t->e_start, t->length);
+    }
+    g_array_unref(tail);
+    return out;
+}
@@ -0,0 +1,632 @@
+#include "large_file_view.h"
+#include "line_table.h"
+#include "myers_diff.h"
+#include <string.h>
+
+/* Upper bound on the number of stored line offsets, whatever the file size */
+#define LINE_INDEX_CHECKPOINTS 65536
+/* Lines longer than this are cut when drawn */
+#define MAX_DRAWN_LINE_BYTES 4096
+/* Past the common prefix, lines hashed per side to line the two files up; more falls back to line numbers */
+#define ALIGN_MAX_LINES (4u * 1024 * 1024)
+/* Edits the alignment may need; past this the diff would take too long and line numbers are used */
+#define ALIGN_MAX_EDITS 8192
+
+/* Offsets of every 'stride'-th line start; other lines are found by scanning forward */
+typedef struct {
+    guint64 n_lines;
+    guint64 stride;
+    guint64 *checkpoints;
+    guint n_checkpoints;
+} LineIndex;
+
+#define ALIGN_BOTH 3
+
+/* Rows row..row + length - 1 of both panes; a side missing from 'present' shows gaps there */
+typedef struct {
+    guint64 row;
+    guint64 line[2];    /* first line of the run on each side */
+    guint64 length;
+    guint present;      /* bit i set: side i has lines in the run */
+} AlignRun;
+
+/* How a view and its peer line up, shared by both (g_atomic_rc_box) */
+typedef struct {
+    GArray *runs;       /* AlignRun, in row order */
+    guint64 n_rows;
+} LineAlignment;
+
+enum {
+    SIGNAL_COMPARED,
+    N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+struct _LargeFileView {
+    GtkWidget parent_instance;
+
+    GMappedFile *mapped;
+    const char *data;
+    gsize length;
+    LineIndex *index;          /* NULL until the worker finished */
+    GCancellable *cancellable;
+
+    LargeFileView *peer;
+    LineAlignment *alignment;  /* NULL: compared by line number */
+    int side;                  /* this view's side in the alignment */
+
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+    guint hscroll_policy : 1;
+    guint vscroll_policy : 1;
+
+    PangoLayout *layout;       /* reused for every drawn line */
+    int line_height;
+    int max_width;             /* widest line drawn so far */
+};
+
+enum {
+    PROP_0,
+    PROP_HADJUSTMENT,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY
+};
+
+G_DEFINE_FINAL_TYPE_WITH_CODE(LargeFileView, large_file_view, GTK_TYPE_WIDGET,
+                              G_IMPLEMENT_INTERFACE(GTK_TYPE_SCROLLABLE, NULL))
+
+static void line_index_free(LineIndex *index) {
+    if (!index) return;
+    g_free(index->checkpoints);
+    g_free(index);
+}
+
+static void line_alignment_clear(LineAlignment *alignment) {
+    g_array_unref(alignment->runs);
+}
+
+static void line_alignment_unref(LineAlignment *alignment) {
+    g_atomic_rc_box_release_full(alignment, (GDestroyNotify)line_alignment_clear);
+}
+
+// ---
+// --- Line index
+// ---
+
+static LineIndex *line_index_build(const char *data, gsize length, GCancellable *cancellable) {
+    LineIndex *index = g_new0(LineIndex, 1);
+
+    /* Pass 1: count lines, so the stride can be chosen to fit the checkpoint budget */
+    const char *p = data, *end = data + length;
+    guint64 newlines = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) break;
+        newlines++;
+        p = nl + 1;
+        if ((newlines & 0xFFFFF) == 0 && g_cancellable_is_cancelled(cancellable)) {
+            line_index_free(index);
+            return NULL;
+        }
+    }
+    index->n_lines = newlines + (length > 0 && data[length - 1] != '\n' ? 1 : 0);
+    index->stride = index->n_lines / LINE_INDEX_CHECKPOINTS + 1;
+    index->n_checkpoints = (guint)((index->n_lines + index->stride - 1) / index->stride);
+    index->checkpoints = g_new(guint64, MAX(index->n_checkpoints, 1));
+
+    /* Pass 2: record the start of every stride-th line */
+    guint64 line = 0;
+    guint cp = 0;
+    p = data;
+    while (cp < index->n_checkpoints) {
+        if (line % index->stride == 0) index->checkpoints[cp++] = (guint64)(p - data);
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) break;
+        p = nl + 1;
+        line++;
+        if ((line & 0xFFFFF) == 0 && g_cancellable_is_cancelled(cancellable)) {
+            line_index_free(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+/* Locate line 'line'. Returns FALSE if out of range. *len excludes the newline. */
+static gboolean get_line(LargeFileView *self, guint64 line, const char **start, gsize *len) {
+    if (!self->index || line >= self->index->n_lines) return FALSE;
+    const char *end = self->data + self->length;
+    const char *p = self->data + self->index->checkpoints[line / self->index->stride];
+    for (guint64 skip = line % self->index->stride; skip > 0; --skip) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) return FALSE;
+        p = nl + 1;
+    }
+    const char *nl = memchr(p, '\n', end - p);
+    *start = p;
+    *len = (nl ? nl : end) - p;
+    return TRUE;
+}
+
+/* Step from a line to the next one without going back to the index */
+static gboolean next_line(LargeFileView *self, const char **start, gsize *len) {
+    const char *end = self->data + self->length;
+    const char *p = *start + *len;
+    if (p >= end) return FALSE;
+    p++; /* skip '\n' */
+    if (p >= end) return FALSE;
+    const char *nl = memchr(p, '\n', end - p);
+    *start = p;
+    *len = (nl ? nl : end) - p;
+    return TRUE;
+}
+
+// ---
+// --- Scrolling
+// ---
+
+static guint64 total_lines(LargeFileView *self) {
+    if (self->alignment) return self->alignment->n_rows;
+    guint64 n = self->index ? self->index->n_lines : 0;
+    if (self->peer && self->peer->index) n = MAX(n, self->peer->index->n_lines);
+    return n;
+}
+
+static void update_adjustments(LargeFileView *self) {
+    int width = gtk_widget_get_width(GTK_WIDGET(self));
+    int height = gtk_widget_get_height(GTK_WIDGET(self));
+    int line_h = MAX(self->line_height, 1);
+
+    if (self->vadjustment) {
+        double upper = (double)total_lines(self) * line_h;
+        double value = gtk_adjustment_get_value(self->vadjustment);
+        value = CLAMP(value, 0, MAX(upper - height, 0));
+        gtk_adjustment_configure(self->vadjustment, value, 0, MAX(upper, height),
+                                 line_h, height * 0.9, height);
+    }
+    if (self->hadjustment) {
+        double upper = MAX(self->max_width, width);
+        double value = CLAMP(gtk_adjustment_get_value(self->hadjustment), 0, MAX(upper - width, 0));
+        gtk_adjustment_configure(self->hadjustment, value, 0, upper, line_h, width * 0.9, width);
+    }
+}
+
+static void on_adjustment_value_changed(GtkAdjustment *adjustment, gpointer user_data) {
+    gtk_widget_queue_draw(GTK_WIDGET(user_data));
+}
+
+static void set_adjustment(LargeFileView *self, GtkAdjustment **slot, GtkAdjustment *adjustment) {
+    if (*slot == adjustment && adjustment) return;
+    if (*slot) {
+        g_signal_handlers_disconnect_by_func(*slot, on_adjustment_value_changed, self);
+        g_object_unref(*slot);
+    }
+    if (!adjustment) adjustment = gtk_adjustment_new(0, 0, 0, 0, 0, 0);
+    *slot = g_object_ref_sink(adjustment);
+    g_signal_connect(adjustment, "value-changed", G_CALLBACK(on_adjustment_value_changed), self);
+    update_adjustments(self);
+}
+
+// ---
+// --- Drawing
+// ---
+
+static void draw_line(LargeFileView *self, GtkSnapshot *snapshot, const char *start, gsize len, int y, double left,
+                      const GdkRGBA *fg, int *widest) {
+    gsize draw_len = MIN(len, MAX_DRAWN_LINE_BYTES);
+    if (draw_len > 0 && start[draw_len - 1] == '\r') draw_len--;
+    /* Mapped files may hold anything; Pango needs valid UTF-8 */
+    gchar *text = g_utf8_make_valid(start, (gssize)draw_len);
+    pango_layout_set_text(self->layout, text, -1);
+    g_free(text);
+    int w;
+    pango_layout_get_pixel_size(self->layout, &w, NULL);
+    *widest = MAX(*widest, w);
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_translate(snapshot, &GRAPHENE_POINT_INIT((float)-left, y));
+    gtk_snapshot_append_layout(snapshot, self->layout, fg);
+    gtk_snapshot_restore(snapshot);
+}
+
+/* The run holding 'row' (the last one if row is past the end) */
+static guint find_run(const LineAlignment *alignment, guint64 row) {
+    guint lo = 0, hi = alignment->runs->len;
+    while (hi - lo > 1) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(alignment->runs, AlignRun, mid).row <= row) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static const GdkRGBA changed_bg = { 0.90, 0.30, 0.30, 0.25 };
+static const GdkRGBA gap_bg = { 0.50, 0.50, 0.50, 0.12 };
+
+/* Rows from the alignment: the lines of runs this side is missing from are drawn as gaps */
+static void snapshot_aligned(LargeFileView *self, GtkSnapshot *snapshot, guint64 first, int y, int width,
+                             int height, double left, const GdkRGBA *fg, int *widest) {
+    const LineAlignment *alignment = self->alignment;
+    int line_h = MAX(self->line_height, 1);
+    guint own = 1u << self->side;
+    guint r = find_run(alignment, first);
+    guint64 row = first;
+    const char *start = NULL;
+    gsize len = 0;
+    gboolean have = FALSE;  /* start/len hold the last line drawn; own lines follow on across runs */
+    for (; y < height && r < alignment->runs->len; y += line_h) {
+        const AlignRun *run = &g_array_index(alignment->runs, AlignRun, r);
+        if (run->present & own) {
+            have = have ? next_line(self, &start, &len)
+                        : get_line(self, run->line[self->side] + (row - run->row), &start, &len);
+            if (!have) break;
+            if (run->present != ALIGN_BOTH) {
+                gtk_snapshot_append_color(snapshot, &changed_bg, &GRAPHENE_RECT_INIT(0, y, width, line_h));
+            }
+            draw_line(self, snapshot, start, len, y, left, fg, widest);
+        } else {
+            gtk_snapshot_append_color(snapshot, &gap_bg, &GRAPHENE_RECT_INIT(0, y, width, line_h));
+        }
+        if (++row >= run->row + run->length) r++;
+    }
+}
+
+static void large_file_view_snapshot(GtkWidget *widget, GtkSnapshot *snapshot) {
+    LargeFileView *self = LARGE_FILE_VIEW(widget);
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    GdkRGBA fg;
+    gtk_widget_get_color(widget, &fg);
+
+    if (!self->index) {
+        pango_layout_set_text(self->layout, self->mapped ? "Indexing…" : "", -1);
+        gtk_snapshot_append_layout(snapshot, self->layout, &fg);
+        return;
+    }
+
+    int line_h = MAX(self->line_height, 1);
+    double top = self->vadjustment ? gtk_adjustment_get_value(self->vadjustment) : 0;
+    double left = self->hadjustment ? gtk_adjustment_get_value(self->hadjustment) : 0;
+    guint64 first = (guint64)(top / line_h);
+    int y = (int)(first * line_h - top);
+
+    int widest = self->max_width;
+    gtk_snapshot_push_clip(snapshot, &GRAPHENE_RECT_INIT(0, 0, width, height));
+    if (self->alignment) {
+        snapshot_aligned(self, snapshot, first, y, width, height, left, &fg, &widest);
+    } else {
+        /* Not lined up (yet): a line differs if the peer's line with the same number is missing or different */
+        const char *start = NULL, *peer_start = NULL;
+        gsize len = 0, peer_len = 0;
+        gboolean have = get_line(self, first, &start, &len);
+        gboolean peer_have = self->peer ? get_line(self->peer, first, &peer_start, &peer_len) : FALSE;
+        for (; y < height && (have || peer_have); y += line_h) {
+            gboolean differs = self->peer && self->peer->index &&
+                               (have != peer_have || (have && (len != peer_len || memcmp(start, peer_start, len) != 0)));
+            if (differs && have) {
+                gtk_snapshot_append_color(snapshot, &changed_bg, &GRAPHENE_RECT_INIT(0, y, width, line_h));
+            }
+            if (have) {
+                draw_line(self, snapshot, start, len, y, left, &fg, &widest);
+                have = next_line(self, &start, &len);
+            }
+            if (peer_have) peer_have = next_line(self->peer, &peer_start, &peer_len);
+        }
+    }
+    gtk_snapshot_pop(snapshot);
+
+    if (widest > self->max_width) {
+        /* Grow the horizontal range lazily as wider lines scroll into view */
+        self->max_width = widest;
+        update_adjustments(self);
+    }
+}
+
+static void large_file_view_size_allocate(GtkWidget *widget, int width, int height, int baseline) {
+    update_adjustments(LARGE_FILE_VIEW(widget));
+}
+
+static void large_file_view_measure(GtkWidget *widget, GtkOrientation orientation, int for_size,
+                                    int *minimum, int *natural, int *minimum_baseline, int *natural_baseline) {
+    LargeFileView *self = LARGE_FILE_VIEW(widget);
+    *minimum = 0;
+    *natural = orientation == GTK_ORIENTATION_HORIZONTAL ? 400 : self->line_height * 40;
+}
+
+// ---
+// --- Loading
+// ---
+
+static void index_build_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    GMappedFile *mapped = (GMappedFile *)task_data;
+    LineIndex *index = line_index_build(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped),
+                                        cancellable);
+    if (!index) {
+        g_task_return_error_if_cancelled(task);
+        return;
+    }
+    g_task_return_pointer(task, index, (GDestroyNotify)line_index_free);
+}
+
+/* Both files of a pair, as they were when the alignment was started */
+typedef struct {
+    GMappedFile *mapped[2];
+    guint64 n_lines[2];
+} AlignJob;
+
+static void align_job_free(AlignJob *job) {
+    for (int i = 0; i < 2; ++i) g_mapped_file_unref(job->mapped[i]);
+    g_free(job);
+}
+
+static void add_run(LineAlignment *alignment, guint present, guint64 line0, guint64 line1, guint64 length) {
+    if (length == 0) return;
+    AlignRun run = { alignment->n_rows, { line0, line1 }, length, present };
+    g_array_append_val(alignment->runs, run);
+    alignment->n_rows += length;
+}
+
+/* Hashes of n lines from p on; the end of the last one is left in *p */
+static guint64 *hash_lines(const char **p, const char *end, guint n) {
+    guint64 *hashes = g_new(guint64, MAX(n, 1));
+    for (guint i = 0; i < n; ++i) {
+        const char *nl = memchr(*p, '\n', end - *p);
+        const char *line_end = nl ? nl : end;
+        hashes[i] = line_table_hash(*p, line_end - *p);
+        *p = nl ? nl + 1 : end;
+    }
+    return hashes;
+}
+
+/* Line the two files up with a line diff. The common prefix is skipped by comparing bytes, so an
+ * appended tail or a local edit costs only the lines after it; returns NULL if the rest is too big
+ * or too different, and the pair is then compared by line number. */
+static void align_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    AlignJob *job = task_data;
+    const char *p[2], *end[2];
+    for (int i = 0; i < 2; ++i) {
+        p[i] = g_mapped_file_get_contents(job->mapped[i]);
+        end[i] = p[i] + g_mapped_file_get_length(job->mapped[i]);
+    }
+
+    guint64 prefix = 0;
+    while (prefix < job->n_lines[0] && prefix < job->n_lines[1]) {
+        const char *nl0 = memchr(p[0], '\n', end[0] - p[0]);
+        const char *nl1 = memchr(p[1], '\n', end[1] - p[1]);
+        gsize len0 = (nl0 ? nl0 : end[0]) - p[0], len1 = (nl1 ? nl1 : end[1]) - p[1];
+        if (len0 != len1 || memcmp(p[0], p[1], len0) != 0) break;
+        p[0] = nl0 ? nl0 + 1 : end[0];
+        p[1] = nl1 ? nl1 + 1 : end[1];
+        if ((++prefix & 0xFFFFF) == 0 && g_task_return_error_if_cancelled(task)) return;
+    }
+
+    guint64 rest0 = job->n_lines[0] - prefix, rest1 = job->n_lines[1] - prefix;
+    if (rest0 > ALIGN_MAX_LINES || rest1 > ALIGN_MAX_LINES) {
+        g_task_return_pointer(task, NULL, NULL);
+        return;
+    }
+    guint64 *a = hash_lines(&p[0], end[0], (guint)rest0);
+    guint64 *b = hash_lines(&p[1], end[1], (guint)rest1);
+    LineAlignment *alignment = NULL;
+    guint inserted, deleted;
+    if (!g_cancellable_is_cancelled(cancellable) &&
+        myers_diff_stats(a, (guint)rest0, b, (guint)rest1, ALIGN_MAX_EDITS, &inserted, &deleted)) {
+        GArray *script = myers_diff_sequence(a, (guint)rest0, b, (guint)rest1);
+        alignment = g_atomic_rc_box_new0(LineAlignment);
+        alignment->runs = g_array_sized_new(FALSE, FALSE, sizeof(AlignRun), script->len + 1);
+        add_run(alignment, ALIGN_BOTH, 0, 0, prefix);
+        for (guint i = 0; i < script->len; ++i) {
+            const DiffEdit *e = &g_array_index(script, DiffEdit, i);
+            guint present = e->type == DIFF_OP_EQUAL ? ALIGN_BOTH : e->type == DIFF_OP_DELETE ? 1 : 2;
+            add_run(alignment, present, prefix + e->left_start, prefix + e->right_start, e->length);
+        }
+        g_array_unref(script);
+    }
+    g_free(a);
+    g_free(b);
+    if (g_task_return_error_if_cancelled(task)) {
+        if (alignment) line_alignment_unref(alignment);
+        return;
+    }
+    g_task_return_pointer(task, alignment, (GDestroyNotify)line_alignment_unref);
+}
+
+static void set_alignment(LargeFileView *self, LineAlignment *alignment, int side) {
+    if (self->alignment) line_alignment_unref(self->alignment);
+    self->alignment = alignment ? g_atomic_rc_box_acquire(alignment) : NULL;
+    self->side = side;
+    update_adjustments(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void on_aligned(GObject *source, GAsyncResult *res, gpointer user_data) {
+    LargeFileView *self = LARGE_FILE_VIEW(source);
+    AlignJob *job = g_task_get_task_data(G_TASK(res));
+    GError *error = NULL;
+    LineAlignment *alignment = g_task_propagate_pointer(G_TASK(res), &error);
+    /* Dropped if either side was reloaded or unpaired meanwhile */
+    gboolean current = !error && self->peer && self->mapped == job->mapped[0] && self->peer->mapped == job->mapped[1];
+    g_clear_error(&error);
+    if (current) {
+        LargeFileView *peer = self->peer;
+        set_alignment(self, alignment, 0);
+        set_alignment(peer, alignment, 1);
+        g_signal_emit(self, signals[SIGNAL_COMPARED], 0, alignment != NULL);
+        g_signal_emit(peer, signals[SIGNAL_COMPARED], 0, alignment != NULL);
+    }
+    if (alignment) line_alignment_unref(alignment);
+}
+
+/* Once both sides are indexed, line them up in a worker; until then lines are compared by number */
+static void start_alignment(LargeFileView *self) {
+    LargeFileView *peer = self->peer;
+    if (!peer || !self->index || !peer->index) return;
+    AlignJob *job = g_new0(AlignJob, 1);
+    job->mapped[0] = g_mapped_file_ref(self->mapped);
+    job->mapped[1] = g_mapped_file_ref(peer->mapped);
+    job->n_lines[0] = self->index->n_lines;
+    job->n_lines[1] = peer->index->n_lines;
+    GTask *task = g_task_new(self, self->cancellable, on_aligned, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)align_job_free);
+    g_task_run_in_thread(task, align_thread);
+    g_object_unref(task);
+}
+
+/* Back to comparing by line number, on both sides */
+static void drop_alignment(LargeFileView *self) {
+    if (self->alignment) set_alignment(self, NULL, 0);
+    if (self->peer && self->peer->alignment) set_alignment(self->peer, NULL, 0);
+}
+
+static void on_index_built(GObject *source, GAsyncResult *res, gpointer user_data) {
+    LargeFileView *self = LARGE_FILE_VIEW(source);
+    LineIndex *index = g_task_propagate_pointer(G_TASK(res), NULL);
+    if (!index) return;
+    line_index_free(self->index);
+    self->index = index;
+    update_adjustments(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+    if (self->peer) {
+        /* The peer's highlighting and scroll range depend on our line count */
+        update_adjustments(self->peer);
+        gtk_widget_queue_draw(GTK_WIDGET(self->peer));
+        start_alignment(self);
+    }
+}
+
+gboolean large_file_view_load(LargeFileView *self, const char *path, GError **error) {
+    g_return_val_if_fail(LARGE_IS_FILE_VIEW(self), FALSE);
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, error);
+    if (!mapped) return FALSE;
+
+    g_cancellable_cancel(self->cancellable);
+    g_object_unref(self->cancellable);
+    self->cancellable = g_cancellable_new();
+    line_index_free(self->index);
+    self->index = NULL;
+    drop_alignment(self);
+    if (self->mapped) g_mapped_file_unref(self->mapped);
+    self->mapped = mapped;
+    self->data = g_mapped_file_get_contents(mapped);
+    self->length = g_mapped_file_get_length(mapped);
+    self->max_width = 0;
+
+    GTask *task = g_task_new(self, self->cancellable, on_index_built, NULL);
+    g_task_set_task_data(task, g_mapped_file_ref(mapped), (GDestroyNotify)g_mapped_file_unref);
+    g_task_run_in_thread(task, index_build_thread);
+    g_object_unref(task);
+
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+    return TRUE;
+}
+
+void large_file_view_set_peer(LargeFileView *self, LargeFileView *peer) {
+    g_return_if_fail(LARGE_IS_FILE_VIEW(self));
+    drop_alignment(self);
+    self->peer = peer;
+    update_adjustments(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+    start_alignment(self);
+}
+
+// ---
+// --- GObject boilerplate
+// ---
+
+static void large_file_view_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+    LargeFileView *self = LARGE_FILE_VIEW(object);
+    switch (prop_id) {
+    case PROP_HADJUSTMENT:     g_value_set_object(value, self->hadjustment); break;
+    case PROP_VADJUSTMENT:     g_value_set_object(value, self->vadjustment); break;
+    case PROP_HSCROLL_POLICY:  g_value_set_enum(value, self->hscroll_policy); break;
+    case PROP_VSCROLL_POLICY:  g_value_set_enum(value, self->vscroll_policy); break;
+    default: G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void large_file_view_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+    LargeFileView *self = LARGE_FILE_VIEW(object);
+    switch (prop_id) {
+    case PROP_HADJUSTMENT: set_adjustment(self, &self->hadjustment, g_value_get_object(value)); break;
+    case PROP_VADJUSTMENT: set_adjustment(self, &self->vadjustment, g_value_get_object(value)); break;
+    case PROP_HSCROLL_POLICY:
+        self->hscroll_policy = g_value_get_enum(value);
+        gtk_widget_queue_resize(GTK_WIDGET(self));
+        break;
+    case PROP_VSCROLL_POLICY:
+        self->vscroll_policy = g_value_get_enum(value);
+        gtk_widget_queue_resize(GTK_WIDGET(self));
+        break;
+    default: G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void large_file_view_dispose(GObject *object) {
+    LargeFileView *self = LARGE_FILE_VIEW(object);
+    g_cancellable_cancel(self->cancellable);
+    drop_alignment(self);
+    if (self->peer && self->peer->peer == self) self->peer->peer = NULL;
+    self->peer = NULL;
+    if (self->hadjustment) {
+        g_signal_handlers_disconnect_by_func(self->hadjustment, on_adjustment_value_changed, self);
+        g_clear_object(&self->hadjustment);
+    }
+    if (self->vadjustment) {
+        g_signal_handlers_disconnect_by_func(self->vadjustment, on_adjustment_value_changed, self);
+        g_clear_object(&self->vadjustment);
+    }
+    g_clear_object(&self->layout);
+    G_OBJECT_CLASS(large_file_view_parent_class)->dispose(object);
+}
+
+static void large_file_view_finalize(GObject *object) {
+    LargeFileView *self = LARGE_FILE_VIEW(object);
+    line_index_free(self->index);
+    if (self->mapped) g_mapped_file_unref(self->mapped);
+    g_object_unref(self->cancellable);
+    G_OBJECT_CLASS(large_file_view_parent_class)->finalize(object);
+}
+
+static void large_file_view_class_init(LargeFileViewClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->get_property = large_file_view_get_property;
+    object_class->set_property = large_file_view_set_property;
+    object_class->dispose = large_file_view_dispose;
+    object_class->finalize = large_file_view_finalize;
+
+    widget_class->snapshot = large_file_view_snapshot;
+    widget_class->size_allocate = large_file_view_size_allocate;
+    widget_class->measure = large_file_view_measure;
+
+    g_object_class_override_property(object_class, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property(object_class, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property(object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property(object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+    gtk_widget_class_set_css_name(widget_class, "largefileview");
+
+    /* Emitted on both views of a pair once they are lined up (TRUE) or left compared by line number */
+    signals[SIGNAL_COMPARED] = g_signal_new("compared", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0, NULL,
+                                            NULL, NULL, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+}
+
+static void large_file_view_init(LargeFileView *self) {
+    self->cancellable = g_cancellable_new();
+    self->layout = gtk_widget_create_pango_layout(GTK_WIDGET(self), NULL);
+    PangoFontDescription *font = pango_font_description_from_string("monospace 11");
+    pango_layout_set_font_description(self->layout, font);
+    pango_font_description_free(font);
+
+    int h;
+    pango_layout_set_text(self->layout, "Mg", -1);
+    pango_layout_get_pixel_size(self->layout, NULL, &h);
+    self->line_height = MAX(h, 1);
+    gtk_widget_set_overflow(GTK_WIDGET(self), GTK_OVERFLOW_HIDDEN);
+}
+
+GtkWidget *large_file_view_new(void) {
+    return g_object_new(LARGE_TYPE_FILE_VIEW, NULL);
+}
@@ -0,0 +1,171 @@
+#include "line_table.h"
+#include <string.h>
+
+guint64 line_table_hash(const char *data, gsize length) {
+    guint64 h = G_GUINT64_CONSTANT(14695981039346656037);
+    for (gsize i = 0; i < length; ++i) {
+        h ^= (guchar)data[i];
+        h *= G_GUINT64_CONSTANT(1099511628211);
+    }
+    return h;
+}
+
+/* Append the lines of text[from, to) to offsets/hashes; 'to' must be a line end */
+static void scan_lines(const char *text, gsize from, gsize to, GArray *offsets, GArray *hashes) {
+    gsize pos = from;
+    while (pos < to) {
+        const char *nl = memchr(text + pos, '\n', to - pos);
+        gsize line_end = nl ? (gsize)(nl - text) + 1 : to;
+        guint64 h = line_table_hash(text + pos, line_end - pos);
+        g_array_append_val(offsets, pos);
+        g_array_append_val(hashes, h);
+        pos = line_end;
+    }
+}
+
+LineTable *line_table_new(const char *text, gsize length) {
+    LineTable *table = g_new0(LineTable, 1);
+    table->offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+    table->hashes = g_array_new(FALSE, FALSE, sizeof(guint64));
+    scan_lines(text, 0, length, table->offsets, table->hashes);
+    g_array_append_val(table->offsets, length);
+    table->n_lines = table->hashes->len;
+    return table;
+}
+
+static void drop_keys(LineTable *table) {
+    for (guint i = 0; i <= LINE_COMPARE_FLAGS_ALL; ++i) g_clear_pointer(&table->keys[i], g_array_unref);
+    g_clear_pointer(&table->non_blank, g_array_unref);
+}
+
+void line_table_free(LineTable *table) {
+    if (!table) return;
+    drop_keys(table);
+    g_array_unref(table->offsets);
+    g_array_unref(table->hashes);
+    g_free(table);
+}
+
+/* Largest i in [0, n_lines] with offsets[i] <= byte */
+static guint line_at(const LineTable *table, gsize byte) {
+    guint lo = 0, hi = table->n_lines + 1;
+    while (hi - lo > 1) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(table->offsets, gsize, mid) <= byte) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void line_table_splice(LineTable *table, const char *new_text, gsize new_length,
+                       gsize byte_start, gsize old_bytes, gsize new_bytes, LineEdit *edit) {
+    drop_keys(table);
+    /* Appending at the end may extend the last line, so rescan it */
+    guint first = line_at(table, byte_start);
+    if (first == table->n_lines && first > 0) first--;
+    /* The line holding the old end is affected too: deleting the '\n' before it joins them */
+    guint last = MIN(line_at(table, byte_start + old_bytes) + 1, table->n_lines);
+    last = MAX(last, first);
+
+    gsize from = g_array_index(table->offsets, gsize, first);
+    gsize to = last < table->n_lines
+        ? g_array_index(table->offsets, gsize, last) + new_bytes - old_bytes
+        : new_length;
+
+    GArray *offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+    GArray *hashes = g_array_new(FALSE, FALSE, sizeof(guint64));
+    scan_lines(new_text, from, to, offsets, hashes);
+
+    /* Shift the unchanged tail (including the end sentinel) */
+    for (guint i = last; i <= table->n_lines; ++i) {
+        gsize *o = &g_array_index(table->offsets, gsize, i);
+        *o = *o + new_bytes - old_bytes;
+    }
+    g_array_remove_range(table->offsets, first, last - first);
+    g_array_insert_vals(table->offsets, first, offsets->data, offsets->len);
+    g_array_remove_range(table->hashes, first, last - first);
+    g_array_insert_vals(table->hashes, first, hashes->data, hashes->len);
+    table->n_lines = table->hashes->len;
+
+    edit->start = first;
+    edit->old_lines = last - first;
+    edit->new_lines = hashes->len;
+    g_array_unref(offsets);
+    g_array_unref(hashes);
+}
+
+// ---
+// --- Normalized keys
+// ---
+
+/* line_table_hash() of the line as 'flags' see it, skipping bytes rather than building a copy */
+static guint64 normalized_hash(const char *data, gsize length, guint flags) {
+    if (flags & LINE_IGNORE_LINE_ENDING) {
+        if (length > 0 && data[length - 1] == '\n') length--;
+        if (length > 0 && data[length - 1] == '\r') length--;
+    }
+    guint64 h = G_GUINT64_CONSTANT(14695981039346656037);
+    for (gsize i = 0; i < length; ++i) {
+        guchar c = (guchar)data[i];
+        if ((flags & LINE_IGNORE_WHITESPACE) && g_ascii_isspace(c)) continue;
+        if (flags & LINE_IGNORE_CASE) c = (guchar)g_ascii_tolower(c);
+        h ^= c;
+        h *= G_GUINT64_CONSTANT(1099511628211);
+    }
+    return h;
+}
+
+static gboolean is_blank(const char *data, gsize length) {
+    for (gsize i = 0; i < length; ++i) {
+        if (!g_ascii_isspace(data[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+static const GArray *non_blank_lines(LineTable *table, const char *text) {
+    if (table->non_blank) return table->non_blank;
+    table->non_blank = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint i = 0; i < table->n_lines; ++i) {
+        gsize start = g_array_index(table->offsets, gsize, i);
+        gsize end = g_array_index(table->offsets, gsize, i + 1);
+        if (!is_blank(text + start, end - start)) g_array_append_val(table->non_blank, i);
+    }
+    g_array_append_val(table->non_blank, table->n_lines);
+    return table->non_blank;
+}
+
+/* Keys of every line under 'flags' (blank lines included) */
+static const GArray *all_keys(LineTable *table, const char *text, guint flags) {
+    if (flags == 0) return table->hashes;
+    if (table->keys[flags]) return table->keys[flags];
+    GArray *keys = g_array_sized_new(FALSE, FALSE, sizeof(guint64), table->n_lines);
+    g_array_set_size(keys, table->n_lines);
+    for (guint i = 0; i < table->n_lines; ++i) {
+        gsize start = g_array_index(table->offsets, gsize, i);
+        gsize end = g_array_index(table->offsets, gsize, i + 1);
+        g_array_index(keys, guint64, i) = normalized_hash(text + start, end - start, flags);
+    }
+    table->keys[flags] = keys;
+    return keys;
+}
+
+const guint64 *line_table_keys(LineTable *table, const char *text, guint flags, guint *n_keys, const guint **kept) {
+    flags &= LINE_COMPARE_FLAGS_ALL;
+    const GArray *keys = all_keys(table, text, flags & ~LINE_IGNORE_BLANK_LINES);
+    if (!(flags & LINE_IGNORE_BLANK_LINES)) {
+        *n_keys = table->n_lines;
+        *kept = NULL;
+        return (const guint64 *)keys->data;
+    }
+
+    const GArray *non_blank = non_blank_lines(table, text);
+    if (!table->keys[flags]) {
+        GArray *compact = g_array_sized_new(FALSE, FALSE, sizeof(guint64), non_blank->len - 1);
+        for (guint i = 0; i + 1 < non_blank->len; ++i)
+            g_array_append_val(compact, g_array_index(keys, guint64, g_array_index(non_blank, guint, i)));
+        table->keys[flags] = compact;
+    }
+    *n_keys = non_blank->len - 1;
+    *kept = (const guint *)non_blank->data;
+    return (const guint64 *)table->keys[flags]->data;
+}
@@ -2,7 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 
-GArray* myers_diff(const char* text1, const char* text2) {
+GArray* myers_diff(const char* text1, const char* text2, Arena* arena) {
     GArray* diffs = g_array_new(FALSE, FALSE, sizeof(DiffOp));
     int n = strlen(text1);
     int m = strlen(text2);
@@ -50,7 +50,7 @@ GArray* myers_diff(const char* text1, const char* text2) {
                     int prev_y = prev_x - prev_k;
 
                     while (current_x > prev_x && current_y > prev_y && text1[current_x - 1] == text2[current_y - 1]) {
-                        DiffOp op = {DIFF_OP_EQUAL, g_strndup(&text1[current_x - 1], 1)};
+                        DiffOp op = {DIFF_OP_EQUAL, arena_strndup(arena, &text1[current_x - 1], 1), 1};
                         g_array_prepend_val(diffs, op);
                         current_x--;
                         current_y--;
@@ -58,11 +58,11 @@ GArray* myers_diff(const char* text1, const char* text2) {
 
                     if (prev_d >= 0) {
                         if (prev_x < current_x) {
-                            DiffOp op = {DIFF_OP_DELETE, g_strndup(&text1[current_x - 1], 1)};
+                            DiffOp op = {DIFF_OP_DELETE, arena_strndup(arena, &text1[current_x - 1], 1), 1};
                             g_array_prepend_val(diffs, op);
                             current_x--;
                         } else if (prev_y < current_y) {
-                            DiffOp op = {DIFF_OP_INSERT, g_strndup(&text2[current_y - 1], 1)};
+                            DiffOp op = {DIFF_OP_INSERT, arena_strndup(arena, &text2[current_y - 1], 1), 1};
                             g_array_prepend_val(diffs, op);
                             current_y--;
                         }
@@ -71,7 +71,7 @@ GArray* myers_diff(const char* text1, const char* text2) {
                 }
 
                 while (current_x > 0 && current_y > 0 && text1[current_x - 1] == text2[current_y - 1]) {
-                    DiffOp op = {DIFF_OP_EQUAL, g_strndup(&text1[current_x - 1], 1)};
+                    DiffOp op = {DIFF_OP_EQUAL, arena_strndup(arena, &text1[current_x - 1], 1), 1};
                     g_array_prepend_val(diffs, op);
                     current_x--;
                     current_y--;
@@ -86,3 +86,299 @@ GArray* myers_diff(const char* text1, const char* text2) {
     g_free(v);
     return diffs;
 }
+
+// ---
+// --- Sequence diff (linear space)
+// ---
+
+void diff_edits_append(GArray* edits, DiffOpType type, guint left_start, guint right_start, guint length) {
+    if (length == 0) return;
+    if (edits->len > 0) {
+        DiffEdit *last = &g_array_index(edits, DiffEdit, edits->len - 1);
+        guint left_end = last->left_start + (last->type == DIFF_OP_INSERT ? 0 : last->length);
+        guint right_end = last->right_start + (last->type == DIFF_OP_DELETE ? 0 : last->length);
+        if (last->type == type && left_end == left_start && right_end == right_start) {
+            last->length += length;
+            return;
+        }
+        /* Keep deletions before insertions within a change, as diff(1) prints them */
+        if (last->type == DIFF_OP_INSERT && type == DIFF_OP_DELETE && left_end == left_start && right_end == right_start) {
+            DiffEdit insert = *last;
+            g_array_set_size(edits, edits->len - 1);
+            diff_edits_append(edits, DIFF_OP_DELETE, insert.left_start, insert.right_start, length);
+            diff_edits_append(edits, DIFF_OP_INSERT, insert.left_start + length, insert.right_start, insert.length);
+            return;
+        }
+    }
+    DiffEdit edit = { type, left_start, right_start, length };
+    g_array_append_val(edits, edit);
+}
+
+typedef struct {
+    const guint64 *a;
+    const guint64 *b;
+    int *vf;        /* furthest x per diagonal, forward */
+    int *vb;        /* furthest x per diagonal, backward (from the ends) */
+    int offset;     /* index of diagonal 0 in vf/vb */
+    GArray *edits;
+} SequenceDiff;
+
+/*
+ * Find the middle snake of a[a0, a0 + n) and b[b0, b0 + m), both non-empty.
+ * The snake runs from (*x0, *y0) to (*x1, *y1), relative to a0/b0.
+ */
+static void middle_snake(SequenceDiff *sd, int a0, int n, int b0, int m, int *x0, int *y0, int *x1, int *y1) {
+    const guint64 *a = sd->a + a0;
+    const guint64 *b = sd->b + b0;
+    int *vf = sd->vf + sd->offset;
+    int *vb = sd->vb + sd->offset;
+    int delta = n - m;
+    gboolean odd = (delta & 1) != 0;
+    int max = (n + m + 1) / 2;
+
+    vf[1] = 0;
+    vb[1] = 0;
+    for (int d = 0; d <= max; ++d) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && vf[k - 1] < vf[k + 1])) ? vf[k + 1] : vf[k - 1] + 1;
+            int y = x - k;
+            int sx = x, sy = y;
+            while (x < n && y < m && a[x] == b[y]) { x++; y++; }
+            vf[k] = x;
+            int c = delta - k;
+            if (odd && c >= -(d - 1) && c <= d - 1 && x + vb[c] >= n) {
+                *x0 = sx; *y0 = sy; *x1 = x; *y1 = y;
+                return;
+            }
+        }
+        for (int c = -d; c <= d; c += 2) {
+            int x = (c == -d || (c != d && vb[c - 1] < vb[c + 1])) ? vb[c + 1] : vb[c - 1] + 1;
+            int y = x - c;
+            int sx = x, sy = y;
+            while (x < n && y < m && a[n - 1 - x] == b[m - 1 - y]) { x++; y++; }
+            vb[c] = x;
+            int k = delta - c;
+            if (!odd && k >= -d && k <= d && vf[k] + x >= n) {
+                *x0 = n - x; *y0 = m - y; *x1 = n - sx; *y1 = m - sy;
+                return;
+            }
+        }
+    }
+    /* Unreachable for non-empty inputs: the paths always meet by d = max */
+    *x0 = *x1 = n;
+    *y0 = *y1 = m;
+}
+
+static void diff_range(SequenceDiff *sd, int a0, int n, int b0, int m) {
+    int prefix = 0;
+    while (prefix < n && prefix < m && sd->a[a0 + prefix] == sd->b[b0 + prefix]) prefix++;
+    diff_edits_append(sd->edits, DIFF_OP_EQUAL, a0, b0, prefix);
+    a0 += prefix; b0 += prefix; n -= prefix; m -= prefix;
+
+    int suffix = 0;
+    while (suffix < n && suffix < m && sd->a[a0 + n - 1 - suffix] == sd->b[b0 + m - 1 - suffix]) suffix++;
+    n -= suffix; m -= suffix;
+
+    if (n == 0) {
+        diff_edits_append(sd->edits, DIFF_OP_INSERT, a0, b0, m);
+    } else if (m == 0) {
+        diff_edits_append(sd->edits, DIFF_OP_DELETE, a0, b0, n);
+    } else {
+        int x0, y0, x1, y1;
+        middle_snake(sd, a0, n, b0, m, &x0, &y0, &x1, &y1);
+        diff_range(sd, a0, x0, b0, y0);
+        diff_edits_append(sd->edits, DIFF_OP_EQUAL, a0 + x0, b0 + y0, x1 - x0);
+        diff_range(sd, a0 + x1, n - x1, b0 + y1, m - y1);
+    }
+
+    diff_edits_append(sd->edits, DIFF_OP_EQUAL, a0 + n, b0 + m, suffix);
+}
+
+GArray* myers_diff_sequence(const guint64* a, guint n, const guint64* b, guint m) {
+    SequenceDiff sd;
+    sd.a = a;
+    sd.b = b;
+    sd.offset = (int)(n + m) / 2 + 2;
+    sd.vf = g_new(int, 2 * sd.offset + 1);
+    sd.vb = g_new(int, 2 * sd.offset + 1);
+    sd.edits = g_array_new(FALSE, FALSE, sizeof(DiffEdit));
+
+    diff_range(&sd, 0, (int)n, 0, (int)m);
+
+    g_free(sd.vf);
+    g_free(sd.vb);
+    return sd.edits;
+}
+
+// ---
+// --- Counts only
+// ---
+
+gboolean myers_diff_stats(const guint64* a, guint n, const guint64* b, guint m, guint max_d,
+                          guint* inserted, guint* deleted) {
+    while (n > 0 && m > 0 && a[0] == b[0]) { a++; b++; n--; m--; }
+    while (n > 0 && m > 0 && a[n - 1] == b[m - 1]) { n--; m--; }
+
+    /* Upper bound until a path is found */
+    *inserted = m;
+    *deleted = n;
+    if (n == 0 || m == 0) return TRUE;
+
+    int limit = (int)(n + m);
+    if (max_d && (int)max_d < limit) limit = (int)max_d;
+    int *v = g_new(int, 2 * limit + 3) + limit + 1;
+    gboolean found = FALSE;
+
+    v[1] = 0;
+    for (int d = 0; d <= limit && !found; ++d) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[k - 1] < v[k + 1])) ? v[k + 1] : v[k - 1] + 1;
+            int y = x - k;
+            while (x < (int)n && y < (int)m && a[x] == b[y]) { x++; y++; }
+            v[k] = x;
+            if (x >= (int)n && y >= (int)m) {
+                /* d = inserted + deleted and m - n = inserted - deleted */
+                *inserted = (guint)((d + (int)m - (int)n) / 2);
+                *deleted = (guint)((d - (int)m + (int)n) / 2);
+                found = TRUE;
+                break;
+            }
+        }
+    }
+
+    g_free(v - limit - 1);
+    return found;
+}
+
+// ---
+// --- Moved blocks
+// ---
+
+/* Source positions tried per inserted element, and chain entries looked at before giving up */
+#define MOVE_CANDIDATES 8
+#define MOVE_CHAIN_LIMIT (4 * MOVE_CANDIDATES)
+
+/* Group of an element that is not deleted/inserted, or already part of a move */
+#define NO_GROUP G_MAXUINT
+
+typedef struct {
+    guint left_start;
+    guint right_start;
+    guint length;
+} MoveMatch;
+
+/* Longest acceptable block at a[i] / b[j] within their changes, or 0; a[i] == b[j] */
+static guint extend_move(const guint64 *a, guint n, const guint64 *b, guint m,
+                         const guint *left_group, const guint *right_group, guint i, guint j) {
+    guint left = left_group[i], right = right_group[j];
+    guint best = 0, mismatches = 0, k = 0;
+    gboolean last_mismatched = FALSE;
+    while (i + k < n && j + k < m && left_group[i + k] == left && right_group[j + k] == right) {
+        if (a[i + k] == b[j + k]) {
+            k++;
+            last_mismatched = FALSE;
+            if (mismatches * DIFF_MOVE_FUZZ <= k) best = k;
+        } else {
+            if (last_mismatched) break;
+            mismatches++;
+            k++;
+            last_mismatched = TRUE;
+        }
+    }
+    return best;
+}
+
+GArray* diff_edits_find_moves(const GArray* edits, const guint64* a, guint n, const guint64* b, guint m) {
+    /* Each change (the runs between two EQUAL runs) gets a group number; moves must cross groups */
+    guint *left_group = g_new(guint, n + 1);
+    guint *right_group = g_new(guint, m + 1);
+    guint *left_move = g_new0(guint, n + 1);
+    guint *right_move = g_new0(guint, m + 1);
+    memset(left_group, 0xff, (n + 1) * sizeof(guint));
+    memset(right_group, 0xff, (m + 1) * sizeof(guint));
+    guint group = 0;
+    for (guint e = 0; e < edits->len; ++e) {
+        const DiffEdit *edit = &g_array_index(edits, DiffEdit, e);
+        if (edit->type == DIFF_OP_EQUAL) group++;
+        else if (edit->type == DIFF_OP_DELETE) for (guint k = 0; k < edit->length; ++k) left_group[edit->left_start + k] = group;
+        else if (edit->type == DIFF_OP_INSERT) for (guint k = 0; k < edit->length; ++k) right_group[edit->right_start + k] = group;
+    }
+
+    /* Deleted elements by hash: heads maps a hash to its first position + 1, next_same chains the rest in order */
+    GHashTable *heads = g_hash_table_new(g_int64_hash, g_int64_equal);
+    guint *next_same = g_new0(guint, n + 1);
+    for (guint i = n; i-- > 0;) {
+        if (left_group[i] == NO_GROUP) continue;
+        next_same[i] = GPOINTER_TO_UINT(g_hash_table_lookup(heads, &a[i]));
+        g_hash_table_insert(heads, (gpointer)&a[i], GUINT_TO_POINTER(i + 1));
+    }
+
+    GArray *moves = g_array_new(FALSE, FALSE, sizeof(MoveMatch));
+    for (guint j = 0; j < m;) {
+        if (right_group[j] == NO_GROUP) { j++; continue; }
+        guint best_length = 0, best_start = 0, tried = 0, visited = 0;
+        for (guint c = GPOINTER_TO_UINT(g_hash_table_lookup(heads, &b[j]));
+             c && tried < MOVE_CANDIDATES && visited < MOVE_CHAIN_LIMIT; c = next_same[c - 1], visited++) {
+            guint i = c - 1;
+            if (left_group[i] == NO_GROUP || left_group[i] == right_group[j]) continue;
+            tried++;
+            guint length = extend_move(a, n, b, m, left_group, right_group, i, j);
+            if (length > best_length) {
+                best_length = length;
+                best_start = i;
+            }
+        }
+        if (best_length < DIFF_MOVE_MIN_LENGTH) { j++; continue; }
+
+        MoveMatch match = { best_start, j, best_length };
+        g_array_append_val(moves, match);
+        for (guint k = 0; k < best_length; ++k) {
+            left_group[best_start + k] = NO_GROUP;
+            right_group[j + k] = NO_GROUP;
+            left_move[best_start + k] = moves->len;
+            right_move[j + k] = moves->len;
+        }
+        j += best_length;
+    }
+
+    /* Rebuild the script, replacing the matched parts of deletions and insertions with MOVE runs */
+    GArray *result = g_array_sized_new(FALSE, FALSE, sizeof(DiffEdit), edits->len + 2 * moves->len);
+    for (guint e = 0; e < edits->len; ++e) {
+        const DiffEdit *edit = &g_array_index(edits, DiffEdit, e);
+        if (edit->type != DIFF_OP_DELETE && edit->type != DIFF_OP_INSERT) {
+            diff_edits_append(result, edit->type, edit->left_start, edit->right_start, edit->length);
+            continue;
+        }
+        gboolean left_side = edit->type == DIFF_OP_DELETE;
+        const guint *move_of = left_side ? left_move : right_move;
+        guint start = left_side ? edit->left_start : edit->right_start;
+        for (guint k = 0; k < edit->length;) {
+            guint id = move_of[start + k];
+            if (id) {
+                /* A block never spans two runs of one change, but don't rely on it */
+                const MoveMatch *match = &g_array_index(moves, MoveMatch, id - 1);
+                guint match_start = left_side ? match->left_start : match->right_start;
+                if (start + k == match_start) {
+                    DiffEdit run = { DIFF_OP_MOVE, match->left_start, match->right_start, match->length };
+                    g_array_append_val(result, run);
+                }
+                k = MIN(match_start + match->length - start, edit->length);
+                continue;
+            }
+            guint end = k;
+            while (end < edit->length && !move_of[start + end]) end++;
+            if (left_side) diff_edits_append(result, DIFF_OP_DELETE, start + k, edit->right_start, end - k);
+            else diff_edits_append(result, DIFF_OP_INSERT, edit->left_start, start + k, end - k);
+            k = end;
+        }
+    }
+
+    g_array_unref(moves);
+    g_hash_table_unref(heads);
+    g_free(next_same);
+    g_free(left_group);
+    g_free(right_group);
+    g_free(left_move);
+    g_free(right_move);
+    return result;
+}
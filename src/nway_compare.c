@@ -0,0 +1,124 @@
+#include "nway_compare.h"
+#include "chunk_store.h"
+#include "myers_diff.h"
+#include "work_pool.h"
+#include "trace.h"
+#include <string.h>
+
+typedef enum {
+    NWAY_LOAD,      /* read each version and split it into lines */
+    NWAY_DIFF       /* diff each version against the base */
+} NWayPhase;
+
+struct _NWayCompare {
+    GPtrArray *paths;
+    guint n;
+    NWayPhase phase;
+    guint base;
+    NWayColumnFunc func;
+    gpointer user_data;
+    gchar **display;        /* each version as valid UTF-8 */
+    LineTable **lines;
+    gint cancelled;
+};
+
+void nway_column_free(NWayColumn *column) {
+    if (!column) return;
+    g_array_unref(column->edits);
+    g_free(column);
+}
+
+NWayCompare *nway_compare_new(const char *const *paths, guint n_paths) {
+    NWayCompare *cmp = g_new0(NWayCompare, 1);
+    cmp->n = n_paths;
+    cmp->paths = g_ptr_array_new_full(n_paths, g_free);
+    for (guint i = 0; i < n_paths; ++i) g_ptr_array_add(cmp->paths, g_strdup(paths[i]));
+    cmp->display = g_new0(gchar *, n_paths);
+    cmp->lines = g_new0(LineTable *, n_paths);
+    return cmp;
+}
+
+void nway_compare_free(NWayCompare *cmp) {
+    if (!cmp) return;
+    for (guint i = 0; i < cmp->n; ++i) {
+        g_free(cmp->display[i]);
+        if (cmp->lines[i]) line_table_free(cmp->lines[i]);
+    }
+    g_free(cmp->display);
+    g_free(cmp->lines);
+    g_ptr_array_free(cmp->paths, TRUE);
+    g_free(cmp);
+}
+
+static void load_column(NWayCompare *cmp, guint i) {
+    const char *path = g_ptr_array_index(cmp->paths, i);
+    gchar *text = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+    if (!chunk_store_read_file(path, &text, &length, &error)) {
+        cmp->display[i] = g_strdup_printf("(could not read %s: %s)", path, error ? error->message : "unknown error");
+        g_clear_error(&error);
+    } else {
+        cmp->display[i] = g_utf8_make_valid(text, (gssize)length);
+    }
+    cmp->lines[i] = line_table_new(text ? text : "", length);
+    g_free(text);
+}
+
+static void diff_column(NWayCompare *cmp, guint i) {
+    const LineTable *left = cmp->lines[cmp->base];
+    const LineTable *right = cmp->lines[i];
+    NWayColumn *column = g_new0(NWayColumn, 1);
+    column->column = i;
+    column->base = cmp->base;
+    column->edits = myers_diff_sequence((const guint64 *)left->hashes->data, left->n_lines,
+                                        (const guint64 *)right->hashes->data, right->n_lines);
+    for (guint e = 0; e < column->edits->len; ++e) {
+        const DiffEdit *edit = &g_array_index(column->edits, DiffEdit, e);
+        if (edit->type == DIFF_OP_INSERT) column->inserted += edit->length;
+        else if (edit->type == DIFF_OP_DELETE) column->deleted += edit->length;
+    }
+    cmp->func(column, cmp->user_data);
+}
+
+static void nway_work(gpointer item, gpointer user_data) {
+    NWayCompare *cmp = user_data;
+    if (g_atomic_int_get(&cmp->cancelled)) return;
+    guint i = GPOINTER_TO_UINT(item) - 1;
+    if (cmp->phase == NWAY_LOAD) load_column(cmp, i);
+    else if (i != cmp->base) diff_column(cmp, i);
+}
+
+/* Every version through one phase */
+static void run_phase(NWayCompare *cmp, NWayPhase phase) {
+    cmp->phase = phase;
+    WorkPool *pool = work_pool_new(MIN(cmp->n, g_get_num_processors()), nway_work, cmp);
+    for (guint i = 0; i < cmp->n; ++i) work_pool_push(pool, GUINT_TO_POINTER(i + 1));
+    work_pool_free(pool);
+}
+
+void nway_compare_load(NWayCompare *cmp) {
+    TRACE_SCOPE("nway.load");
+    run_phase(cmp, NWAY_LOAD);
+}
+
+const char *nway_compare_get_display(NWayCompare *cmp, guint i) {
+    return cmp->display[i];
+}
+
+const LineTable *nway_compare_get_lines(NWayCompare *cmp, guint i) {
+    return cmp->lines[i];
+}
+
+void nway_compare_run(NWayCompare *cmp, guint base, NWayColumnFunc func, gpointer user_data) {
+    TRACE_SCOPE("nway.diff");
+    g_return_if_fail(base < cmp->n);
+    cmp->base = base;
+    cmp->func = func;
+    cmp->user_data = user_data;
+    run_phase(cmp, NWAY_DIFF);
+}
+
+void nway_compare_cancel(NWayCompare *cmp) {
+    g_atomic_int_set(&cmp->cancelled, 1);
+}
@@ -0,0 +1,277 @@
+#include "nway_view.h"
+#include "nway_compare.h"
+#include "myers_diff.h"
+#include "trace.h"
+#include <string.h>
+
+#define COLUMN_MIN_WIDTH 260
+
+/*
+ * Shared between the window and the worker threads, hence reference counted.
+ * Widgets are only touched on the main thread and are NULL once the window
+ * is gone. The versions are loaded by the first run and kept, so switching
+ * the base only redoes the diffs.
+ */
+typedef struct {
+    GtkWidget **views;
+    GtkWidget **headers;
+    GtkWidget *status;
+    GtkWidget *base_choice;
+    GPtrArray *paths;
+    guint n;
+    guint base;
+    gboolean loaded;
+    NWayCompare *compare;
+    gint64 started;
+    gint completed;
+} NWay;
+
+static void nway_clear(gpointer data) {
+    NWay *nw = data;
+    nway_compare_free(nw->compare);
+    g_free(nw->views);
+    g_free(nw->headers);
+    g_ptr_array_free(nw->paths, TRUE);
+}
+
+static NWay *nway_ref(NWay *nw) {
+    return g_atomic_rc_box_acquire(nw);
+}
+
+static void nway_unref(gpointer nw) {
+    g_atomic_rc_box_release_full(nw, nway_clear);
+}
+
+// ---
+// --- Results, applied on the main thread
+// ---
+
+/* One version's diff against the base, on its way to the main thread */
+typedef struct {
+    NWay *nw;
+    NWayColumn *column;
+} ColumnResult;
+
+static void column_result_free(gpointer data) {
+    ColumnResult *result = data;
+    nway_column_free(result->column);
+    nway_unref(result->nw);
+    g_free(result);
+}
+
+static GtkTextBuffer *column_buffer(NWay *nw, guint column) {
+    return gtk_text_view_get_buffer(GTK_TEXT_VIEW(nw->views[column]));
+}
+
+static void tag_lines(GtkTextBuffer *buffer, const char *tag, guint first, guint count) {
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, (int)first);
+    gtk_text_buffer_get_iter_at_line(buffer, &end, (int)(first + count));
+    gtk_text_buffer_apply_tag_by_name(buffer, tag, &start, &end);
+}
+
+static void set_header(NWay *nw, guint column, const char *suffix) {
+    gchar *name = g_path_get_basename(g_ptr_array_index(nw->paths, column));
+    gchar *text = g_strdup_printf("%s  %s", name, suffix);
+    gtk_label_set_text(GTK_LABEL(nw->headers[column]), text);
+    g_free(text);
+    g_free(name);
+}
+
+static gboolean show_texts(gpointer user_data) {
+    NWay *nw = user_data;
+    if (!nw->status) return G_SOURCE_REMOVE;
+    for (guint i = 0; i < nw->n; ++i) {
+        gtk_text_buffer_set_text(column_buffer(nw, i), nway_compare_get_display(nw->compare, i), -1);
+    }
+    gtk_label_set_text(GTK_LABEL(nw->status), "Comparing…");
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean apply_column(gpointer user_data) {
+    ColumnResult *result = user_data;
+    NWay *nw = result->nw;
+    const NWayColumn *column = result->column;
+    if (!nw->status || column->base != nw->base) return G_SOURCE_REMOVE;
+
+    GtkTextBuffer *base_buffer = column_buffer(nw, column->base);
+    GtkTextBuffer *buffer = column_buffer(nw, column->column);
+    for (guint i = 0; i < column->edits->len; ++i) {
+        const DiffEdit *edit = &g_array_index(column->edits, DiffEdit, i);
+        if (edit->type == DIFF_OP_INSERT) tag_lines(buffer, "nway-added", edit->right_start, edit->length);
+        else if (edit->type == DIFF_OP_DELETE) tag_lines(base_buffer, "nway-removed", edit->left_start, edit->length);
+    }
+    gchar *counts = g_strdup_printf("+%u −%u", column->inserted, column->deleted);
+    set_header(nw, column->column, counts);
+    g_free(counts);
+
+    gchar *message = g_strdup_printf("Compared %d of %u versions with the base…", g_atomic_int_get(&nw->completed),
+                                     nw->n - 1);
+    gtk_label_set_text(GTK_LABEL(nw->status), message);
+    g_free(message);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean finish_run(gpointer user_data) {
+    NWay *nw = user_data;
+    if (!nw->status) return G_SOURCE_REMOVE;
+    gchar *message = g_strdup_printf("%u versions against the base, compared in %.0f ms", nw->n,
+                                     (g_get_monotonic_time() - nw->started) / 1000.0);
+    gtk_label_set_text(GTK_LABEL(nw->status), message);
+    g_free(message);
+    gtk_widget_set_sensitive(nw->base_choice, TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+// ---
+// --- Worker side
+// ---
+
+/* Called on a worker thread as each version's diff is done */
+static void on_column_done(NWayColumn *column, gpointer user_data) {
+    NWay *nw = user_data;
+    g_atomic_int_inc(&nw->completed);
+    ColumnResult *result = g_new0(ColumnResult, 1);
+    result->nw = nway_ref(nw);
+    result->column = column;
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, apply_column, result, column_result_free);
+}
+
+/* Runs the comparison from its own thread, since it blocks */
+static gpointer compute_nway(gpointer data) {
+    NWay *nw = data;
+    TRACE_THREAD_NAME("nway");
+    TRACE_SCOPE("nway.compute");
+    TRACE_SCOPE_ARG("versions", nw->n);
+    if (!nw->loaded) {
+        nway_compare_load(nw->compare);
+        nw->loaded = TRUE;
+        g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, show_texts, nway_ref(nw), nway_unref);
+    }
+    nway_compare_run(nw->compare, nw->base, on_column_done, nw);
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, finish_run, nway_ref(nw), nway_unref);
+    nway_unref(nw);
+    return NULL;
+}
+
+/* Start a run against nw->base; the base choice stays locked until it finishes */
+static void start_run(NWay *nw) {
+    nw->started = g_get_monotonic_time();
+    g_atomic_int_set(&nw->completed, 0);
+    gtk_widget_set_sensitive(nw->base_choice, FALSE);
+    for (guint i = 0; i < nw->n; ++i) set_header(nw, i, i == nw->base ? "(base)" : "…");
+    g_thread_unref(g_thread_new("nway", compute_nway, nway_ref(nw)));
+}
+
+// ---
+// --- Window
+// ---
+
+static void on_base_selected(GObject *dropdown, GParamSpec *pspec, gpointer user_data) {
+    NWay *nw = user_data;
+    guint base = gtk_drop_down_get_selected(GTK_DROP_DOWN(dropdown));
+    if (base == GTK_INVALID_LIST_POSITION || base == nw->base || !nw->loaded) return;
+    nw->base = base;
+    for (guint i = 0; i < nw->n; ++i) {
+        GtkTextBuffer *buffer = column_buffer(nw, i);
+        GtkTextIter start, end;
+        gtk_text_buffer_get_bounds(buffer, &start, &end);
+        gtk_text_buffer_remove_tag_by_name(buffer, "nway-added", &start, &end);
+        gtk_text_buffer_remove_tag_by_name(buffer, "nway-removed", &start, &end);
+    }
+    gtk_label_set_text(GTK_LABEL(nw->status), "Comparing…");
+    start_run(nw);
+}
+
+static void on_nway_destroy(GtkWidget *window, gpointer user_data) {
+    NWay *nw = user_data;
+    nw->status = NULL;
+    nw->base_choice = NULL;
+    nway_compare_cancel(nw->compare);
+    nway_unref(nw);
+}
+
+void create_nway_window(GtkWindow *parent, const char *const *paths, guint n_paths, guint base) {
+    g_return_if_fail(n_paths >= 2 && base < n_paths);
+    NWay *nw = g_atomic_rc_box_new0(NWay);
+    nw->n = n_paths;
+    nw->base = base;
+    nw->paths = g_ptr_array_new_full(n_paths, g_free);
+    for (guint i = 0; i < n_paths; ++i) g_ptr_array_add(nw->paths, g_strdup(paths[i]));
+    nw->compare = nway_compare_new(paths, n_paths);
+    nw->views = g_new0(GtkWidget *, n_paths);
+    nw->headers = g_new0(GtkWidget *, n_paths);
+
+    GtkWidget *window = gtk_window_new();
+    gchar *title = g_strdup_printf("Compare %u Versions", n_paths);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    g_free(title);
+    gtk_window_set_default_size(GTK_WINDOW(window), MIN(1600, 140 + n_paths * 360), 800);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    GtkWidget *top = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_widget_set_margin_start(top, 10);
+    gtk_widget_set_margin_end(top, 10);
+    gtk_widget_set_margin_top(top, 5);
+    gtk_widget_set_margin_bottom(top, 5);
+    gtk_box_append(GTK_BOX(top), gtk_label_new("Base:"));
+
+    const char **names = g_new0(const char *, n_paths + 1);
+    gchar **owned = g_new0(gchar *, n_paths + 1);
+    for (guint i = 0; i < n_paths; ++i) names[i] = owned[i] = g_path_get_basename(paths[i]);
+    nw->base_choice = gtk_drop_down_new_from_strings(names);
+    g_strfreev(owned);
+    g_free(names);
+    gtk_drop_down_set_selected(GTK_DROP_DOWN(nw->base_choice), base);
+    g_signal_connect(nw->base_choice, "notify::selected", G_CALLBACK(on_base_selected), nw);
+    gtk_box_append(GTK_BOX(top), nw->base_choice);
+
+    nw->status = gtk_label_new("Reading versions…");
+    gtk_widget_set_halign(nw->status, GTK_ALIGN_START);
+    gtk_widget_set_hexpand(nw->status, TRUE);
+    gtk_box_append(GTK_BOX(top), nw->status);
+    gtk_box_append(GTK_BOX(vbox), top);
+
+    /* Unwrapped lines are all one height, so the shared scroll position keeps line numbers level */
+    GtkWidget *columns = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
+    gtk_box_set_homogeneous(GTK_BOX(columns), TRUE);
+    GtkAdjustment *vadjustment = NULL;
+    for (guint i = 0; i < n_paths; ++i) {
+        GtkWidget *column = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+        nw->headers[i] = gtk_label_new(NULL);
+        gtk_label_set_ellipsize(GTK_LABEL(nw->headers[i]), PANGO_ELLIPSIZE_MIDDLE);
+        gtk_widget_set_margin_top(nw->headers[i], 3);
+        gtk_widget_set_margin_bottom(nw->headers[i], 3);
+        gtk_box_append(GTK_BOX(column), nw->headers[i]);
+
+        nw->views[i] = gtk_text_view_new();
+        gtk_text_view_set_editable(GTK_TEXT_VIEW(nw->views[i]), FALSE);
+        gtk_text_view_set_monospace(GTK_TEXT_VIEW(nw->views[i]), TRUE);
+        gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(nw->views[i]), GTK_WRAP_NONE);
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(nw->views[i]));
+        gtk_text_buffer_create_tag(buffer, "nway-added", "paragraph-background", "#ddf4dd", NULL);
+        gtk_text_buffer_create_tag(buffer, "nway-removed", "paragraph-background", "#fbe0e0", NULL);
+
+        GtkWidget *scrolled = gtk_scrolled_window_new();
+        gtk_widget_set_vexpand(scrolled, TRUE);
+        gtk_widget_set_size_request(scrolled, COLUMN_MIN_WIDTH, -1);
+        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), nw->views[i]);
+        if (!vadjustment) vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled));
+        else gtk_scrolled_window_set_vadjustment(GTK_SCROLLED_WINDOW(scrolled), vadjustment);
+        gtk_box_append(GTK_BOX(column), scrolled);
+        gtk_box_append(GTK_BOX(columns), column);
+    }
+    /* Ten columns need not fit the screen: they scroll sideways together */
+    GtkWidget *outer = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(outer), GTK_POLICY_AUTOMATIC, GTK_POLICY_NEVER);
+    gtk_widget_set_vexpand(outer, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(outer), columns);
+    gtk_box_append(GTK_BOX(vbox), outer);
+
+    gtk_window_set_child(GTK_WINDOW(window), vbox);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_nway_destroy), nw);
+    gtk_window_present(GTK_WINDOW(window));
+
+    start_run(nw);
+}
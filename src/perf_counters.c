@@ -0,0 +1,25 @@
+#include "perf_counters.h"
+#include <stdatomic.h>
+
+/* GLib has no 64-bit atomic integers, so these use C11 atomics */
+static _Atomic gint64 counters[PERF_COUNTER_COUNT];
+
+void perf_counter_set(PerfCounter counter, gint64 value) {
+    atomic_store_explicit(&counters[counter], value, memory_order_relaxed);
+}
+
+void perf_counter_add(PerfCounter counter, gint64 delta) {
+    atomic_fetch_add_explicit(&counters[counter], delta, memory_order_relaxed);
+}
+
+void perf_counter_max(PerfCounter counter, gint64 value) {
+    gint64 current = atomic_load_explicit(&counters[counter], memory_order_relaxed);
+    while (current < value &&
+           !atomic_compare_exchange_weak_explicit(&counters[counter], &current, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+gint64 perf_counter_get(PerfCounter counter) {
+    return atomic_load_explicit(&counters[counter], memory_order_relaxed);
+}
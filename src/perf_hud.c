@@ -0,0 +1,111 @@
+#include "perf_hud.h"
+#include "perf_counters.h"
+
+#define HUD_REFRESH_MS 250
+
+typedef struct {
+    GtkWidget *label;
+    guint refresh_id;
+    guint tick_id;
+    gint64 last_frame_us;
+} PerfHud;
+
+static gchar *format_ms(gint64 us) {
+    return g_strdup_printf("%.1f ms", us / 1000.0);
+}
+
+static gboolean refresh_hud(gpointer user_data) {
+    PerfHud *hud = user_data;
+    gchar *diff_time = format_ms(perf_counter_get(PERF_LAST_DIFF_US));
+    gchar *left = g_format_size((guint64)perf_counter_get(PERF_LAST_DIFF_LEFT_BYTES));
+    gchar *right = g_format_size((guint64)perf_counter_get(PERF_LAST_DIFF_RIGHT_BYTES));
+    gchar *index_time = format_ms(perf_counter_get(PERF_INDEX_LOAD_US));
+    gchar *recorded = g_format_size((guint64)perf_counter_get(PERF_RECORD_BYTES));
+    gchar *stored = g_format_size((guint64)perf_counter_get(PERF_STORED_BYTES));
+    gchar *cached = g_format_size((guint64)perf_counter_get(PERF_DIFF_RESULT_BYTES));
+    gchar *chunks = g_format_size((guint64)perf_counter_get(PERF_CHUNK_CACHE_BYTES));
+    gchar *worst = format_ms(perf_counter_get(PERF_WORST_STALL_US));
+
+    gchar *text = g_strdup_printf("last diff    %s (%s / %s)\n"
+                                  "index load   %s\n"
+                                  "versions     %" G_GINT64_FORMAT " rows\n"
+                                  "recorded     %s (%s new)\n"
+                                  "diff cache   %s\n"
+                                  "chunk cache  %s\n"
+                                  "stalls       %" G_GINT64_FORMAT " (worst %s)",
+                                  diff_time, left, right, index_time,
+                                  perf_counter_get(PERF_VERSIONS_RENDERED), recorded, stored, cached, chunks,
+                                  perf_counter_get(PERF_FRAME_STALLS), worst);
+    gtk_label_set_text(GTK_LABEL(hud->label), text);
+
+    g_free(text);
+    g_free(diff_time);
+    g_free(left);
+    g_free(right);
+    g_free(index_time);
+    g_free(recorded);
+    g_free(stored);
+    g_free(cached);
+    g_free(chunks);
+    g_free(worst);
+    return G_SOURCE_CONTINUE;
+}
+
+/* The tick callback keeps the frame clock running, so a long gap between frames is the main loop being blocked */
+static gboolean on_frame(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data) {
+    PerfHud *hud = user_data;
+    gint64 now = gdk_frame_clock_get_frame_time(clock);
+    if (hud->last_frame_us) {
+        gint64 interval = 0;
+        gdk_frame_clock_get_refresh_info(clock, now, &interval, NULL);
+        if (interval <= 0) interval = 16667;
+        gint64 late = now - hud->last_frame_us - interval;
+        if (late > PERF_STALL_US) {
+            perf_counter_add(PERF_FRAME_STALLS, 1);
+            perf_counter_max(PERF_WORST_STALL_US, late);
+        }
+    }
+    hud->last_frame_us = now;
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_hud_map(GtkWidget *widget, gpointer user_data) {
+    PerfHud *hud = user_data;
+    refresh_hud(hud);
+    hud->refresh_id = g_timeout_add(HUD_REFRESH_MS, refresh_hud, hud);
+    hud->last_frame_us = 0;
+    hud->tick_id = gtk_widget_add_tick_callback(widget, on_frame, hud, NULL);
+}
+
+static void on_hud_unmap(GtkWidget *widget, gpointer user_data) {
+    PerfHud *hud = user_data;
+    g_clear_handle_id(&hud->refresh_id, g_source_remove);
+    if (hud->tick_id) {
+        gtk_widget_remove_tick_callback(widget, hud->tick_id);
+        hud->tick_id = 0;
+    }
+}
+
+GtkWidget *perf_hud_new(void) {
+    PerfHud *hud = g_new0(PerfHud, 1);
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_widget_add_css_class(box, "perf-hud");
+    gtk_widget_set_halign(box, GTK_ALIGN_END);
+    gtk_widget_set_valign(box, GTK_ALIGN_START);
+    /* Clicks go through to whatever is underneath */
+    gtk_widget_set_can_target(box, FALSE);
+    gtk_widget_set_visible(box, FALSE);
+
+    hud->label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(hud->label), 0.0);
+    gtk_box_append(GTK_BOX(box), hud->label);
+
+    g_signal_connect(box, "map", G_CALLBACK(on_hud_map), hud);
+    g_signal_connect(box, "unmap", G_CALLBACK(on_hud_unmap), hud);
+    g_object_set_data_full(G_OBJECT(box), "perf-hud", hud, g_free);
+    return box;
+}
+
+void perf_hud_toggle(GtkWidget *hud) {
+    gtk_widget_set_visible(hud, !gtk_widget_get_visible(hud));
+}
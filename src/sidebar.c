@@ -1,5 +1,12 @@
 #include "sidebar.h" // Or "temp.h" as your file includes
 #include "context_menu.h"
+#include "tracked_file.h"
+#include "version_store.h"
+#include "diff_logic.h"
+#include "version_stats.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "trigram_index.h"
 #include <gtk/gtk.h>
 #include <glib/gstdio.h> // For g_path_get_basename
 #include <string.h>
@@ -11,22 +18,29 @@
 #  define HAVE_JSON_GLIB 1
 # endif
 #endif
-#if defined(G_OS_WIN32)
-#include <windows.h>
-#include <shellapi.h>
-#endif
 
 // This struct now holds all widgets our sidebar needs
 typedef struct {
     GtkWindow *parent_window;
-    GtkWidget *list_box;
+    GtkWidget *list_view;
     GtkWidget *delete_button; // So we can enable/disable it
+    GListStore *store;        // TrackedFile items backing the list view
+    GtkSingleSelection *selection;
+    GCancellable *cancellable; // Cancels index loading and stat queries on destroy
+    GQueue stat_queue;         // TrackedFile refs still waiting for g_file_query_info_async
+    guint stats_in_flight;
 } SidebarData;
 
+/* How many g_file_query_info_async calls may be outstanding at once */
+#define STAT_BATCH_SIZE 16
+/* Directories holding at least this many tracked files are enumerated instead of stat'ed per file */
+#define ENUMERATE_MIN_FILES 8
+/* Number of GFileInfo fetched per g_file_enumerator_next_files_async call */
+#define ENUMERATE_BATCH_SIZE 64
+#define STAT_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED
+
 /* Forward: populate_versions_for_path is used externally */
 void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, const char *original_path);
-/* Forward: on_version_activated is connected later */
-static void on_version_activated(GtkListBox *box, GtkListBoxRow *row, gpointer user_data);
 
 /* Clear all children from a container (list box) */
 void clear_list_box_widget(GtkWidget *box_widget) {
@@ -57,46 +71,57 @@ void clear_list_box_widget(GtkWidget *box_widget) {
     }
 }
 
-/* Add a full path to the sidebar list (creates row, label, gesture, stores file-path) */
-static void add_path_to_list(SidebarData *data, const char *full_path) {
-    if (!data || !full_path) return;
-    char *basename = g_path_get_basename(full_path);
-    GtkWidget *row = gtk_list_box_row_new();
-    GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
-    GtkWidget *list_row_label = gtk_label_new(basename);
-    gtk_widget_set_halign(list_row_label, GTK_ALIGN_START);
-    gtk_label_set_wrap(GTK_LABEL(list_row_label), TRUE);
-    gtk_box_append(GTK_BOX(hbox), list_row_label);
-    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), hbox);
-    gtk_widget_set_name(row, basename);
-    g_object_set_data(G_OBJECT(row), "label-widget", list_row_label);
-    GtkGesture *right_click = gtk_gesture_click_new();
-    gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(right_click), GDK_BUTTON_SECONDARY);
-    /* Do not make the right-click gesture exclusive — that can prevent
-     * normal left-click selection from reaching the list box. */
-    gtk_gesture_single_set_exclusive(GTK_GESTURE_SINGLE(right_click), FALSE);
-    g_signal_connect(right_click, "pressed", G_CALLBACK(on_widget_right_click), (gpointer)"sidebar-element");
-    gtk_widget_add_controller(row, GTK_EVENT_CONTROLLER(right_click));
-    g_object_set_data_full(G_OBJECT(row), "file-path", g_strdup(full_path), g_free);
-    gtk_list_box_append(GTK_LIST_BOX(data->list_box), row);
-    g_free(basename);
+
+// ---
+// --- Version summaries (count + newest timestamp per tracked file)
+// ---
+
+typedef struct {
+    int count;
+    gint64 last_recorded;
+} VersionSummary;
+
+/* Parse the "YYYYmmddHHMMSS" timestamp written by record_version() */
+static gint64 parse_version_timestamp(const char *ts) {
+    if (!ts || strlen(ts) < 14) return -1;
+    int fields[6];
+    const int widths[6] = {4, 2, 2, 2, 2, 2};
+    const char *p = ts;
+    for (int i = 0; i < 6; ++i) {
+        char buf[5] = {0};
+        memcpy(buf, p, widths[i]);
+        fields[i] = atoi(buf);
+        p += widths[i];
+    }
+    GDateTime *dt = g_date_time_new_local(fields[0], fields[1], fields[2], fields[3], fields[4], fields[5]);
+    if (!dt) return -1;
+    gint64 unix_time = g_date_time_to_unix(dt);
+    g_date_time_unref(dt);
+    return unix_time;
 }
 
-/* Populate versions list for an original file path */
-void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, const char *original_path) {
-    if (!versions_list) return;
-    clear_list_box_widget(GTK_WIDGET(versions_list));
+static void summary_add(GHashTable *summaries, const char *orig, const char *ts) {
+    VersionSummary *s = g_hash_table_lookup(summaries, orig);
+    if (!s) {
+        s = g_new0(VersionSummary, 1);
+        s->last_recorded = -1;
+        g_hash_table_insert(summaries, g_strdup(orig), s);
+    }
+    s->count++;
+    gint64 t = parse_version_timestamp(ts);
+    if (t > s->last_recorded) s->last_recorded = t;
+}
+
+/* Read the versions index once and summarise it per original path.
+ * Runs in a worker thread, so it must not touch any widget. */
+static GHashTable *load_version_summaries(void) {
+    GHashTable *summaries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     const char *data_dir = "data";
-    /* Try JSON index first (if available), otherwise fallback to text index */
 #ifdef HAVE_JSON_GLIB
     gchar *index_path = g_build_filename(data_dir, "versions_index.json", NULL);
     if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-        GError *error = NULL;
         JsonParser *parser = json_parser_new();
-        if (!json_parser_load_from_file(parser, index_path, &error)) {
-            g_printerr("Failed to parse versions index JSON: %s\n", error ? error->message : "unknown");
-            g_clear_error(&error);
-        } else {
+        if (json_parser_load_from_file(parser, index_path, NULL)) {
             JsonNode *root = json_parser_get_root(parser);
             if (JSON_NODE_HOLDS_ARRAY(root)) {
                 JsonArray *arr = json_node_get_array(root);
@@ -106,161 +131,730 @@ void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, co
                     if (!JSON_NODE_HOLDS_OBJECT(elem)) continue;
                     JsonObject *obj = json_node_get_object(elem);
                     const char *orig = json_object_get_string_member(obj, "original");
-                    const char *stored = json_object_get_string_member(obj, "stored");
                     const char *ts = json_object_get_string_member(obj, "timestamp");
-                    if (!orig || !stored) continue;
-                    if (g_strcmp0(orig, original_path) == 0) {
-                        char timestr_human[128] = {0};
-                        if (ts && strlen(ts) >= 14) {
-                            struct tm tm = {0};
-                            char buf2[5];
-                            memcpy(buf2, ts+0, 4); buf2[4]='\0'; tm.tm_year = atoi(buf2) - 1900;
-                            memcpy(buf2, ts+4, 2); buf2[2]='\0'; tm.tm_mon = atoi(buf2) - 1;
-                            memcpy(buf2, ts+6, 2); buf2[2]='\0'; tm.tm_mday = atoi(buf2);
-                            memcpy(buf2, ts+8, 2); buf2[2]='\0'; tm.tm_hour = atoi(buf2);
-                            memcpy(buf2, ts+10,2); buf2[2]='\0'; tm.tm_min = atoi(buf2);
-                            memcpy(buf2, ts+12,2); buf2[2]='\0'; tm.tm_sec = atoi(buf2);
-                            strftime(timestr_human, sizeof(timestr_human), "%Y-%m-%d %H:%M:%S", &tm);
-                        } else if (ts) {
-                            g_strlcpy(timestr_human, ts, sizeof(timestr_human));
-                        }
-
-                        gchar *label_text = g_strdup_printf("%s  %s", stored, timestr_human);
-
-                        GtkWidget *vrow = gtk_list_box_row_new();
-                        GtkWidget *vlabel = gtk_label_new(label_text);
-                        gtk_widget_set_halign(vlabel, GTK_ALIGN_START);
-                        gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(vrow), vlabel);
-
-                        gchar *stored_path = g_build_filename("data", "versions", stored, NULL);
-                        g_object_set_data_full(G_OBJECT(vrow), "version-path", g_strdup(stored_path), g_free);
-                        g_object_set_data_full(G_OBJECT(vrow), "file-path", g_strdup(stored_path), g_free); // Set file-path for comparison
-                        g_free(stored_path);
-
-                        /* Attach right-click gesture to version row so user can open/delete the version */
-                        GtkGesture *right_click = gtk_gesture_click_new();
-                        gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(right_click), GDK_BUTTON_SECONDARY);
-                        gtk_gesture_single_set_exclusive(GTK_GESTURE_SINGLE(right_click), FALSE);
-                        g_signal_connect(right_click, "pressed", G_CALLBACK(on_widget_right_click), (gpointer)"version-element");
-                        gtk_widget_add_controller(vrow, GTK_EVENT_CONTROLLER(right_click));
-
-                        gtk_list_box_append(GTK_LIST_BOX(versions_list), vrow);
-                        g_free(label_text);
-                    }
+                    if (orig) summary_add(summaries, orig, ts);
                 }
             }
         }
         g_object_unref(parser);
         g_free(index_path);
-        return;
+        return summaries;
     }
+    g_free(index_path);
 #endif
-
-    /* Fallback: read text-based index */
     gchar *index_path_txt = g_build_filename(data_dir, "versions_index.txt", NULL);
-    if (!g_file_test(index_path_txt, G_FILE_TEST_EXISTS)) { g_free(index_path_txt); return; }
     FILE *f = fopen(index_path_txt, "r");
-    if (!f) { g_free(index_path_txt); return; }
-    char line[4096];
-    while (fgets(line, sizeof(line), f)) {
-        char *nl = strchr(line, '\n'); if (nl) *nl = '\0';
-        char *p1 = strchr(line, '|');
-        if (!p1) continue;
-        *p1 = '\0';
-        char *p2 = strchr(p1 + 1, '|');
-        if (!p2) continue;
-        *p2 = '\0';
-        const char *orig = line;
-        const char *stored = p1 + 1;
-        const char *ts = p2 + 1;
-        if (g_strcmp0(orig, original_path) == 0) {
-            char timestr_human[128] = {0};
-            if (strlen(ts) >= 14) {
-                struct tm tm = {0};
-                char buf2[5];
-                memcpy(buf2, ts+0, 4); buf2[4]='\0'; tm.tm_year = atoi(buf2) - 1900;
-                memcpy(buf2, ts+4, 2); buf2[2]='\0'; tm.tm_mon = atoi(buf2) - 1;
-                memcpy(buf2, ts+6, 2); buf2[2]='\0'; tm.tm_mday = atoi(buf2);
-                memcpy(buf2, ts+8, 2); buf2[2]='\0'; tm.tm_hour = atoi(buf2);
-                memcpy(buf2, ts+10,2); buf2[2]='\0'; tm.tm_min = atoi(buf2);
-                memcpy(buf2, ts+12,2); buf2[2]='\0'; tm.tm_sec = atoi(buf2);
-                strftime(timestr_human, sizeof(timestr_human), "%Y-%m-%d %H:%M:%S", &tm);
-            } else {
-                g_strlcpy(timestr_human, ts, sizeof(timestr_human));
-            }
-
-            gchar *label_text = g_strdup_printf("%s  %s", stored, timestr_human);
-
-            GtkWidget *vrow = gtk_list_box_row_new();
-            /* Create two-column row: filename on left, timestamp on right */
-            GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-            GtkWidget *name_label = gtk_label_new(stored);
-            gtk_widget_set_halign(name_label, GTK_ALIGN_START);
-            gtk_widget_set_hexpand(name_label, TRUE);
-            gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
-
-            GtkWidget *time_label = gtk_label_new(timestr_human);
-            gtk_widget_set_halign(time_label, GTK_ALIGN_END);
-            gtk_widget_set_hexpand(time_label, FALSE);
-            gtk_label_set_xalign(GTK_LABEL(time_label), 1.0);
-
-            gtk_box_append(GTK_BOX(hbox), name_label);
-            gtk_box_append(GTK_BOX(hbox), time_label);
-            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(vrow), hbox);
-
-            gchar *stored_path = g_build_filename("data", "versions", stored, NULL);
-            g_object_set_data_full(G_OBJECT(vrow), "version-path", g_strdup(stored_path), g_free);
-            g_object_set_data_full(G_OBJECT(vrow), "file-path", g_strdup(stored_path), g_free); // Set file-path for comparison
-            /* Also store labels for potential updates */
-            g_object_set_data(G_OBJECT(vrow), "version-name-label", name_label);
-            g_object_set_data(G_OBJECT(vrow), "version-time-label", time_label);
-            g_free(stored_path);
-
-            /* Attach right-click gesture to version row so user can open/delete the version */
-            GtkGesture *right_click = gtk_gesture_click_new();
-            gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(right_click), GDK_BUTTON_SECONDARY);
-            gtk_gesture_single_set_exclusive(GTK_GESTURE_SINGLE(right_click), FALSE);
-            g_signal_connect(right_click, "pressed", G_CALLBACK(on_widget_right_click), (gpointer)"version-element");
-            gtk_widget_add_controller(vrow, GTK_EVENT_CONTROLLER(right_click));
-
-            gtk_list_box_append(GTK_LIST_BOX(versions_list), vrow);
-            g_free(label_text);
+    if (f) {
+        char line[4096];
+        while (fgets(line, sizeof(line), f)) {
+            char *nl = strpbrk(line, "\r\n"); if (nl) *nl = '\0';
+            char *p1 = strchr(line, '|');
+            if (!p1) continue;
+            *p1 = '\0';
+            char *p2 = strchr(p1 + 1, '|');
+            if (!p2) continue;
+            summary_add(summaries, line, p2 + 1);
         }
+        fclose(f);
     }
-    fclose(f);
     g_free(index_path_txt);
+    return summaries;
 }
 
-/* Open a stored version when its row is activated (double click) */
-static void on_version_activated(GtkListBox *box, GtkListBoxRow *row, gpointer user_data) {
-    if (!row) return;
-    const char *vpath = g_object_get_data(G_OBJECT(row), "version-path");
-    if (!vpath) return;
+static void apply_version_summaries(SidebarData *data, GHashTable *summaries, const char *only_path) {
+    guint n = g_list_model_get_n_items(G_LIST_MODEL(data->store));
+    for (guint i = 0; i < n; ++i) {
+        TrackedFile *item = g_list_model_get_item(G_LIST_MODEL(data->store), i);
+        const char *path = tracked_file_get_path(item);
+        if (!only_path || g_strcmp0(path, only_path) == 0) {
+            VersionSummary *s = g_hash_table_lookup(summaries, path);
+            tracked_file_set_versions(item, s ? s->count : 0, s ? s->last_recorded : -1);
+        }
+        g_object_unref(item);
+    }
+}
+
+// ---
+// --- Asynchronous stat population
+// ---
 
-#if defined(G_OS_WIN32)
-    gunichar2 *wpath = g_utf8_to_utf16(vpath, -1, NULL, NULL, NULL);
-    if (wpath) {
-        HINSTANCE res = ShellExecuteW(NULL, L"open", (LPCWSTR)wpath, NULL, NULL, SW_SHOWNORMAL);
-        g_free(wpath);
-        if ((intptr_t)res > 32) return; /* success */
+static void pump_stat_queue(SidebarData *data);
+
+typedef struct {
+    SidebarData *data;
+    TrackedFile *item;
+} StatRequest;
+
+static void stat_request_free(StatRequest *req) {
+    g_object_unref(req->item);
+    g_free(req);
+}
+
+static void apply_file_info(TrackedFile *item, GFileInfo *info) {
+    gint64 mtime = -1;
+    GDateTime *dt = g_file_info_get_modification_date_time(info);
+    if (dt) {
+        mtime = g_date_time_to_unix(dt);
+        g_date_time_unref(dt);
     }
-#endif
+    tracked_file_set_stat(item, g_file_info_get_size(info), mtime);
+}
 
+static void on_stat_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    StatRequest *req = (StatRequest *)user_data;
     GError *error = NULL;
-    char *uri = g_filename_to_uri(vpath, NULL, &error);
-    if (uri) {
-        gboolean launched = g_app_info_launch_default_for_uri(uri, NULL, &error);
-        if (!launched) {
-            g_printerr("Failed to open version '%s': %s\n", uri, error ? error->message : "unknown");
-            g_clear_error(&error);
-        }
-        g_free(uri);
+    GFileInfo *info = g_file_query_info_finish(G_FILE(source), res, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        /* The sidebar is gone; req->data must not be touched */
+        g_error_free(error);
+        stat_request_free(req);
+        return;
+    }
+
+    if (info) {
+        apply_file_info(req->item, info);
+        g_object_unref(info);
     } else {
-        g_printerr("on_version_activated: failed to build uri for %s: %s\n", vpath, error ? error->message : "unknown");
+        /* Missing or unreadable: mark as stat'ed so the row stops waiting */
+        tracked_file_set_stat(req->item, -1, -1);
+        g_clear_error(&error);
+    }
+
+    SidebarData *data = req->data;
+    data->stats_in_flight--;
+    stat_request_free(req);
+    pump_stat_queue(data);
+}
+
+/* Keep at most STAT_BATCH_SIZE queries outstanding; low priority so the UI wins */
+static void pump_stat_queue(SidebarData *data) {
+    while (data->stats_in_flight < STAT_BATCH_SIZE && !g_queue_is_empty(&data->stat_queue)) {
+        TrackedFile *item = g_queue_pop_head(&data->stat_queue);
+        StatRequest *req = g_new0(StatRequest, 1);
+        req->data = data;
+        req->item = item; /* takes the queue's reference */
+        GFile *file = g_file_new_for_path(tracked_file_get_path(item));
+        data->stats_in_flight++;
+        g_file_query_info_async(file, STAT_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+                                data->cancellable, on_stat_ready, req);
+        g_object_unref(file);
+    }
+}
+
+/* A directory with many tracked files is listed once instead of stat'ing each file */
+typedef struct {
+    SidebarData *data;
+    GFileEnumerator *enumerator;
+    GHashTable *by_name; /* basename -> TrackedFile (owned ref) */
+} DirScan;
+
+static void dir_scan_free(DirScan *scan) {
+    if (scan->enumerator) g_object_unref(scan->enumerator);
+    g_hash_table_unref(scan->by_name);
+    g_free(scan);
+}
+
+/* Whatever the enumeration did not find goes through the per-file path */
+static void dir_scan_finish(DirScan *scan) {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, scan->by_name);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_queue_push_tail(&scan->data->stat_queue, g_object_ref(value));
+    }
+    SidebarData *data = scan->data;
+    dir_scan_free(scan);
+    pump_stat_queue(data);
+}
+
+static void on_dir_batch_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    DirScan *scan = (DirScan *)user_data;
+    GError *error = NULL;
+    GList *infos = g_file_enumerator_next_files_finish(G_FILE_ENUMERATOR(source), res, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        dir_scan_free(scan);
+        return;
+    }
+    if (error || !infos) {
         g_clear_error(&error);
+        dir_scan_finish(scan);
+        return;
+    }
+
+    for (GList *l = infos; l; l = l->next) {
+        GFileInfo *info = G_FILE_INFO(l->data);
+        const char *name = g_file_info_get_name(info);
+        TrackedFile *item = name ? g_hash_table_lookup(scan->by_name, name) : NULL;
+        if (item) {
+            apply_file_info(item, info);
+            g_hash_table_remove(scan->by_name, name);
+        }
+    }
+    g_list_free_full(infos, g_object_unref);
+
+    if (g_hash_table_size(scan->by_name) == 0) {
+        dir_scan_free(scan);
+        return;
+    }
+    g_file_enumerator_next_files_async(scan->enumerator, ENUMERATE_BATCH_SIZE, G_PRIORITY_LOW,
+                                       scan->data->cancellable, on_dir_batch_ready, scan);
+}
+
+static void on_dir_enumerate_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    DirScan *scan = (DirScan *)user_data;
+    GError *error = NULL;
+    scan->enumerator = g_file_enumerate_children_finish(G_FILE(source), res, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        dir_scan_free(scan);
+        return;
+    }
+    if (!scan->enumerator) {
+        g_clear_error(&error);
+        dir_scan_finish(scan);
+        return;
+    }
+    g_file_enumerator_next_files_async(scan->enumerator, ENUMERATE_BATCH_SIZE, G_PRIORITY_LOW,
+                                       scan->data->cancellable, on_dir_batch_ready, scan);
+}
+
+/* Start filling size/mtime for the given items, grouped by directory */
+static void queue_file_metadata(SidebarData *data, GPtrArray *items) {
+    GHashTable *by_dir = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_ptr_array_unref);
+    for (guint i = 0; i < items->len; ++i) {
+        TrackedFile *item = g_ptr_array_index(items, i);
+        gchar *dir = g_path_get_dirname(tracked_file_get_path(item));
+        GPtrArray *group = g_hash_table_lookup(by_dir, dir);
+        if (!group) {
+            group = g_ptr_array_new();
+            g_hash_table_insert(by_dir, dir, group);
+        } else {
+            g_free(dir);
+        }
+        g_ptr_array_add(group, item);
+    }
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, by_dir);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *group = value;
+        if (group->len >= ENUMERATE_MIN_FILES) {
+            DirScan *scan = g_new0(DirScan, 1);
+            scan->data = data;
+            scan->by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+            for (guint i = 0; i < group->len; ++i) {
+                TrackedFile *item = g_ptr_array_index(group, i);
+                g_hash_table_insert(scan->by_name, g_strdup(tracked_file_get_name(item)), g_object_ref(item));
+            }
+            GFile *dir = g_file_new_for_path(key);
+            g_file_enumerate_children_async(dir, STAT_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+                                            data->cancellable, on_dir_enumerate_ready, scan);
+            g_object_unref(dir);
+        } else {
+            for (guint i = 0; i < group->len; ++i) {
+                g_queue_push_tail(&data->stat_queue, g_object_ref(g_ptr_array_index(group, i)));
+            }
+        }
+    }
+    g_hash_table_unref(by_dir);
+    pump_stat_queue(data);
+}
+
+// ---
+// --- Startup: read files_index.txt and the versions index off the main thread
+// ---
+
+typedef struct {
+    GPtrArray *paths;      /* char*, in index order */
+    GHashTable *summaries; /* original path -> VersionSummary */
+} IndexLoadResult;
+
+static void index_load_result_free(IndexLoadResult *r) {
+    if (!r) return;
+    if (r->paths) g_ptr_array_unref(r->paths);
+    if (r->summaries) g_hash_table_unref(r->summaries);
+    g_free(r);
+}
+
+static void load_index_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    gboolean summaries_only = GPOINTER_TO_INT(task_data);
+    IndexLoadResult *r = g_new0(IndexLoadResult, 1);
+
+    TRACE_SCOPE("sidebar.load_index");
+    gint64 started = g_get_monotonic_time();
+    if (!summaries_only) {
+        /* Load persisted files list from data/files_index.txt */
+        r->paths = g_ptr_array_new_with_free_func(g_free);
+        const char *data_dir = "data";
+        gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
+        FILE *f = fopen(index_path, "r");
+        if (f) {
+            char buf[4096];
+            while (fgets(buf, sizeof(buf), f)) {
+                char *nl = strpbrk(buf, "\r\n"); if (nl) *nl = '\0';
+                if (buf[0] != '\0') g_ptr_array_add(r->paths, g_strdup(buf));
+            }
+            fclose(f);
+        }
+        g_free(index_path);
+    }
+
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        r->summaries = load_version_summaries();
+    }
+    perf_counter_set(PERF_INDEX_LOAD_US, g_get_monotonic_time() - started);
+    g_task_return_pointer(task, r, (GDestroyNotify)index_load_result_free);
+}
+
+static void on_index_loaded(GObject *source, GAsyncResult *res, gpointer user_data) {
+    SidebarData *data = (SidebarData *)user_data;
+    GError *error = NULL;
+    IndexLoadResult *r = g_task_propagate_pointer(G_TASK(res), &error);
+    if (!r) {
+        /* Cancelled means the sidebar was destroyed: data is already freed */
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_printerr("Failed to load files index: %s\n", error ? error->message : "unknown");
+        g_clear_error(&error);
+        return;
+    }
+
+    /* Insert all rows with one splice so the list view only rebuilds once */
+    GPtrArray *items = g_ptr_array_new_with_free_func(g_object_unref);
+    for (guint i = 0; i < r->paths->len; ++i) {
+        g_ptr_array_add(items, tracked_file_new(g_ptr_array_index(r->paths, i)));
+    }
+    g_list_store_splice(data->store, g_list_model_get_n_items(G_LIST_MODEL(data->store)), 0,
+                        items->pdata, items->len);
+    if (r->summaries) apply_version_summaries(data, r->summaries, NULL);
+    queue_file_metadata(data, items);
+
+    g_ptr_array_unref(items);
+    index_load_result_free(r);
+}
+
+typedef struct {
+    SidebarData *data;
+    gchar *path;
+} SummaryRefresh;
+
+static void on_summaries_refreshed(GObject *source, GAsyncResult *res, gpointer user_data) {
+    SummaryRefresh *refresh = (SummaryRefresh *)user_data;
+    IndexLoadResult *r = g_task_propagate_pointer(G_TASK(res), NULL);
+    if (r) {
+        if (r->summaries) apply_version_summaries(refresh->data, r->summaries, refresh->path);
+        index_load_result_free(r);
+    }
+    g_free(refresh->path);
+    g_free(refresh);
+}
+
+/* Re-read version count and size/mtime for one tracked path */
+static void refresh_tracked_path(SidebarData *data, const char *path) {
+    guint n = g_list_model_get_n_items(G_LIST_MODEL(data->store));
+    for (guint i = 0; i < n; ++i) {
+        TrackedFile *item = g_list_model_get_item(G_LIST_MODEL(data->store), i);
+        if (g_strcmp0(tracked_file_get_path(item), path) == 0) {
+            g_queue_push_tail(&data->stat_queue, g_object_ref(item));
+        }
+        g_object_unref(item);
+    }
+    pump_stat_queue(data);
+
+    SummaryRefresh *refresh = g_new0(SummaryRefresh, 1);
+    refresh->data = data;
+    refresh->path = g_strdup(path);
+    GTask *task = g_task_new(NULL, data->cancellable, on_summaries_refreshed, refresh);
+    g_task_set_task_data(task, GINT_TO_POINTER(TRUE), NULL);
+    g_task_run_in_thread(task, load_index_thread);
+    g_object_unref(task);
+}
+
+void sidebar_refresh_file(GtkWindow *window, const char *path) {
+    if (!window || !path) return;
+    SidebarData *data = g_object_get_data(G_OBJECT(window), "sidebar-data");
+    if (data) refresh_tracked_path(data, path);
+}
+
+// ---
+// --- List item factory
+// ---
+
+static void update_file_row(GtkWidget *row, TrackedFile *item) {
+    GtkWidget *name_label = g_object_get_data(G_OBJECT(row), "label-widget");
+    GtkWidget *badge = g_object_get_data(G_OBJECT(row), "badge-widget");
+    GtkWidget *meta_label = g_object_get_data(G_OBJECT(row), "meta-widget");
+    const char *name = tracked_file_get_name(item);
+
+    gtk_label_set_text(GTK_LABEL(name_label), name ? name : "");
+    gtk_widget_set_name(row, name ? name : "");
+    /* Context menu actions read the path from the row widget */
+    g_object_set_data_full(G_OBJECT(row), "file-path", g_strdup(tracked_file_get_path(item)), g_free);
+
+    gtk_widget_set_visible(badge, tracked_file_get_changed(item));
+
+    GString *meta = g_string_new(NULL);
+    int count = tracked_file_get_version_count(item);
+    if (count >= 0) g_string_append_printf(meta, count == 1 ? "%d version" : "%d versions", count);
+    gint64 size = tracked_file_get_size(item);
+    if (size >= 0) {
+        gchar *size_str = g_format_size((guint64)size);
+        if (meta->len) g_string_append(meta, " · ");
+        g_string_append(meta, size_str);
+        g_free(size_str);
+    }
+    gtk_label_set_text(GTK_LABEL(meta_label), meta->str);
+    g_string_free(meta, TRUE);
+}
+
+static void on_tracked_file_notify(GObject *object, GParamSpec *pspec, gpointer user_data) {
+    update_file_row(GTK_WIDGET(user_data), TRACKED_FILE(object));
+}
+
+static void on_file_item_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *list_row_label = gtk_label_new(NULL);
+    gtk_widget_set_halign(list_row_label, GTK_ALIGN_START);
+    gtk_widget_set_hexpand(list_row_label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(list_row_label), 0.0);
+    gtk_label_set_wrap(GTK_LABEL(list_row_label), TRUE);
+
+    GtkWidget *badge = gtk_label_new("●");
+    gtk_widget_add_css_class(badge, "changed-badge");
+    gtk_widget_set_tooltip_text(badge, "Changed since the last recorded version");
+    gtk_widget_set_visible(badge, FALSE);
+
+    GtkWidget *meta_label = gtk_label_new(NULL);
+    gtk_widget_add_css_class(meta_label, "file-meta");
+    gtk_widget_set_halign(meta_label, GTK_ALIGN_END);
+
+    gtk_box_append(GTK_BOX(hbox), list_row_label);
+    gtk_box_append(GTK_BOX(hbox), badge);
+    gtk_box_append(GTK_BOX(hbox), meta_label);
+    g_object_set_data(G_OBJECT(hbox), "label-widget", list_row_label);
+    g_object_set_data(G_OBJECT(hbox), "badge-widget", badge);
+    g_object_set_data(G_OBJECT(hbox), "meta-widget", meta_label);
+
+    GtkGesture *right_click = gtk_gesture_click_new();
+    gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(right_click), GDK_BUTTON_SECONDARY);
+    /* Do not make the right-click gesture exclusive — that can prevent
+     * normal left-click selection from reaching the list view. */
+    gtk_gesture_single_set_exclusive(GTK_GESTURE_SINGLE(right_click), FALSE);
+    g_signal_connect(right_click, "pressed", G_CALLBACK(on_widget_right_click), (gpointer)"sidebar-element");
+    gtk_widget_add_controller(hbox, GTK_EVENT_CONTROLLER(right_click));
+
+    gtk_list_item_set_child(list_item, hbox);
+}
+
+static void on_file_item_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    GtkWidget *row = gtk_list_item_get_child(list_item);
+    TrackedFile *item = TRACKED_FILE(gtk_list_item_get_item(list_item));
+    /* The row keeps a ref so context menu actions can reach the model item */
+    g_object_set_data_full(G_OBJECT(row), "tracked-file", g_object_ref(item), g_object_unref);
+    update_file_row(row, item);
+    gulong handler = g_signal_connect(item, "notify", G_CALLBACK(on_tracked_file_notify), row);
+    g_object_set_data(G_OBJECT(row), "notify-handler", GSIZE_TO_POINTER(handler));
+}
+
+static void on_file_item_unbind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data) {
+    GtkWidget *row = gtk_list_item_get_child(list_item);
+    TrackedFile *item = g_object_get_data(G_OBJECT(row), "tracked-file");
+    gulong handler = GPOINTER_TO_SIZE(g_object_get_data(G_OBJECT(row), "notify-handler"));
+    if (item && handler) g_signal_handler_disconnect(item, handler);
+    g_object_set_data(G_OBJECT(row), "notify-handler", NULL);
+    g_object_set_data(G_OBJECT(row), "tracked-file", NULL);
+}
+
+/* Add a full path to the sidebar model (rows are created on demand by the factory) */
+static void add_path_to_list(SidebarData *data, const char *full_path) {
+    if (!data || !full_path) return;
+    guint n = g_list_model_get_n_items(G_LIST_MODEL(data->store));
+    for (guint i = 0; i < n; ++i) {
+        TrackedFile *existing = g_list_model_get_item(G_LIST_MODEL(data->store), i);
+        gboolean same = g_strcmp0(tracked_file_get_path(existing), full_path) == 0;
+        g_object_unref(existing);
+        if (same) return;
+    }
+    TrackedFile *item = tracked_file_new(full_path);
+    g_list_store_append(data->store, item);
+    g_object_unref(item);
+    refresh_tracked_path(data, full_path);
+}
+
+// ---
+// --- Change counts on version rows
+// ---
+
+typedef struct {
+    gchar *older;
+    gchar *newer;
+    DiffStats stats;
+    gboolean ok;
+} VersionStatsJob;
+
+static void version_stats_job_free(VersionStatsJob *job) {
+    g_free(job->older);
+    g_free(job->newer);
+    g_free(job);
+}
+
+static void set_stats_badge(GtkLabel *label, const DiffStats *stats) {
+    if (stats->binary) {
+        gtk_label_set_text(label, "binary");
+        return;
+    }
+    gchar *text = g_strdup_printf("%s+%u / \u2212%u", stats->approximate ? "~" : "",
+                                  stats->inserted, stats->deleted);
+    gtk_label_set_text(label, text);
+    g_free(text);
+}
+
+static void version_stats_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    VersionStatsJob *job = task_data;
+    job->ok = version_stats_get(job->older, job->newer, VERSION_STATS_MAX_D, &job->stats);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_version_stats_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    VersionStatsJob *job = g_task_get_task_data(G_TASK(res));
+    if (!job->ok) return;
+    /* The label is the task's source object, so it is still alive even if its row is gone */
+    set_stats_badge(GTK_LABEL(source), &job->stats);
+}
+
+static void request_version_stats(GtkWidget *badge) {
+    if (g_object_get_data(G_OBJECT(badge), "stats-requested")) return;
+    g_object_set_data(G_OBJECT(badge), "stats-requested", GINT_TO_POINTER(1));
+
+    const char *older = g_object_get_data(G_OBJECT(badge), "older-path");
+    const char *newer = g_object_get_data(G_OBJECT(badge), "newer-path");
+    /* Rows are rebuilt often; counts version_stats already has are shown without a worker round trip */
+    DiffStats stats;
+    if (version_stats_lookup(older, newer, VERSION_STATS_MAX_D, &stats)) {
+        set_stats_badge(GTK_LABEL(badge), &stats);
+        return;
+    }
+
+    VersionStatsJob *job = g_new0(VersionStatsJob, 1);
+    job->older = g_strdup(older);
+    job->newer = g_strdup(newer);
+    GTask *task = g_task_new(badge, NULL, on_version_stats_ready, NULL);
+    g_task_set_priority(task, G_PRIORITY_LOW);
+    g_task_set_task_data(task, job, (GDestroyNotify)version_stats_job_free);
+    g_task_run_in_thread(task, version_stats_thread);
+    g_object_unref(task);
+}
+
+/* Start counts for rows within a page of the visible part of the list */
+static void request_visible_version_stats(GtkWidget *versions_list) {
+    GtkWidget *scrolled = gtk_widget_get_ancestor(versions_list, GTK_TYPE_SCROLLED_WINDOW);
+    if (!scrolled) return;
+    GtkAdjustment *adj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled));
+    double page = gtk_adjustment_get_page_size(adj);
+    double top = MAX(gtk_adjustment_get_value(adj) - page, 0);
+    double bottom = gtk_adjustment_get_value(adj) + 2 * page;
+
+    /* From the first row in range to the first one past it, not the whole list */
+    GtkListBoxRow *first = gtk_list_box_get_row_at_y(GTK_LIST_BOX(versions_list), (int)top);
+    for (GtkWidget *row = GTK_WIDGET(first); row; row = gtk_widget_get_next_sibling(row)) {
+        graphene_rect_t bounds;
+        if (!gtk_widget_compute_bounds(row, versions_list, &bounds)) break; /* not laid out yet */
+        if (bounds.origin.y > bottom) break;
+        GtkWidget *badge = g_object_get_data(G_OBJECT(row), "stats-badge");
+        if (badge && !g_object_get_data(G_OBJECT(badge), "stats-requested")) request_version_stats(badge);
     }
 }
 
+static void on_versions_scrolled(GtkAdjustment *adj, gpointer user_data) {
+    request_visible_version_stats(GTK_WIDGET(user_data));
+}
+
+/* Counts are requested on scroll and after layout ("changed" fires when the list's height settles) */
+static void watch_versions_scrolling(GtkWidget *versions_list) {
+    if (g_object_get_data(G_OBJECT(versions_list), "stats-scroll-watch")) return;
+    GtkWidget *scrolled = gtk_widget_get_ancestor(versions_list, GTK_TYPE_SCROLLED_WINDOW);
+    if (!scrolled) return;
+    GtkAdjustment *adj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled));
+    g_signal_connect_object(adj, "value-changed", G_CALLBACK(on_versions_scrolled), versions_list, 0);
+    g_signal_connect_object(adj, "changed", G_CALLBACK(on_versions_scrolled), versions_list, 0);
+    g_object_set_data(G_OBJECT(versions_list), "stats-scroll-watch", GINT_TO_POINTER(1));
+}
+
+/* Badge for a version row showing lines added/removed since the previous version */
+static GtkWidget *new_stats_badge(GtkWidget *vrow, const char *older_path, const char *newer_path) {
+    GtkWidget *badge = gtk_label_new(older_path ? "\u2026" : "new");
+    gtk_widget_add_css_class(badge, "version-stats");
+    gtk_widget_set_halign(badge, GTK_ALIGN_END);
+    if (older_path) {
+        g_object_set_data_full(G_OBJECT(badge), "older-path", g_strdup(older_path), g_free);
+        g_object_set_data_full(G_OBJECT(badge), "newer-path", g_strdup(newer_path), g_free);
+        g_object_set_data(G_OBJECT(vrow), "stats-badge", badge);
+    }
+    return badge;
+}
+
+// ---
+// --- Versions search
+// ---
+
+typedef struct {
+    gchar *needle;
+    GHashTable *within;     /* stored names of the rows shown when the search started */
+    GHashTable *matches;
+    guint generation;
+} VersionSearchJob;
+
+static void version_search_job_free(VersionSearchJob *job) {
+    g_free(job->needle);
+    g_hash_table_unref(job->within);
+    if (job->matches) g_hash_table_unref(job->matches);
+    g_free(job);
+}
+
+static gchar *row_stored_name(GtkListBoxRow *row) {
+    const char *vpath = g_object_get_data(G_OBJECT(row), "version-path");
+    return vpath ? g_path_get_basename(vpath) : NULL;
+}
+
+/* Rows are hidden only once a search has answered; until then the previous result stays */
+static gboolean version_row_visible(GtkListBoxRow *row, gpointer user_data) {
+    GHashTable *matches = g_object_get_data(G_OBJECT(user_data), "search-matches");
+    if (!matches) return TRUE;
+    gchar *stored = row_stored_name(row);
+    gboolean visible = stored && g_hash_table_contains(matches, stored);
+    g_free(stored);
+    return visible;
+}
+
+static void version_search_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable) {
+    VersionSearchJob *job = task_data;
+    job->matches = trigram_index_search(job->needle, job->within);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_version_search_ready(GObject *source, GAsyncResult *res, gpointer user_data) {
+    VersionSearchJob *job = g_task_get_task_data(G_TASK(res));
+    /* A newer search (or a cleared entry) supersedes this one */
+    if (job->generation != GPOINTER_TO_UINT(g_object_get_data(source, "search-generation"))) return;
+    g_object_set_data_full(source, "search-matches", g_steal_pointer(&job->matches), (GDestroyNotify)g_hash_table_unref);
+    gtk_list_box_invalidate_filter(GTK_LIST_BOX(source));
+}
+
+void sidebar_search_versions(GtkListBox *versions_list, const char *needle) {
+    GObject *list = G_OBJECT(versions_list);
+    if (!g_object_get_data(list, "search-filter-set")) {
+        gtk_list_box_set_filter_func(versions_list, version_row_visible, versions_list, NULL);
+        g_object_set_data(list, "search-filter-set", GINT_TO_POINTER(1));
+    }
+    guint generation = GPOINTER_TO_UINT(g_object_get_data(list, "search-generation")) + 1;
+    g_object_set_data(list, "search-generation", GUINT_TO_POINTER(generation));
+    g_object_set_data_full(list, "search-needle", g_strdup(needle), g_free);
+
+    if (!needle || !*needle) {
+        g_object_set_data(list, "search-matches", NULL);
+        gtk_list_box_invalidate_filter(versions_list);
+        return;
+    }
+
+    /* Only the file being shown is searched, which keeps the final content check small */
+    VersionSearchJob *job = g_new0(VersionSearchJob, 1);
+    job->needle = g_strdup(needle);
+    job->within = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    job->generation = generation;
+    for (GtkWidget *row = gtk_widget_get_first_child(GTK_WIDGET(versions_list)); row; row = gtk_widget_get_next_sibling(row)) {
+        if (!GTK_IS_LIST_BOX_ROW(row)) continue;
+        gchar *stored = row_stored_name(GTK_LIST_BOX_ROW(row));
+        if (stored) g_hash_table_add(job->within, stored);
+    }
+
+    GTask *task = g_task_new(versions_list, NULL, on_version_search_ready, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)version_search_job_free);
+    g_task_run_in_thread(task, version_search_thread);
+    g_object_unref(task);
+}
+
+/* After the rows are rebuilt, search again so new versions are matched too */
+static void rerun_versions_search(GtkListBox *versions_list) {
+    const char *needle = g_object_get_data(G_OBJECT(versions_list), "search-needle");
+    if (!needle || !*needle) return;
+    gchar *copy = g_strdup(needle);
+    sidebar_search_versions(versions_list, copy);
+    g_free(copy);
+}
+
+/* YYYYmmddHHMMSS -> "YYYY-mm-dd HH:MM:SS" */
+static void format_version_time(char *out, gsize size, const char *ts) {
+    if (ts && strlen(ts) >= 14) {
+        g_snprintf(out, size, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s", ts, ts + 4, ts + 6, ts + 8, ts + 10, ts + 12);
+    } else {
+        g_strlcpy(out, ts ? ts : "", size);
+    }
+}
+
+static GtkWidget *new_version_row(const VersionEntry *entry, const char *prev_stored_path, const char *stored_path) {
+    char when[32];
+    format_version_time(when, sizeof(when), entry->timestamp);
+
+    GtkWidget *vrow = gtk_list_box_row_new();
+    /* Create two-column row: filename on left, timestamp on right */
+    GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget *name_label = gtk_label_new(entry->stored);
+    gtk_widget_set_halign(name_label, GTK_ALIGN_START);
+    gtk_widget_set_hexpand(name_label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
+
+    GtkWidget *time_label = gtk_label_new(when);
+    gtk_widget_set_halign(time_label, GTK_ALIGN_END);
+    gtk_widget_set_hexpand(time_label, FALSE);
+    gtk_label_set_xalign(GTK_LABEL(time_label), 1.0);
+
+    gtk_box_append(GTK_BOX(hbox), name_label);
+    gtk_box_append(GTK_BOX(hbox), time_label);
+    gtk_box_append(GTK_BOX(hbox), new_stats_badge(vrow, prev_stored_path, stored_path));
+    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(vrow), hbox);
+
+    g_object_set_data_full(G_OBJECT(vrow), "version-path", g_strdup(stored_path), g_free);
+    g_object_set_data_full(G_OBJECT(vrow), "file-path", g_strdup(stored_path), g_free); // Set file-path for comparison
+    /* Also store labels for potential updates */
+    g_object_set_data(G_OBJECT(vrow), "version-name-label", name_label);
+    g_object_set_data(G_OBJECT(vrow), "version-time-label", time_label);
+
+    /* Attach right-click gesture to version row so user can open/delete the version */
+    GtkGesture *right_click = gtk_gesture_click_new();
+    gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(right_click), GDK_BUTTON_SECONDARY);
+    gtk_gesture_single_set_exclusive(GTK_GESTURE_SINGLE(right_click), FALSE);
+    g_signal_connect(right_click, "pressed", G_CALLBACK(on_widget_right_click), (gpointer)"version-element");
+    gtk_widget_add_controller(vrow, GTK_EVENT_CONTROLLER(right_click));
+    return vrow;
+}
+
+/* Populate versions list for an original file path */
+void populate_versions_for_path(GtkWindow *parent, GtkListBox *versions_list, const char *original_path) {
+    if (!versions_list) return;
+    TRACE_SCOPE("versions.populate");
+    clear_list_box_widget(GTK_WIDGET(versions_list));
+    /* NULL would list every file's versions */
+    GPtrArray *versions = version_store_list(original_path ? original_path : "");
+    gchar *prev_stored_path = NULL;
+    for (guint i = 0; i < versions->len; ++i) {
+        const VersionEntry *entry = g_ptr_array_index(versions, i);
+        gchar *stored_path = version_store_stored_path(entry->stored);
+        gtk_list_box_append(versions_list, new_version_row(entry, prev_stored_path, stored_path));
+        g_free(prev_stored_path);
+        prev_stored_path = stored_path;
+    }
+    g_free(prev_stored_path);
+    perf_counter_set(PERF_VERSIONS_RENDERED, versions->len);
+    g_ptr_array_free(versions, TRUE);
+    watch_versions_scrolling(GTK_WIDGET(versions_list));
+    request_visible_version_stats(GTK_WIDGET(versions_list));
+    rerun_versions_search(versions_list);
+}
 
 // --- "Add Files" FINISH callback ---
 // GTK 4.10: This is the new GAsyncReadyCallback that handles the result
@@ -285,30 +879,10 @@ on_browse_open_finish(GObject *source, GAsyncResult *res, gpointer user_data) {
         char *full_path = g_file_get_path(file);
 
         /* Add to UI */
-        void add_path_to_list(SidebarData *data, const char *full_path);
         add_path_to_list(data, full_path);
 
         /* Persist in data/files_index.txt (create data dir if needed) */
-        const char *data_dir = "data";
-        g_mkdir_with_parents(data_dir, 0755);
-        gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
-        gboolean already = FALSE;
-        if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-            FILE *f = fopen(index_path, "r");
-            if (f) {
-                char buf[4096];
-                while (fgets(buf, sizeof(buf), f)) {
-                    char *nl = strchr(buf, '\n'); if (nl) *nl = '\0';
-                    if (g_strcmp0(buf, full_path) == 0) { already = TRUE; break; }
-                }
-                fclose(f);
-            }
-        }
-        if (!already) {
-            FILE *f = fopen(index_path, "a");
-            if (f) { fprintf(f, "%s\n", full_path); fclose(f); }
-        }
-        g_free(index_path);
+        version_store_track_file(full_path);
 
         g_free(full_path);
         g_object_unref(file); // Unref the file
@@ -352,7 +926,7 @@ static void on_browse_clicked(GtkButton *button, gpointer user_data) {
 // --- Data struct for the delete confirmation callback ---
 typedef struct {
     SidebarData *sidebar_data;
-    GtkListBoxRow *row_to_delete;
+    TrackedFile *item_to_delete;
 } DeleteCallbackData;
 
 
@@ -364,11 +938,13 @@ on_delete_response(GObject *source, GAsyncResult *res, gpointer user_data) {
     int response = gtk_alert_dialog_choose_finish(GTK_ALERT_DIALOG(source), res, NULL);
 
     if (response == 1) { // 1 is the "Delete" button
-        gtk_list_box_remove(
-            GTK_LIST_BOX(delete_data->sidebar_data->list_box),
-            GTK_WIDGET(delete_data->row_to_delete)
-        );
+        /* Look the item up again: the model may have changed while the dialog was open */
+        guint position;
+        if (g_list_store_find(delete_data->sidebar_data->store, delete_data->item_to_delete, &position)) {
+            g_list_store_remove(delete_data->sidebar_data->store, position);
+        }
     }
+    g_object_unref(delete_data->item_to_delete);
     g_free(delete_data);
 }
 
@@ -377,17 +953,15 @@ on_delete_response(GObject *source, GAsyncResult *res, gpointer user_data) {
 static void on_delete_clicked(GtkButton *button, gpointer user_data) {
     SidebarData *data = (SidebarData *)user_data;
 
-    GtkListBoxRow *selected_row = gtk_list_box_get_selected_row(
-        GTK_LIST_BOX(data->list_box)
-    );
+    gpointer selected_item = gtk_single_selection_get_selected_item(data->selection);
 
-    if (selected_row == NULL) {
+    if (selected_item == NULL) {
         return;
     }
 
     DeleteCallbackData *delete_data = g_new(DeleteCallbackData, 1);
     delete_data->sidebar_data = data;
-    delete_data->row_to_delete = selected_row;
+    delete_data->item_to_delete = g_object_ref(selected_item);
 
     GtkAlertDialog *alert = gtk_alert_dialog_new("Do you want to delete this file?");
     const char *buttons[] = {"Cancel", "Delete", NULL};
@@ -406,42 +980,48 @@ static void on_delete_clicked(GtkButton *button, gpointer user_data) {
 }
 
 // --- "List Selection" callback ---
-static void on_row_selected(GtkListBox *list_box, GtkListBoxRow *row, gpointer user_data) {
+static void on_selection_changed(GtkSingleSelection *selection, GParamSpec *pspec, gpointer user_data) {
     SidebarData *data = (SidebarData *)user_data;
-    gtk_widget_set_sensitive(data->delete_button, (row != NULL));
-
-    /* When a row is selected, populate the versions list on the right and show it. */
-    GtkWidget *toplevel = NULL;
-    GtkListBox *versions_list = NULL;
-    if (row != NULL) {
-        /* Get stored file path on the row */
-        const char *path = g_object_get_data(G_OBJECT(row), "file-path");
-        toplevel = gtk_widget_get_ancestor(GTK_WIDGET(row), GTK_TYPE_WINDOW);
-        if (toplevel) {
-            g_object_set_data(G_OBJECT(toplevel), "original-path", (gpointer)path);
-            GtkWidget *v = g_object_get_data(G_OBJECT(toplevel), "versions-list");
-            if (v && GTK_IS_LIST_BOX(v)) {
-                versions_list = GTK_LIST_BOX(v);
-                /* Ensure visible */
-                gtk_widget_set_visible(GTK_WIDGET(versions_list), TRUE);
-                /* Populate with versions for this path */
-                populate_versions_for_path(GTK_WINDOW(toplevel), versions_list, path ? path : "");
-            }
-        }
-    } else {
-        /* No selection: hide versions list if we can find it */
-        toplevel = gtk_widget_get_ancestor(GTK_WIDGET(list_box), GTK_TYPE_WINDOW);
-        if (toplevel) {
-            GtkWidget *v = g_object_get_data(G_OBJECT(toplevel), "versions-list");
-            if (v) gtk_widget_set_visible(v, FALSE);
+    gpointer item = gtk_single_selection_get_selected_item(selection);
+    gtk_widget_set_sensitive(data->delete_button, (item != NULL));
+
+    /* When a file is selected, populate the versions list on the right and show it. */
+    GtkWidget *toplevel = GTK_WIDGET(data->parent_window);
+    if (!toplevel) return;
+    GtkWidget *v = g_object_get_data(G_OBJECT(toplevel), "versions-list");
+    if (item != NULL) {
+        const char *path = tracked_file_get_path(TRACKED_FILE(item));
+        g_object_set_data_full(G_OBJECT(toplevel), "original-path", g_strdup(path), g_free);
+        if (v && GTK_IS_LIST_BOX(v)) {
+            /* Ensure visible */
+            gtk_widget_set_visible(v, TRUE);
+            /* Populate with versions for this path */
+            populate_versions_for_path(GTK_WINDOW(toplevel), GTK_LIST_BOX(v), path ? path : "");
         }
+    } else if (v) {
+        /* No selection: hide versions list */
+        gtk_widget_set_visible(v, FALSE);
     }
 }
 
+static void sidebar_data_free(SidebarData *data) {
+    /* Pending index loads and stat queries see G_IO_ERROR_CANCELLED and skip 'data' */
+    g_cancellable_cancel(data->cancellable);
+    g_object_unref(data->cancellable);
+    g_signal_handlers_disconnect_by_data(data->selection, data);
+    g_queue_clear_full(&data->stat_queue, g_object_unref);
+    if (data->parent_window) g_object_set_data(G_OBJECT(data->parent_window), "sidebar-data", NULL);
+    g_free(data);
+}
+
+static void on_sidebar_destroy(GtkWidget *widget, gpointer user_data) {
+    sidebar_data_free((SidebarData *)user_data);
+}
+
 
 // --- Main create_sidebar function (Modified) ---
 GtkWidget *create_sidebar(GtkWindow *parent_window) {
-    GtkWidget *sidebar_vbox, *button_hbox, *browse_button, *delete_button, *scrolled_window, *list_box, *icon;
+    GtkWidget *sidebar_vbox, *button_hbox, *browse_button, *delete_button, *scrolled_window, *list_view, *icon;
 
     sidebar_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
     button_hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
@@ -473,25 +1053,44 @@ GtkWidget *create_sidebar(GtkWindow *parent_window) {
     gtk_box_append(GTK_BOX(button_hbox), browse_button);
     gtk_box_append(GTK_BOX(button_hbox), delete_button);
 
-    // 6. Create list box
+    // 6. Create the model and a list view that only builds rows for visible items
+    SidebarData *callback_data = g_new0(SidebarData, 1);
+    callback_data->parent_window = parent_window;
+    callback_data->delete_button = delete_button;
+    callback_data->cancellable = g_cancellable_new();
+    g_queue_init(&callback_data->stat_queue);
+
+    callback_data->store = g_list_store_new(TRACKED_TYPE_FILE);
+    callback_data->selection = gtk_single_selection_new(G_LIST_MODEL(callback_data->store));
+    gtk_single_selection_set_autoselect(callback_data->selection, FALSE);
+    gtk_single_selection_set_can_unselect(callback_data->selection, TRUE);
+
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(on_file_item_setup), callback_data);
+    g_signal_connect(factory, "bind", G_CALLBACK(on_file_item_bind), callback_data);
+    g_signal_connect(factory, "unbind", G_CALLBACK(on_file_item_unbind), callback_data);
+
     scrolled_window = gtk_scrolled_window_new();
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-    list_box = gtk_list_box_new();
-    gtk_widget_set_name(list_box, "file-list-box"); // For CSS
-    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), list_box);
+    /* The selection owns the store and the list view owns both the selection and
+     * the factory; SidebarData only keeps borrowed pointers. */
+    list_view = gtk_list_view_new(GTK_SELECTION_MODEL(callback_data->selection), factory);
+    gtk_widget_set_name(list_view, "file-list-box"); // For CSS
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled_window), list_view);
+    callback_data->list_view = list_view;
 
-    // 7. Create and fill the SidebarData struct
-    SidebarData *callback_data = g_new(SidebarData, 1);
-    callback_data->parent_window = parent_window;
-    callback_data->list_box = list_box;
-    callback_data->delete_button = delete_button;
+    // 7. Expose the model so context menu actions can update or remove items
+    if (parent_window) {
+        g_object_set_data(G_OBJECT(parent_window), "files-store", callback_data->store);
+        g_object_set_data(G_OBJECT(parent_window), "sidebar-data", callback_data);
+    }
 
     // 8. Connect all signals
     g_signal_connect(browse_button, "clicked", G_CALLBACK(on_browse_clicked), callback_data);
     g_signal_connect(delete_button, "clicked", G_CALLBACK(on_delete_clicked), callback_data);
-    g_signal_connect(list_box, "row-selected", G_CALLBACK(on_row_selected), callback_data);
-    g_signal_connect(sidebar_vbox, "destroy", G_CALLBACK(g_free), callback_data);
+    g_signal_connect(callback_data->selection, "notify::selected-item", G_CALLBACK(on_selection_changed), callback_data);
+    g_signal_connect(sidebar_vbox, "destroy", G_CALLBACK(on_sidebar_destroy), callback_data);
 
     // 9. Pack main sidebar
     gtk_box_append(GTK_BOX(sidebar_vbox), button_hbox);
@@ -499,23 +1098,12 @@ GtkWidget *create_sidebar(GtkWindow *parent_window) {
     gtk_widget_set_valign(scrolled_window, GTK_ALIGN_FILL);
     gtk_box_append(GTK_BOX(sidebar_vbox), scrolled_window);
 
-    /* Load persisted files list from data/files_index.txt */
-    const char *data_dir = "data";
-    gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
-    if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
-        FILE *f = fopen(index_path, "r");
-        if (f) {
-            char buf[4096];
-            while (fgets(buf, sizeof(buf), f)) {
-                char *nl = strchr(buf, '\n'); if (nl) *nl = '\0';
-                if (buf[0] != '\0') {
-                    add_path_to_list(callback_data, buf);
-                }
-            }
-            fclose(f);
-        }
-    }
-    g_free(index_path);
+    /* Load the persisted files list and version counts in a worker thread;
+     * rows appear when it finishes and metadata fills in afterwards. */
+    GTask *task = g_task_new(NULL, callback_data->cancellable, on_index_loaded, callback_data);
+    g_task_set_task_data(task, GINT_TO_POINTER(FALSE), NULL);
+    g_task_run_in_thread(task, load_index_thread);
+    g_object_unref(task);
 
     return sidebar_vbox;
 }
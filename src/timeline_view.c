@@ -0,0 +1,287 @@
+#include "timeline_view.h"
+#include "diff_view.h"
+#include "version_stats.h"
+#include "version_store.h"
+#include "work_pool.h"
+#include "trace.h"
+#include <math.h>
+#include <string.h>
+
+/* Redraws while counts are arriving are batched to at most one per this many ms */
+#define TIMELINE_REFRESH_MS 100
+
+/*
+ * Shared between the window and the worker threads, hence reference counted.
+ * The widgets are only touched on the main thread and are NULL once the
+ * window is gone; pair i is versions i -> i + 1.
+ */
+typedef struct {
+    GtkWidget *area;
+    GtkWidget *status;
+    GPtrArray *versions;    /* VersionEntry*, oldest first */
+    GPtrArray *paths;       /* stored path of each version */
+    DiffStats *stats;
+    gint *done;             /* per pair, set once stats[i] is filled in */
+    guint n_pairs;
+    gint completed;
+    gint refresh_queued;
+    gint cancelled;
+} Timeline;
+
+static void timeline_clear(gpointer data) {
+    Timeline *tl = data;
+    g_ptr_array_free(tl->versions, TRUE);
+    g_ptr_array_free(tl->paths, TRUE);
+    g_free(tl->stats);
+    g_free(tl->done);
+}
+
+static Timeline *timeline_ref(Timeline *tl) {
+    return g_atomic_rc_box_acquire(tl);
+}
+
+static void timeline_unref(gpointer tl) {
+    g_atomic_rc_box_release_full(tl, timeline_clear);
+}
+
+/* YYYYmmddHHMMSS -> "YYYY-mm-dd HH:MM" */
+static void format_timestamp(char *out, gsize size, const char *ts) {
+    if (ts && strlen(ts) >= 12) {
+        g_snprintf(out, size, "%.4s-%.2s-%.2s %.2s:%.2s", ts, ts + 4, ts + 6, ts + 8, ts + 10);
+    } else {
+        g_strlcpy(out, ts ? ts : "", size);
+    }
+}
+
+// ---
+// --- Computing the counts
+// ---
+
+static gboolean refresh_timeline(gpointer user_data) {
+    Timeline *tl = user_data;
+    g_atomic_int_set(&tl->refresh_queued, 0);
+    if (!tl->area) return G_SOURCE_REMOVE;
+
+    guint completed = (guint)g_atomic_int_get(&tl->completed);
+    gchar *message = completed < tl->n_pairs
+        ? g_strdup_printf("Compared %u of %u consecutive versions…", completed, tl->n_pairs)
+        : g_strdup_printf("%u versions. Hover a bar for its counts, click it to see the diff.", tl->versions->len);
+    gtk_label_set_text(GTK_LABEL(tl->status), message);
+    g_free(message);
+    gtk_widget_queue_draw(tl->area);
+    return G_SOURCE_REMOVE;
+}
+
+static void compute_pair(gpointer item, gpointer user_data) {
+    Timeline *tl = user_data;
+    if (g_atomic_int_get(&tl->cancelled)) return;
+    guint i = GPOINTER_TO_UINT(item) - 1;
+    if (!version_stats_get(g_ptr_array_index(tl->paths, i), g_ptr_array_index(tl->paths, i + 1),
+                           VERSION_STATS_MAX_D, &tl->stats[i])) {
+        memset(&tl->stats[i], 0, sizeof(DiffStats));
+    }
+    g_atomic_int_set(&tl->done[i], 1);
+    g_atomic_int_inc(&tl->completed);
+    if (g_atomic_int_compare_and_exchange(&tl->refresh_queued, 0, 1)) {
+        g_timeout_add_full(G_PRIORITY_LOW, TIMELINE_REFRESH_MS, refresh_timeline, timeline_ref(tl), timeline_unref);
+    }
+}
+
+/* Runs the pool from its own thread, since freeing it waits for every pair */
+static gpointer compute_timeline(gpointer data) {
+    Timeline *tl = data;
+    TRACE_THREAD_NAME("timeline");
+    TRACE_SCOPE("timeline.compute");
+    TRACE_SCOPE_ARG("pairs", tl->n_pairs);
+    WorkPool *pool = work_pool_new(0, compute_pair, tl);
+    for (guint i = 0; i < tl->n_pairs; ++i) work_pool_push(pool, GUINT_TO_POINTER(i + 1));
+    work_pool_free(pool);
+    timeline_unref(tl);
+    return NULL;
+}
+
+// ---
+// --- Drawing
+// ---
+
+/* One bar per pair, or per pixel column when there are more pairs than pixels */
+static guint n_bars(const Timeline *tl, int width) {
+    return width > 0 ? MIN(tl->n_pairs, (guint)width) : 0;
+}
+
+/* Pairs [first, last) under bar 'bar' */
+static void bar_pairs(const Timeline *tl, guint bars, guint bar, guint *first, guint *last) {
+    *first = (guint)((guint64)bar * tl->n_pairs / bars);
+    *last = (guint)((guint64)(bar + 1) * tl->n_pairs / bars);
+}
+
+/* Largest counts among the computed pairs of a bar; FALSE if none is computed yet */
+static gboolean bar_peak(const Timeline *tl, guint first, guint last, guint *inserted, guint *deleted, guint *pair) {
+    gboolean any = FALSE;
+    *inserted = *deleted = 0;
+    for (guint i = first; i < last; ++i) {
+        if (!g_atomic_int_get(&tl->done[i])) continue;
+        const DiffStats *stats = &tl->stats[i];
+        /* Binary pairs have nothing counted; any counted pair under the bar is shown instead */
+        if (!any || (tl->stats[*pair].binary && !stats->binary) ||
+            (!stats->binary && stats->inserted + stats->deleted > *inserted + *deleted)) {
+            *inserted = stats->inserted;
+            *deleted = stats->deleted;
+            *pair = i;
+        }
+        any = TRUE;
+    }
+    return any;
+}
+
+static void draw_timeline(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data) {
+    Timeline *tl = user_data;
+    cairo_set_source_rgb(cr, 0.98, 0.98, 0.98);
+    cairo_paint(cr);
+
+    double mid = height / 2.0;
+    cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+    cairo_rectangle(cr, 0, floor(mid), width, 1);
+    cairo_fill(cr);
+
+    guint bars = n_bars(tl, width);
+    if (bars == 0) return;
+
+    /* One scale for both halves, so a bar's two sides compare */
+    guint peak = 0;
+    for (guint i = 0; i < tl->n_pairs; ++i) {
+        if (!g_atomic_int_get(&tl->done[i])) continue;
+        peak = MAX(peak, MAX(tl->stats[i].inserted, tl->stats[i].deleted));
+    }
+    double scale = peak > 0 ? (mid - 4) / log1p(peak) : 0;
+
+    double bar_width = (double)width / bars;
+    double gap = bar_width >= 4 ? 1 : 0;
+    for (guint b = 0; b < bars; ++b) {
+        guint first, last, inserted, deleted, pair;
+        bar_pairs(tl, bars, b, &first, &last);
+        double x = b * bar_width;
+        if (!bar_peak(tl, first, last, &inserted, &deleted, &pair)) {
+            cairo_set_source_rgb(cr, 0.85, 0.85, 0.85);
+            cairo_rectangle(cr, x, mid - 2, bar_width - gap, 4);
+            cairo_fill(cr);
+            continue;
+        }
+        if (tl->stats[pair].binary) {
+            cairo_set_source_rgb(cr, 0.45, 0.45, 0.55);
+            cairo_rectangle(cr, x, mid - 6, bar_width - gap, 12);
+            cairo_fill(cr);
+            continue;
+        }
+        double up = log1p(inserted) * scale;
+        double down = log1p(deleted) * scale;
+        cairo_set_source_rgb(cr, 0.18, 0.63, 0.26);
+        cairo_rectangle(cr, x, mid - up, bar_width - gap, up);
+        cairo_fill(cr);
+        cairo_set_source_rgb(cr, 0.81, 0.13, 0.18);
+        cairo_rectangle(cr, x, mid, bar_width - gap, down);
+        cairo_fill(cr);
+    }
+}
+
+static gboolean on_timeline_query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboard_mode,
+                                          GtkTooltip *tooltip, gpointer user_data) {
+    Timeline *tl = user_data;
+    int width = gtk_widget_get_width(widget);
+    guint bars = n_bars(tl, width);
+    if (bars == 0 || x < 0 || x >= width) return FALSE;
+
+    guint first, last, inserted, deleted, pair;
+    bar_pairs(tl, bars, (guint)((guint64)x * bars / width), &first, &last);
+    gchar *text;
+    if (!bar_peak(tl, first, last, &inserted, &deleted, &pair)) {
+        text = g_strdup_printf("v%u → v%u: not compared yet", first + 1, last + 1);
+    } else {
+        const VersionEntry *entry = g_ptr_array_index(tl->versions, pair + 1);
+        char when[32];
+        format_timestamp(when, sizeof(when), entry->timestamp);
+        if (tl->stats[pair].binary) {
+            text = g_strdup_printf("v%u → v%u (%s): binary, no lines to count", pair + 1, pair + 2, when);
+        } else {
+            text = g_strdup_printf("v%u → v%u (%s): %s+%u / −%u%s", pair + 1, pair + 2, when,
+                                   tl->stats[pair].approximate ? "~" : "", inserted, deleted,
+                                   last - first > 1 ? "\nlargest of the versions under this bar" : "");
+        }
+    }
+    gtk_tooltip_set_text(tooltip, text);
+    g_free(text);
+    return TRUE;
+}
+
+static void on_timeline_pressed(GtkGestureClick *gesture, int n_press, double x, double y, gpointer user_data) {
+    Timeline *tl = user_data;
+    int width = gtk_widget_get_width(tl->area);
+    guint bars = n_bars(tl, width);
+    if (bars == 0 || x < 0 || x >= width) return;
+
+    guint first, last, inserted, deleted, pair;
+    bar_pairs(tl, bars, (guint)(x * bars / width), &first, &last);
+    if (!bar_peak(tl, first, last, &inserted, &deleted, &pair)) return;
+    create_diff_window(GTK_WINDOW(gtk_widget_get_root(tl->area)), g_ptr_array_index(tl->paths, pair),
+                       g_ptr_array_index(tl->paths, pair + 1));
+}
+
+static void on_timeline_destroy(GtkWidget *window, gpointer user_data) {
+    Timeline *tl = user_data;
+    tl->area = NULL;
+    tl->status = NULL;
+    g_atomic_int_set(&tl->cancelled, 1);
+    timeline_unref(tl);
+}
+
+// ---
+// --- Window
+// ---
+
+void create_timeline_window(GtkWindow *parent, const char *original_path) {
+    Timeline *tl = g_atomic_rc_box_new0(Timeline);
+    /* Recording order, as populate_versions_for_path() lists them */
+    tl->versions = version_store_list(original_path);
+    tl->paths = g_ptr_array_new_full(tl->versions->len, g_free);
+    for (guint i = 0; i < tl->versions->len; ++i) {
+        const VersionEntry *entry = g_ptr_array_index(tl->versions, i);
+        g_ptr_array_add(tl->paths, version_store_stored_path(entry->stored));
+    }
+    tl->n_pairs = tl->versions->len > 1 ? tl->versions->len - 1 : 0;
+    tl->stats = g_new0(DiffStats, MAX(tl->n_pairs, 1));
+    tl->done = g_new0(gint, MAX(tl->n_pairs, 1));
+
+    GtkWidget *window = gtk_window_new();
+    gchar *basename = g_path_get_basename(original_path);
+    gchar *title = g_strdup_printf("Timeline of %s", basename);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_default_size(GTK_WINDOW(window), 900, 300);
+    gtk_window_set_transient_for(GTK_WINDOW(window), parent);
+    g_free(title);
+    g_free(basename);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    tl->status = gtk_label_new(tl->n_pairs > 0 ? "Comparing versions…" : "Fewer than two versions recorded.");
+    gtk_widget_set_halign(tl->status, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(tl->status, 10);
+    gtk_widget_set_margin_top(tl->status, 5);
+    gtk_widget_set_margin_bottom(tl->status, 5);
+    gtk_box_append(GTK_BOX(vbox), tl->status);
+
+    tl->area = gtk_drawing_area_new();
+    gtk_widget_set_vexpand(tl->area, TRUE);
+    gtk_widget_set_hexpand(tl->area, TRUE);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(tl->area), draw_timeline, tl, NULL);
+    gtk_widget_set_has_tooltip(tl->area, TRUE);
+    g_signal_connect(tl->area, "query-tooltip", G_CALLBACK(on_timeline_query_tooltip), tl);
+    GtkGesture *click = gtk_gesture_click_new();
+    g_signal_connect(click, "pressed", G_CALLBACK(on_timeline_pressed), tl);
+    gtk_widget_add_controller(tl->area, GTK_EVENT_CONTROLLER(click));
+    gtk_box_append(GTK_BOX(vbox), tl->area);
+
+    gtk_window_set_child(GTK_WINDOW(window), vbox);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_timeline_destroy), tl);
+    gtk_window_present(GTK_WINDOW(window));
+
+    if (tl->n_pairs > 0) g_thread_unref(g_thread_new("timeline", compute_timeline, timeline_ref(tl)));
+}
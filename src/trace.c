@@ -0,0 +1,139 @@
+#include "trace.h"
+
+#ifdef GH_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Spans kept per thread; a power of two so the ring index is a mask */
+#define TRACE_RING_SIZE 16384
+
+typedef struct {
+    const char *name;
+    const char *arg_name;
+    gint64 arg;
+    gint64 start_us;
+    gint64 duration_us;
+} TraceEvent;
+
+/*
+ * One per thread. Only the owning thread writes events; it publishes each
+ * one by advancing 'head' afterwards. A dump copies the published range and
+ * then drops whatever the owner may have overwritten while it was copying.
+ * Rings are never freed, so threads that have exited still show up.
+ */
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    guint head;                 /* events written so far, atomic */
+    guint tid;
+    const char *thread_name;
+    struct TraceRing *next;
+} TraceRing;
+
+static TraceRing *rings;        /* lock-free list, pushed at the head */
+static gint next_tid = 1;
+static GPrivate current_ring;
+static const char *dump_path;
+
+static TraceRing *thread_ring(void) {
+    TraceRing *ring = g_private_get(&current_ring);
+    if (ring) return ring;
+
+    ring = g_new0(TraceRing, 1);
+    ring->tid = (guint)g_atomic_int_add(&next_tid, 1);
+    TraceRing *head;
+    do {
+        head = g_atomic_pointer_get(&rings);
+        ring->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&rings, head, ring));
+    g_private_set(&current_ring, ring);
+    return ring;
+}
+
+void trace_span_end(TraceSpan *span) {
+    gint64 now = g_get_monotonic_time();
+    TraceRing *ring = thread_ring();
+    guint head = (guint)g_atomic_int_get((gint *)&ring->head);
+    TraceEvent *event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->name = span->name;
+    event->arg_name = span->arg_name;
+    event->arg = span->arg;
+    event->start_us = span->start_us;
+    event->duration_us = now - span->start_us;
+    g_atomic_int_set((gint *)&ring->head, (gint)(head + 1));
+}
+
+void trace_set_thread_name(const char *name) {
+    thread_ring()->thread_name = name;
+}
+
+const char *trace_default_path(void) {
+    if (!dump_path) {
+        const char *env = g_getenv("GYATTHUB_TRACE");
+        dump_path = env && *env ? env : "gyatthub-trace.json";
+    }
+    return dump_path;
+}
+
+static void dump_at_exit(void) {
+    GError *error = NULL;
+    if (!trace_dump(trace_default_path(), &error)) {
+        g_printerr("trace: %s\n", error ? error->message : "dump failed");
+        g_clear_error(&error);
+    }
+}
+
+void trace_init(void) {
+    trace_set_thread_name("main");
+    trace_default_path();
+    atexit(dump_at_exit);
+}
+
+/* Copy out a ring's events that are still intact, oldest first */
+static guint snapshot_ring(TraceRing *ring, TraceEvent *out) {
+    guint end = (guint)g_atomic_int_get((gint *)&ring->head);
+    guint start = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+    for (guint i = start; i < end; ++i) out[i - start] = ring->events[i & (TRACE_RING_SIZE - 1)];
+
+    /* The owner kept writing: slots up to its current head (plus the one in progress) were reused */
+    guint now = (guint)g_atomic_int_get((gint *)&ring->head);
+    guint first_valid = now + 1 > TRACE_RING_SIZE ? now + 1 - TRACE_RING_SIZE : 0;
+    if (first_valid <= start) return end - start;
+    if (first_valid >= end) return 0;
+    guint skip = first_valid - start;
+    memmove(out, out + skip, (end - first_valid) * sizeof(TraceEvent));
+    return end - first_valid;
+}
+
+gboolean trace_dump(const char *path, GError **error) {
+    GString *json = g_string_new("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    TraceEvent *events = g_new(TraceEvent, TRACE_RING_SIZE);
+    gboolean first = TRUE;
+
+    for (TraceRing *ring = g_atomic_pointer_get(&rings); ring; ring = ring->next) {
+        g_string_append_printf(json, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                               "\"args\":{\"name\":\"%s\"}}",
+                               first ? "" : ",", ring->tid, ring->thread_name ? ring->thread_name : "worker");
+        first = FALSE;
+
+        guint n = snapshot_ring(ring, events);
+        for (guint i = 0; i < n; ++i) {
+            const TraceEvent *e = &events[i];
+            /* Names are string literals from the source, so they need no escaping */
+            g_string_append_printf(json, ",{\"name\":\"%s\",\"cat\":\"gyatthub\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                   "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT,
+                                   e->name, ring->tid, e->start_us, e->duration_us);
+            if (e->arg_name) g_string_append_printf(json, ",\"args\":{\"%s\":%" G_GINT64_FORMAT "}", e->arg_name, e->arg);
+            g_string_append_c(json, '}');
+        }
+    }
+    g_string_append(json, "]}\n");
+
+    gboolean ok = g_file_set_contents(path, json->str, (gssize)json->len, error);
+    g_free(events);
+    g_string_free(json, TRUE);
+    return ok;
+}
+
+#endif // GH_TRACE
@@ -0,0 +1,149 @@
+#include "tracked_file.h"
+
+struct _TrackedFile {
+    GObject parent_instance;
+
+    char *path;
+    char *name;
+    gint64 size;          /* -1 until stat'ed */
+    gint64 mtime;         /* -1 until stat'ed or if missing */
+    int version_count;    /* -1 until the versions index was read */
+    gint64 last_recorded; /* -1 if never recorded */
+    gboolean changed;
+};
+
+G_DEFINE_FINAL_TYPE(TrackedFile, tracked_file, G_TYPE_OBJECT)
+
+enum {
+    PROP_0,
+    PROP_PATH,
+    PROP_NAME,
+    PROP_SIZE,
+    PROP_MTIME,
+    PROP_VERSION_COUNT,
+    PROP_CHANGED,
+    N_PROPS
+};
+
+static GParamSpec *properties[N_PROPS];
+
+/* A file is "changed" when it was modified after its newest recorded version,
+ * or when it has never been recorded at all. Unknown values never show a badge. */
+static void tracked_file_update_changed(TrackedFile *self) {
+    gboolean changed = FALSE;
+    if (self->version_count == 0 && self->mtime >= 0) {
+        changed = TRUE;
+    } else if (self->version_count > 0 && self->mtime >= 0 && self->last_recorded >= 0) {
+        changed = self->mtime > self->last_recorded;
+    }
+    if (changed != self->changed) {
+        self->changed = changed;
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_CHANGED]);
+    }
+}
+
+static void tracked_file_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+    TrackedFile *self = TRACKED_FILE(object);
+    switch (prop_id) {
+    case PROP_PATH:          g_value_set_string(value, self->path); break;
+    case PROP_NAME:          g_value_set_string(value, self->name); break;
+    case PROP_SIZE:          g_value_set_int64(value, self->size); break;
+    case PROP_MTIME:         g_value_set_int64(value, self->mtime); break;
+    case PROP_VERSION_COUNT: g_value_set_int(value, self->version_count); break;
+    case PROP_CHANGED:       g_value_set_boolean(value, self->changed); break;
+    default: G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void tracked_file_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+    TrackedFile *self = TRACKED_FILE(object);
+    switch (prop_id) {
+    case PROP_PATH: tracked_file_set_path(self, g_value_get_string(value)); break;
+    default: G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void tracked_file_finalize(GObject *object) {
+    TrackedFile *self = TRACKED_FILE(object);
+    g_free(self->path);
+    g_free(self->name);
+    G_OBJECT_CLASS(tracked_file_parent_class)->finalize(object);
+}
+
+static void tracked_file_class_init(TrackedFileClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    object_class->get_property = tracked_file_get_property;
+    object_class->set_property = tracked_file_set_property;
+    object_class->finalize = tracked_file_finalize;
+
+    properties[PROP_PATH] = g_param_spec_string("path", NULL, NULL, NULL,
+                                                G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+    properties[PROP_NAME] = g_param_spec_string("name", NULL, NULL, NULL,
+                                                G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    properties[PROP_SIZE] = g_param_spec_int64("size", NULL, NULL, -1, G_MAXINT64, -1,
+                                               G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    properties[PROP_MTIME] = g_param_spec_int64("mtime", NULL, NULL, -1, G_MAXINT64, -1,
+                                                G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    properties[PROP_VERSION_COUNT] = g_param_spec_int("version-count", NULL, NULL, -1, G_MAXINT, -1,
+                                                      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    properties[PROP_CHANGED] = g_param_spec_boolean("changed", NULL, NULL, FALSE,
+                                                    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_properties(object_class, N_PROPS, properties);
+}
+
+static void tracked_file_init(TrackedFile *self) {
+    self->size = -1;
+    self->mtime = -1;
+    self->version_count = -1;
+    self->last_recorded = -1;
+}
+
+TrackedFile *tracked_file_new(const char *path) {
+    return g_object_new(TRACKED_TYPE_FILE, "path", path, NULL);
+}
+
+const char *tracked_file_get_path(TrackedFile *self) { return self->path; }
+const char *tracked_file_get_name(TrackedFile *self) { return self->name; }
+gint64 tracked_file_get_size(TrackedFile *self) { return self->size; }
+gint64 tracked_file_get_mtime(TrackedFile *self) { return self->mtime; }
+int tracked_file_get_version_count(TrackedFile *self) { return self->version_count; }
+gint64 tracked_file_get_last_recorded(TrackedFile *self) { return self->last_recorded; }
+gboolean tracked_file_get_changed(TrackedFile *self) { return self->changed; }
+
+void tracked_file_set_path(TrackedFile *self, const char *path) {
+    g_return_if_fail(TRACKED_IS_FILE(self));
+    if (g_strcmp0(self->path, path) == 0) return;
+    g_free(self->path);
+    g_free(self->name);
+    self->path = g_strdup(path);
+    self->name = path ? g_path_get_basename(path) : NULL;
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_PATH]);
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_NAME]);
+}
+
+void tracked_file_set_stat(TrackedFile *self, gint64 size, gint64 mtime) {
+    g_return_if_fail(TRACKED_IS_FILE(self));
+    g_object_freeze_notify(G_OBJECT(self));
+    if (self->size != size) {
+        self->size = size;
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_SIZE]);
+    }
+    if (self->mtime != mtime) {
+        self->mtime = mtime;
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_MTIME]);
+    }
+    tracked_file_update_changed(self);
+    g_object_thaw_notify(G_OBJECT(self));
+}
+
+void tracked_file_set_versions(TrackedFile *self, int count, gint64 last_recorded) {
+    g_return_if_fail(TRACKED_IS_FILE(self));
+    g_object_freeze_notify(G_OBJECT(self));
+    self->last_recorded = last_recorded;
+    if (self->version_count != count) {
+        self->version_count = count;
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_VERSION_COUNT]);
+    }
+    tracked_file_update_changed(self);
+    g_object_thaw_notify(G_OBJECT(self));
+}
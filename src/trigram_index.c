@@ -0,0 +1,615 @@
+#include "trigram_index.h"
+#include "version_store.h"
+#include "chunk_store.h"
+#include "trace.h"
+#include "wire_format.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRIGRAM_MAGIC "GHTI"
+#define TRIGRAM_FORMAT 1
+/* magic, format, documents, trigrams, then offsets of the names, table and lists */
+#define HEADER_SIZE (4 + 3 * 4 + 3 * 8)
+/* trigram, count, last document, length, offset */
+#define TABLE_ENTRY_SIZE (4 * 4 + 8)
+/* Below this size a document's trigrams are sorted; above it they are collected in a bitmap */
+#define SORT_MAX_BYTES (64 * 1024)
+
+typedef struct {
+    guint32 trigram;
+    guint32 count;
+    guint32 last_doc;
+    guint32 length;
+    guint64 offset;
+} TableEntry;
+
+static GMutex index_lock;
+static gboolean loaded;
+static GPtrArray *doc_names;    /* document id -> stored name */
+static GHashTable *indexed;     /* stored names with a document */
+
+/* index.bin */
+static GMappedFile *mapped;
+static const guint8 *table;
+static guint32 table_len;
+static const guint8 *lists;
+static gsize lists_size;
+
+/* pending.log, in memory: trigram -> GArray of guint32 document ids */
+static GHashTable *pending;
+static guint pending_docs;
+
+/* Set once trigram_index_search() has brought the index up to date with the versions index */
+static gboolean synced;
+
+static gchar *index_file(const char *name) {
+    return g_build_filename("data", "trigram", name, NULL);
+}
+
+// ---
+// --- Encoding
+// ---
+
+static void read_table_entry(guint32 i, TableEntry *entry) {
+    const guint8 *p = table + (gsize)i * TABLE_ENTRY_SIZE;
+    entry->trigram = wire_get_u32(p);
+    entry->count = wire_get_u32(p + 4);
+    entry->last_doc = wire_get_u32(p + 8);
+    entry->length = wire_get_u32(p + 12);
+    entry->offset = wire_get_u64(p + 16);
+}
+
+static int compare_u32(gconstpointer a, gconstpointer b) {
+    guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Distinct trigrams of 'data' in increasing order, each packed as b0 << 16 | b1 << 8 | b2 */
+static GArray *extract_trigrams(const guint8 *data, gsize length) {
+    GArray *out = g_array_new(FALSE, FALSE, sizeof(guint32));
+    if (length < 3) return out;
+
+    if (length <= SORT_MAX_BYTES) {
+        g_array_set_size(out, (guint)(length - 2));
+        guint32 *t = (guint32 *)out->data;
+        for (gsize i = 0; i + 2 < length; ++i) t[i] = (guint32)data[i] << 16 | (guint32)data[i + 1] << 8 | data[i + 2];
+        g_array_sort(out, compare_u32);
+        guint n = 0;
+        for (guint i = 0; i < out->len; ++i) if (n == 0 || t[n - 1] != t[i]) t[n++] = t[i];
+        g_array_set_size(out, n);
+        return out;
+    }
+
+    /* One bit per possible trigram: 2 MB, and the scan comes out sorted */
+    guint64 *seen = g_new0(guint64, (1u << 24) / 64);
+    guint32 t = (guint32)data[0] << 8 | data[1];
+    for (gsize i = 2; i < length; ++i) {
+        t = (t << 8 | data[i]) & 0xffffff;
+        seen[t >> 6] |= G_GUINT64_CONSTANT(1) << (t & 63);
+    }
+    for (guint32 w = 0; w < (1u << 24) / 64; ++w) {
+        if (!seen[w]) continue;
+        for (guint32 bit = 0; bit < 64; ++bit) {
+            if (!(seen[w] >> bit & 1)) continue;
+            guint32 trigram = w << 6 | bit;
+            g_array_append_val(out, trigram);
+        }
+    }
+    g_free(seen);
+    return out;
+}
+
+// ---
+// --- Loading
+// ---
+
+static void pending_add(guint32 trigram, guint32 doc) {
+    GArray *docs = g_hash_table_lookup(pending, GUINT_TO_POINTER(trigram));
+    if (!docs) {
+        docs = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_hash_table_insert(pending, GUINT_TO_POINTER(trigram), docs);
+    }
+    g_array_append_val(docs, doc);
+}
+
+static void add_document_name(const char *name, gsize length) {
+    gchar *copy = g_strndup(name, length);
+    g_ptr_array_add(doc_names, copy);
+    g_hash_table_add(indexed, copy);
+}
+
+/* Map index.bin and read its document names; FALSE if it is missing or damaged */
+static gboolean load_mapped_locked(void) {
+    gchar *path = index_file("index.bin");
+    mapped = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (!mapped) return FALSE;
+
+    const guint8 *data = (const guint8 *)g_mapped_file_get_contents(mapped);
+    gsize size = g_mapped_file_get_length(mapped);
+    if (size < HEADER_SIZE || memcmp(data, TRIGRAM_MAGIC, 4) != 0 || wire_get_u32(data + 4) != TRIGRAM_FORMAT) return FALSE;
+    guint32 n_docs = wire_get_u32(data + 8);
+    guint32 n_trigrams = wire_get_u32(data + 12);
+    guint64 names_at = wire_get_u64(data + 16), table_at = wire_get_u64(data + 24), lists_at = wire_get_u64(data + 32);
+    if (names_at != HEADER_SIZE || table_at < names_at || lists_at > size ||
+        lists_at - table_at != (guint64)n_trigrams * TABLE_ENTRY_SIZE) return FALSE;
+
+    const guint8 *p = data + names_at;
+    const guint8 *names_end = data + table_at;
+    for (guint32 i = 0; i < n_docs; ++i) {
+        guint64 len;
+        if (!wire_get_varint(&p, names_end, &len) || len > (guint64)(names_end - p)) return FALSE;
+        add_document_name((const char *)p, (gsize)len);
+        p += len;
+    }
+    if (p != names_end) return FALSE;
+
+    table = data + table_at;
+    table_len = n_trigrams;
+    lists = data + lists_at;
+    lists_size = size - lists_at;
+    return TRUE;
+}
+
+/* Read pending.log; a torn last record (from a crash mid-append) is cut off */
+static void load_pending_locked(void) {
+    gchar *path = index_file("pending.log");
+    gchar *contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(path, &contents, &length, NULL)) {
+        g_free(path);
+        return;
+    }
+
+    const guint8 *p = (const guint8 *)contents;
+    const guint8 *end = p + length;
+    const guint8 *valid_end = p;
+    GArray *trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+    while (p < end) {
+        guint64 name_len, count;
+        if (!wire_get_varint(&p, end, &name_len) || name_len > (guint64)(end - p)) break;
+        const char *name = (const char *)p;
+        p += name_len;
+        if (!wire_get_varint(&p, end, &count) || count > (guint64)(end - p)) break;
+
+        g_array_set_size(trigrams, 0);
+        guint64 prev = 0, delta;
+        gboolean ok = TRUE;
+        for (guint64 i = 0; i < count && ok; ++i) {
+            ok = wire_get_varint(&p, end, &delta);
+            prev += delta;
+            guint32 t = (guint32)prev;
+            g_array_append_val(trigrams, t);
+        }
+        if (!ok) break;
+
+        guint32 doc = doc_names->len;
+        add_document_name(name, (gsize)name_len);
+        for (guint i = 0; i < trigrams->len; ++i) pending_add(g_array_index(trigrams, guint32, i), doc);
+        pending_docs++;
+        valid_end = p;
+    }
+    g_array_unref(trigrams);
+
+    if (valid_end != (const guint8 *)contents + length) {
+        g_printerr("trigram index: dropping a damaged record at the end of %s\n", path);
+        g_file_set_contents(path, contents, valid_end - (const guint8 *)contents, NULL);
+    }
+    g_free(contents);
+    g_free(path);
+}
+
+static void init_empty_locked(void) {
+    doc_names = g_ptr_array_new_with_free_func(g_free);
+    indexed = g_hash_table_new(g_str_hash, g_str_equal);
+    pending = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_array_unref);
+}
+
+static void unload_locked(void) {
+    g_clear_pointer(&mapped, g_mapped_file_unref);
+    table = lists = NULL;
+    table_len = 0;
+    lists_size = 0;
+    g_clear_pointer(&pending, g_hash_table_unref);
+    g_clear_pointer(&indexed, g_hash_table_unref);
+    g_clear_pointer(&doc_names, g_ptr_array_unref);
+    pending_docs = 0;
+    loaded = FALSE;
+}
+
+static void ensure_loaded_locked(void) {
+    if (loaded) return;
+    TRACE_SCOPE("trigram.load");
+    init_empty_locked();
+    gchar *index_path = index_file("index.bin");
+    if (!load_mapped_locked() && g_file_test(index_path, G_FILE_TEST_EXISTS)) {
+        /* Pending records carry their own names, so they stay valid; trigram_index_sync() re-adds the rest */
+        g_printerr("trigram index: %s is damaged, rebuilding\n", index_path);
+        unload_locked();
+        init_empty_locked();
+        g_remove(index_path);
+    }
+    g_free(index_path);
+    load_pending_locked();
+    loaded = TRUE;
+}
+
+// ---
+// --- Compaction
+// ---
+
+static gboolean write_bytes(FILE *f, const void *data, gsize length) {
+    return length == 0 || fwrite(data, 1, length, f) == length;
+}
+
+/*
+ * Write index.bin.new from the mapped index plus the pending lists, then
+ * swap it in. Lists of trigrams present in both keep their old bytes and get
+ * the pending documents appended, encoded relative to the old last document.
+ */
+static gboolean compact_locked(GError **error) {
+    TRACE_SCOPE("trigram.compact");
+    TRACE_SCOPE_ARG("docs", doc_names->len);
+
+    GArray *keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32), g_hash_table_size(pending));
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, pending);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        guint32 t = GPOINTER_TO_UINT(key);
+        g_array_append_val(keys, t);
+    }
+    g_array_sort(keys, compare_u32);
+
+    /* Merge the two sorted trigram sequences into the new table and the appended bytes */
+    GArray *entries = g_array_new(FALSE, FALSE, sizeof(TableEntry));
+    GPtrArray *appended = g_ptr_array_new_with_free_func((GDestroyNotify)g_byte_array_unref);
+    GArray *old_offsets = g_array_new(FALSE, FALSE, sizeof(guint64));
+    guint32 i = 0;
+    guint j = 0;
+    guint64 offset = 0;
+    while (i < table_len || j < keys->len) {
+        TableEntry entry = {0};
+        guint64 old_offset = 0;
+        guint32 pending_key = j < keys->len ? g_array_index(keys, guint32, j) : G_MAXUINT32;
+        if (i < table_len) read_table_entry(i, &entry);
+        gboolean take_old = i < table_len && entry.trigram <= pending_key;
+        gboolean take_new = j < keys->len && (!take_old || entry.trigram == pending_key);
+        if (!take_old) memset(&entry, 0, sizeof(entry));
+        if (take_old) {
+            old_offset = entry.offset;
+            i++;
+        }
+
+        GByteArray *bytes = g_byte_array_new();
+        if (take_new) {
+            GArray *docs = g_hash_table_lookup(pending, GUINT_TO_POINTER(pending_key));
+            guint32 prev = entry.count ? entry.last_doc : 0;
+            for (guint d = 0; d < docs->len; ++d) {
+                guint32 doc = g_array_index(docs, guint32, d);
+                wire_put_varint(bytes, doc - prev);
+                prev = doc;
+            }
+            entry.trigram = pending_key;
+            entry.count += docs->len;
+            entry.last_doc = prev;
+            j++;
+        }
+        if ((guint64)entry.length + bytes->len > G_MAXUINT32) {
+            /* More than 4 GB of postings for one trigram: stop here rather than corrupt the table */
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FBIG, "trigram index posting list too large");
+            g_byte_array_unref(bytes);
+            g_array_unref(entries);
+            g_array_unref(old_offsets);
+            g_ptr_array_unref(appended);
+            g_array_unref(keys);
+            return FALSE;
+        }
+        entry.offset = offset;
+        entry.length += bytes->len;
+        offset += entry.length;
+        g_array_append_val(entries, entry);
+        g_array_append_val(old_offsets, old_offset);
+        g_ptr_array_add(appended, bytes);
+    }
+    g_array_unref(keys);
+
+    GByteArray *head = g_byte_array_new();
+    g_byte_array_append(head, (const guint8 *)TRIGRAM_MAGIC, 4);
+    wire_put_u32(head, TRIGRAM_FORMAT);
+    wire_put_u32(head, doc_names->len);
+    wire_put_u32(head, entries->len);
+    wire_put_u64(head, 0);
+    wire_put_u64(head, 0);
+    wire_put_u64(head, 0);
+    guint64 names_at = head->len;
+    for (guint d = 0; d < doc_names->len; ++d) {
+        const char *name = g_ptr_array_index(doc_names, d);
+        gsize len = strlen(name);
+        wire_put_varint(head, len);
+        g_byte_array_append(head, (const guint8 *)name, (guint)len);
+    }
+    guint64 table_at = head->len;
+    guint64 lists_at = table_at + (guint64)entries->len * TABLE_ENTRY_SIZE;
+    guint64 v = GUINT64_TO_LE(names_at);
+    memcpy(head->data + 16, &v, 8);
+    v = GUINT64_TO_LE(table_at);
+    memcpy(head->data + 24, &v, 8);
+    v = GUINT64_TO_LE(lists_at);
+    memcpy(head->data + 32, &v, 8);
+    for (guint e = 0; e < entries->len; ++e) {
+        const TableEntry *entry = &g_array_index(entries, TableEntry, e);
+        wire_put_u32(head, entry->trigram);
+        wire_put_u32(head, entry->count);
+        wire_put_u32(head, entry->last_doc);
+        wire_put_u32(head, entry->length);
+        wire_put_u64(head, entry->offset);
+    }
+
+    gchar *dir = g_build_filename("data", "trigram", NULL);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+    gchar *index_path = index_file("index.bin");
+    gchar *new_path = index_file("index.bin.new");
+    gboolean ok = FALSE;
+    FILE *f = g_fopen(new_path, "wb");
+    if (f) {
+        ok = write_bytes(f, head->data, head->len);
+        for (guint e = 0; e < entries->len && ok; ++e) {
+            const TableEntry *entry = &g_array_index(entries, TableEntry, e);
+            GByteArray *bytes = g_ptr_array_index(appended, e);
+            gsize old_len = entry->length - bytes->len;
+            guint64 old_offset = g_array_index(old_offsets, guint64, e);
+            if (old_len > 0 && old_offset + old_len > lists_size) ok = FALSE;
+            ok = ok && write_bytes(f, lists + old_offset, old_len) && write_bytes(f, bytes->data, bytes->len);
+        }
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (!ok) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                    "could not write %s: %s", new_path, g_strerror(saved));
+        g_remove(new_path);
+    }
+    g_byte_array_unref(head);
+    g_array_unref(entries);
+    g_array_unref(old_offsets);
+    g_ptr_array_unref(appended);
+
+    if (ok) {
+        /* The old file is still mapped, and Windows will not replace a mapped or existing file */
+        g_clear_pointer(&mapped, g_mapped_file_unref);
+#ifdef G_OS_WIN32
+        g_remove(index_path);
+#endif
+        if (g_rename(new_path, index_path) != 0) {
+            int saved = errno;
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                        "could not replace %s: %s", index_path, g_strerror(saved));
+            ok = FALSE;
+        } else {
+            gchar *pending_path = index_file("pending.log");
+            g_remove(pending_path);
+            g_free(pending_path);
+        }
+        /* Start over from disk: either the new index with nothing pending, or whatever survived */
+        unload_locked();
+        ensure_loaded_locked();
+    }
+    g_free(new_path);
+    g_free(index_path);
+    return ok;
+}
+
+// ---
+// --- Public API
+// ---
+
+gboolean trigram_index_add(const char *stored, const char *contents, gsize length, GError **error) {
+    TRACE_SCOPE("trigram.add");
+    TRACE_SCOPE_ARG("bytes", length);
+    GArray *trigrams = extract_trigrams((const guint8 *)contents, length);
+
+    GByteArray *record = g_byte_array_sized_new(16 + trigrams->len * 2);
+    gsize name_len = strlen(stored);
+    wire_put_varint(record, name_len);
+    g_byte_array_append(record, (const guint8 *)stored, (guint)name_len);
+    wire_put_varint(record, trigrams->len);
+    guint32 prev = 0;
+    for (guint i = 0; i < trigrams->len; ++i) {
+        guint32 t = g_array_index(trigrams, guint32, i);
+        wire_put_varint(record, t - prev);
+        prev = t;
+    }
+
+    g_mutex_lock(&index_lock);
+    ensure_loaded_locked();
+    gchar *path = index_file("pending.log");
+    FILE *f = g_fopen(path, "ab");
+    if (!f) {
+        gchar *dir = g_build_filename("data", "trigram", NULL);
+        g_mkdir_with_parents(dir, 0755);
+        g_free(dir);
+        f = g_fopen(path, "ab");
+    }
+    gboolean ok = f && write_bytes(f, record->data, record->len);
+    if (f) ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                    "could not append to %s: %s", path, g_strerror(saved));
+    } else {
+        guint32 doc = doc_names->len;
+        add_document_name(stored, name_len);
+        for (guint i = 0; i < trigrams->len; ++i) pending_add(g_array_index(trigrams, guint32, i), doc);
+        if (++pending_docs >= TRIGRAM_COMPACT_DOCS) {
+            GError *compact_error = NULL;
+            /* The document is safe in pending.log either way, so a failed merge is only logged */
+            if (!compact_locked(&compact_error)) {
+                g_printerr("trigram index: %s\n", compact_error ? compact_error->message : "compaction failed");
+                g_clear_error(&compact_error);
+            }
+        }
+    }
+    g_mutex_unlock(&index_lock);
+
+    g_free(path);
+    g_byte_array_unref(record);
+    g_array_unref(trigrams);
+    return ok;
+}
+
+guint trigram_index_sync(void) {
+    TRACE_SCOPE("trigram.sync");
+    GPtrArray *entries = version_store_list(NULL);
+    guint added = 0;
+    for (guint i = 0; i < entries->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(entries, i);
+        g_mutex_lock(&index_lock);
+        ensure_loaded_locked();
+        gboolean known = g_hash_table_contains(indexed, entry->stored);
+        g_mutex_unlock(&index_lock);
+        if (known) continue;
+
+        gchar *path = version_store_stored_path(entry->stored);
+        gchar *contents = NULL;
+        gsize length = 0;
+        if (chunk_store_read_file(path, &contents, &length, NULL)) {
+            GError *error = NULL;
+            if (trigram_index_add(entry->stored, contents, length, &error)) added++;
+            else {
+                g_printerr("trigram index: %s\n", error ? error->message : "could not add a version");
+                g_clear_error(&error);
+            }
+        }
+        g_free(contents);
+        g_free(path);
+    }
+    g_ptr_array_free(entries, TRUE);
+    TRACE_SCOPE_ARG("added", added);
+    return added;
+}
+
+/* Document ids containing 'trigram', from index.bin and then pending (which only has later ids) */
+static GArray *postings_locked(guint32 trigram) {
+    GArray *docs = g_array_new(FALSE, FALSE, sizeof(guint32));
+    guint32 lo = 0, hi = table_len;
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        if (wire_get_u32(table + (gsize)mid * TABLE_ENTRY_SIZE) < trigram) lo = mid + 1;
+        else hi = mid;
+    }
+    TableEntry entry;
+    if (lo < table_len && (read_table_entry(lo, &entry), entry.trigram == trigram) &&
+        entry.offset + entry.length <= lists_size && entry.count <= entry.length) {
+        const guint8 *p = lists + entry.offset;
+        const guint8 *end = p + entry.length;
+        g_array_set_size(docs, entry.count);
+        guint32 prev = 0;
+        guint n = 0;
+        guint64 delta;
+        while (n < entry.count && wire_get_varint(&p, end, &delta)) {
+            prev += (guint32)delta;
+            g_array_index(docs, guint32, n++) = prev;
+        }
+        g_array_set_size(docs, n);
+    }
+    GArray *more = g_hash_table_lookup(pending, GUINT_TO_POINTER(trigram));
+    if (more) g_array_append_vals(docs, more->data, more->len);
+    return docs;
+}
+
+static int compare_array_len(gconstpointer a, gconstpointer b) {
+    const GArray *x = *(GArray *const *)a, *y = *(GArray *const *)b;
+    return x->len < y->len ? -1 : x->len > y->len;
+}
+
+/* Names of the documents that contain every trigram of the needle, restricted to 'within' */
+static GPtrArray *candidates_locked(const char *needle, gsize needle_len, GHashTable *within) {
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    GArray *trigrams = extract_trigrams((const guint8 *)needle, needle_len);
+
+    GArray *docs = NULL;
+    if (trigrams->len == 0) {
+        docs = g_array_sized_new(FALSE, FALSE, sizeof(guint32), doc_names->len);
+        for (guint32 d = 0; d < doc_names->len; ++d) g_array_append_val(docs, d);
+    } else {
+        GPtrArray *lists_for = g_ptr_array_new_with_free_func((GDestroyNotify)g_array_unref);
+        for (guint i = 0; i < trigrams->len; ++i) g_ptr_array_add(lists_for, postings_locked(g_array_index(trigrams, guint32, i)));
+        /* Shortest first, so each step shrinks the running result as fast as possible */
+        g_ptr_array_sort(lists_for, compare_array_len);
+        docs = g_ptr_array_steal_index(lists_for, 0);
+        for (guint l = 1; l < lists_for->len && docs->len > 0; ++l) {
+            const GArray *other = g_ptr_array_index(lists_for, l);
+            guint n = 0, k = 0;
+            for (guint a = 0; a < docs->len; ++a) {
+                guint32 d = g_array_index(docs, guint32, a);
+                while (k < other->len && g_array_index(other, guint32, k) < d) k++;
+                if (k == other->len) break;
+                if (g_array_index(other, guint32, k) == d) g_array_index(docs, guint32, n++) = d;
+            }
+            g_array_set_size(docs, n);
+        }
+        g_ptr_array_unref(lists_for);
+    }
+
+    for (guint i = 0; i < docs->len; ++i) {
+        const char *name = g_ptr_array_index(doc_names, g_array_index(docs, guint32, i));
+        if (within && !g_hash_table_contains(within, name)) continue;
+        if (!g_hash_table_add(seen, (gpointer)name)) continue;
+        g_ptr_array_add(names, g_strdup(name));
+    }
+    g_array_unref(docs);
+    g_array_unref(trigrams);
+    g_hash_table_unref(seen);
+    return names;
+}
+
+GHashTable *trigram_index_search(const char *needle, GHashTable *within) {
+    GHashTable *matches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gsize needle_len = needle ? strlen(needle) : 0;
+    if (needle_len == 0) return matches;
+    TRACE_SCOPE("trigram.search");
+
+    g_mutex_lock(&index_lock);
+    gboolean need_sync = !synced;
+    g_mutex_unlock(&index_lock);
+    if (need_sync) {
+        trigram_index_sync();
+        g_mutex_lock(&index_lock);
+        synced = TRUE;
+        g_mutex_unlock(&index_lock);
+    }
+
+    g_mutex_lock(&index_lock);
+    ensure_loaded_locked();
+    GPtrArray *candidates = candidates_locked(needle, needle_len, within);
+    g_mutex_unlock(&index_lock);
+    TRACE_SCOPE_ARG("candidates", candidates->len);
+
+    /* Trigrams only narrow it down; the needle must also appear as a whole */
+    for (guint i = 0; i < candidates->len; ++i) {
+        const char *name = g_ptr_array_index(candidates, i);
+        gchar *path = version_store_stored_path(name);
+        gchar *contents = NULL;
+        gsize length = 0;
+        if (chunk_store_read_file(path, &contents, &length, NULL) &&
+            g_strstr_len(contents, (gssize)length, needle)) {
+            g_hash_table_add(matches, g_strdup(name));
+        }
+        g_free(contents);
+        g_free(path);
+    }
+    g_ptr_array_unref(candidates);
+    return matches;
+}
+
+void trigram_index_close(void) {
+    g_mutex_lock(&index_lock);
+    if (loaded) unload_locked();
+    synced = FALSE;
+    g_mutex_unlock(&index_lock);
+}
@@ -0,0 +1,181 @@
+#include "version_stats.h"
+#include "line_table.h"
+#include "chunk_store.h"
+#include "binary_diff.h"
+#include "trace.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+static GMutex stats_lock;
+/* "<hash older> <hash newer> <max_d>" -> DiffStats* */
+static GHashTable *stats_cache;
+/* stored path -> key of its contents (see content_key) */
+static GHashTable *path_hashes;
+/* keys of contents found to be binary */
+static GHashTable *binary_keys;
+
+static gchar *cache_file_path(void) {
+    return g_build_filename("data", "version_stats.txt", NULL);
+}
+
+/* Read data/version_stats.txt; lines that don't parse (e.g. a torn last one) are skipped */
+static void load_cache_locked(void) {
+    if (stats_cache) return;
+    stats_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    path_hashes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    binary_keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    gchar *path = cache_file_path();
+    gchar *contents = NULL;
+    gboolean ok = g_file_get_contents(path, &contents, NULL, NULL);
+    g_free(path);
+    if (!ok) return;
+
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (gchar **line = lines; *line; ++line) {
+        char older[65], newer[65];
+        guint max_d, inserted, deleted, approximate;
+        if (sscanf(*line, "%64s %64s %u %u %u %u", older, newer, &max_d, &inserted, &deleted, &approximate) != 6) continue;
+        if (strlen(older) != 64 || strlen(newer) != 64) continue;
+        DiffStats *stats = g_new0(DiffStats, 1);
+        stats->inserted = inserted;
+        stats->deleted = deleted;
+        stats->approximate = approximate != 0;
+        g_hash_table_insert(stats_cache, g_strdup_printf("%s %s %u", older, newer, max_d), stats);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+}
+
+static void append_cache_locked(const char *key, const DiffStats *stats) {
+    gchar *path = cache_file_path();
+    FILE *out = g_fopen(path, "a");
+    if (!out) {
+        g_mkdir_with_parents("data", 0755);
+        out = g_fopen(path, "a");
+    }
+    if (out) {
+        fprintf(out, "%s %u %u %d\n", key, stats->inserted, stats->deleted, stats->approximate ? 1 : 0);
+        fclose(out);
+    } else {
+        g_printerr("version_stats: could not append to %s\n", path);
+    }
+    g_free(path);
+}
+
+/* Key for the contents of 'path': the hash of its chunk list when it is chunked, which only takes
+ * reading the list, else the SHA-256 of the contents, which are then handed back */
+static gchar *content_key(const char *path, gchar **contents, gsize *length) {
+    g_mutex_lock(&stats_lock);
+    load_cache_locked();
+    gchar *hash = g_strdup(g_hash_table_lookup(path_hashes, path));
+    g_mutex_unlock(&stats_lock);
+    if (hash) return hash;
+
+    hash = chunk_store_content_id(path);
+    if (!hash) {
+        if (!chunk_store_read_file(path, contents, length, NULL)) return NULL;
+        hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *)*contents, *length);
+    }
+    g_mutex_lock(&stats_lock);
+    g_hash_table_insert(path_hashes, g_strdup(path), g_strdup(hash));
+    g_mutex_unlock(&stats_lock);
+    return hash;
+}
+
+gboolean version_stats_get(const char *older_path, const char *newer_path, guint max_d, DiffStats *stats) {
+    TRACE_SCOPE("version_stats.get");
+    memset(stats, 0, sizeof(*stats));
+    gchar *contents1 = NULL, *contents2 = NULL;
+    gsize length1 = 0, length2 = 0;
+    gchar *hash1 = content_key(older_path, &contents1, &length1);
+    gchar *hash2 = hash1 ? content_key(newer_path, &contents2, &length2) : NULL;
+    gboolean ok = FALSE;
+    if (!hash2) goto out;
+    ok = TRUE;
+    /* Same contents: nothing to diff, and nothing worth caching */
+    if (strcmp(hash1, hash2) == 0) goto out;
+
+    gchar *key = g_strdup_printf("%s %s %u", hash1, hash2, max_d);
+    g_mutex_lock(&stats_lock);
+    DiffStats *cached = g_hash_table_lookup(stats_cache, key);
+    if (cached) *stats = *cached;
+    stats->binary = g_hash_table_contains(binary_keys, hash1) || g_hash_table_contains(binary_keys, hash2);
+    g_mutex_unlock(&stats_lock);
+    if (cached || stats->binary) {
+        g_free(key);
+        goto out;
+    }
+
+    /* Diffed outside the lock so workers run in parallel; a pair raced by two of them is just stored twice */
+    if ((!contents1 && !chunk_store_read_file(older_path, &contents1, &length1, NULL)) ||
+        (!contents2 && !chunk_store_read_file(newer_path, &contents2, &length2, NULL))) {
+        g_free(key);
+        ok = FALSE;
+        goto out;
+    }
+    /* Binary contents have no lines to count; remembered so they aren't read again */
+    gboolean binary1 = binary_diff_is_binary(contents1, length1);
+    if (binary1 || binary_diff_is_binary(contents2, length2)) {
+        g_mutex_lock(&stats_lock);
+        g_hash_table_add(binary_keys, g_strdup(binary1 ? hash1 : hash2));
+        g_mutex_unlock(&stats_lock);
+        stats->binary = TRUE;
+        g_free(key);
+        goto out;
+    }
+    LineTable *left = line_table_new(contents1, length1);
+    LineTable *right = line_table_new(contents2, length2);
+    stats->approximate = !myers_diff_stats(&g_array_index(left->hashes, guint64, 0), left->n_lines,
+                                           &g_array_index(right->hashes, guint64, 0), right->n_lines,
+                                           max_d, &stats->inserted, &stats->deleted);
+    line_table_free(left);
+    line_table_free(right);
+
+    g_mutex_lock(&stats_lock);
+    if (!g_hash_table_contains(stats_cache, key)) append_cache_locked(key, stats);
+    DiffStats *copy = g_new(DiffStats, 1);
+    *copy = *stats;
+    g_hash_table_insert(stats_cache, key, copy);
+    g_mutex_unlock(&stats_lock);
+
+out:
+    g_free(contents1);
+    g_free(contents2);
+    g_free(hash1);
+    g_free(hash2);
+    return ok;
+}
+
+gboolean version_stats_lookup(const char *older_path, const char *newer_path, guint max_d, DiffStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    g_mutex_lock(&stats_lock);
+    load_cache_locked();
+    const char *hash1 = g_hash_table_lookup(path_hashes, older_path);
+    const char *hash2 = g_hash_table_lookup(path_hashes, newer_path);
+    gboolean found = FALSE;
+    if (hash1 && hash2 && strcmp(hash1, hash2) == 0) {
+        found = TRUE;
+    } else if (hash1 && hash2 &&
+               (g_hash_table_contains(binary_keys, hash1) || g_hash_table_contains(binary_keys, hash2))) {
+        stats->binary = TRUE;
+        found = TRUE;
+    } else if (hash1 && hash2) {
+        gchar *key = g_strdup_printf("%s %s %u", hash1, hash2, max_d);
+        DiffStats *cached = g_hash_table_lookup(stats_cache, key);
+        if (cached) *stats = *cached;
+        found = cached != NULL;
+        g_free(key);
+    }
+    g_mutex_unlock(&stats_lock);
+    return found;
+}
+
+void version_stats_close(void) {
+    g_mutex_lock(&stats_lock);
+    g_clear_pointer(&stats_cache, g_hash_table_unref);
+    g_clear_pointer(&path_hashes, g_hash_table_unref);
+    g_clear_pointer(&binary_keys, g_hash_table_unref);
+    g_mutex_unlock(&stats_lock);
+}
@@ -0,0 +1,380 @@
+#include "version_store.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "trigram_index.h"
+#include "blame.h"
+#include "chunk_store.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__has_include)
+# if __has_include(<json-glib/json-glib.h>)
+#  include <json-glib/json-glib.h>
+#  define HAVE_JSON_GLIB 1
+# endif
+#endif
+
+static const char *data_dir = "data";
+
+void version_entry_free(VersionEntry *entry) {
+    if (!entry) return;
+    g_free(entry->original);
+    g_free(entry->stored);
+    g_free(entry->timestamp);
+    g_free(entry);
+}
+
+static VersionEntry *version_entry_new(const char *original, const char *stored, const char *timestamp) {
+    VersionEntry *entry = g_new0(VersionEntry, 1);
+    entry->original = g_strdup(original);
+    entry->stored = g_strdup(stored);
+    entry->timestamp = g_strdup(timestamp ? timestamp : "");
+    return entry;
+}
+
+gchar *version_store_stored_path(const char *stored) {
+    return g_build_filename(data_dir, "versions", stored, NULL);
+}
+
+// ---
+// --- Versions index
+// ---
+
+#ifdef HAVE_JSON_GLIB
+
+static GPtrArray *load_index(void) {
+    TRACE_SCOPE("store.load_index");
+    gint64 started = g_get_monotonic_time();
+    GPtrArray *entries = g_ptr_array_new_with_free_func((GDestroyNotify)version_entry_free);
+    gchar *index_path = g_build_filename(data_dir, "versions_index.json", NULL);
+    if (g_file_test(index_path, G_FILE_TEST_EXISTS)) {
+        GError *error = NULL;
+        JsonParser *parser = json_parser_new();
+        if (!json_parser_load_from_file(parser, index_path, &error)) {
+            g_printerr("Failed to parse versions index JSON: %s\n", error ? error->message : "unknown");
+            g_clear_error(&error);
+        } else {
+            JsonNode *root = json_parser_get_root(parser);
+            if (JSON_NODE_HOLDS_ARRAY(root)) {
+                JsonArray *arr = json_node_get_array(root);
+                guint len = json_array_get_length(arr);
+                for (guint i = 0; i < len; ++i) {
+                    JsonNode *elem = json_array_get_element(arr, i);
+                    if (!JSON_NODE_HOLDS_OBJECT(elem)) continue;
+                    JsonObject *obj = json_node_get_object(elem);
+                    const char *orig = json_object_get_string_member(obj, "original");
+                    const char *stored = json_object_get_string_member(obj, "stored");
+                    const char *ts = json_object_get_string_member(obj, "timestamp");
+                    if (!orig || !stored) continue;
+                    g_ptr_array_add(entries, version_entry_new(orig, stored, ts));
+                }
+            }
+        }
+        g_object_unref(parser);
+    }
+    g_free(index_path);
+    perf_counter_set(PERF_INDEX_LOAD_US, g_get_monotonic_time() - started);
+    return entries;
+}
+
+static gboolean save_index(GPtrArray *entries, GError **error) {
+    TRACE_SCOPE("store.save_index");
+    TRACE_SCOPE_ARG("entries", entries->len);
+    JsonArray *arr = json_array_new();
+    for (guint i = 0; i < entries->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(entries, i);
+        JsonObject *obj = json_object_new();
+        json_object_set_string_member(obj, "original", entry->original);
+        json_object_set_string_member(obj, "stored", entry->stored);
+        json_object_set_string_member(obj, "timestamp", entry->timestamp);
+        json_array_add_object_element(arr, obj);
+    }
+    gchar *index_path = g_build_filename(data_dir, "versions_index.json", NULL);
+    JsonGenerator *gen = json_generator_new();
+    JsonNode *root_node = json_node_new(JSON_NODE_ARRAY);
+    json_node_take_array(root_node, arr);
+    json_generator_set_root(gen, root_node);
+    gboolean ok = json_generator_to_file(gen, index_path, error);
+    g_object_unref(gen);
+    json_node_free(root_node);
+    g_free(index_path);
+    return ok;
+}
+
+static gboolean append_index(const VersionEntry *entry, GError **error) {
+    GPtrArray *entries = load_index();
+    g_ptr_array_add(entries, version_entry_new(entry->original, entry->stored, entry->timestamp));
+    gboolean ok = save_index(entries, error);
+    g_ptr_array_free(entries, TRUE);
+    return ok;
+}
+
+#else
+
+static GPtrArray *load_index(void) {
+    TRACE_SCOPE("store.load_index");
+    gint64 started = g_get_monotonic_time();
+    GPtrArray *entries = g_ptr_array_new_with_free_func((GDestroyNotify)version_entry_free);
+    gchar *index_path = g_build_filename(data_dir, "versions_index.txt", NULL);
+    FILE *f = fopen(index_path, "r");
+    g_free(index_path);
+    if (!f) return entries;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        char *nl = strpbrk(line, "\r\n"); if (nl) *nl = '\0';
+        char *p1 = strchr(line, '|');
+        if (!p1) continue;
+        *p1 = '\0';
+        char *p2 = strchr(p1 + 1, '|');
+        if (!p2) continue;
+        *p2 = '\0';
+        g_ptr_array_add(entries, version_entry_new(line, p1 + 1, p2 + 1));
+    }
+    fclose(f);
+    perf_counter_set(PERF_INDEX_LOAD_US, g_get_monotonic_time() - started);
+    return entries;
+}
+
+static gboolean save_index(GPtrArray *entries, GError **error) {
+    TRACE_SCOPE("store.save_index");
+    TRACE_SCOPE_ARG("entries", entries->len);
+    GString *out = g_string_new(NULL);
+    for (guint i = 0; i < entries->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(entries, i);
+        g_string_append_printf(out, "%s|%s|%s\n", entry->original, entry->stored, entry->timestamp);
+    }
+    gchar *index_path = g_build_filename(data_dir, "versions_index.txt", NULL);
+    gboolean ok = g_file_set_contents(index_path, out->str, (gssize)out->len, error);
+    g_free(index_path);
+    g_string_free(out, TRUE);
+    return ok;
+}
+
+static gboolean append_index(const VersionEntry *entry, GError **error) {
+    gchar *index_path = g_build_filename(data_dir, "versions_index.txt", NULL);
+    FILE *fi = fopen(index_path, "a");
+    g_free(index_path);
+    if (!fi) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "could not open versions index for writing");
+        return FALSE;
+    }
+    fprintf(fi, "%s|%s|%s\n", entry->original, entry->stored, entry->timestamp);
+    fclose(fi);
+    return TRUE;
+}
+
+#endif
+
+// ---
+// --- Versions
+// ---
+
+static void format_timestamp(char *buf, gsize size) {
+    time_t t = time(NULL);
+    struct tm tminfo;
+#if defined(_WIN32) || defined(__MINGW32__)
+    localtime_s(&tminfo, &t);
+#elif defined(__linux__) || defined(__unix__) || defined(__APPLE__)
+    localtime_r(&t, &tminfo);
+#else
+    {
+        struct tm *tmp = localtime(&t);
+        if (tmp) tminfo = *tmp; else memset(&tminfo, 0, sizeof(tminfo));
+    }
+#endif
+    strftime(buf, size, "%Y%m%d%H%M%S", &tminfo);
+}
+
+/* <base>_<timestamp>.<ext>, with a counter added if that name is already taken */
+static gchar *unique_stored_name(const char *versions_dir, const char *path, const char *timestr) {
+    gchar *base = g_path_get_basename(path);
+    for (char *p = base; *p; ++p) if (*p == '/' || *p == '\\') *p = '_';
+    /* extract extension manually to avoid missing glib API on some systems */
+    const char *ext = NULL;
+    char *dot = strrchr(base, '.');
+    if (dot && dot[1] != '\0') ext = dot + 1;
+
+    gchar *name = NULL;
+    for (guint n = 1; ; ++n) {
+        gchar *stamp = n == 1 ? g_strdup(timestr) : g_strdup_printf("%s_%u", timestr, n);
+        name = ext ? g_strdup_printf("%s_%s.%s", base, stamp, ext) : g_strdup_printf("%s_%s", base, stamp);
+        g_free(stamp);
+        gchar *candidate = g_build_filename(versions_dir, name, NULL);
+        gboolean taken = g_file_test(candidate, G_FILE_TEST_EXISTS) || chunk_store_is_chunked(candidate);
+        g_free(candidate);
+        if (!taken) break;
+        g_free(name);
+    }
+    g_free(base);
+    return name;
+}
+
+gchar *version_store_record(const char *path, GError **error) {
+    TRACE_SCOPE("store.record");
+    gchar *versions_dir = g_build_filename(data_dir, "versions", NULL);
+    g_mkdir_with_parents(versions_dir, 0755);
+
+    char timestr[64];
+    format_timestamp(timestr, sizeof(timestr));
+    gchar *dest_name = unique_stored_name(versions_dir, path, timestr);
+    gchar *dest_path = g_build_filename(versions_dir, dest_name, NULL);
+
+    /* Stored as chunks: only the regions this version doesn't share with anything recorded before take space */
+    gchar *contents = NULL;
+    gsize length = 0;
+    TRACE_BEGIN(copy, "store.chunk");
+    ChunkWriteStats stats;
+    gboolean ok = g_file_get_contents(path, &contents, &length, error) &&
+                  chunk_store_write(dest_path, contents, length, &stats, error);
+    if (ok) {
+        perf_counter_add(PERF_RECORD_BYTES, (gint64)length);
+        perf_counter_add(PERF_STORED_BYTES, (gint64)stats.new_bytes);
+    }
+    TRACE_END(copy);
+    if (ok) {
+        TRACE_BEGIN(append, "store.append_index");
+        VersionEntry entry = { (gchar *)path, dest_name, timestr };
+        ok = append_index(&entry, error);
+        TRACE_END(append);
+    }
+    if (ok) {
+        /* The version is recorded either way; anything missed here is caught up by the next search or annotation */
+        GError *index_error = NULL;
+        if (!trigram_index_add(dest_name, contents, length, &index_error)) {
+            g_printerr("Could not index %s for search: %s\n", dest_name, index_error ? index_error->message : "unknown");
+            g_clear_error(&index_error);
+        }
+
+        GError *blame_error = NULL;
+        if (!blame_extend_cached(path, &blame_error)) {
+            g_printerr("Could not update the annotation of %s: %s\n", path, blame_error ? blame_error->message : "unknown");
+            g_clear_error(&blame_error);
+        }
+    }
+    g_free(contents);
+    g_free(dest_path);
+    g_free(versions_dir);
+
+    if (!ok) {
+        g_free(dest_name);
+        return NULL;
+    }
+    return dest_name;
+}
+
+GPtrArray *version_store_list(const char *path) {
+    GPtrArray *entries = load_index();
+    if (!path) return entries;
+    GPtrArray *matching = g_ptr_array_new_with_free_func((GDestroyNotify)version_entry_free);
+    for (guint i = 0; i < entries->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(entries, i);
+        if (g_strcmp0(entry->original, path) == 0) {
+            /* Moved out in place; stealing by index would shift the rest each time */
+            g_ptr_array_add(matching, entry);
+            g_ptr_array_index(entries, i) = NULL;
+        }
+    }
+    g_ptr_array_free(entries, TRUE);
+    return matching;
+}
+
+gboolean version_store_delete(const char *stored_path, GError **error) {
+    TRACE_SCOPE("store.delete");
+    /* Versions recorded before chunking are plain files; the chunks of a chunked one may be shared and
+     * stay until version_store_collect_chunks() */
+    if (chunk_store_is_chunked(stored_path)) {
+        if (!chunk_store_remove(stored_path, error)) return FALSE;
+    } else if (g_remove(stored_path) != 0) {
+        /* g_remove takes UTF-8 and uses the wide API on Windows */
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                    "could not remove %s: %s", stored_path, g_strerror(saved));
+        return FALSE;
+    }
+
+    gchar *stored = g_path_get_basename(stored_path);
+    GPtrArray *entries = load_index();
+    guint before = entries->len;
+    for (guint i = 0; i < entries->len; ++i) {
+        VersionEntry *entry = g_ptr_array_index(entries, i);
+        if (g_strcmp0(entry->stored, stored) == 0) g_ptr_array_remove_index(entries, i--);
+    }
+    gboolean ok = entries->len == before || save_index(entries, error);
+    g_ptr_array_free(entries, TRUE);
+    g_free(stored);
+    return ok;
+}
+
+gboolean version_store_collect_chunks(ChunkCollectStats *stats, GError **error) {
+    gchar *versions_dir = g_build_filename(data_dir, "versions", NULL);
+    gboolean ok = chunk_store_collect(versions_dir, stats, error);
+    g_free(versions_dir);
+    return ok;
+}
+
+gboolean version_store_restore(const char *stored_path, const char *path, GError **error) {
+    TRACE_SCOPE("store.restore");
+    if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+        /* Cheap: whatever the file shares with its recorded versions is stored already */
+        gchar *stored = version_store_record(path, error);
+        if (!stored) return FALSE;
+        g_free(stored);
+    }
+    return chunk_store_export(stored_path, path, error);
+}
+
+// ---
+// --- Tracked files
+// ---
+
+static GPtrArray *read_files_index(gboolean *found, const char *path) {
+    GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+    gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
+    FILE *f = fopen(index_path, "r");
+    g_free(index_path);
+    if (found) *found = FALSE;
+    if (!f) return lines;
+    char buf[4096];
+    while (fgets(buf, sizeof(buf), f)) {
+        char *nl = strpbrk(buf, "\r\n"); if (nl) *nl = '\0';
+        if (g_strcmp0(buf, path) == 0) {
+            if (found) *found = TRUE;
+            continue;
+        }
+        g_ptr_array_add(lines, g_strdup(buf));
+    }
+    fclose(f);
+    return lines;
+}
+
+void version_store_track_file(const char *path) {
+    g_mkdir_with_parents(data_dir, 0755);
+    gboolean already = FALSE;
+    GPtrArray *lines = read_files_index(&already, path);
+    g_ptr_array_free(lines, TRUE);
+    if (already) return;
+
+    gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
+    FILE *f = fopen(index_path, "a");
+    if (f) { fprintf(f, "%s\n", path); fclose(f); }
+    g_free(index_path);
+}
+
+void version_store_untrack_file(const char *path) {
+    gboolean found = FALSE;
+    GPtrArray *lines = read_files_index(&found, path);
+    if (found) {
+        gchar *index_path = g_build_filename(data_dir, "files_index.txt", NULL);
+        FILE *fw = fopen(index_path, "w");
+        if (fw) {
+            for (guint i = 0; i < lines->len; ++i) {
+                fprintf(fw, "%s\n", (char *)g_ptr_array_index(lines, i));
+            }
+            fclose(fw);
+        }
+        g_free(index_path);
+    }
+    g_ptr_array_free(lines, TRUE);
+}
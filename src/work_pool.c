@@ -0,0 +1,156 @@
+#include "work_pool.h"
+
+typedef struct {
+    GMutex lock;
+    GQueue items;       /* owner pushes/pops at the head, thieves take from the tail */
+} WorkDeque;
+
+struct _WorkPool {
+    WorkPoolFunc func;
+    gpointer user_data;
+    guint n_workers;
+    WorkDeque *deques;
+    GThread **threads;
+
+    GMutex lock;        /* guards the counters below */
+    GCond work_cond;    /* signalled when items are queued or the pool stops */
+    GCond done_cond;    /* signalled when pending drops to zero */
+    gint queued;        /* in a deque, not yet taken (briefly -1 while a push completes) */
+    guint pending;      /* pushed and not yet finished */
+    guint next;         /* round-robin target for outside pushes */
+    gboolean stopping;
+};
+
+typedef struct {
+    WorkPool *pool;
+    guint index;
+} WorkerStart;
+
+/* Which pool and worker the current thread belongs to */
+static GPrivate current_pool;
+static GPrivate current_index;
+
+static gpointer take_item(WorkPool *pool, guint self) {
+    WorkDeque *own = &pool->deques[self];
+    g_mutex_lock(&own->lock);
+    gpointer item = g_queue_pop_head(&own->items);
+    g_mutex_unlock(&own->lock);
+
+    for (guint i = 1; !item && i < pool->n_workers; ++i) {
+        WorkDeque *victim = &pool->deques[(self + i) % pool->n_workers];
+        g_mutex_lock(&victim->lock);
+        item = g_queue_pop_tail(&victim->items);
+        g_mutex_unlock(&victim->lock);
+    }
+
+    if (item) {
+        g_mutex_lock(&pool->lock);
+        pool->queued--;
+        g_mutex_unlock(&pool->lock);
+    }
+    return item;
+}
+
+static gpointer worker_main(gpointer data) {
+    WorkerStart *start = data;
+    WorkPool *pool = start->pool;
+    guint self = start->index;
+    g_free(start);
+    g_private_set(&current_pool, pool);
+    g_private_set(&current_index, GUINT_TO_POINTER(self + 1));
+
+    for (;;) {
+        gpointer item = take_item(pool, self);
+        if (item) {
+            pool->func(item, pool->user_data);
+            g_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) g_cond_broadcast(&pool->done_cond);
+            g_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        g_mutex_lock(&pool->lock);
+        while (pool->queued <= 0 && !pool->stopping) g_cond_wait(&pool->work_cond, &pool->lock);
+        gboolean stop = pool->queued <= 0 && pool->stopping;
+        g_mutex_unlock(&pool->lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+WorkPool *work_pool_new(guint n_threads, WorkPoolFunc func, gpointer user_data) {
+    WorkPool *pool = g_new0(WorkPool, 1);
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->n_workers = n_threads ? n_threads : MAX(g_get_num_processors(), 1);
+    pool->deques = g_new0(WorkDeque, pool->n_workers);
+    pool->threads = g_new0(GThread *, pool->n_workers);
+    g_mutex_init(&pool->lock);
+    g_cond_init(&pool->work_cond);
+    g_cond_init(&pool->done_cond);
+
+    for (guint i = 0; i < pool->n_workers; ++i) {
+        g_mutex_init(&pool->deques[i].lock);
+        g_queue_init(&pool->deques[i].items);
+    }
+    for (guint i = 0; i < pool->n_workers; ++i) {
+        WorkerStart *start = g_new(WorkerStart, 1);
+        start->pool = pool;
+        start->index = i;
+        pool->threads[i] = g_thread_new("work-pool", worker_main, start);
+    }
+    return pool;
+}
+
+guint work_pool_get_n_threads(WorkPool *pool) {
+    return pool->n_workers;
+}
+
+int work_pool_current_worker(void) {
+    return (int)GPOINTER_TO_UINT(g_private_get(&current_index)) - 1;
+}
+
+void work_pool_push(WorkPool *pool, gpointer item) {
+    /* Count it as pending first so a fast worker can't finish it before it is counted */
+    g_mutex_lock(&pool->lock);
+    pool->pending++;
+    guint target;
+    if (g_private_get(&current_pool) == pool) target = (guint)work_pool_current_worker();
+    else target = pool->next++ % pool->n_workers;
+    g_mutex_unlock(&pool->lock);
+
+    WorkDeque *deque = &pool->deques[target];
+    g_mutex_lock(&deque->lock);
+    g_queue_push_head(&deque->items, item);
+    g_mutex_unlock(&deque->lock);
+
+    g_mutex_lock(&pool->lock);
+    pool->queued++;
+    g_cond_signal(&pool->work_cond);
+    g_mutex_unlock(&pool->lock);
+}
+
+void work_pool_wait(WorkPool *pool) {
+    g_mutex_lock(&pool->lock);
+    while (pool->pending > 0) g_cond_wait(&pool->done_cond, &pool->lock);
+    g_mutex_unlock(&pool->lock);
+}
+
+void work_pool_free(WorkPool *pool) {
+    if (!pool) return;
+    work_pool_wait(pool);
+
+    g_mutex_lock(&pool->lock);
+    pool->stopping = TRUE;
+    g_cond_broadcast(&pool->work_cond);
+    g_mutex_unlock(&pool->lock);
+    for (guint i = 0; i < pool->n_workers; ++i) g_thread_join(pool->threads[i]);
+
+    for (guint i = 0; i < pool->n_workers; ++i) g_mutex_clear(&pool->deques[i].lock);
+    g_mutex_clear(&pool->lock);
+    g_cond_clear(&pool->work_cond);
+    g_cond_clear(&pool->done_cond);
+    g_free(pool->deques);
+    g_free(pool->threads);
+    g_free(pool);
+}
@@ -0,0 +1,161 @@
+/*
+ * chunk_store_write() and reading back, in a scratch data directory.
+ *
+ * Contents of assorted sizes (empty, under one chunk, many chunks, chunks cut
+ * at CHUNK_MAX_SIZE) are written as chunk lists and must come back byte for
+ * byte through chunk_store_read_file() and chunk_store_stream(). Files that
+ * share most of their bytes must share chunks: writing an edited copy stores
+ * only the chunks around the edit, and after one of them is removed and
+ * chunk_store_collect() runs the other still reads back whole.
+ */
+#include "chunk_store.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+static GByteArray *random_bytes(gsize length) {
+    GByteArray *data = g_byte_array_sized_new(MAX(length, 1));
+    for (gsize i = 0; i < length; ++i) {
+        guint8 b = (guint8)g_test_rand_int_range(0, 256);
+        g_byte_array_append(data, &b, 1);
+    }
+    return data;
+}
+
+static gboolean append_sink(const char *data, gsize length, gpointer user_data, GError **error) {
+    g_byte_array_append(user_data, (const guint8 *)data, (guint)length);
+    return TRUE;
+}
+
+static void assert_reads_back(const char *path, const guint8 *data, gsize length) {
+    g_assert_true(chunk_store_is_chunked(path));
+    g_assert_cmpint(chunk_store_file_length(path), ==, (gint64)length);
+
+    GError *error = NULL;
+    gchar *contents = NULL;
+    gsize read_length = 0;
+    g_assert_true(chunk_store_read_file(path, &contents, &read_length, &error));
+    g_assert_no_error(error);
+    g_assert_cmpmem(contents, read_length, data, length);
+    g_free(contents);
+
+    GByteArray *streamed = g_byte_array_new();
+    g_assert_true(chunk_store_stream(path, append_sink, streamed, &error));
+    g_assert_no_error(error);
+    g_assert_cmpmem(streamed->data, streamed->len, data, length);
+    g_byte_array_unref(streamed);
+}
+
+static void write_and_check(const char *path, const guint8 *data, gsize length, ChunkWriteStats *stats) {
+    GError *error = NULL;
+    g_assert_true(chunk_store_write(path, (const char *)data, length, stats, &error));
+    g_assert_no_error(error);
+    assert_reads_back(path, data, length);
+}
+
+static void test_round_trip(void) {
+    const gsize sizes[] = { 0, 1, CHUNK_MIN_SIZE - 1, CHUNK_AVG_SIZE, 3 * CHUNK_MAX_SIZE + 17, 1 << 20 };
+    for (guint i = 0; i < G_N_ELEMENTS(sizes); ++i) {
+        GByteArray *data = random_bytes(sizes[i]);
+        gchar *path = g_strdup_printf("data/versions/round_trip_%u", i);
+        ChunkWriteStats stats;
+        write_and_check(path, data->data, data->len, &stats);
+        g_assert_cmpuint(stats.chunks, >=, (sizes[i] + CHUNK_MAX_SIZE - 1) / CHUNK_MAX_SIZE);
+        g_free(path);
+        g_byte_array_unref(data);
+    }
+
+    /* A run of one byte value has no cut points, so every chunk is cut at the maximum */
+    GByteArray *flat = g_byte_array_new();
+    guint8 zero = 0;
+    for (gsize i = 0; i < 5 * CHUNK_MAX_SIZE + 3; ++i) g_byte_array_append(flat, &zero, 1);
+    ChunkWriteStats stats;
+    write_and_check("data/versions/flat", flat->data, flat->len, &stats);
+    g_assert_cmpuint(stats.chunks, ==, 6);
+    /* ...and the five full chunks are one chunk */
+    g_assert_cmpuint(stats.new_chunks, <=, 2);
+    g_byte_array_unref(flat);
+}
+
+static void test_shared_chunks(void) {
+    GByteArray *base = random_bytes(1 << 20);
+    ChunkWriteStats stats;
+    write_and_check("data/versions/shared_base", base->data, base->len, &stats);
+    guint base_chunks = stats.chunks;
+
+    /* The same contents again store nothing and name the same list */
+    write_and_check("data/versions/shared_same", base->data, base->len, &stats);
+    g_assert_cmpuint(stats.new_chunks, ==, 0);
+    g_assert_cmpuint(stats.new_bytes, ==, 0);
+    gchar *base_id = chunk_store_content_id("data/versions/shared_base");
+    gchar *same_id = chunk_store_content_id("data/versions/shared_same");
+    g_assert_nonnull(base_id);
+    g_assert_cmpstr(base_id, ==, same_id);
+
+    /* A few bytes inserted in the middle only change the chunks around them */
+    GByteArray *edited = g_byte_array_sized_new(base->len + 100);
+    g_byte_array_append(edited, base->data, base->len / 2);
+    g_byte_array_append(edited, (const guint8 *)"inserted in the middle", 22);
+    g_byte_array_append(edited, base->data + base->len / 2, base->len - base->len / 2);
+    write_and_check("data/versions/shared_edited", edited->data, edited->len, &stats);
+    g_assert_cmpuint(stats.new_chunks, >=, 1);
+    g_assert_cmpuint(stats.new_chunks, <=, 3);
+    g_assert_cmpuint(stats.new_bytes, <, edited->len / 4);
+    g_assert_cmpuint(stats.chunks, >=, base_chunks - 2);
+    gchar *edited_id = chunk_store_content_id("data/versions/shared_edited");
+    g_assert_cmpstr(base_id, !=, edited_id);
+
+    /* Removing lists leaves the chunks the others still name */
+    GError *error = NULL;
+    g_assert_true(chunk_store_remove("data/versions/shared_base", &error));
+    g_assert_true(chunk_store_remove("data/versions/shared_same", &error));
+    g_assert_no_error(error);
+    g_assert_false(chunk_store_is_chunked("data/versions/shared_base"));
+    ChunkCollectStats collected;
+    g_assert_true(chunk_store_collect("data/versions", &collected, &error));
+    g_assert_no_error(error);
+    g_assert_cmpuint(collected.removed_chunks, >=, 1);
+    g_assert_cmpuint(collected.removed_chunks, <=, 3);
+    assert_reads_back("data/versions/shared_edited", edited->data, edited->len);
+
+    g_free(base_id);
+    g_free(same_id);
+    g_free(edited_id);
+    g_byte_array_unref(edited);
+    g_byte_array_unref(base);
+}
+
+static gboolean remove_tree(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        if (dir) {
+            const char *name;
+            while ((name = g_dir_read_name(dir))) {
+                gchar *child = g_build_filename(path, name, NULL);
+                remove_tree(child);
+                g_free(child);
+            }
+            g_dir_close(dir);
+        }
+    }
+    return g_remove(path) == 0;
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/chunk-store/round-trip", test_round_trip);
+    g_test_add_func("/chunk-store/shared-chunks", test_shared_chunks);
+
+    /* The store works on ./data */
+    gchar *cwd = g_get_current_dir();
+    gchar *root = g_dir_make_tmp("chunk_store_test_XXXXXX", NULL);
+    g_assert_nonnull(root);
+    g_assert_cmpint(g_chdir(root), ==, 0);
+    g_mkdir_with_parents("data/versions", 0755);
+    int status = g_test_run();
+    g_chdir(cwd);
+    remove_tree(root);
+    g_free(root);
+    g_free(cwd);
+    return status;
+}
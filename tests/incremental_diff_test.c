@@ -0,0 +1,191 @@
+/*
+ * incremental_diff() against a full rediff.
+ *
+ * Each case builds two texts, diffs them in full, then makes random byte
+ * edits to one side. After every edit the line table is spliced and the
+ * script updated with incremental_diff(); the spliced table must equal a
+ * fresh one, and the script must be a valid edit script of the new texts.
+ * With distinct lines there is only one shortest script, so it must also be
+ * the one myers_diff_sequence() gives for the whole texts.
+ */
+#include "incremental_diff.h"
+#include "line_table.h"
+#include "myers_diff.h"
+#include <glib.h>
+#include <string.h>
+
+#define EDITS_PER_CASE 40
+
+static void append_line(GString *text, gboolean distinct, guint *serial) {
+    if (distinct) g_string_append_printf(text, "line %u\n", (*serial)++);
+    else g_string_append_printf(text, "%c\n", 'a' + g_test_rand_int_range(0, 6));
+}
+
+static GString *random_text(guint n_lines, gboolean distinct, guint *serial) {
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i < n_lines; ++i) append_line(text, distinct, serial);
+    return text;
+}
+
+/* Replace a random stretch of whole lines of 'text' with fresh ones; returns the byte edit */
+static void edit_lines(GString *text, gboolean distinct, guint *serial, gsize *start, gsize *old_bytes,
+                       gsize *new_bytes) {
+    LineTable *table = line_table_new(text->str, text->len);
+    guint first = g_test_rand_int_range(0, table->n_lines + 1);
+    guint removed = g_test_rand_int_range(0, 4);
+    removed = MIN(removed, table->n_lines - first);
+    guint added = g_test_rand_int_range(removed == 0 ? 1 : 0, 4);
+    *start = g_array_index(table->offsets, gsize, first);
+    *old_bytes = g_array_index(table->offsets, gsize, first + removed) - *start;
+    line_table_free(table);
+
+    GString *fresh = g_string_new(NULL);
+    for (guint i = 0; i < added; ++i) append_line(fresh, distinct, serial);
+    g_string_erase(text, (gssize)*start, (gssize)*old_bytes);
+    g_string_insert_len(text, (gssize)*start, fresh->str, (gssize)fresh->len);
+    *new_bytes = fresh->len;
+    g_string_free(fresh, TRUE);
+}
+
+/* Replace a few random bytes, newlines included, so lines split and join */
+static void edit_bytes(GString *text, gsize *start, gsize *old_bytes, gsize *new_bytes) {
+    static const char pool[] = "ab\n";
+    *start = g_test_rand_int_range(0, (gint32)text->len + 1);
+    *old_bytes = g_test_rand_int_range(0, 4);
+    *old_bytes = MIN(*old_bytes, text->len - *start);
+    *new_bytes = g_test_rand_int_range(*old_bytes == 0 ? 1 : 0, 4);
+    char fresh[4];
+    for (gsize i = 0; i < *new_bytes; ++i) fresh[i] = pool[g_test_rand_int_range(0, 3)];
+    g_string_erase(text, (gssize)*start, (gssize)*old_bytes);
+    g_string_insert_len(text, (gssize)*start, fresh, (gssize)*new_bytes);
+}
+
+static void assert_tables_equal(const LineTable *spliced, const LineTable *fresh) {
+    g_assert_cmpuint(spliced->n_lines, ==, fresh->n_lines);
+    g_assert_cmpmem(spliced->hashes->data, spliced->n_lines * sizeof(guint64),
+                    fresh->hashes->data, fresh->n_lines * sizeof(guint64));
+    g_assert_cmpmem(spliced->offsets->data, (spliced->n_lines + 1) * sizeof(gsize),
+                    fresh->offsets->data, (fresh->n_lines + 1) * sizeof(gsize));
+}
+
+/* Walk the script over both sides: runs in order, equal runs equal, every line covered once */
+static void check_script(const GArray *script, const LineTable *left, const LineTable *right) {
+    const guint64 *a = (const guint64 *)left->hashes->data;
+    const guint64 *b = (const guint64 *)right->hashes->data;
+    guint i = 0, j = 0;
+    for (guint k = 0; k < script->len; ++k) {
+        const DiffEdit *e = &g_array_index(script, DiffEdit, k);
+        g_assert_cmpuint(e->length, >, 0);
+        g_assert_cmpuint(e->left_start, ==, i);
+        g_assert_cmpuint(e->right_start, ==, j);
+        switch (e->type) {
+        case DIFF_OP_EQUAL:
+            g_assert_cmpuint(i + e->length, <=, left->n_lines);
+            g_assert_cmpuint(j + e->length, <=, right->n_lines);
+            for (guint l = 0; l < e->length; ++l) g_assert_true(a[i + l] == b[j + l]);
+            i += e->length;
+            j += e->length;
+            break;
+        case DIFF_OP_DELETE:
+            i += e->length;
+            break;
+        case DIFF_OP_INSERT:
+            j += e->length;
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+    g_assert_cmpuint(i, ==, left->n_lines);
+    g_assert_cmpuint(j, ==, right->n_lines);
+}
+
+static void assert_scripts_equal(const GArray *got, const GArray *want) {
+    g_assert_cmpuint(got->len, ==, want->len);
+    for (guint k = 0; k < got->len; ++k) {
+        const DiffEdit *x = &g_array_index(got, DiffEdit, k);
+        const DiffEdit *y = &g_array_index(want, DiffEdit, k);
+        g_assert_cmpint(x->type, ==, y->type);
+        g_assert_cmpuint(x->left_start, ==, y->left_start);
+        g_assert_cmpuint(x->right_start, ==, y->right_start);
+        g_assert_cmpuint(x->length, ==, y->length);
+    }
+}
+
+static GArray *full_diff(const LineTable *left, const LineTable *right) {
+    return myers_diff_sequence((const guint64 *)left->hashes->data, left->n_lines,
+                               (const guint64 *)right->hashes->data, right->n_lines);
+}
+
+static void run_case(DiffSide side, gboolean distinct, gboolean whole_lines) {
+    guint serial = 0;
+    GString *texts[2];
+    texts[0] = random_text(g_test_rand_int_range(0, 200), distinct, &serial);
+    texts[1] = g_string_new(texts[0]->str);
+    LineTable *tables[2] = { line_table_new(texts[0]->str, texts[0]->len), NULL };
+    /* Start from a diff with some changes in it */
+    for (int i = 0; i < 5; ++i) {
+        gsize start, old_bytes, new_bytes;
+        edit_lines(texts[1], distinct, &serial, &start, &old_bytes, &new_bytes);
+    }
+    tables[1] = line_table_new(texts[1]->str, texts[1]->len);
+    GArray *script = full_diff(tables[0], tables[1]);
+
+    int e = side == DIFF_SIDE_LEFT ? 0 : 1;
+    for (int round = 0; round < EDITS_PER_CASE; ++round) {
+        gsize start, old_bytes, new_bytes;
+        if (whole_lines) edit_lines(texts[e], distinct, &serial, &start, &old_bytes, &new_bytes);
+        else edit_bytes(texts[e], &start, &old_bytes, &new_bytes);
+
+        LineEdit edit;
+        line_table_splice(tables[e], texts[e]->str, texts[e]->len, start, old_bytes, new_bytes, &edit);
+        LineTable *fresh = line_table_new(texts[e]->str, texts[e]->len);
+        assert_tables_equal(tables[e], fresh);
+        line_table_free(fresh);
+
+        GArray *updated = incremental_diff(script, tables[0], tables[1], side, &edit, 1);
+        GArray *full = full_diff(tables[0], tables[1]);
+        check_script(updated, tables[0], tables[1]);
+        if (distinct) assert_scripts_equal(updated, full);
+        g_array_unref(full);
+        g_array_unref(script);
+        script = updated;
+    }
+
+    g_array_unref(script);
+    for (int i = 0; i < 2; ++i) {
+        line_table_free(tables[i]);
+        g_string_free(texts[i], TRUE);
+    }
+}
+
+static void test_distinct_lines_right(void) {
+    for (int i = 0; i < 50; ++i) run_case(DIFF_SIDE_RIGHT, TRUE, TRUE);
+}
+
+static void test_distinct_lines_left(void) {
+    for (int i = 0; i < 50; ++i) run_case(DIFF_SIDE_LEFT, TRUE, TRUE);
+}
+
+static void test_repeated_lines(void) {
+    for (int i = 0; i < 50; ++i) {
+        run_case(DIFF_SIDE_RIGHT, FALSE, TRUE);
+        run_case(DIFF_SIDE_LEFT, FALSE, TRUE);
+    }
+}
+
+static void test_byte_edits(void) {
+    for (int i = 0; i < 50; ++i) {
+        run_case(DIFF_SIDE_RIGHT, FALSE, FALSE);
+        run_case(DIFF_SIDE_LEFT, FALSE, FALSE);
+    }
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/incremental-diff/distinct-lines-right", test_distinct_lines_right);
+    g_test_add_func("/incremental-diff/distinct-lines-left", test_distinct_lines_left);
+    g_test_add_func("/incremental-diff/repeated-lines", test_repeated_lines);
+    g_test_add_func("/incremental-diff/byte-edits", test_byte_edits);
+    return g_test_run();
+}
@@ -0,0 +1,130 @@
+/*
+ * perform_merge3() and merge3_render() on small files.
+ *
+ * Clean merges (changes on one side, on both sides apart, the same change on
+ * both) must give the text with every change applied and no conflicts;
+ * overlapping changes must give one conflict per overlap, with the left,
+ * base and right lines between the markers. A binary input is refused.
+ */
+#include "diff_logic.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+static const char *const labels[3] = { "base", "left", "right" };
+
+typedef struct {
+    gchar *dir;
+    gchar *paths[3];
+} MergeFiles;
+
+static void merge_files_init(MergeFiles *files, const char *base, const char *left, const char *right) {
+    const char *texts[3] = { base, left, right };
+    files->dir = g_dir_make_tmp("merge3_test_XXXXXX", NULL);
+    g_assert_nonnull(files->dir);
+    for (int s = 0; s < 3; ++s) {
+        files->paths[s] = g_build_filename(files->dir, labels[s], NULL);
+        g_assert_true(g_file_set_contents(files->paths[s], texts[s], -1, NULL));
+    }
+}
+
+static void merge_files_clear(MergeFiles *files) {
+    for (int s = 0; s < 3; ++s) {
+        g_remove(files->paths[s]);
+        g_free(files->paths[s]);
+    }
+    g_rmdir(files->dir);
+    g_free(files->dir);
+}
+
+/* Merge, check the conflict count and the rendered text */
+static void check_merge(const char *base, const char *left, const char *right, guint conflicts, const char *expected) {
+    MergeFiles files;
+    merge_files_init(&files, base, left, right);
+    GError *error = NULL;
+    Merge3Result *merge = perform_merge3(files.paths[MERGE_BASE], files.paths[MERGE_LEFT], files.paths[MERGE_RIGHT], &error);
+    g_assert_no_error(error);
+    g_assert_nonnull(merge);
+    g_assert_cmpuint(merge->n_conflicts, ==, conflicts);
+
+    GArray *conflict_lines = g_array_new(FALSE, FALSE, sizeof(guint));
+    gsize length = 0;
+    gchar *text = merge3_render(merge, labels, &length, conflict_lines);
+    g_assert_cmpstr(text, ==, expected);
+    g_assert_cmpuint(length, ==, strlen(expected));
+    g_assert_cmpuint(conflict_lines->len, ==, 2 * conflicts);
+
+    /* Every conflict's lines start at its "<<<<<<<" marker and end with its ">>>>>>>" one */
+    gchar **lines = g_strsplit(text, "\n", -1);
+    for (guint c = 0; c < conflicts; ++c) {
+        guint first = g_array_index(conflict_lines, guint, 2 * c);
+        guint count = g_array_index(conflict_lines, guint, 2 * c + 1);
+        g_assert_true(g_str_has_prefix(lines[first], "<<<<<<< left"));
+        g_assert_true(g_str_has_prefix(lines[first + count - 1], ">>>>>>> right"));
+    }
+    g_strfreev(lines);
+    g_array_unref(conflict_lines);
+    g_free(text);
+    merge3_result_free(merge);
+    merge_files_clear(&files);
+}
+
+static void test_clean(void) {
+    const char *base = "one\ntwo\nthree\nfour\nfive\nsix\n";
+    /* Nothing changed */
+    check_merge(base, base, base, 0, base);
+    /* One side only */
+    check_merge(base, "one\nTWO\nthree\nfour\nfive\nsix\n", base, 0, "one\nTWO\nthree\nfour\nfive\nsix\n");
+    check_merge(base, base, "one\ntwo\nthree\nfour\nfive\nsix\nseven\n", 0, "one\ntwo\nthree\nfour\nfive\nsix\nseven\n");
+    /* Both sides, apart: an edit, a delete and an insert */
+    check_merge(base, "one\nTWO\nthree\nfour\nfive\nsix\n", "one\ntwo\nthree\nfive\nsix\nseven\n", 0,
+                "one\nTWO\nthree\nfive\nsix\nseven\n");
+    /* The same change on both sides is taken once */
+    check_merge(base, "zero\none\ntwo\nthree\nfour\nfive\nSIX\n", "one\ntwo\nthree\nfour\nfive\nSIX\n", 0,
+                "zero\none\ntwo\nthree\nfour\nfive\nSIX\n");
+    /* A last line without a newline */
+    check_merge("a\nb\nc", "A\nb\nc", "a\nb\nC", 0, "A\nb\nC");
+}
+
+static void test_conflicts(void) {
+    const char *base = "one\ntwo\nthree\nfour\nfive\nsix\n";
+    /* Both sides change the same line differently */
+    check_merge(base, "one\nleft\nthree\nfour\nfive\nsix\n", "one\nright\nthree\nfour\nfive\nsix\n", 1,
+                "one\n"
+                "<<<<<<< left\nleft\n||||||| base\ntwo\n=======\nright\n>>>>>>> right\n"
+                "three\nfour\nfive\nsix\n");
+    /* One side deletes what the other edits */
+    check_merge(base, "one\ntwo\nthree\nfive\nsix\n", "one\ntwo\nthree\nFOUR\nfive\nsix\n", 1,
+                "one\ntwo\nthree\n"
+                "<<<<<<< left\n||||||| base\nfour\n=======\nFOUR\n>>>>>>> right\n"
+                "five\nsix\n");
+    /* Two separate overlaps, with a clean change between them */
+    check_merge(base, "ONE\ntwo\nthree\nfour\nfive\nsix!\n", "1\ntwo\nTHREE\nfour\nfive\n6\n", 2,
+                "<<<<<<< left\nONE\n||||||| base\none\n=======\n1\n>>>>>>> right\n"
+                "two\nTHREE\nfour\nfive\n"
+                "<<<<<<< left\nsix!\n||||||| base\nsix\n=======\n6\n>>>>>>> right\n");
+    /* Both sides insert different lines at the same place */
+    check_merge("a\nb\n", "a\nleft\nb\n", "a\nright\nb\n", 1,
+                "a\n<<<<<<< left\nleft\n||||||| base\n=======\nright\n>>>>>>> right\nb\n");
+}
+
+static void test_binary(void) {
+    MergeFiles files;
+    merge_files_init(&files, "text\n", "text\n", "text\n");
+    static const char binary[] = { 'P', 'K', 3, 4, 0, 0, 0, 0, 'x' };
+    g_assert_true(g_file_set_contents(files.paths[MERGE_RIGHT], binary, sizeof(binary), NULL));
+    GError *error = NULL;
+    Merge3Result *merge = perform_merge3(files.paths[MERGE_BASE], files.paths[MERGE_LEFT], files.paths[MERGE_RIGHT], &error);
+    g_assert_null(merge);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_clear_error(&error);
+    merge_files_clear(&files);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/merge3/clean", test_clean);
+    g_test_add_func("/merge3/conflicts", test_conflicts);
+    g_test_add_func("/merge3/binary", test_binary);
+    return g_test_run();
+}
@@ -0,0 +1,142 @@
+/*
+ * myers_diff_sequence() and myers_diff_stats() against a brute-force LCS.
+ *
+ * Random sequences over a small alphabet (so there are many equal elements
+ * and many equally short scripts) are diffed. The script must be a valid
+ * edit script of the two sequences, and it must be a shortest one: its equal
+ * runs add up to the length of the longest common subsequence, which the
+ * quadratic dynamic program gives. myers_diff_stats() must count the same
+ * insertions and deletions, and below the limit either give those exact
+ * counts or give up with an upper bound.
+ */
+#include "myers_diff.h"
+#include <glib.h>
+
+static guint64 *random_sequence(guint n, guint alphabet) {
+    guint64 *s = g_new(guint64, MAX(n, 1));
+    for (guint i = 0; i < n; ++i) s[i] = (guint64)g_test_rand_int_range(0, (gint32)alphabet);
+    return s;
+}
+
+static guint brute_force_lcs(const guint64 *a, guint n, const guint64 *b, guint m) {
+    guint *row = g_new0(guint, m + 1);
+    for (guint i = 1; i <= n; ++i) {
+        guint diag = 0;
+        for (guint j = 1; j <= m; ++j) {
+            guint up = row[j];
+            row[j] = a[i - 1] == b[j - 1] ? diag + 1 : MAX(up, row[j - 1]);
+            diag = up;
+        }
+    }
+    guint lcs = row[m];
+    g_free(row);
+    return lcs;
+}
+
+/* Walk the script over both sides: runs in order, equal runs equal, every element covered once */
+static guint check_script(const GArray *script, const guint64 *a, guint n, const guint64 *b, guint m) {
+    guint i = 0, j = 0, equal = 0;
+    for (guint k = 0; k < script->len; ++k) {
+        const DiffEdit *e = &g_array_index(script, DiffEdit, k);
+        g_assert_cmpuint(e->length, >, 0);
+        g_assert_cmpuint(e->left_start, ==, i);
+        g_assert_cmpuint(e->right_start, ==, j);
+        switch (e->type) {
+        case DIFF_OP_EQUAL:
+            g_assert_cmpuint(i + e->length, <=, n);
+            g_assert_cmpuint(j + e->length, <=, m);
+            for (guint l = 0; l < e->length; ++l) g_assert_true(a[i + l] == b[j + l]);
+            i += e->length;
+            j += e->length;
+            equal += e->length;
+            break;
+        case DIFF_OP_DELETE:
+            i += e->length;
+            break;
+        case DIFF_OP_INSERT:
+            j += e->length;
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+    g_assert_cmpuint(i, ==, n);
+    g_assert_cmpuint(j, ==, m);
+    return equal;
+}
+
+static void run_case(guint n, guint m, guint alphabet) {
+    guint64 *a = random_sequence(n, alphabet);
+    guint64 *b = random_sequence(m, alphabet);
+    guint lcs = brute_force_lcs(a, n, b, m);
+
+    GArray *script = myers_diff_sequence(a, n, b, m);
+    g_assert_cmpuint(check_script(script, a, n, b, m), ==, lcs);
+    g_array_unref(script);
+
+    guint inserted = 0, deleted = 0;
+    g_assert_true(myers_diff_stats(a, n, b, m, 0, &inserted, &deleted));
+    g_assert_cmpuint(inserted, ==, m - lcs);
+    g_assert_cmpuint(deleted, ==, n - lcs);
+
+    /* D edits fit in a limit of D; with D - 1 the counts are exact or, if it gave up, an upper bound */
+    guint d = n + m - 2 * lcs;
+    if (d > 1) {
+        g_assert_true(myers_diff_stats(a, n, b, m, d, &inserted, &deleted));
+        g_assert_cmpuint(inserted + deleted, ==, d);
+        if (myers_diff_stats(a, n, b, m, d - 1, &inserted, &deleted)) {
+            g_assert_cmpuint(inserted, ==, m - lcs);
+            g_assert_cmpuint(deleted, ==, n - lcs);
+        } else {
+            g_assert_cmpuint(inserted, >=, m - lcs);
+            g_assert_cmpuint(deleted, >=, n - lcs);
+        }
+    }
+    g_free(a);
+    g_free(b);
+}
+
+static void test_small(void) {
+    for (int i = 0; i < 2000; ++i) {
+        run_case(g_test_rand_int_range(0, 12), g_test_rand_int_range(0, 12), g_test_rand_int_range(1, 4));
+    }
+}
+
+static void test_medium(void) {
+    for (int i = 0; i < 200; ++i) {
+        run_case(g_test_rand_int_range(0, 300), g_test_rand_int_range(0, 300), g_test_rand_int_range(2, 20));
+    }
+}
+
+/* One side a small edit of the other: long common prefix, suffix and middle runs */
+static void test_similar(void) {
+    for (int c = 0; c < 200; ++c) {
+        guint n = g_test_rand_int_range(1, 400);
+        guint64 *a = random_sequence(n, 50);
+        GArray *b = g_array_new(FALSE, FALSE, sizeof(guint64));
+        for (guint i = 0; i < n; ++i) {
+            gint32 roll = g_test_rand_int_range(0, 100);
+            if (roll < 5) continue;
+            if (roll < 10) {
+                guint64 fresh = (guint64)g_test_rand_int_range(0, 50);
+                g_array_append_val(b, fresh);
+            }
+            g_array_append_val(b, a[i]);
+        }
+        guint m = b->len;
+        guint lcs = brute_force_lcs(a, n, (const guint64 *)b->data, m);
+        GArray *script = myers_diff_sequence(a, n, (const guint64 *)b->data, m);
+        g_assert_cmpuint(check_script(script, a, n, (const guint64 *)b->data, m), ==, lcs);
+        g_array_unref(script);
+        g_array_unref(b);
+        g_free(a);
+    }
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/myers-diff/small", test_small);
+    g_test_add_func("/myers-diff/medium", test_medium);
+    g_test_add_func("/myers-diff/similar", test_similar);
+    return g_test_run();
+}
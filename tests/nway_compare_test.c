@@ -0,0 +1,183 @@
+/*
+ * nway_compare_load() and nway_compare_run() against pairwise diffs.
+ *
+ * Each case writes a base text and up to MAX_VERSIONS - 1 random edits of it
+ * to a scratch directory. Loading must give every version's text and line
+ * table as reading it alone does; a run against each base in turn must hand
+ * over one column per other version, with the same script and counts
+ * myers_diff_sequence() gives for that pair. A version that can't be read
+ * loads as a note with its lines, and a cancelled compare hands over nothing.
+ */
+#include "nway_compare.h"
+#include "myers_diff.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* As many as the window opens with (NWAY_MAX_VERSIONS) */
+#define MAX_VERSIONS 10
+
+typedef struct {
+    GMutex lock;
+    GPtrArray *columns;     /* NWayColumn */
+} Collected;
+
+static void collect_column(NWayColumn *column, gpointer user_data) {
+    Collected *collected = user_data;
+    g_mutex_lock(&collected->lock);
+    g_ptr_array_add(collected->columns, column);
+    g_mutex_unlock(&collected->lock);
+}
+
+static GString *random_text(guint n_lines) {
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i < n_lines; ++i) g_string_append_printf(text, "line %c\n", 'a' + g_test_rand_int_range(0, 8));
+    return text;
+}
+
+/* A few stretches of lines replaced with fresh ones */
+static GString *edited_copy(const GString *base) {
+    gchar **lines = g_strsplit(base->str, "\n", -1);
+    guint n = g_strv_length(lines);
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i + 1 < n; ++i) {
+        gint32 roll = g_test_rand_int_range(0, 100);
+        if (roll < 8) continue;
+        if (roll < 16) g_string_append_printf(text, "new %c\n", 'a' + g_test_rand_int_range(0, 8));
+        g_string_append_printf(text, "%s\n", lines[i]);
+    }
+    g_strfreev(lines);
+    return text;
+}
+
+static void assert_same_edits(const GArray *got, const GArray *want) {
+    g_assert_cmpuint(got->len, ==, want->len);
+    for (guint k = 0; k < got->len; ++k) {
+        const DiffEdit *x = &g_array_index(got, DiffEdit, k);
+        const DiffEdit *y = &g_array_index(want, DiffEdit, k);
+        g_assert_cmpint(x->type, ==, y->type);
+        g_assert_cmpuint(x->left_start, ==, y->left_start);
+        g_assert_cmpuint(x->right_start, ==, y->right_start);
+        g_assert_cmpuint(x->length, ==, y->length);
+    }
+}
+
+static void check_run(NWayCompare *cmp, guint n, guint base) {
+    Collected collected = { { 0 }, g_ptr_array_new_with_free_func((GDestroyNotify)nway_column_free) };
+    g_mutex_init(&collected.lock);
+    nway_compare_run(cmp, base, collect_column, &collected);
+    g_assert_cmpuint(collected.columns->len, ==, n - 1);
+
+    gboolean *seen = g_new0(gboolean, n);
+    const LineTable *left = nway_compare_get_lines(cmp, base);
+    for (guint c = 0; c < collected.columns->len; ++c) {
+        const NWayColumn *column = g_ptr_array_index(collected.columns, c);
+        g_assert_cmpuint(column->base, ==, base);
+        g_assert_cmpuint(column->column, <, n);
+        g_assert_cmpuint(column->column, !=, base);
+        g_assert_false(seen[column->column]);
+        seen[column->column] = TRUE;
+
+        const LineTable *right = nway_compare_get_lines(cmp, column->column);
+        GArray *want = myers_diff_sequence((const guint64 *)left->hashes->data, left->n_lines,
+                                           (const guint64 *)right->hashes->data, right->n_lines);
+        assert_same_edits(column->edits, want);
+        guint inserted = 0, deleted = 0;
+        for (guint k = 0; k < want->len; ++k) {
+            const DiffEdit *e = &g_array_index(want, DiffEdit, k);
+            if (e->type == DIFF_OP_INSERT) inserted += e->length;
+            else if (e->type == DIFF_OP_DELETE) deleted += e->length;
+        }
+        g_assert_cmpuint(column->inserted, ==, inserted);
+        g_assert_cmpuint(column->deleted, ==, deleted);
+        g_array_unref(want);
+    }
+    g_free(seen);
+    g_ptr_array_unref(collected.columns);
+    g_mutex_clear(&collected.lock);
+}
+
+static void run_case(const char *dir, guint n, gboolean missing) {
+    GString *base = random_text(g_test_rand_int_range(0, 300));
+    GPtrArray *texts = g_ptr_array_new_with_free_func((GDestroyNotify)g_free);
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    for (guint i = 0; i < n; ++i) {
+        GString *text = i == 0 ? g_string_new(base->str) : edited_copy(base);
+        gchar *name = g_strdup_printf("version_%u.txt", i);
+        gchar *path = g_build_filename(dir, name, NULL);
+        /* The last version may be one that is not there */
+        if (!(missing && i == n - 1)) g_assert_true(g_file_set_contents(path, text->str, (gssize)text->len, NULL));
+        g_ptr_array_add(texts, g_string_free(text, FALSE));
+        g_ptr_array_add(paths, path);
+        g_free(name);
+    }
+
+    NWayCompare *cmp = nway_compare_new((const char *const *)paths->pdata, n);
+    nway_compare_load(cmp);
+    for (guint i = 0; i < n; ++i) {
+        const char *text = g_ptr_array_index(texts, i);
+        const LineTable *lines = nway_compare_get_lines(cmp, i);
+        g_assert_nonnull(lines);
+        if (missing && i == n - 1) {
+            g_assert_true(g_str_has_prefix(nway_compare_get_display(cmp, i), "(could not read "));
+            g_assert_cmpuint(lines->n_lines, ==, 0);
+            continue;
+        }
+        g_assert_cmpstr(nway_compare_get_display(cmp, i), ==, text);
+        LineTable *fresh = line_table_new(text, strlen(text));
+        g_assert_cmpuint(lines->n_lines, ==, fresh->n_lines);
+        g_assert_cmpmem(lines->hashes->data, lines->n_lines * sizeof(guint64),
+                        fresh->hashes->data, fresh->n_lines * sizeof(guint64));
+        line_table_free(fresh);
+    }
+    /* Every base in turn, as the window's base choice does, over the same loaded versions */
+    for (guint b = 0; b < n; ++b) check_run(cmp, n, b);
+    nway_compare_free(cmp);
+
+    for (guint i = 0; i < n; ++i) g_remove(g_ptr_array_index(paths, i));
+    g_ptr_array_unref(paths);
+    g_ptr_array_unref(texts);
+    g_string_free(base, TRUE);
+}
+
+static gchar *scratch_dir(void) {
+    gchar *dir = g_dir_make_tmp("nway_compare_test_XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    return dir;
+}
+
+static void test_against_pairwise(void) {
+    gchar *dir = scratch_dir();
+    for (int c = 0; c < 20; ++c) run_case(dir, g_test_rand_int_range(2, MAX_VERSIONS + 1), FALSE);
+    g_rmdir(dir);
+    g_free(dir);
+}
+
+static void test_unreadable_version(void) {
+    gchar *dir = scratch_dir();
+    for (int c = 0; c < 5; ++c) run_case(dir, g_test_rand_int_range(2, MAX_VERSIONS + 1), TRUE);
+    g_rmdir(dir);
+    g_free(dir);
+}
+
+static void test_cancelled(void) {
+    const char *paths[3] = { "a", "b", "c" };
+    NWayCompare *cmp = nway_compare_new(paths, 3);
+    nway_compare_load(cmp);
+    nway_compare_cancel(cmp);
+    Collected collected = { { 0 }, g_ptr_array_new_with_free_func((GDestroyNotify)nway_column_free) };
+    g_mutex_init(&collected.lock);
+    nway_compare_run(cmp, 0, collect_column, &collected);
+    g_assert_cmpuint(collected.columns->len, ==, 0);
+    g_ptr_array_unref(collected.columns);
+    g_mutex_clear(&collected.lock);
+    nway_compare_free(cmp);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/nway-compare/against-pairwise", test_against_pairwise);
+    g_test_add_func("/nway-compare/unreadable-version", test_unreadable_version);
+    g_test_add_func("/nway-compare/cancelled", test_cancelled);
+    return g_test_run();
+}
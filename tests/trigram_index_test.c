@@ -0,0 +1,160 @@
+/*
+ * trigram_index_search() against a naive substring scan.
+ *
+ * Versions of random text over a small alphabet (so most trigrams occur in
+ * many documents) are recorded in a scratch data directory, more than
+ * TRIGRAM_COMPACT_DOCS of them so the index is both compacted and pending.
+ * Needles cut from the documents, random needles and needles shorter than a
+ * trigram must match exactly the documents a scan finds them in, with and
+ * without a 'within' set, after reopening the index and after deletes.
+ */
+#include "trigram_index.h"
+#include "version_store.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define N_DOCS (TRIGRAM_COMPACT_DOCS + 44)
+#define ALPHABET "abcde \n"
+
+typedef struct {
+    gchar *stored;      /* name under data/versions */
+    gchar *contents;
+    gboolean deleted;
+} Doc;
+
+static Doc docs[N_DOCS];
+
+static gchar *random_text(guint length) {
+    gchar *text = g_malloc(length + 1);
+    for (guint i = 0; i < length; ++i) text[i] = ALPHABET[g_test_rand_int_range(0, sizeof(ALPHABET) - 1)];
+    text[length] = '\0';
+    return text;
+}
+
+static gboolean naive_contains(const char *haystack, const char *needle) {
+    gsize n = strlen(haystack), m = strlen(needle);
+    for (gsize i = 0; i + m <= n; ++i) {
+        if (memcmp(haystack + i, needle, m) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static void check_needle(const char *needle, GHashTable *within) {
+    GHashTable *matches = trigram_index_search(needle, within);
+    guint expected = 0;
+    for (guint i = 0; i < N_DOCS; ++i) {
+        if (docs[i].deleted || (within && !g_hash_table_contains(within, docs[i].stored))) continue;
+        gboolean found = naive_contains(docs[i].contents, needle);
+        g_assert_true(found == g_hash_table_contains(matches, docs[i].stored));
+        if (found) expected++;
+    }
+    /* ...and nothing else */
+    g_assert_cmpuint(g_hash_table_size(matches), ==, expected);
+    g_hash_table_unref(matches);
+}
+
+static void check_needles(GHashTable *within) {
+    for (int i = 0; i < 200; ++i) {
+        /* A piece of some document, so most needles match something */
+        const Doc *doc = &docs[g_test_rand_int_range(0, N_DOCS)];
+        gsize length = strlen(doc->contents);
+        if (length == 0) continue;
+        gsize start = g_test_rand_int_range(0, (gint32)length);
+        gsize take = MIN((gsize)g_test_rand_int_range(1, 12), length - start);
+        gchar *needle = g_strndup(doc->contents + start, take);
+        check_needle(needle, within);
+        g_free(needle);
+    }
+    for (int i = 0; i < 100; ++i) {
+        gchar *needle = random_text(g_test_rand_int_range(1, 8));
+        check_needle(needle, within);
+        g_free(needle);
+    }
+    check_needle("not in any document", within);
+}
+
+static void test_record(void) {
+    for (guint i = 0; i < N_DOCS; ++i) {
+        gchar *name = g_strdup_printf("doc_%u.txt", i);
+        gchar *path = g_canonicalize_filename(name, NULL);
+        docs[i].contents = random_text(g_test_rand_int_range(0, 600));
+        g_assert_true(g_file_set_contents(path, docs[i].contents, -1, NULL));
+        GError *error = NULL;
+        docs[i].stored = version_store_record(path, &error);
+        g_assert_no_error(error);
+        g_assert_nonnull(docs[i].stored);
+        g_free(path);
+        g_free(name);
+    }
+    check_needles(NULL);
+}
+
+static void test_within(void) {
+    GHashTable *within = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < N_DOCS; ++i) {
+        if (g_test_rand_int_range(0, 4) == 0) g_hash_table_add(within, docs[i].stored);
+    }
+    check_needles(within);
+    g_hash_table_unref(within);
+}
+
+/* The index is read back from data/trigram/ */
+static void test_reopen(void) {
+    trigram_index_close();
+    check_needles(NULL);
+}
+
+static void test_deleted(void) {
+    for (guint i = 0; i < N_DOCS; i += 3) {
+        gchar *stored_path = version_store_stored_path(docs[i].stored);
+        GError *error = NULL;
+        g_assert_true(version_store_delete(stored_path, &error));
+        g_assert_no_error(error);
+        docs[i].deleted = TRUE;
+        g_free(stored_path);
+    }
+    check_needles(NULL);
+}
+
+static gboolean remove_tree(const char *path) {
+    if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        if (dir) {
+            const char *name;
+            while ((name = g_dir_read_name(dir))) {
+                gchar *child = g_build_filename(path, name, NULL);
+                remove_tree(child);
+                g_free(child);
+            }
+            g_dir_close(dir);
+        }
+    }
+    return g_remove(path) == 0;
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+    /* In order: each step searches what the ones before it recorded */
+    g_test_add_func("/trigram-index/record", test_record);
+    g_test_add_func("/trigram-index/within", test_within);
+    g_test_add_func("/trigram-index/reopen", test_reopen);
+    g_test_add_func("/trigram-index/deleted", test_deleted);
+
+    /* version_store works on ./data */
+    gchar *cwd = g_get_current_dir();
+    gchar *root = g_dir_make_tmp("trigram_index_test_XXXXXX", NULL);
+    g_assert_nonnull(root);
+    g_assert_cmpint(g_chdir(root), ==, 0);
+    int status = g_test_run();
+    trigram_index_close();
+    g_chdir(cwd);
+    remove_tree(root);
+    for (guint i = 0; i < N_DOCS; ++i) {
+        g_free(docs[i].stored);
+        g_free(docs[i].contents);
+    }
+    g_free(root);
+    g_free(cwd);
+    return status;
+}